@@ -385,6 +385,14 @@ struct BloomBits {
   }
 };
 
+/* a route change, prefix hash added or removed, logged for delta updates */
+struct BloomDeltaOp {
+  uint32_t hash;       /* prefix hash */
+  uint16_t prefix_len; /* prefix length or SUB_RTE */
+  int32_t  cnt;        /* net adds, negative for removes */
+};
+typedef ArrayCount< BloomDeltaOp, 64 > BloomDeltaOps;
+
 /* serialize BloomBits,
  *   distinct sections:
  *     1. bloom bits set,
@@ -429,6 +437,18 @@ struct BloomCodec : public ArraySpace< uint32_t, 1024 > {
   void encode_geom( const BloomBits &bits ) noexcept;
   void encode_bloom( const BloomBits &bits ) noexcept;
   void encode_ht( const BloomBits &bits ) noexcept;
+  /* delta of route changes after from_seqno, ops[] is sorted and merged:
+   *   version, from_seqno                      <- 12 bytes
+   *   | prefix_len << 16 | del | cnt | bucket  <- 4 bytes, bucket = hash>>30
+   *   | nvals                                  <- 4 bytes
+   *   |   hash & 0x3fffffff 0 -> nvals         <- delta codes
+   *   V   cnt - 1 0 -> nvals, if cnt flag      <- int codes
+   *   (repeat for each group) */
+  static uint32_t merge_ops( BloomDeltaOp *ops,  uint32_t nops ) noexcept;
+  void encode_ops( uint64_t from_seqno,  BloomDeltaOp *ops,
+                   uint32_t nops ) noexcept;
+  bool decode_ops( uint64_t &from_seqno,  BloomDeltaOps &ops,
+                   const void *code,  size_t len ) noexcept;
 
   BloomBits *decode( uint32_t *pref,  size_t npref,
                      void *&details,  size_t &details_size,
@@ -96,7 +96,8 @@ enum EvSockFlags {
   IN_WRITE_QUEUE = 8, /* in write queue, stuck in epoll for write */
   IN_EPOLL_READ  = 16,/* in epoll set waiting for read (normal) */
   IN_EPOLL_WRITE = 32,/* in epoll set waiting for write (if blocked) */
-  IN_SOCK_MEM    = 64 /* alloced from sock mem */
+  IN_SOCK_MEM    = 64,/* alloced from sock mem */
+  IN_FLUSH_QUEUE = 128 /* in flush queue, write held for coalescing */
 };
 
 enum EvSockErr {
@@ -119,10 +120,24 @@ enum EvSockErr {
   EV_ERR_ADD_MCAST     = 16, /* join multicast network */
   EV_ERR_CONN_SELF     = 17, /* connected to self */
   EV_ERR_READ_OVERFLOW = 18, /* connected to self */
-  EV_ERR_LAST          = 19  /* extend errors after LAST */
+  EV_ERR_SEND_MEM      = 19, /* closed to shed send buffer mem */
+  EV_ERR_LAST          = 20  /* extend errors after LAST */
 };
 bool ev_would_block( int err ) noexcept;
 
+/* what to do when EvPoll::send_mem is over send_mem_max */
+enum EvShedPolicy {
+  SHED_DROP_LOSSY = 1, /* drop lossy subject msgs to backed up socks */
+  SHED_CLOSE_SLOW = 2, /* close the sock holding the most send mem */
+  SHED_PAUSE_READ = 4  /* limit reads to blocked_read_rate */
+};
+
+/* subject options, EvPoll::add_subj_opt() */
+enum EvSubjOpt {
+  SUBJ_LOSSY    = 1, /* may drop when over send_mem_max, SHED_DROP_LOSSY */
+  SUBJ_CONFLATE = 2  /* only the last msg is sent while sock write blocked */
+};
+
 enum EvSubState {
   EV_SUBSCRIBED     = 1,
   EV_NOT_SUBSCRIBED = 2,
@@ -153,11 +168,19 @@ struct EvSocket : public PeerData /* fd and address of peer */EV_DBG_INHERIT {
                 msgs_recv,
                 msgs_sent,
                 bytes_active,
-                sock_unused[ 7 ];
+                wr_hold_ns, /* when a coalesced write was first held */
+                send_mem,   /* send buffer bytes alloced by ev_poll_alloc() */
+                msgs_conflated, /* msgs replaced while write blocked */
+                pause_ns,   /* when a paused read resumes, 0 = not paused */
+                sock_unused[ 3 ];
 
   EvSocket( EvPoll &p,  const uint8_t t,  const uint8_t b = EV_OTHER_BASE )
     : poll( p ), prio_cnt( 0 ), sock_state( 0 ),  sock_opts( 0 ),
-      sock_type( t ), sock_flags( 0 ), sock_base( b ) { this->init_stats(); }
+      sock_type( t ), sock_flags( 0 ), sock_base( b ) {
+    this->send_mem = 0;
+    this->pause_ns = 0;
+    this->init_stats();
+  }
   void init_stats( void ) {
     this->sock_err     = 0;
     this->sock_errno   = 0;
@@ -168,6 +191,8 @@ struct EvSocket : public PeerData /* fd and address of peer */EV_DBG_INHERIT {
     this->msgs_recv    = 0;
     this->msgs_sent    = 0;
     this->bytes_active = 0;
+    this->wr_hold_ns   = 0;
+    this->msgs_conflated = 0;
   }
   int set_sock_err( uint16_t serr,  uint16_t err ) noexcept;
   /* if socket mem is free */
@@ -175,7 +200,7 @@ struct EvSocket : public PeerData /* fd and address of peer */EV_DBG_INHERIT {
     return ( this->sock_opts & o ) != 0;
   }
   /* flags: IN_ACTIVE_LIST, IN_FREE_LIST, IN_EVENT_QUEUE, IN_WRITE_QUEUE,
-   *        IN_EPOLL_READ, IN_EPOLL_WRITE, IN_SOCK_MEM */
+   *        IN_EPOLL_READ, IN_EPOLL_WRITE, IN_SOCK_MEM, IN_FLUSH_QUEUE */
   bool test_flags( EvSockFlags f,  uint16_t test ) const {
     if ( f == IN_NO_LIST ) /* zero */
       return ( this->sock_flags & test ) == 0;
@@ -191,13 +216,14 @@ struct EvSocket : public PeerData /* fd and address of peer */EV_DBG_INHERIT {
     this->sock_flags &= ~( IN_ACTIVE_LIST | IN_FREE_LIST );
     this->sock_flags |= l;
   }
-  /* if in event queue or write queue */
+  /* if in event queue, write queue or flush queue */
   bool in_queue( EvSockFlags q ) const {
-    return this->test_flags( q, IN_EVENT_QUEUE | IN_WRITE_QUEUE );
+    return this->test_flags( q, IN_EVENT_QUEUE | IN_WRITE_QUEUE |
+                                IN_FLUSH_QUEUE );
   }
-  /* either event or write queue, not both */
+  /* one of event, write or flush queue, not more than one */
   void set_queue( EvSockFlags q ) {
-    this->sock_flags &= ~( IN_EVENT_QUEUE | IN_WRITE_QUEUE );
+    this->sock_flags &= ~( IN_EVENT_QUEUE | IN_WRITE_QUEUE | IN_FLUSH_QUEUE );
     this->sock_flags |= q;
   }
   /* either read or write epoll, not both */
@@ -358,16 +384,92 @@ struct BPWait : public ArraySpace<BPList, 64> {
   void pop( uint32_t fd,  BPData &data ) noexcept;
 };
 
+/* a publish held for a write blocked sock, the msg is followed by
+ * hash[ prefix_cnt ], prefix[ prefix_cnt ], subject, reply */
+struct ConflateMsg {
+  RoutePublish * sub_route;
+  PeerId         src_route;
+  uint32_t       buf_size,
+                 msg_len,
+                 subj_hash,
+                 msg_enc,
+                 shard,
+                 hdr_len,
+                 suf_len,
+                 pub_host;
+  uint16_t       subject_len,
+                 reply_len,
+                 pub_status;
+  uint8_t        publish_type,
+                 prefix_cnt;
+  uint64_t       cnt;
+  char           buf[ 8 ];
+
+  static size_t alloc_size( const EvPublish &pub ) noexcept;
+  void set( const EvPublish &pub ) noexcept;
+};
+
+/* the conflated msgs of a sock, held until the sock is write ready, a msg
+ * with the same subj_hash replaces the one held */
+struct ConflateQueue : public BPData {
+  EvPoll       & poll;
+  UIntHashTab  * ht;  /* subj_hash -> msg[] index */
+  ArrayCount<ConflateMsg *, 16> msg; /* held msgs, in order of arrival */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  ConflateQueue( EvPoll &p ) : poll( p ), ht( 0 ) {}
+  enum { HOLD_NO_MEM = -1, HOLD_NEW = 0, HOLD_REPLACED = 1 };
+  int hold( EvPublish &pub ) noexcept;  /* HOLD_REPLACED if replaced a msg */
+  void flush( EvSocket &s ) noexcept;   /* send held msgs until blocked */
+  void release( void ) noexcept;        /* free held msgs */
+  virtual void on_write_ready( void ) noexcept;
+};
+
+/* a buffer referenced by the iovecs of StreamBufs, owner is the fd of the
+ * recv buffer, ZREF_POOL when copied from a publish by zero_copy_pub(), or
+ * the next free index when ref_count is zero */
 struct ZeroRef {
   char   * buf;
   uint32_t ref_count,
            owner,
            buf_size;
 };
+static const uint32_t ZREF_POOL = (uint32_t) -2;
 
 static const size_t FREE_BUF_MAX_SIZE = 2 * 1024 * 1024;
 typedef Balloc<16 * 1024, FREE_BUF_MAX_SIZE> Balloc16k_2m;
 
+/* wakes up poll() when the oldest write held for coalescing expires or
+ * when paused reads resume */
+struct EvFlushTimer : public EvTimerCallback {
+  EvPoll      & poll;
+  uint64_t      expires_ns, /* when the armed timer fires, 0 = not armed */
+                timer_id;   /* incremented when armed */
+  const bool    is_pause;   /* resume_read() instead of flush_held() */
+  EvFlushTimer( EvPoll &p,  bool pause ) : poll( p ), expires_ns( 0 ),
+    timer_id( 0 ), is_pause( pause ) {}
+  bool arm( uint64_t ns ) noexcept; /* false if the timer was not armed */
+  virtual bool timer_cb( uint64_t timer_id,  uint64_t event_id ) noexcept;
+};
+
+/* counters of the poll, not of a socket, from EvPoll::poll_stats() */
+struct PollStats {
+  uint64_t send_cnt,    /* send syscalls, msgs_sent / send_cnt is coalescing */
+           wr_hold,     /* writes held for coalescing */
+           wr_flush,    /* held writes flushed */
+           conflated,   /* SUBJ_CONFLATE msgs replaced */
+           send_mem,    /* send buffer bytes of all socks */
+           send_mem_peak,
+           cache_hit,   /* route cache */
+           cache_miss,
+           cache_inval,
+           cache_evict,
+           shed_drop,   /* send mem shedding */
+           shed_close,
+           shed_pause;
+};
+
 struct EvPoll {
   static bool is_event_greater( EvSocket *s1,  EvSocket *s2 ) {
     int x1 = kv_ffsw( s1->sock_state ),
@@ -379,10 +481,15 @@ struct EvPoll {
     /* active_ns is set when epoll says sock is read ready */
     return s1->PeerData::active_ns < s2->PeerData::active_ns;
   }
+  static bool is_hold_older( EvSocket *s1,  EvSocket *s2 ) {
+    return s1->wr_hold_ns < s2->wr_hold_ns;
+  }
   /* order by event priority */
   kv::PrioQueue<EvSocket *, EvPoll::is_event_greater> ev_queue;
   /* order by last active time */
   kv::PrioQueue<EvSocket *, EvPoll::is_active_older>  ev_write;
+  /* order by time a write was held, for coalescing */
+  kv::PrioQueue<EvSocket *, EvPoll::is_hold_older>    ev_flush;
 
   void push_event_queue( EvSocket *s ) {
     if ( s->in_queue( IN_NO_QUEUE ) ) {
@@ -411,10 +518,26 @@ struct EvPoll {
       this->ev_write.remove( s );
     }
   }
+  /* sock has a small low priority write, hold it until wr_coalesce_ns
+   * passes so that more msgs are sent with the same sendmsg() */
+  void push_flush_queue( EvSocket *s ) {
+    if ( s->in_queue( IN_NO_QUEUE ) ) {
+      s->set_queue( IN_FLUSH_QUEUE );
+      this->ev_flush.push( s );
+    }
+  }
+  void remove_flush_queue( EvSocket *s ) {
+    if ( s->in_queue( IN_FLUSH_QUEUE ) ) {
+      s->set_queue( IN_NO_QUEUE );
+      this->ev_flush.remove( s );
+    }
+  }
 
   EvSocket           ** sock;            /* sock array indexed by fd */
   struct epoll_event  * ev;              /* event array used by epoll() */
   TimerQueue            timer;           /* timer events */
+  EvFlushTimer          flush_timer,     /* expires held writes */
+                        pause_timer;     /* resumes paused reads */
   EvPrefetchQueue     * prefetch_queue;  /* ordering keys */
   FDSetStack            fd_stk;
   BPWait                bp_wait;
@@ -428,13 +551,31 @@ struct EvPoll {
                         init_ns,         /* when map or poll was created */
                         mono_ns,         /* monotonic updated by current  */
                         coarse_ns,
-                        coarse_mono;
-  uint32_t              fdcnt,           /* num fds in poll set */
+                        coarse_mono,
+                        wr_coalesce_ns,  /* hold low prio writes, 0 = off */
+                        wr_hold_cnt,     /* count of writes held */
+                        wr_flush_cnt,    /* count of held writes flushed */
+                        wr_send_cnt,     /* count of send syscalls */
+                        send_mem,        /* send buffer bytes of all socks */
+                        send_mem_peak,   /* max send_mem */
+                        send_mem_max,    /* shed when send_mem over, 0 = off */
+                        shed_drop_cnt,   /* lossy msgs dropped */
+                        conflate_cnt,    /* msgs replaced by SUBJ_CONFLATE */
+                        shed_close_cnt,  /* slow socks closed */
+                        shed_pause_cnt,  /* reads paused */
+                        pause_start_ns,  /* when reads limited, 0 = not */
+                        pause_recv,      /* bytes read since pause_start_ns */
+                        shed_slow_ns,    /* last shed_slow() scan */
+                        subj_opt_mask;   /* prefix lens of subj_opt_ht */
+  UIntHashTab         * subj_opt_ht;     /* subject hash -> opt<<8 | pre len */
+  uint32_t              shed_policy,     /* EvShedPolicy bits */
+                        fdcnt,           /* num fds in poll set */
                         wr_count,        /* num fds with write set */
                         maxfd,           /* current maximum fd number */
                         nfds,            /* max epoll() fds, array sz ev[] */
                         send_highwater,  /* when to backpressure sends */
-                        recv_highwater;  /* size of recv buffer & processed */
+                        recv_highwater,  /* size of recv buffer & processed */
+                        wr_coalesce_size;/* write held data when less than */
   int                   efd,             /* epoll fd */
                         null_fd,         /* /dev/null fd for null sockets */
                         quit;            /* when > 0, wants to exit */
@@ -457,6 +598,10 @@ struct EvPoll {
   void                  * sock_mem;
   size_t                  sock_mem_left;
   ArrayCount<ZeroRef, 64> zref;
+  ArrayCount<uint32_t, 16> zref_pub;  /* zero_copy_pub() refs held by poll */
+  uint32_t                zref_free;  /* free zref[] list, index + 1 */
+  ArraySpace<ConflateQueue *, 64> conflate_q; /* conflated msgs by fd */
+  ArrayCount<EvSocket *, 16> pause_list; /* socks with pause_ns != 0 */
   Balloc16k_2m          * free_buf;
 
   void * operator new( size_t, void *ptr ) { return ptr; }
@@ -466,10 +611,14 @@ struct EvPoll {
                         DEFAULT_NS_KEEPALIVE       = 10 * ONE_NS,
                         DEFAULT_NS_WRTIMEOUT       = 15 * ONE_NS,
                         DEFAULT_NS_CONNECT_TIMEOUT =  1 * ONE_NS,
-                        DEFAULT_BLOCKED_READ_RATE  = 25 * 1024 * 1024;
+                        DEFAULT_BLOCKED_READ_RATE  = 25 * 1024 * 1024,
+                        SHED_SLOW_IVAL_NS          = ONE_NS / 1000;
   static const uint32_t DEFAULT_RCV_BUFSIZE        = 16 * 1024;
+  static const uint32_t DEFAULT_COALESCE_SIZE      = 16 * 1024;
 
   EvPoll() noexcept;
+  /* fill ps with the counters of the poll */
+  void poll_stats( PollStats &ps ) const noexcept;
 
   /* alloc ALLOC_INCR(64) elems of the above list elems at a time, aligned 64 */
   template<class T, class... Ts>
@@ -517,6 +666,8 @@ struct EvPoll {
     WRITE_PRESSURE = 8  /* something in a write hi state, retry write again */
   };
   int dispatch( void ) noexcept;          /* process any sock in the queues */
+  bool hold_write( EvSocket *s ) noexcept; /* coalesce EV_WRITE if small */
+  bool flush_held( void ) noexcept;       /* push expired holds to ev_queue */
   void drain_prefetch( void ) noexcept;   /* process prefetches */
   void update_time_ns( void ) noexcept;   /* update mono_ns and now_ns */
   uint64_t current_coarse_ns( void ) noexcept; /* current time */
@@ -535,7 +686,38 @@ struct EvPoll {
   uint32_t zero_copy_ref( uint32_t src_route,  const void *msg,
                           size_t msg_len ) noexcept;
   void zero_copy_deref( uint32_t zref_index,  bool owner ) noexcept;
+  uint32_t zero_copy_alloc( void ) noexcept;
+  /* ref pub.msg for fan-out, the first call may copy it to the pool and
+   * update pub.msg, the following calls with the same pub share the ref */
+  uint32_t zero_copy_pub( EvPublish &pub ) noexcept;
+  void zero_copy_release_pub( void ) noexcept; /* after event dispatched */
   uint32_t zero_copy_ref_count( uint32_t ref_index ) noexcept;
+  /* send buffer mem cap, send_mem_max, is enforced by shed_policy */
+  bool over_send_mem( void ) const {
+    return this->send_mem_max != 0 && this->send_mem > this->send_mem_max;
+  }
+  /* set EvSubjOpt of subject or prefix ( "MD.", prefix len 3 ) */
+  void add_subj_opt( const char *sub,  size_t len,  bool is_prefix,
+                     uint32_t opt ) noexcept;
+  void add_lossy( const char *sub,  size_t len,  bool is_prefix ) {
+    this->add_subj_opt( sub, len, is_prefix, SUBJ_LOSSY );
+  }
+  void add_conflate( const char *sub,  size_t len,  bool is_prefix ) {
+    this->add_subj_opt( sub, len, is_prefix, SUBJ_CONFLATE );
+  }
+  uint32_t subj_opt( const EvPublish &pub ) noexcept;
+  bool has_conflate( uint32_t fd ) const {
+    return fd < this->conflate_q.size && this->conflate_q.ptr[ fd ] != NULL &&
+           this->conflate_q.ptr[ fd ]->msg.count > 0;
+  }
+  /* true if msg to s is conflated or dropped, when subj_opt_ht is set */
+  bool hold_msg( EvSocket &s,  EvPublish &pub ) noexcept;
+  void release_conflate( uint32_t fd ) noexcept;
+  bool shed_read( EvSocket *s ) noexcept;                 /* true if paused */
+  void resume_read( void ) noexcept;            /* push paused reads */
+  void remove_pause( EvSocket *s ) noexcept;    /* remove from pause_list */
+  void shed_slow( void ) noexcept;              /* close largest send mem */
+  void *poll_alloc( EvSocket &sock,  size_t size ) noexcept;
   static void *ev_poll_alloc( void *cl,  size_t size ) noexcept;
   void poll_free( void *ptr,  size_t size ) noexcept;
   static void ev_poll_free( void *cl,  void *ptr,  size_t size ) noexcept;
@@ -641,6 +823,9 @@ struct EvConnection : public EvSocket, public StreamBuf {
       }
     }
     this->reset_recv();
+    /* unsent zero copy refs */
+    for ( uint32_t i = 0; i < this->StreamBuf::ref_cnt; i++ )
+      this->poll.zero_copy_deref( this->StreamBuf::refs[ i ], false );
     this->StreamBuf::release();
   }
   void reset_recv( void ) {
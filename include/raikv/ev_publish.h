@@ -14,6 +14,7 @@ enum EvPubType {
   PUB_TYPE_KV       = 6,  /* kv internal publish */
   PUB_TYPE_INBOX    = 7,  /* extra inbox info, source from inbox */
   PUB_TYPE_IPC      = 8,  /* extra source info, b4 routed to ipc */
+  PUB_TYPE_BUS      = 9,  /* from another thread through the route bus */
   PUB_TYPE_QUEUE    = 128 /* forward queue publish */
 };
 
@@ -46,6 +47,7 @@ struct EvPublish {
                  prefix_cnt;  /* count of prefix[] */
   uint16_t       pub_status;  /* EvPubStatus, if msg loss */
   uint32_t       pub_host,    /* host id of publish */
+                 msg_ref,     /* EvPoll::zero_copy_pub() ref of msg */
                * hash;        /* the prefix hashes which match */
   uint8_t      * prefix;      /* the prefixes which match */
   uint64_t       cnt;         /* publish counter */
@@ -63,7 +65,8 @@ struct EvPublish {
       reply_len( (uint16_t) repl_len ), msg_len( (uint32_t) mesg_len ), subj_hash( shash ),
       msg_enc( msg_encoding ), shard( 0 ), hdr_len( 0 ), suf_len( 0 ),
       publish_type( pub_type ), prefix_cnt( 0 ), pub_status( status ),
-      pub_host( host ), hash( 0 ), prefix( 0 ), cnt( counter ) {}
+      pub_host( host ), msg_ref( 0 ), hash( 0 ), prefix( 0 ),
+      cnt( counter ) {}
 
   EvPublish( const EvPublish &p )
     : subject( p.subject ), reply( p.reply ), msg( p.msg ),
@@ -71,7 +74,8 @@ struct EvPublish {
       reply_len( p.reply_len ), msg_len( p.msg_len ), subj_hash( p.subj_hash ),
       msg_enc( p.msg_enc ), shard( p.shard ), hdr_len( p.hdr_len ), suf_len( p.suf_len ),
       publish_type( p.publish_type ), prefix_cnt( 0 ), pub_status( p.pub_status ),
-      pub_host( p.pub_host ), hash( 0 ), prefix( 0 ), cnt( p.cnt ) {}
+      pub_host( p.pub_host ), msg_ref( p.msg_ref ), hash( 0 ), prefix( 0 ),
+      cnt( p.cnt ) {}
 
   bool is_pub_type( EvPubType t ) const { return ( this->publish_type & 0x7f ) == t; }
   bool is_queue_pub( void ) const { return ( this->publish_type & PUB_TYPE_QUEUE ) != 0; }
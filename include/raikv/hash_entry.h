@@ -109,6 +109,26 @@ struct KeyFragment : public kv_key_frag_s {
     if ( (seed[ 6 ] &= ~ZOMBIE64) <= DROPPED_HASH)
       seed[ 6 ] = DROPPED_HASH + 1;
   }
+  /* seed[ 0 ], seed[ 1 ] is the seed, results are in seed[ i*2 ], [ i*2+1 ],
+   * batched 8 at a time with kv_hash_meow128_array() */
+  static inline void hash_array( KeyFragment **kb,  uint64_t *seed,
+                                 size_t count ) {
+    const uint64_t k1 = seed[ 0 ], k2 = seed[ 1 ];
+    const void   * p[ 8 ];
+    size_t         sz[ 8 ], i, j, n;
+    for ( i = 0; i < count; i += n ) {
+      n = ( count - i < 8 ? count - i : 8 );
+      for ( j = 0; j < n; j++ ) {
+        p[ j ]  = kb[ i + j ]->u.buf;
+        sz[ j ] = kb[ i + j ]->keylen;
+      }
+      seed[ i * 2 ] = k1; seed[ i * 2 + 1 ] = k2;
+      kv_hash_meow128_array( p, sz, &seed[ i * 2 ], n );
+    }
+    for ( i = 0; i < count * 2; i += 2 )
+      if ( (seed[ i ] &= ~ZOMBIE64) <= DROPPED_HASH)
+        seed[ i ] = DROPPED_HASH + 1;
+  }
 };
 
 /* flags attached to hash entry and msg value */
@@ -236,6 +256,25 @@ struct ValueCtr { /* packed 64 bit immediate size & serial & seal */
                 |                     |
      Value CTR  |  2b = size/seal     | 56 -> 58   Always present
                 |  6b = serial cnt    | 58 -> 64       "
+
+   HashEntry layout (compact, when hash_entry_size=32):
+     What       |  Fields             | Offset
+    ------------+---------------------+----------
+     Header     |  8b = hash          |  0 ->  8   Always present
+                |  4b = hash2         |  8 -> 12   Low 32 bits of hash2
+     Value PTR  |  4b = offset        | 12 -> 16   When value is in segment
+                |  2b = segment       | 16 -> 18   (val)
+     Header     |  1b = db            | 18 -> 19   Always present
+                |  1b = type          | 19 -> 20       "
+                |  2b = flags         | 20 -> 22       "
+     Value PTR  |  2b = size          | 22 -> 24   (key len)
+                |                     |
+     Value CTR  |  2b = size/seal     | 24 -> 26   Always present, the serial
+                |  6b = serial cnt    | 26 -> 32   is also the value serial
+
+   The compact entry has no room for a key, immediate data or the stamps,
+   the key is always FL_PART_KEY and the value is always in a segment, the
+   value size is limited to 0xffff << seg_align_shift
 */
 struct HashEntry {
   AtomUInt64  hash;   /* the lock and the hash value */
@@ -279,6 +318,22 @@ struct HashEntry {
     return hdr_size_part();
     /*return sizeof( HashEntry );*/
   }
+  /* a 32 byte entry packs the value ptr into the header */
+  static bool is_compact( uint32_t hash_entry_size ) {
+    return hash_entry_size < 64;
+  }
+  /* the bits of hash2 used for key identity, all of them unless compact */
+  static uint64_t hash2_mask( uint32_t hash_entry_size ) {
+    return is_compact( hash_entry_size ) ? (uint64_t) 0xffffffffU :
+                                           ~(uint64_t) 0;
+  }
+  uint64_t get_hash2( uint32_t hash_entry_size ) const {
+    return this->hash2 & hash2_mask( hash_entry_size );
+  }
+  void set_hash2( uint32_t hash_entry_size,  uint64_t h2 ) {
+    const uint64_t m = hash2_mask( hash_entry_size );
+    this->hash2 = ( this->hash2 & ~m ) | ( h2 & m );
+  }
   void clear( uint32_t fl )          { this->flags &= ~fl; }
   void set( uint32_t fl )            { this->flags |= fl; }
   uint32_t test( uint32_t fl ) const { return this->flags & fl; }
@@ -319,7 +374,7 @@ struct HashEntry {
   /* before value ctr, relative stamp */
   uint32_t trail_offset( uint32_t hash_entry_size ) const {
     uint32_t sz = hash_entry_size - sizeof( ValueCtr );
-    if ( this->test( FL_SEGMENT_VALUE ) )
+    if ( this->test( FL_SEGMENT_VALUE ) && ! is_compact( hash_entry_size ) )
       sz -= sizeof( ValuePtr );
     if ( this->test( FL_SEQNO ) )
       sz -= sizeof( uint64_t );
@@ -330,6 +385,7 @@ struct HashEntry {
   void *trail_ptr( uint32_t hash_entry_size ) const {
     return this->ptr( this->trail_offset( hash_entry_size ) );
   }
+  /* not used with a compact entry, use the value_geom functions below */
   ValuePtr &value_ptr( uint32_t hash_entry_size ) {
     uint32_t sz = hash_entry_size - ( sizeof( ValueCtr ) + sizeof( ValuePtr ) );
     if ( this->test( FL_EXPIRE_STAMP | FL_UPDATE_STAMP ) )
@@ -358,13 +414,45 @@ struct HashEntry {
   /* expand geom bits into value geom */
   void get_value_geom( uint32_t hash_entry_size,  ValueGeom &geom,
                        uint32_t align_shift ) {
+    if ( is_compact( hash_entry_size ) ) {
+      geom.segment = this->val;
+      geom.offset  = ( this->hash2 >> 32 ) << align_shift;
+      geom.size    = (uint64_t) this->key.keylen << align_shift;
+      geom.serial  = this->value_ctr( hash_entry_size ).get_serial();
+      return;
+    }
     this->value_ptr( hash_entry_size ).get( geom, align_shift );
   }
   /* compress value geom into geom bits */
   void set_value_geom( uint32_t hash_entry_size,  const ValueGeom &geom,
                        uint32_t align_shift ) {
+    if ( is_compact( hash_entry_size ) ) {
+      this->val        = (uint16_t) geom.segment;
+      this->hash2      = ( this->hash2 & 0xffffffffU ) |
+                         ( ( geom.offset >> align_shift ) << 32 );
+      this->key.keylen = (uint16_t) ( geom.size >> align_shift );
+      this->value_ctr( hash_entry_size ).set_serial( geom.serial );
+      return;
+    }
     this->value_ptr( hash_entry_size ).set( geom, align_shift );
   }
+  /* update the serial of the value, the entry is locked */
+  uint64_t set_value_serial( uint32_t hash_entry_size,  uint64_t serial ) {
+    if ( is_compact( hash_entry_size ) ) {
+      this->value_ctr( hash_entry_size ).set_serial( serial );
+      return serial;
+    }
+    return this->value_ptr( hash_entry_size ).set_serial( serial );
+  }
+  void zero_value_geom( uint32_t hash_entry_size ) {
+    if ( is_compact( hash_entry_size ) ) {
+      this->val        = 0;
+      this->hash2     &= 0xffffffffU;
+      this->key.keylen = 0;
+      return;
+    }
+    this->value_ptr( hash_entry_size ).zero();
+  }
 };
 
 } /* kv */
@@ -12,19 +12,64 @@ struct CuckooVisit {
            to_pos;
   int32_t  next;
   uint16_t to_off;
-  uint8_t  to_inc;
+  uint8_t  to_inc,
+           depth;  /* number of moves to an empty slot at to_pos */
 
   void set( uint64_t fpos,  uint64_t fhash,  uint64_t tpos,
-            uint8_t tinc,  uint16_t toff,  int32_t nxt ) {
+            uint8_t tinc,  uint16_t toff,  int32_t nxt,  uint8_t d ) {
     this->from_pos  = fpos;
     this->from_hash = fhash;
     this->to_pos    = tpos;
     this->next      = nxt;
     this->to_off    = toff;
     this->to_inc    = tinc;
+    this->depth     = d;
   }
 };
 
+/* the node[] queue of the bfs, starts on the stack and grows to the heap
+ * when the depth needs more nodes */
+struct CuckooVisitBuf {
+  CuckooVisit * ptr,
+              * stk;
+  uint32_t      size;
+
+  CuckooVisitBuf( CuckooVisit *s,  uint32_t sz )
+    : ptr( s ), stk( s ), size( sz ) {}
+  ~CuckooVisitBuf() {
+    if ( this->ptr != this->stk )
+      ::free( this->ptr );
+  }
+  bool grow( uint32_t max_size ) noexcept;
+};
+
+/* positions queued by the bfs, a position is only searched once */
+struct CuckooVisitSet {
+  static const uint32_t INIT_SIZE = 1024; /* power of 2 */
+  uint64_t * tab,                  /* pos + 1, 0 is empty */
+             init_tab[ INIT_SIZE ];
+  uint32_t   mask,
+             cnt;
+
+  CuckooVisitSet() : tab( 0 ), mask( 0 ), cnt( 0 ) {}
+  ~CuckooVisitSet() {
+    if ( this->tab != this->init_tab )
+      ::free( this->tab );
+  }
+  void reset( void ) {
+    if ( this->tab != this->init_tab ) {
+      ::free( this->tab );
+      this->tab = this->init_tab;
+    }
+    ::memset( this->init_tab, 0, sizeof( this->init_tab ) );
+    this->mask = INIT_SIZE - 1;
+    this->cnt  = 0;
+  }
+  /* true if pos is already in the set, otherwise add it */
+  bool test_set( uint64_t pos ) noexcept;
+  bool grow( void ) noexcept;
+};
+
 template <uint32_t NBITS>
 struct PositionBits {
   static const uint64_t M  = 64 - 1, /* mask */
@@ -14,8 +14,8 @@ template <class Position, bool is_blocking>
 KeyStatus
 KeyCtx::acquire( Position &next )
 {
-  ThrCtxOwner  closure( this->ht.ctx );
-  ThrCtx     & ctx     = this->ht.ctx[ this->ctx_id ];
+  ThrCtxOwner  closure( this->ht );
+  ThrCtx     & ctx     = this->ht.get_ctx( this->ctx_id );
   HashEntry  * el,              /* current ht[] ptr */
              * last,            /* last ht[] ptr */
              * drop    = NULL;  /* drop ht[] ptr */
@@ -49,7 +49,7 @@ KeyCtx::acquire( Position &next )
     if ( kv_unlikely( h != 0 && el->test( FL_DROPPED ) ) ) {
   found_drop:;
       this->drop_key   = h; /* track in case entry needs to restore tombstone */
-      this->drop_key2  = el->hash2;
+      this->drop_key2  = el->get_hash2( this->hash_entry_size );
       this->drop_flags = el->flags;
       el->flags        = FL_NO_ENTRY; /* clear the drop */
       h                = 0; /* treat as a new entry */
@@ -210,7 +210,7 @@ KeyCtx::acquire_single_thread( Position &next )
     if ( kv_unlikely( h != 0 && el->test( FL_DROPPED ) ) ) {
   found_drop:;
       this->drop_key   = h; /* track in case entry needs to restore tombstone */
-      this->drop_key2  = el->hash2;
+      this->drop_key2  = el->get_hash2( this->hash_entry_size );
       this->drop_flags = el->flags;
       el->flags        = FL_NO_ENTRY; /* clear the drop */
       h                = 0; /* treat as a new entry */
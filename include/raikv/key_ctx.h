@@ -243,7 +243,7 @@ struct KeyCtx {
   KeyStatus get_key( KeyFragment *&b ) noexcept;
   /* compare hash entry to kbuf, true if kbuf == NULL, when hash is perfect */
   bool equals( const HashEntry &el ) const {
-    return el.hash2 == this->key2;
+    return el.get_hash2( this->hash_entry_size ) == this->key2;
     /*if ( this->kbuf == NULL )
       return true;
     return this->frag_equals( el );*/
@@ -344,6 +344,14 @@ struct KeyCtx {
   KeyStatus tombstone( void ) noexcept;
   /* like tombstone and incr expired */
   KeyStatus expire( void ) noexcept;
+  /* evict other entries of the db until the quota has room for a new entry
+   * and need_bytes, false if not enough were found */
+  bool evict_db_quota( uint64_t need_bytes ) noexcept;
+  /* pin the read epoch of ctx, the values found with KEYCTX_NO_COPY_ON_READ
+   * are not moved or reused by gc until unpin_read(), resize() copies while
+   * pinned readers exist, value_update() in place is detected as mutated */
+  void pin_read( void ) noexcept;
+  void unpin_read( void ) noexcept;
   /* state set during acquire */
   void copy_acquire_state( const KeyCtx &kctx );
   /* start a new read only operation */
@@ -420,9 +428,12 @@ struct KeyCtx {
     void *p = (void *) res;
     return this->append_vector( 1, &p, &size, max_size );
   }
-  /* append a vector of count elems, where vec[ i ] -> msg @ size[ i ] */
+  /* append a vector of count elems, where vec[ i ] -> msg @ size[ i ],
+   * when is_trimmed, the list is not full if the oldest chains were trimmed
+   * with trim_msg(), used by TopicLog to keep the newest msgs */
   KeyStatus append_vector( uint64_t count,  void *vec,
-                           msg_size_t *size,  uint64_t max_size = 0 ) noexcept;
+                           msg_size_t *size,  uint64_t max_size = 0,
+                           bool is_trimmed = false ) noexcept;
   /* get the geoms of the chained messages */
   ValueGeom *get_msg_chain( uint8_t i,  ValueGeom &buf ) noexcept;
   /* fetch a messsge from a message list value */
@@ -128,6 +128,16 @@ void kv_hash_meow128_2_diff_length( const void *p, size_t sz, const void *p2,
 void kv_hash_meow128_4_diff_length( const void *p, size_t sz, const void *p2,
                                     size_t sz2, const void *p3, size_t s3,
                                     const void *p4, size_t s4, uint64_t *x );
+/* arrays of different lengths, seed in x[ 0 ], x[ 1 ], results in
+ * x[ i*2 ], x[ i*2+1 ], AES rounds of 4 or 8 keys interleaved (uses VAES
+ * ymm regs when compiled with -mvaes -mavx2) */
+void kv_hash_meow128_4_diff_length_a( const void **p, const size_t *sz,
+                                      uint64_t *x );
+void kv_hash_meow128_8_diff_length_a( const void **p, const size_t *sz,
+                                      uint64_t *x );
+/* any count, x[] is count * 2 */
+void kv_hash_meow128_array( const void **p, const size_t *sz, uint64_t *x,
+                            size_t count );
 #endif
 
 #ifdef __cplusplus
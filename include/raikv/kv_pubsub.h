@@ -112,16 +112,23 @@ struct PsCtrlFile {
 struct KvPubSub;
 struct KvMsgIn;
 
+/* pub data this size or larger is sent by reference to the recv buffer of
+ * the publisher or to a pool buffer, with EvPoll::zero_copy_pub() */
+static const uint32_t KV_ZERO_COPY_MIN_SIZE = 1024;
+
 struct KvPubSubPeer : public EvConnection {
   RoutePublish & sub_route;
   KvPubSub     & me;
   PsCtrlFile   & ctrl;
   BloomRoute   * bloom_rt;
   BloomDB        bloom_db;
+  UInt64HashTab * sent_seqno, /* ref_num -> bloom seqno sent to peer */
+                * recv_seqno; /* ref_num -> bloom seqno recv from peer */
   uint64_t       time_ns,
                  sub_seqno;
   uint32_t       ctx_id;
-  bool           is_shutdown;
+  bool           is_shutdown,
+                 in_process;  /* peer is a thread of this process */
   KvPubSubPeer * next, * back;
 
   void * operator new( size_t, void *ptr ) { return ptr; }
@@ -139,6 +146,12 @@ struct KvPubSubPeer : public EvConnection {
   void hello_msg( KvMsgIn &msg ) noexcept;
   void bloom_msg( KvMsgIn &msg ) noexcept;
   void bloom_del_msg( KvMsgIn &msg ) noexcept;
+  void bloom_delta_msg( KvMsgIn &msg ) noexcept;
+  void set_bloom_seqno( UInt64HashTab *&ht,  uint32_t ref_num,
+                        uint64_t seqno ) noexcept;
+  bool get_bloom_seqno( UInt64HashTab *ht,  uint32_t ref_num,
+                        uint64_t &seqno ) noexcept;
+  void del_bloom_seqno( UInt64HashTab *&ht,  uint32_t ref_num ) noexcept;
   void bye_msg( KvMsgIn &msg ) noexcept;
   void on_sub_msg( KvMsgIn &msg ) noexcept;
   void on_unsub_msg( KvMsgIn &msg ) noexcept;
@@ -180,6 +193,8 @@ struct KvPubSub : public KVPS_LISTEN, public RouteNotify {
 
   bool init( void ) noexcept;
   void send_hello( KvPubSubPeer &c ) noexcept;
+  void send_bloom( KvPubSubPeer &c,  BloomRef &ref,  BloomCodec &code,
+                   uint64_t seqno ) noexcept;
   void bcast_msg( KvMsg &m ) noexcept;
   KvMsg &get_msg_buf( KvEst &e, int mtype ) noexcept;
   bool attach_ctx( void ) noexcept;
@@ -202,16 +217,17 @@ struct KvPubSub : public KVPS_LISTEN, public RouteNotify {
 };
 
 enum KvMsgType {
-  KV_MSG_HELLO     = 0,
-  KV_MSG_BLOOM     = 1,
-  KV_MSG_BLOOM_DEL = 2,
-  KV_MSG_BYE       = 3,
-  KV_MSG_ON_SUB    = 4,
-  KV_MSG_ON_PSUB   = 5,
-  KV_MSG_ON_UNSUB  = 6,
-  KV_MSG_ON_PUNSUB = 7,
-  KV_MSG_FWD       = 8,
-  KV_MSG_MAX       = 9
+  KV_MSG_HELLO       = 0,
+  KV_MSG_BLOOM       = 1,
+  KV_MSG_BLOOM_DEL   = 2,
+  KV_MSG_BYE         = 3,
+  KV_MSG_ON_SUB      = 4,
+  KV_MSG_ON_PSUB     = 5,
+  KV_MSG_ON_UNSUB    = 6,
+  KV_MSG_ON_PUNSUB   = 7,
+  KV_MSG_FWD         = 8,
+  KV_MSG_BLOOM_DELTA = 9,
+  KV_MSG_MAX         = 10
 };
 
 #define kv_dispatch_msg { \
@@ -223,30 +239,32 @@ enum KvMsgType {
   &KvPubSubPeer::on_psub_msg, \
   &KvPubSubPeer::on_unsub_msg, \
   &KvPubSubPeer::on_punsub_msg, \
-  &KvPubSubPeer::fwd_msg \
+  &KvPubSubPeer::fwd_msg, \
+  &KvPubSubPeer::bloom_delta_msg \
 }
 #define kv_msg_name { \
   "hello", "bloom", "bloom_del", "bye", "on_sub", "on_psub", "on_unsub", \
-  "on_punsub", "fwd" \
+  "on_punsub", "fwd", "bloom_delta" \
 }
 
 enum KvFieldType {
-  KV_FLD_CTX_ID     = 0,
-  KV_FLD_TIME_NS    = 1,
-  KV_FLD_SUB_SEQNO  = 2,
-  KV_FLD_SUBJECT    = 3,
-  KV_FLD_REPLY      = 4,
-  KV_FLD_SUBJ_HASH  = 5,
-  KV_FLD_SUB_COUNT  = 6,
-  KV_FLD_HASH_COLL  = 7,
-  KV_FLD_PATTERN    = 8,
-  KV_FLD_PAT_FMT    = 9,
-  KV_FLD_MSG_ENC    = 10,
-  KV_FLD_DATA       = 11,
-  KV_FLD_REF_NUM    = 12,
-  KV_FLD_NAME       = 13,
-  KV_FLD_PUB_STATUS = 14,
-  KV_FLD_MAX        = 15
+  KV_FLD_CTX_ID      = 0,
+  KV_FLD_TIME_NS     = 1,
+  KV_FLD_SUB_SEQNO   = 2,
+  KV_FLD_SUBJECT     = 3,
+  KV_FLD_REPLY       = 4,
+  KV_FLD_SUBJ_HASH   = 5,
+  KV_FLD_SUB_COUNT   = 6,
+  KV_FLD_HASH_COLL   = 7,
+  KV_FLD_PATTERN     = 8,
+  KV_FLD_PAT_FMT     = 9,
+  KV_FLD_MSG_ENC     = 10,
+  KV_FLD_DATA        = 11,
+  KV_FLD_REF_NUM     = 12,
+  KV_FLD_NAME        = 13,
+  KV_FLD_PUB_STATUS  = 14,
+  KV_FLD_BLOOM_SEQNO = 15,
+  KV_FLD_MAX         = 16
 };
 
 /* KvMsg :
@@ -316,7 +334,18 @@ struct KvMsg {
   KvMsg & data( const void *s,  uint32_t len ) {
     return this->v32( KV_FLD_DATA, len, s );
   }
+  /* data field without the data, which is sent by reference after the
+   * len() - len bytes of the msg */
+  KvMsg & data_ref( uint32_t len ) {
+    this->d[ this->off ] = (char) ( (uint8_t) KV_FLD_DATA | len_byte( 4, true ) );
+    ::memcpy( &this->d[ this->off + 1 ], &len, 4 );
+    this->off += 5 + len;
+    return *this;
+  }
   KvMsg & ref_num( uint32_t n )  { return this->u( KV_FLD_REF_NUM, &n, 4 ); }
+  KvMsg & bloom_seqno( uint64_t n ) {
+    return this->u( KV_FLD_BLOOM_SEQNO, &n, 8 );
+  }
   KvMsg & name( const char *s,  uint32_t len ) {
     return this->v16( KV_FLD_NAME, len, s );
   }
@@ -350,6 +379,7 @@ struct KvEst {
   KvEst & pub_status( void )      { return this->u( 2 ); }
   KvEst & data( uint32_t len )    { return this->u( len + 4 ); }
   KvEst & ref_num( void )         { return this->u( 4 ); }
+  KvEst & bloom_seqno( void )     { return this->u( 8 ); }
   KvEst & name( uint32_t len )    { return this->u( len + 2 ); }
 };
 
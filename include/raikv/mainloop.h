@@ -1,7 +1,7 @@
 #ifndef __rai_raikv__mainloop_h__
 #define __rai_raikv__mainloop_h__
 
-#include <raikv/ev_net.h>
+#include <raikv/route_bus.h>
 /*#include <raikv/kv_pubsub.h>*/
 
 namespace rai {
@@ -14,8 +14,12 @@ struct MainLoopVars {
                 thr_error;    /* if failed to start */
   const char  * map_name,
               * ipc_name;
+  RouteBus    * route_bus;    /* pubsub between threads, -b */
   int           maxfd,        /* max fd count */
                 timeout,      /* keep alive timeout */
+                coalesce_us,  /* hold small writes for coalescing */
+                send_mem_mb,  /* cap send buffers of all socks, 0 = off */
+                shed_policy,  /* EvShedPolicy bits used over send_mem_mb */
                 num_threads,  /* thread count */
                 tcp_opts,     /* sock options for tcp */
                 udp_opts;     /* sock options for udp */
@@ -23,6 +27,7 @@ struct MainLoopVars {
                 use_ipv4,     /* true to only bind to ipv4 address */
                 use_sigusr,   /* true to use sig usr to signal messages */
                 use_prefetch, /* prefetch keys in batches */
+                use_route_bus,/* route pubs between threads, not ipc */
                 all,          /* start all ports with default */
                 no_threads,   /* don't want threading options */
                 no_reuseport, /* don't want so_reuseport */
@@ -74,12 +79,17 @@ struct MainLoopVars {
       printf( "  -D dbnum = default db num          (0) (" KV_DB_NUM_ENV ")\n" );
     printf( "  -x maxfd = max fds                 (10000) (" KV_MAXFD_ENV ")\n" );
     printf( "  -k secs  = keep alive timeout      (16) (" KV_KEEPALIVE_ENV ")\n" );
+    printf( "  -wc usec = hold small writes usecs (0) (" KV_COALESCE_ENV ")\n" );
+    printf( "  -sm mb   = cap send buffers mbytes (0) (" KV_SEND_MEM_ENV ")\n" );
+    printf( "  -sp bits = shed policy over cap    (7) 1 = drop lossy, 2 = close slow, 4 = pause read (" KV_SHED_POLICY_ENV ")\n" );
     if ( ! this->no_map )
       printf( "  -f prefe = prefetch keys:          (1) 0 = no, 1 = yes (" KV_PREFETCH_ENV ")\n" );
     if ( ! this->no_reuseport )
       printf( "  -P       = set SO_REUSEPORT for clustering multiple instances (" KV_REUSEPORT_ENV ")\n" );
-    if ( ! this->no_threads )
+    if ( ! this->no_threads ) {
       printf( "  -t nthr  = spawn N threads         (1) (implies -P) (" KV_NUM_THREADS_ENV ")\n" );
+      printf( "  -b       = route pubsub between threads without ipc (" KV_ROUTE_BUS_ENV ")\n" );
+    }
     printf( "  -4       = use only ipv4 listeners (" KV_IPV4_ONLY_ENV ")\n" );
     if ( ! this->no_default )
       printf( "  -X       = do not listen to default ports, only using cmd line\n" );
@@ -104,12 +114,17 @@ struct MainLoopVars {
       this->ipc_name = get_arg( argc, argv, 1, "-i", NULL, KV_IPC_NAME_ENV );
     this->maxfd       = int_arg(  argc, argv, 1, "-x", "10000", KV_MAXFD_ENV );
     this->timeout     = int_arg(  argc, argv, 1, "-k", "16", KV_KEEPALIVE_ENV );
+    this->coalesce_us = int_arg(  argc, argv, 1, "-wc", "0", KV_COALESCE_ENV );
+    this->send_mem_mb = int_arg(  argc, argv, 1, "-sm", "0", KV_SEND_MEM_ENV );
+    this->shed_policy = int_arg(  argc, argv, 1, "-sp", "7", KV_SHED_POLICY_ENV );
     if ( ! this->no_map )
       this->use_prefetch = bool_arg( argc, argv, 1, "-f", "1", KV_PREFETCH_ENV );
     if ( ! this->no_reuseport )
       this->use_reuseport = bool_arg( argc, argv, 0, "-P", 0, KV_REUSEPORT_ENV );
-    if ( ! this->no_threads )
+    if ( ! this->no_threads ) {
       this->num_threads = int_arg(  argc, argv, 1, "-t", "1", KV_NUM_THREADS_ENV);
+      this->use_route_bus = bool_arg( argc, argv, 0, "-b", 0, KV_ROUTE_BUS_ENV );
+    }
     this->use_ipv4 = bool_arg( argc, argv, 0, "-4", 0, KV_IPV4_ONLY_ENV );
     if ( ! this->no_default )
       this->all = ! bool_arg( argc, argv, 0, "-X", 0 );
@@ -190,12 +205,22 @@ struct MainLoop {
       this->shm.ipc_name = this->r.ipc_name;
     this->poll.wr_timeout_ns   = (uint64_t) this->r.timeout * 1000000000;
     this->poll.so_keepalive_ns = (uint64_t) this->r.timeout * 1000000000;
+    this->poll.wr_coalesce_ns  = (uint64_t) this->r.coalesce_us * 1000;
+    this->poll.send_mem_max    = (uint64_t) this->r.send_mem_mb * 1024 * 1024;
+    this->poll.shed_policy     = (uint32_t) this->r.shed_policy &
+                         ( SHED_DROP_LOSSY | SHED_CLOSE_SLOW | SHED_PAUSE_READ );
 
     if ( this->poll.init( this->r.maxfd, this->r.use_prefetch ) != 0 ||
          this->poll.sub_route.init_shm( this->shm ) != 0 ) {
       fprintf( stderr, "unable to init poll\n" );
       return false;
     }
+    if ( this->r.route_bus != NULL &&
+         this->r.route_bus->attach( this->poll,
+                                    (uint32_t) this->thr_num ) == NULL ) {
+      fprintf( stderr, "unable to attach route bus\n" );
+      return false;
+    }
     return true;
   }
 #if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
@@ -265,6 +290,8 @@ struct Runner {
   Runner( MAIN_LOOP_ARGS &r,  EvShm &shm ) {
     this->num_thr = ( r.num_threads <= 1 ? 1 : r.num_threads );
 
+    if ( this->num_thr > 1 && r.use_route_bus )
+      r.route_bus = RouteBus::create( (uint32_t) this->num_thr );
     const size_t size = kv::align<size_t>( sizeof( MAIN_LOOP ), 64 );
     char * buf = (char *) ::malloc( size * this->num_thr );
     size_t i, off = 0;
@@ -293,6 +320,11 @@ struct Runner {
         pthread_join( this->tid[ i ], nullptr );
     }
 #endif
+    if ( r.route_bus != NULL ) { /* after threads exit */
+      r.route_bus->release();
+      delete r.route_bus;
+      r.route_bus = NULL;
+    }
     printf( "\nbye\n" );
     ::free( buf );
   }
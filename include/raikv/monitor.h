@@ -1,6 +1,8 @@
 #ifndef __rai_raikv__monitor_h__
 #define __rai_raikv__monitor_h__
 
+#include <raikv/ev_net.h>
+
 namespace rai {
 namespace kv {
 
@@ -30,6 +32,30 @@ struct Monitor {
   void check_broken_locks( void ); /* check for broken locks */
 };
 
+/* watchdog hosted by an EvPoll timer, recovers locks held by ctx[] of dead
+ * processes so that threads waiting on them do not stall:
+ *
+ *   EvCtxRecover rec( poll, *map );
+ *   rec.start( 100 ); -- check every 100 ms
+ *
+ * Any number of attached processes can run one, HashTab::recover_dead_ctx()
+ * allows only one at a time, the counters are in map->hdr.recover */
+struct EvCtxRecover : public EvTimerCallback {
+  EvPoll   & poll;
+  HashTab  & map;
+  uint64_t   timer_id,   /* unique id for timer, incremented on start() */
+             dead_cnt;   /* count of dead ctx found by this process */
+  uint32_t   ival_ms;    /* check interval */
+  bool       is_running;
+
+  EvCtxRecover( EvPoll &p,  HashTab &m ) noexcept;
+  /* arm the timer, check at ival_ms intervals */
+  bool start( uint32_t ival ) noexcept;
+  /* remove the timer */
+  void stop( void ) noexcept;
+  virtual bool timer_cb( uint64_t timer_id,  uint64_t event_id ) noexcept;
+};
+
 }
 }
 
@@ -185,7 +185,21 @@ struct MsgHdr {
   /* no longer need the memory, mark freed */
   void release( void ) {
     this->seal2( 0, 0, 0 );
-    this->hash = ZOMBIE64;
+    this->hash2 = 0;
+    this->hash  = ZOMBIE64;
+  }
+  /* mark freed data which pinned readers may reference, it is unsealed before
+   * the epoch is loaded and stamped with it before it is marked free, gc does
+   * not reuse it until the readers pinned at the stamp are unpinned */
+  void release_stamped( AtomUInt32 &pin_ctx_count,  AtomUInt32 &read_epoch ) {
+    this->seal2( 0, 0, 0 );
+    kv_sync_mfence();
+    this->hash2 = ( pin_ctx_count == 0 ? 0 : (uint32_t) read_epoch );
+    kv_release_fence();
+    this->hash  = ZOMBIE64;
+  }
+  uint32_t release_stamp( void ) const {
+    return (uint32_t) this->hash2;
   }
   /* the serial and seal are at the end of the msg data */
   ValueCtr &value_ctr( void ) const {
@@ -389,7 +403,8 @@ struct GCStats {
            orphans_size,
            immovable_size,
            msglist_size,
-           compact_size;
+           compact_size,
+           pinned_size;
   uint32_t moved,
            zombie,
            expired,
@@ -398,7 +413,8 @@ struct GCStats {
            immovable,
            msglist,
            compact,
-           chains;
+           chains,
+           pinned;
   void zero( void ) {
     ::memset( this, 0, sizeof( *this ) );
   }
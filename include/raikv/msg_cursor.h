@@ -0,0 +1,109 @@
+#ifndef __rai__raikv__msg_cursor_h__
+#define __rai__raikv__msg_cursor_h__
+
+/* also include stdint.h, string.h */
+#include <raikv/shm_ht.h>
+#include <raikv/key_buf.h>
+#include <raikv/ev_net.h>
+
+#ifdef __cplusplus
+namespace rai {
+namespace kv {
+
+/* A reader of a message list key that remembers where it left off:
+ *
+ *   MsgCursor cur( *map, dbx_id );
+ *   cur.set_key( "log", 3, true ); -- TopicLog::publish( "log", 3, .. )
+ *   cur.seek( 0 );
+ *   uint64_t   first, cnt = 64;
+ *   void     * msg[ 64 ];
+ *   msg_size_t msg_sz[ 64 ];
+ *   while ( cur.read( first, msg, msg_sz, cnt = 64 ) == KEY_OK )
+ *     ... msg[ 0 .. cnt-1 ] are first -> first + cnt - 1
+ *
+ * The first read does a find() and msg_value(), after that the position of
+ * the hash entry and the geometry of the head message of the list are
+ * cached.  Later reads check the entry and the seal of the head message in
+ * place and copy only the messages appended since the last read, without a
+ * hash lookup and without copying the whole list.  When these do not match
+ * (the list grew a new chain, moved by GC, trimmed or dropped), the cursor
+ * falls back to find() and caches the new head.
+ * The msg[] references are valid until the next read(). */
+struct MsgCursor {
+  HashTab   & map;
+  KeyBuf      kbuf;        /* key of list */
+  WorkAlloc8k wrk;         /* copy on read space */
+  KeyCtx      kctx;        /* for find() when cache is not valid */
+  HashSeed    hs;          /* seed for the db */
+  ValueGeom   geom;        /* geom of the head msg, when is_cached */
+  uint64_t    seqno,       /* next seqno to read */
+              pos,         /* position of hash entry, when is_cached */
+              msg_off,     /* offset of seqno in head msg data */
+              hdr_off,     /* offset of data in head msg */
+              cache_hit,   /* reads using the cached geom */
+              cache_miss;  /* reads using find() */
+  uint16_t    chain_size;  /* chain count sealed in head msg */
+  bool        is_cached;   /* if geom is set */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  MsgCursor( HashTab &m,  uint32_t dbx_id ) noexcept;
+
+  /* set the key of the list, false if key is too long, add_null appends a
+   * null to keylen bytes, like the subject of a TopicLog */
+  bool set_key( const void *key,  size_t keylen,
+                bool add_null = false ) noexcept;
+  /* next read starts at seqno */
+  void seek( uint64_t seq ) {
+    this->seqno     = seq;
+    this->is_cached = false;
+  }
+  /* read up to count msgs starting at seqno, first is the seqno of msg[ 0 ],
+   * which is advanced when seqno was trimmed, count is set to the number
+   * read, KEY_NOT_FOUND when no msgs are available */
+  KeyStatus read( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                  uint64_t &count ) noexcept;
+  /* read using the cached geom, KEY_MUTATED if not valid */
+  KeyStatus read_cached( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                         uint64_t &count ) noexcept;
+  /* read using find(), set the cached geom when the end is reached */
+  KeyStatus read_find( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                       uint64_t &count ) noexcept;
+};
+
+/* Poll a cursor from an EvPoll timer, calling on_msgs() with new data:
+ *
+ *   struct MyReader : public EvMsgCursor {
+ *     void on_msgs( uint64_t first,  void **msg,  msg_size_t *msg_size,
+ *                   uint64_t count ) noexcept { ... }
+ *   };
+ *   rdr.cur.set_key( "log", 3, true );
+ *   rdr.start( 100 ); -- check every 100 us
+ *
+ * There is no file descriptor to wake the poll when another process appends
+ * to the list, the timer interval is the latency bound. */
+struct EvMsgCursor : public EvTimerCallback {
+  static const uint32_t READ_BATCH = 64; /* msgs per on_msgs() */
+  EvPoll  & poll;
+  MsgCursor cur;
+  uint64_t  timer_id;      /* unique id for timer, incremented on start() */
+  uint32_t  ival_us;       /* poll interval */
+  bool      is_running;
+
+  EvMsgCursor( EvPoll &p,  HashTab &m,  uint32_t dbx_id ) noexcept;
+  /* arm the timer, which reads at ival_us intervals */
+  bool start( uint32_t ival ) noexcept;
+  /* remove the timer */
+  void stop( void ) noexcept;
+  /* read all of the available msgs, return count */
+  uint64_t read_all( void ) noexcept;
+  virtual bool timer_cb( uint64_t timer_id,  uint64_t event_id ) noexcept;
+  /* called with each batch of msgs read */
+  virtual void on_msgs( uint64_t first,  void **msg,  msg_size_t *msg_size,
+                        uint64_t count ) noexcept;
+};
+
+}
+}
+#endif
+#endif
@@ -116,11 +116,13 @@ typedef RoutePublishSetT<RouteQueueData, QueueRef> RouteQueueSet;
 
 struct RoutePublishContext : public RouteLookup {
   EvPublish     & pub;
-  RouteDB       & rdb;
+  RoutePublish  & rdb;
   RoutePublishSet set;
   uint8_t         save_type;
 
-  RoutePublishContext( RouteDB &db,  EvPublish &pub ) noexcept;
+  /* a RoutePublish, not a RouteDB, the queue selection uses rdb.poll to find
+   * the load of the members */
+  RoutePublishContext( RoutePublish &db,  EvPublish &pub ) noexcept;
   ~RoutePublishContext() {
     this->pub.publish_type = this->save_type;
     this->RouteLookup::deref( this->rdb );
@@ -129,6 +131,15 @@ struct RoutePublishContext : public RouteLookup {
   void make_qroutes( RouteGroup &db ) noexcept;
   void select_queue( QueueDB &q,  RouteQueueSet &qset,
                      RoutePublishSet &prune_set ) noexcept;
+  uint32_t select_rotate( QueueDB &q,  QueueRef *routes,
+                          uint32_t rcnt ) noexcept;
+  uint32_t select_least_load( QueueDB &q,  QueueRef *routes,
+                              uint32_t rcnt ) noexcept;
+  uint32_t select_two_choice( QueueDB &q,  QueueRef *routes,
+                              uint32_t rcnt ) noexcept;
+  /* pending send bytes of route, back pressured is more than QUEUE_BP_LOAD */
+  uint64_t queue_load( uint32_t r ) noexcept;
+  static const uint64_t QUEUE_BP_LOAD = (uint64_t) 1 << 48;
 };
 
 }
@@ -0,0 +1,191 @@
+#ifndef __rai_raikv__route_bus_h__
+#define __rai_raikv__route_bus_h__
+
+#if defined( __linux__ )
+#define HAVE_EVENTFD
+#endif
+#include <raikv/ev_net.h>
+
+namespace rai {
+namespace kv {
+
+/* Route publishes between the EvPoll threads of a process without the kv
+ * pubsub ipc.  Each pair of threads has a single producer, single consumer
+ * ring in each direction.  The subscriptions of a thread are sent through
+ * the same rings, each thread keeps a bloom of the other thread subs which
+ * routes a publish to the RouteBusPeer of the subscribing thread:
+ *
+ *   thread T:  pub -> sub_route -> RouteBusPeer( R ) -> ring[ T ][ R ]
+ *   thread R:  ring[ T ][ R ] -> RouteBusPeer( T ) -> sub_route -> subs
+ *
+ * The publish data is copied, the source recv buffer belongs to thread T */
+enum RouteBusMsgType {
+  BUS_MSG_PUB       = 0, /* publish */
+  BUS_MSG_SUB       = 1, /* subject subscribe */
+  BUS_MSG_UNSUB     = 2, /* subject unsubscribe */
+  BUS_MSG_PSUB      = 3, /* pattern subscribe */
+  BUS_MSG_PUNSUB    = 4, /* pattern unsubscribe */
+  BUS_MSG_BLOOM     = 5, /* encoded bloom ref */
+  BUS_MSG_BLOOM_DEL = 6  /* bloom ref removed */
+};
+
+struct RouteBusMsg {
+  RouteBusMsg * next;        /* overflow list when ring is full */
+  uint32_t      subj_hash,   /* subject hash or pattern prefix hash */
+                msg_len,     /* publish data or bloom code length */
+                msg_enc,     /* publish msg encoding */
+                ref_num;     /* bloom ref of sub, -1 when not in a bloom */
+  uint16_t      subject_len, /* subject, pattern or bloom name */
+                reply_len,
+                pub_status;
+  uint8_t       type,        /* RouteBusMsgType */
+                pat_fmt;     /* PatternFmt of BUS_MSG_PSUB */
+  char          buf[ 8 ];    /* subject, reply, aligned data */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  RouteBusMsg( uint8_t t ) : next( 0 ), subj_hash( 0 ), msg_len( 0 ),
+    msg_enc( 0 ), ref_num( (uint32_t) -1 ), subject_len( 0 ), reply_len( 0 ),
+    pub_status( 0 ), type( t ), pat_fmt( 0 ) {}
+
+  static size_t data_off( size_t sublen,  size_t replen ) {
+    return align<size_t>( sublen + replen, 8 );
+  }
+  static RouteBusMsg *create( uint8_t t,  const char *sub,  size_t sublen,
+                              const void *rep,  size_t replen,
+                              const void *data,  size_t datalen ) noexcept;
+  const char *subject( void ) const { return this->buf; }
+  const char *reply( void ) const { return &this->buf[ this->subject_len ]; }
+  const void *data( void ) const {
+    return &this->buf[ data_off( this->subject_len, this->reply_len ) ];
+  }
+};
+
+/* lock free, one thread pushes, another pops */
+struct RouteBusRing {
+  static const uint32_t RING_SIZE = 1024; /* power of 2 */
+  volatile uint32_t head,      /* next push, by producer */
+                    wake,      /* consumer is signaled, cleared by consumer */
+                    closed;    /* consumer is gone, drop msgs */
+  int               wake_fd;   /* eventfd of consumer */
+  char              pad1[ 64 - 16 ];
+  volatile uint32_t tail;      /* next pop, by consumer */
+  char              pad2[ 64 - 4 ];
+  RouteBusMsg     * ring[ RING_SIZE ];
+
+  bool push( RouteBusMsg *m ) {
+    uint32_t h = this->head;
+    if ( h - kv_sync_load( &this->tail ) >= RING_SIZE )
+      return false;
+    this->ring[ h % RING_SIZE ] = m;
+    kv_release_fence();
+    kv_sync_store( &this->head, h + 1 );
+    return true;
+  }
+  RouteBusMsg *pop( void ) {
+    uint32_t t = this->tail;
+    if ( t == kv_sync_load( &this->head ) )
+      return NULL;
+    RouteBusMsg * m = this->ring[ t % RING_SIZE ];
+    kv_release_fence();
+    kv_sync_store( &this->tail, t + 1 );
+    return m;
+  }
+  /* after push, true if consumer is not signaled yet */
+  bool need_wake( void ) {
+    kv_sync_mfence();
+    return kv_sync_xchg( &this->wake, (uint32_t) 1 ) == 0;
+  }
+  /* before pop, the next push signals again */
+  void clear_wake( void ) {
+    kv_sync_xchg( &this->wake, (uint32_t) 0 );
+    kv_sync_mfence();
+  }
+};
+
+struct RouteBusPort;
+/* a remote thread, routes publishes to it and forwards publishes from it */
+struct RouteBusPeer : public EvSocket {
+  static const uint32_t RECV_BATCH = 256; /* msgs before yielding poll */
+  RouteBusPort & port;
+  RouteBusRing & in,       /* ring[ peer_thr ][ thr ] */
+               & out;      /* ring[ thr ][ peer_thr ] */
+  BloomRoute   * bloom_rt; /* routes to this fd for blooms below */
+  BloomRef     * sub_ref;  /* subs of peer thread, not in a bloom ref */
+  BloomDB        sub_db,   /* holds sub_ref */
+                 bloom_db; /* bloom refs of peer thread, by ref_num */
+  RouteBusMsg  * ovf_hd,   /* msgs waiting for space in out ring */
+               * ovf_tl;
+  uint32_t       peer_thr; /* thread index of peer */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  RouteBusPeer( EvPoll &p,  RouteBusPort &pt,  uint32_t peer ) noexcept;
+  static RouteBusPeer *create( EvPoll &p,  RouteBusPort &pt,
+                               uint32_t peer ) noexcept;
+  /* push msg to out ring, overflow if full, frees msg if peer is gone */
+  void send( RouteBusMsg *m ) noexcept;
+  void wake( void ) noexcept;
+  uint32_t drain( void ) noexcept;
+  void recv_msg( RouteBusMsg &m ) noexcept;
+  void recv_psub( RouteBusMsg &m,  bool is_sub ) noexcept;
+  void recv_bloom( RouteBusMsg &m ) noexcept;
+  void recv_bloom_del( RouteBusMsg &m ) noexcept;
+  BloomRef *get_ref( uint32_t ref_num ) noexcept;
+  void drop_bloom_refs( void ) noexcept;
+  virtual void write( void ) noexcept;     /* retry overflow msgs */
+  virtual void read( void ) noexcept;      /* clear eventfd */
+  virtual void process( void ) noexcept;   /* pop in ring */
+  virtual bool busy_poll( void ) noexcept; /* pop in ring, when no eventfd */
+  virtual void release( void ) noexcept;
+  virtual bool on_msg( EvPublish &pub ) noexcept;
+};
+
+struct RouteBus;
+/* the thread end of the bus, sends the subs of the thread to the peers */
+struct RouteBusPort : public RouteNotify {
+  RouteBus      & bus;
+  EvPoll        & poll;
+  RouteBusPeer ** peer;  /* peer[ thr ] is NULL */
+  uint32_t        thr;   /* thread index of port */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  RouteBusPort( RouteBus &b,  EvPoll &p,  uint32_t t ) noexcept;
+
+  void bcast_sub( uint8_t type,  const char *sub,  size_t sublen,
+                  uint32_t h,  BloomRef *bref,  uint8_t fmt ) noexcept;
+  virtual void on_sub( NotifySub &sub ) noexcept;
+  virtual void on_unsub( NotifySub &sub ) noexcept;
+  virtual void on_psub( NotifyPattern &pat ) noexcept;
+  virtual void on_punsub( NotifyPattern &pat ) noexcept;
+  virtual void on_bloom_ref( BloomRef &ref ) noexcept;
+  virtual void on_bloom_deref( BloomRef &ref ) noexcept;
+};
+
+/* shared by the threads, created before they start, released after exit:
+ *
+ *   RouteBus *bus = RouteBus::create( nthr );
+ *   thread i: bus->attach( poll, i );
+ *   bus->release(); delete bus;
+ */
+struct RouteBus {
+  RouteBusRing  * ring;     /* ring[ src * nthreads + dst ] */
+  RouteBusPort ** port;     /* port[ thr ] after attach */
+  uint32_t        nthreads;
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  RouteBus() : ring( 0 ), port( 0 ), nthreads( 0 ) {}
+
+  static RouteBus *create( uint32_t nthr ) noexcept;
+  RouteBusRing &get_ring( uint32_t src,  uint32_t dst ) {
+    return this->ring[ src * this->nthreads + dst ];
+  }
+  /* create peers for the other threads in poll */
+  RouteBusPort *attach( EvPoll &p,  uint32_t thr ) noexcept;
+  /* free msgs, ports and eventfds, after threads exit */
+  void release( void ) noexcept;
+};
+
+}
+}
+#endif
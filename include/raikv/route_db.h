@@ -145,11 +145,16 @@ uint32_t merge_queue2( QueueRef *routes,  uint32_t count,
 /* ptr to route[] array */
 struct RteCacheVal {
   uint32_t rcnt,
-           off;
+           off,
+           gen, /* RouteCache::gen when saved, stale when not equal */
+           ref; /* set on hit, cleared by evict(), second chance */
 };
 /* table of [prefix|hash] -> [rcnt|off], for caching decompressed routes */
 typedef IntHashTabT<uint64_t, RteCacheVal> RteCacheTab;
 
+/* An entry is purged when the route at [prefix|hash] changes, invalidate()
+ * stales all of the entries by incrementing gen.  When full, the entries not
+ * hit since the last evict() are dropped and the rest are compacted */
 struct RouteCache {
   static const uint32_t MAX_CACHE = 256 * 1024; /* max routes in cache */
   RouteSpace    spc;        /* cache space */
@@ -161,11 +166,19 @@ struct RouteCache {
                 need;       /* need this amount of space */
   uint64_t      hit_cnt,
                 miss_cnt,
+                inval_cnt,  /* count of purged entries and invalidate() */
+                evict_cnt,  /* count of entries dropped by evict() */
                 max_cnt,
                 max_size;
-  bool          is_invalid; /* full or updated, no more entries allowed */
+  uint32_t      gen;        /* current generation */
+  bool          is_full;    /* full while busy, evict when not busy */
   RouteCache() noexcept;
   bool reset( void ) noexcept;
+  void invalidate( void ) {
+    this->gen++;
+    this->inval_cnt++;
+  }
+  bool evict( void ) noexcept;
 };
 
 static const uint16_t MAX_PRE      = 64, /* wildcard prefix routes 0 -> 63 */
@@ -383,6 +396,12 @@ struct BloomGroup {
                    uint32_t hash ) noexcept;
 };
 
+/* map the route ids of a snapshot to the current route ids, the default is
+ * to keep the route, return -1 to drop it */
+struct RouteRemap {
+  virtual uint32_t remap( uint32_t r ) noexcept;
+};
+
 struct RouteGroup {
   static uint32_t pre_seed[ MAX_PRE ]; /* hash seeds for each prefix */
   RouteCache  & cache;                 /* the route arrays indexed by ht */
@@ -417,6 +436,8 @@ struct RouteGroup {
   bool is_sub_member( uint32_t hash,  uint32_t r ) {
     return this->is_member( SUB_RTE, hash, r );
   }
+  /* translate route ids after attaching a snapshot, return count modified */
+  uint32_t remap_routes( RouteRemap &map ) noexcept;
   uint32_t add_pattern_route_str( const char *str,  uint16_t len,
                                   uint32_t r ) noexcept;
   uint32_t add_pattern_route( uint32_t hash, uint32_t r, uint16_t prefix_len ) {
@@ -494,17 +515,18 @@ struct RouteGroup {
   bool cache_find( uint16_t prefix_len,  uint32_t hash,
                    uint32_t *&routes,  uint32_t &rcnt,
                    uint32_t shard,  size_t &pos ) {
-    if ( ! this->cache.is_invalid ) {
-      if ( ! this->cache.busy && this->cache.need )
-        this->cache_need();
-      uint64_t h = ( (uint64_t) this->group_num << 48 ) |
-                   ( (uint64_t) shard << 40 ) |
-                   ( (uint64_t) prefix_len << 32 ) | (uint64_t) hash;
-      RteCacheVal val;
-
-      if ( this->cache.ht->find( h, pos, val ) ) {
-        rcnt   = val.rcnt;
-        routes = &this->cache.spc.ptr[ val.off ];
+    if ( ! this->cache.busy && this->cache.need )
+      this->cache_need();
+    uint64_t h = ( (uint64_t) this->group_num << 48 ) |
+                 ( (uint64_t) shard << 40 ) |
+                 ( (uint64_t) prefix_len << 32 ) | (uint64_t) hash;
+
+    if ( this->cache.ht->find( h, pos ) ) {
+      RteCacheVal & val = this->cache.ht->tab[ pos ].val;
+      if ( val.gen == this->cache.gen ) {
+        val.ref = 1;
+        rcnt    = val.rcnt;
+        routes  = &this->cache.spc.ptr[ val.off ];
         this->cache.hit_cnt++;
         return true;
       }
@@ -519,10 +541,28 @@ struct RouteGroup {
   void cache_need( void ) noexcept;
 };
 
+/* how a publish selects one member of a queue group */
+enum QueueSelect {
+  QUEUE_ROUND_ROBIN = 0, /* rotate members, skewed by subscription refcnt */
+  QUEUE_LEAST_LOAD  = 1, /* member with least pending send bytes */
+  QUEUE_TWO_CHOICE  = 2, /* less loaded of two random members */
+  QUEUE_WEIGHTED    = 3  /* rotate members, skewed by refcnt * weight */
+};
+
+struct QueueStats {
+  uint64_t select_cnt,  /* selections with more than one member */
+           bp_cnt,      /* selected a member with write back pressure */
+           pending_sum; /* sum of pending send bytes of members selected */
+};
+
 struct QueueDB {
-  RouteGroup * route_group;
-  QueueName  * q_name;
-  uint32_t     next_route;
+  RouteGroup  * route_group;
+  QueueName   * q_name;
+  UIntHashTab * weight_ht;  /* route -> weight, for QUEUE_WEIGHTED */
+  uint64_t      rand_state; /* for QUEUE_TWO_CHOICE */
+  uint32_t      next_route;
+  QueueSelect   select;
+  QueueStats    stats;
 
   bool equals( const char *q,  uint32_t qlen,  uint32_t qhash ) const {
     QueueName qn( q, qlen, qhash );
@@ -530,6 +570,24 @@ struct QueueDB {
   }
   void init( RouteCache &c,  RouteZip &z,  BloomGroup &b,  QueueName *qn,
              uint32_t gn ) noexcept;
+  /* weight of a route, default 1, a weight of 0 is not selected */
+  uint32_t get_weight( uint32_t r ) const {
+    size_t   pos;
+    uint32_t w;
+    if ( this->weight_ht != NULL && this->weight_ht->find( r, pos, w ) )
+      return w;
+    return 1;
+  }
+  void set_weight( uint32_t r,  uint32_t w ) noexcept;
+  /* remove the weight of r, a new route with the same fd starts at 1 */
+  void del_weight( uint32_t r ) noexcept;
+  void release( void ) noexcept;
+  uint32_t next_rand( void ) { /* xorshift64 */
+    uint64_t x = this->rand_state;
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    this->rand_state = x;
+    return (uint32_t) ( x >> 32 );
+  }
 };
 
 struct RouteDB : public RouteGroup {
@@ -541,6 +599,9 @@ struct RouteDB : public RouteGroup {
   UIntHashTab          * q_ht;
 
   RouteDB( BloomDB &g_db ) noexcept;
+  ~RouteDB() noexcept;
+  /* route r is closed, remove the state of r kept by the queue groups */
+  void close_route( uint32_t r ) noexcept;
 
   BloomRoute * create_bloom_route( uint32_t r,  BloomRef *ref,
                                    uint32_t shard ) noexcept;
@@ -556,12 +617,21 @@ struct RouteDB : public RouteGroup {
   void remove_bloom_ref( BloomRef *ref ) noexcept;
   uint32_t get_bloom_count( uint16_t prefix_len,  uint32_t hash,
                             uint32_t shard ) noexcept;
-  RouteGroup &get_queue_group( const QueueName &qn ) noexcept;
+  QueueDB &get_queue_db( const QueueName &qn ) noexcept;
+  RouteGroup &get_queue_group( const QueueName &qn ) {
+    return *this->get_queue_db( qn ).route_group;
+  }
   RouteGroup &get_queue_group( const char *queue,  uint32_t queue_len,
                                uint32_t queue_hash ) {
     QueueName qn( queue, queue_len, queue_hash );
     return this->get_queue_group( qn );
   }
+  /* write route tables, zipped routes and bloom refs to a snapshot file */
+  bool save_snap( const char *path ) noexcept;
+  /* attach a snapshot to an empty db, the table images are copied as is,
+   * nothing is rehashed; routes are reconciled after with remap_snap() */
+  bool attach_snap( const char *path ) noexcept;
+  uint32_t remap_snap( RouteRemap &map ) noexcept;
 };
 
 struct SuffixMatch {
@@ -663,6 +733,42 @@ struct BloomDetail {
   bool from_pattern( const PatternCvt &cvt ) noexcept;
 };
 
+/* route changes of a BloomRef after base_seqno, sent to peers as a delta
+ * instead of the full bloom, reset when the bloom is replaced or resized */
+struct BloomDeltaLog {
+  uint64_t      seqno,      /* seqno of the last change */
+                base_seqno; /* log.ptr[ 0 ] is the change after base */
+  uint32_t      seed;       /* geometry of bits when log started */
+  size_t        width;
+  BloomDeltaOps log;
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  BloomDeltaLog( uint64_t start,  const BloomBits &b )
+    : seqno( start ), base_seqno( start ), seed( b.seed ), width( b.width ) {}
+
+  void append( uint16_t prefix_len,  uint32_t hash,  int32_t cnt ) {
+    BloomDeltaOp & op = this->log.push();
+    op.hash       = hash;
+    op.prefix_len = prefix_len;
+    op.cnt        = cnt;
+    this->seqno++;
+  }
+  /* changes before this point can't be sent as a delta */
+  void reset( const BloomBits &b ) {
+    this->base_seqno = ++this->seqno;
+    this->seed       = b.seed;
+    this->width      = b.width;
+    this->log.count  = 0;
+  }
+  /* changes up to seqno are sent to all peers */
+  void trim( uint64_t to_seqno ) noexcept;
+  /* if a peer at from_seqno can be updated with the log */
+  bool has_delta( uint64_t from_seqno ) const {
+    return from_seqno >= this->base_seqno && from_seqno <= this->seqno;
+  }
+};
+
 struct BloomMatchArgs;
 struct BloomRef {
   BloomBits   * bits;
@@ -676,6 +782,7 @@ struct BloomRef {
                 ref_num,
                 queue_cnt;
   BloomDB     & bloom_db;
+  BloomDeltaLog * delta;  /* changes logged after first delta_seqno() */
   bool          sub_detail;
   char          name[ 31 ];
 
@@ -715,6 +822,22 @@ struct BloomRef {
   void update_route( const uint32_t *pref_count,  BloomBits *bits,
                      BloomDetail *details,  uint32_t ndetails ) noexcept;
   /*void notify_update( void ) noexcept;*/
+  /* start logging changes, return seqno of current state, a resize since
+   * the last call resets the log */
+  uint64_t delta_seqno( void ) noexcept;
+  /* if changes after from_seqno are in delta log */
+  bool can_delta( uint64_t from_seqno ) noexcept;
+  void delta_reset( void ) {
+    if ( this->delta != NULL )
+      this->delta->reset( *this->bits );
+  }
+  void delta_append( uint16_t prefix_len,  uint32_t hash,
+                     int32_t cnt ) noexcept;
+  /* encode the log after from_seqno, if can_delta( from_seqno ) */
+  void encode_delta( uint64_t from_seqno,  BloomCodec &code ) noexcept;
+  /* add / del routes of a delta decoded with BloomCodec::decode_ops() */
+  void apply_delta( const BloomDeltaOps &ops ) noexcept;
+  void release_delta( void ) noexcept;
 
   bool add( uint32_t hash ) {
     return this->add_route( SUB_RTE, hash );
@@ -868,16 +991,19 @@ struct PeerStats {
            accept_cnt,
            msgs_recv,
            msgs_sent,
+           msgs_conflated, /* SUBJ_CONFLATE msgs replaced */
            active_ns,
            read_ns;
   PeerStats() : bytes_recv( 0 ), bytes_sent( 0 ), accept_cnt( 0 ),
-                msgs_recv( 0 ), msgs_sent( 0 ), active_ns( 0 ), read_ns( 0 ) {}
+                msgs_recv( 0 ), msgs_sent( 0 ), msgs_conflated( 0 ),
+                active_ns( 0 ), read_ns( 0 ) {}
   void zero( void ) {
     this->bytes_recv = 0;
     this->bytes_sent = 0;
     this->accept_cnt = 0;
     this->msgs_recv  = 0;
     this->msgs_sent  = 0;
+    this->msgs_conflated = 0;
     this->active_ns  = 0;
     this->read_ns    = 0;
   }
@@ -1165,6 +1291,7 @@ struct RouteNotify {
 };
 
 struct KvPubSub; /* manages pubsub through kv shm */
+struct RouteBusPort; /* pubsub between threads of a process */
 struct HashTab;  /* shm ht */
 struct EvShm;    /* shm context */
 struct EvPublish;
@@ -1176,6 +1303,7 @@ struct RoutePublish : public RouteDB {
 
   DLinkList<RouteNotify> notify_list;
   KvPubSub             * pubsub;   /* cross process pubsub */
+  RouteBusPort         * bus;      /* cross thread pubsub, if attached */
   void                 * keyspace; /* update sub_route.key_flags */
 
   const char * service_name;
@@ -23,7 +23,20 @@ enum RouteFit {
   FITS_OK      = 2
 };
 
-/* Data has RouteSub members, with value[] trailing */
+/* A prefix shared by values within a RouteHT block, when compressed */
+struct RoutePrefix {
+  uint16_t refs;      /* count of values using prefix, slot free when zero */
+  uint8_t  len;       /* length of str[], zero when never used */
+  char     str[ 61 ]; /* sizeof( RoutePrefix ) == 64 */
+};
+
+/* Data has RouteSub members, with value[] trailing.
+ *
+ * When prefix compression is enabled (RouteVec::set_prefix_compress()), the
+ * low end of block[] has PFX_MAX prefix slots and value[] is encoded as
+ * [ slot + 1 | PFX_NONE ] [ suffix ], where data->len is the encoded length.
+ * Use get_value() to decode it.  This is only for values that are plain
+ * strings, no data_copy(), data_equals() or resize() */
 template < class Data,
          void (*data_copy)( Data &, const void *, uint16_t ) = nullptr,
          bool (*data_equals)( const Data &, const void *, uint16_t ) = nullptr >
@@ -39,8 +52,14 @@ struct RouteHT {
                       HT_SIZE    = 1 << HT_SHIFT, /* 4096 */
                       HT_83FULL  = HT_SIZE / 6 * 5,
                       BLOCK_SIZE =
-          ( 0x15000 - ( 32 + sizeof( Entry ) * HT_SIZE ) ) / sizeof( uint64_t );
-                      /* 2 * HT_SIZE + 1984; 80k, 40b at 50% */
+          ( 0x15000 - ( 40 + sizeof( Entry ) * HT_SIZE ) ) / sizeof( uint64_t ),
+                      /* 8699 words, 84k; at 1.5M subjects 58.7b each,
+                       * 29.4b with prefix compression */
+                      PFX_MAX    = 8,  /* prefix slots in a block */
+                      PFX_WORDS  = PFX_MAX * sizeof( RoutePrefix ) /
+                                   sizeof( uint64_t ),
+                      PFX_MIN    = 4;  /* shortest prefix used */
+  static const uint8_t PFX_NONE  = 0xff; /* value[ 0 ] when no prefix */
 
   /* entries are never reallocated, so uint16 is enough to count them */
   uint16_t free_off,  /* next offset free */
@@ -52,11 +71,13 @@ struct RouteHT {
            id,
            next_id,
            prev_id,
-           index;
+           index,
+           pfx_words;      /* PFX_WORDS when compressed, block[] prefix slots */
   Entry    entry[ HT_SIZE ];    /* ht index of data */
   uint64_t block[ BLOCK_SIZE ]; /* data items, aligned on uint64_t */
 
   RouteHT( uint32_t i = 0,  uint32_t idx = 0 ) {
+    this->pfx_words = 0;
     this->reset();
     this->min_hash_val = 0;
     this->max_hash_val = ~(uint32_t) 0;
@@ -72,6 +93,30 @@ struct RouteHT {
     this->rem_count = 0;
     this->rem_size  = 0;
     ::memset( this->entry, 0, sizeof( this->entry ) );
+    if ( this->pfx_words != 0 )
+      ::memset( this->block, 0, sizeof( this->block[ 0 ] ) * PFX_WORDS );
+  }
+  /* enable prefix compression, must be empty */
+  void set_prefix_compress( void ) {
+    this->pfx_words = PFX_WORDS;
+    this->reset();
+  }
+  /* use the prefix slots of cp, without refs, before copy_ins() from cp */
+  void copy_prefix( const RouteHT &cp ) {
+    this->pfx_words = cp.pfx_words;
+    if ( this->pfx_words != 0 ) {
+      ::memcpy( this->block, cp.block, sizeof( this->block[ 0 ] ) * PFX_WORDS );
+      for ( size_t k = 0; k < PFX_MAX; k++ )
+        this->prefix( k )->refs = 0;
+    }
+  }
+  RoutePrefix *prefix( size_t k ) const {
+    return (RoutePrefix *) (void *) &this->block[ k * sizeof( RoutePrefix ) /
+                                                  sizeof( uint64_t ) ];
+  }
+  /* end of data space, prefix slots are below */
+  size_t block_end( void ) const {
+    return BLOCK_SIZE - this->pfx_words;
   }
   /* dup this from cp */
   void copy( const RouteHT &cp ) {
@@ -81,7 +126,10 @@ struct RouteHT {
     this->rem_size     = cp.rem_size;
     this->min_hash_val = cp.min_hash_val;
     this->max_hash_val = cp.max_hash_val;
+    this->pfx_words    = cp.pfx_words;
     ::memcpy( this->entry, cp.entry, sizeof( this->entry ) );
+    if ( this->pfx_words != 0 )
+      ::memcpy( this->block, cp.block, sizeof( this->block[ 0 ] ) * PFX_WORDS );
     ::memcpy( &this->block[ BLOCK_SIZE - this->free_off ],
               &cp.block[ BLOCK_SIZE - this->free_off ],
               sizeof( this->block[ 0 ] ) * (size_t) this->free_off );
@@ -90,6 +138,7 @@ struct RouteHT {
   void adjust( void ) {
     if ( this->count != this->rem_count ) {
       RouteHT<Data, data_copy, data_equals> x; /* temp copy */
+      x.copy_prefix( *this );
       x.insert_all( *this );
       x.min_hash_val = this->min_hash_val;
       x.max_hash_val = this->max_hash_val;
@@ -109,12 +158,13 @@ struct RouteHT {
   }
   /* if entry string length l fits into ht */
   RouteFit fits( uint16_t value_len ) const {
-    size_t xoff = (size_t) this->free_off + intsize( value_len );
+    size_t xoff = (size_t) this->free_off +
+                  intsize( value_len + ( this->pfx_words != 0 ? 1 : 0 ) );
     if ( (size_t) ( this->count - this->rem_count ) < HT_83FULL ) {
-      if ( xoff <= BLOCK_SIZE ) /* fits without adjusting */
+      if ( xoff <= this->block_end() ) /* fits without adjusting */
         return FITS_OK;
       xoff -= (size_t) this->rem_size;
-      if ( xoff <= BLOCK_SIZE ) /* only fits after adjusting */
+      if ( xoff <= this->block_end() ) /* only fits after adjusting */
         return FITS_ADJUST;
     }
     return DOES_NOT_FIT; /* does not fit */
@@ -137,8 +187,50 @@ struct RouteHT {
     if ( l == 0 )
       data.value[ 0 ] = 1; /* not removed */
   }
+  /* length of s up to the last separator, which could be a prefix */
+  static uint16_t prefix_len( const void *s,  uint16_t l ) {
+    const char * p = (const char *) s;
+    uint16_t     n = ( l > sizeof( RoutePrefix::str ) ?
+                       (uint16_t) sizeof( RoutePrefix::str ) : l );
+    for ( ; n >= PFX_MIN; n-- ) {
+      if ( p[ n - 1 ] == '.' || p[ n - 1 ] == '/' )
+        return ( n < l ? n : 0 );
+    }
+    return 0;
+  }
+  /* find the longest prefix slot of s, or make a new one if a slot is free */
+  uint8_t find_prefix( const void *s,  uint16_t l,  uint16_t &plen ) {
+    size_t   k, avail = PFX_MAX, best = PFX_MAX;
+    uint16_t n = prefix_len( s, l );
+    plen = 0;
+    if ( n == 0 )
+      return PFX_NONE;
+    for ( k = 0; k < PFX_MAX; k++ ) {
+      RoutePrefix * p = this->prefix( k );
+      if ( p->len != 0 && p->len > plen && p->len <= n &&
+           ::memcmp( p->str, s, p->len ) == 0 ) {
+        best = k;
+        plen = p->len;
+      }
+      else if ( p->refs == 0 && ( avail == PFX_MAX || p->len == 0 ) )
+        avail = k;
+    }
+    /* use a free slot if the prefix found is short */
+    if ( avail != PFX_MAX && n >= plen + PFX_MIN ) {
+      RoutePrefix * p = this->prefix( avail );
+      p->len = (uint8_t) n;
+      ::memcpy( p->str, s, n );
+      best = avail;
+      plen = n;
+    }
+    if ( best == PFX_MAX )
+      return PFX_NONE;
+    return (uint8_t) best;
+  }
   /* put data at location in ht */
   Data *inplace( uint32_t h,  const void *s,  uint16_t l,  uint16_t i ) {
+    if ( this->pfx_words != 0 )
+      return this->inplace_prefix( h, s, l, i );
     Data * data;
     size_t next_off = (size_t) this->free_off + intsize( l );
     if ( next_off > BLOCK_SIZE )
@@ -153,6 +245,56 @@ struct RouteHT {
     do_copy( *data, s, l );
     return data;
   }
+  /* encode s with a prefix slot and put it at location in ht */
+  Data *inplace_prefix( uint32_t h,  const void *s,  uint16_t l,
+                        uint16_t i ) {
+    Data   * data;
+    uint16_t plen;
+    uint8_t  k        = this->find_prefix( s, l, plen );
+    uint16_t elen     = (uint16_t) ( l - plen + 1 );
+    size_t   next_off = (size_t) this->free_off + intsize( elen );
+    if ( next_off > this->block_end() )
+      return NULL;
+    this->free_off = (uint16_t) next_off;
+    this->count++;
+    this->entry[ i ].off  = this->free_off;
+    this->entry[ i ].half = (uint16_t) h;
+    data = (Data *) (void *) &this->block[ BLOCK_SIZE - this->free_off ];
+    data->hash = h;
+    data->len  = elen;
+    data->value[ 0 ] = (char) ( k == PFX_NONE ? PFX_NONE : k + 1 );
+    ::memcpy( &data->value[ 1 ], &((const char *) s)[ plen ], l - plen );
+    if ( k != PFX_NONE )
+      this->prefix( k )->refs++;
+    return data;
+  }
+  /* the prefix slot used by data, NULL if none */
+  RoutePrefix *data_prefix( const Data *data ) const {
+    uint8_t k = (uint8_t) data->value[ 0 ];
+    if ( this->pfx_words == 0 || k == PFX_NONE )
+      return NULL;
+    return this->prefix( k - 1 );
+  }
+  /* length of the value, without encoding */
+  uint16_t value_len( const Data *data ) const {
+    if ( this->pfx_words == 0 )
+      return data->len;
+    RoutePrefix * p = this->data_prefix( data );
+    return (uint16_t) ( data->len - 1 + ( p != NULL ? p->len : 0 ) );
+  }
+  /* copy value to buf, which is at least value_len() bytes */
+  uint16_t get_value( const Data *data,  void *buf ) const {
+    if ( this->pfx_words == 0 ) {
+      ::memcpy( buf, data->value, data->len );
+      return data->len;
+    }
+    RoutePrefix * p    = this->data_prefix( data );
+    uint16_t      plen = ( p != NULL ? p->len : 0 );
+    if ( plen != 0 )
+      ::memcpy( buf, p->str, plen );
+    ::memcpy( &((char *) buf)[ plen ], &data->value[ 1 ], data->len - 1 );
+    return (uint16_t) ( plen + data->len - 1 );
+  }
   /* resize data element, if possible */
   Data *resize( uint16_t i,  uint16_t new_sz ) {
     uint16_t off  = this->entry[ i ].off,
@@ -228,6 +370,17 @@ struct RouteHT {
     pos = i;
     return NULL;
   }
+  /* compare value, decode prefix when compressed */
+  bool equals( const Data &data,  const void *s,  uint16_t l ) const {
+    if ( this->pfx_words == 0 )
+      return test_equals( data, s, l );
+    RoutePrefix * p    = this->data_prefix( &data );
+    uint16_t      plen = ( p != NULL ? p->len : 0 );
+    return l == plen + data.len - 1 &&
+           ( plen == 0 || ::memcmp( s, p->str, plen ) == 0 ) &&
+           ::memcmp( &((const char *) s)[ plen ], &data.value[ 1 ],
+                     data.len - 1 ) == 0;
+  }
   uint16_t locate_data( const Data *data ) const {
     uint32_t h = data->hash;
     uint16_t i = (uint16_t) ( h % HT_SIZE );
@@ -267,7 +420,7 @@ struct RouteHT {
       Data * data = iterate_hash( h, pos, i );
       if ( data == NULL )
         return NULL;
-      if ( test_equals( *data, s, l ) )
+      if ( this->equals( *data, s, l ) )
         return data;
       i = ( pos + 1 ) % HT_SIZE;
     }
@@ -288,7 +441,7 @@ struct RouteHT {
         return NULL;
       }
       hcnt++;
-      if ( found == NULL && test_equals( *data, s, l ) ) {
+      if ( found == NULL && this->equals( *data, s, l ) ) {
         found = data;
         found_pos = pos;
       }
@@ -316,6 +469,9 @@ struct RouteHT {
 
     this->rem_count++;
     this->rem_size += (uint16_t) intsize( data->len );
+    RoutePrefix * p = this->data_prefix( data );
+    if ( p != NULL )
+      p->refs--;
     mark_removed( data );
     this->entry[ i ].off = 0;
     for (;;) {
@@ -371,6 +527,24 @@ struct RouteHT {
     this->entry[ i ].half = (uint16_t) data->hash;
     ::memcpy( &this->block[ BLOCK_SIZE - this->free_off ],
               data, sz * sizeof( this->block[ 0 ] ) );
+    RoutePrefix * p = this->data_prefix( data ); /* same slots as data ht */
+    if ( p != NULL )
+      p->refs++;
+  }
+  /* decode data from fr and encode with the prefix slots of this */
+  bool copy_ins_prefix( const RouteHT &fr,  Data *data ) {
+    char     buf[ 64 * 1024 ];
+    uint16_t l = fr.get_value( data, buf ),
+             i = (uint16_t) ( data->hash % HT_SIZE );
+    while ( this->entry[ i ].off != 0 )
+      i = ( i + 1 ) % HT_SIZE;
+    Data * d = this->inplace_prefix( data->hash, buf, l, i );
+    if ( d == NULL )
+      return false;
+    /* other members before value[] */
+    ::memcpy( (void *) d, (void *) data, (size_t) ( (char *) &d->hash -
+                                                    (char *) d ) );
+    return true;
   }
   /* fetch data at entry[ i ] */
   Data *deref( uint16_t i ) {
@@ -390,7 +564,7 @@ struct RouteHT {
                max_h = this->max_hash_val;
     int        cmp;
     Data     * data;
-    uint32_t * tmph = (uint32_t *) (void *) r.block;
+    uint32_t * tmph = (uint32_t *) (void *) &r.block[ PFX_WORDS ];
     uint16_t   off, cnt = 0;
     /* bsearch the median value */
     for (;;) {
@@ -426,6 +600,8 @@ struct RouteHT {
         break;
     }
     /* split values left and right, left is lteq, right is gt */
+    l.copy_prefix( *this );
+    r.copy_prefix( *this );
     off = this->free_off;
     while ( (data = this->iter_data( off )) != NULL ) {
       if ( data->hash > piv )
@@ -457,8 +633,16 @@ struct RouteHT {
       return false;
 
     RouteHT x; /* temp copy */
+    x.copy_prefix( *this );
     x.insert_all( *this );
-    x.insert_all( fr );
+    if ( this->pfx_words == 0 )
+      x.insert_all( fr );
+    else { /* prefix slots are different, may not fit */
+      Data * data;
+      for ( uint16_t off = fr.free_off; (data = fr.iter_data( off )) != NULL; )
+        if ( ! x.copy_ins_prefix( fr, data ) )
+          return false;
+    }
     x.min_hash_val = this->min_hash_val;
     if ( fr.min_hash_val < this->min_hash_val )
       x.min_hash_val = fr.min_hash_val;
@@ -490,9 +674,10 @@ struct RouteVec {
              vec_size,     /* count of vec[] */
              id;
   uint64_t   seqno;
+  bool       prefix_z;     /* new vec[] use prefix compression */
 
   RouteVec() : vec( 0 ), max_hash_val( 0 ), vec_size( 0 ), id( 0 ),
-               seqno( 0 ) {}
+               seqno( 0 ), prefix_z( false ) {}
   /*RouteVec( RouteVec &v ) : vec( v.vec ), max_hash_val( v.max_hash_val ),
                             vec_size( v.vec_size ), id( v.id ) {}*/
   ~RouteVec() { this->release(); }
@@ -527,6 +712,22 @@ struct RouteVec {
     }
     return cnt - rem;
   }
+  /* share prefixes of values within a block, before the first insert */
+  bool set_prefix_compress( void ) {
+    if ( this->vec_size != 0 )
+      return false;
+    this->prefix_z = true;
+    return true;
+  }
+  /* length of value, decoded if prefix compressed */
+  uint16_t value_len( const RouteLoc &loc,  const Data *data ) const {
+    return this->vec[ loc.i ]->value_len( data );
+  }
+  /* copy value to buf, decoded if prefix compressed */
+  uint16_t get_value( const RouteLoc &loc,  const Data *data,
+                      void *buf ) const {
+    return this->vec[ loc.i ]->get_value( data, buf );
+  }
   size_t mem_size( void ) const {
     return this->vec_size *
              /* *vec[ i ]      + vec[ i ]            + max_hash_val[ i ] */
@@ -773,6 +974,8 @@ struct RouteVec {
       }
     }
     v[ i ] = new ( d ) VecData( this->id++, i );
+    if ( this->prefix_z )
+      v[ i ]->set_prefix_compress();
     if ( i + 1 < this->vec_size )
       v[ i + 1 ]->split( *v[ i ] );
     nhv[ i ] = v[ i ]->max_hash_val;
@@ -819,6 +1022,8 @@ struct RouteVec {
     this->id           = 0;
     ::memcpy( this->vec, v, sizeof( v[ 0 ] ) * count );
 
+    if ( count > 0 )
+      this->prefix_z = ( v[ 0 ]->pfx_words != 0 );
     for ( size_t i = 0; i < count; i++ ) {
       if ( v[ i ]->id >= this->id )
         this->id = v[ i ]->id + 1;
@@ -14,10 +14,14 @@ extern "C" {
 typedef struct kv_geom_s {
   uint64_t map_size;         /* size of memory used by shm */
   uint32_t max_value_size,   /* max size of an data entry */
-           hash_entry_size;  /* size of a hash entry, min 32b */
+           hash_entry_size;  /* size of a hash entry, 32b compact or mult 64b */
   float    hash_value_ratio; /* ratio of hash/data cells: hash = ratio * size */
   uint16_t cuckoo_buckets;   /* how many buckets for each hash */
-  uint8_t  cuckoo_arity;     /* how many hash functions */
+  uint8_t  cuckoo_arity,     /* how many hash functions */
+           cuckoo_path_depth;/* 0 = random walk, N = bfs moves, max
+                                KV_CUCKOO_PATH_MAX, create fails if more */
+  uint16_t ctx_count;        /* number of thread contexts, 0 -> 128 = 128,
+                                max KV_MAX_CTX_COUNT, create fails if more */
 } kv_geom_t;
 
 typedef enum kv_facility_e {
@@ -25,7 +29,9 @@ typedef enum kv_facility_e {
   KV_FILE_MMAP = 2,  /* use open(), mmap()     (f:file, g:file2m, h:file1g) */
   KV_SYSV_SHM  = 4,  /* use shmget(), shmat()  (v:sysv, w:sysv2m, x:sysv1g) */
   KV_HUGE_2MB  = 8,  /* use 2mb pages */
-  KV_HUGE_1GB  = 16  /* use 1gb pages */
+  KV_HUGE_1GB  = 16, /* use 1gb pages */
+  KV_HUGE_AUTO = 32  /* try 1gb, 2mb, then thp advised pages, prefault map
+                        with threads (fileauto, posixauto, sysvauto) */
 } kv_facility_t;
 
 /* +----- +-----
@@ -34,8 +40,10 @@ typedef enum kv_facility_e {
  * |      +-----
  * |      | DBHdr
  * |      |   seed[ 256 ]       = 256 * 16  = 4 K
- * |      |   HashStats[ 256 ]  = 256 * 128 = 32 K ( pad 12 K )
- * |      |   ThrDBStat[ 1024 ] = 1024 * 16 = 16 K   -> 64 K | DB_HDR_SIZE
+ * |      |   HashStats[ 256 ]  = 256 * 128 = 32 K
+ * |      |   ThrDBStat[ 1024 ] = 1024 * 16 = 16 K
+ * |      |   DBQuota[ 256 ]    = 256 * 40  = 10 K ( pad 2 K )
+ * |      |                                          -> 64 K | DB_HDR_SIZE
  * |      +----
  * |      | Segment[ 2032 ] * 64 = 130048            -> 127 K  (192 - (1+64))
  * |      |                                          == 192 K HT_HDR_SIZE
@@ -45,6 +53,11 @@ typedef enum kv_facility_e {
  * |   ThrMCSLock[30]   = 960 -> 1024 - 64           == 128 K HT_CTX_SIZE
  * | HashStats[ 1024 ]  = 128 * 1024                 == 128 K HT_STATS_SIZE
  * +-----
+ * | when ctx_count > 128, the extra ctx and stats, ( 1024 + 1152 ) per ctx
+ * |   ThrCtx[ ctx_count - 128 ]
+ * |   HashStats[ ( ctx_count - 128 ) * 8 ]
+ * |   ThrStatLink[ ( ctx_count - 128 ) * 8 ]      -> align 4 K == ht_off
+ * +-----
  */
 
 /* used as error return for kv_attach_ctx() */
@@ -69,8 +82,18 @@ typedef enum kv_facility_e {
 #define KV_HT_STATS_SIZE    ( 128 * 1024 )
 /* the maximum thread context id */
 #define KV_MAX_CTX_ID       ( KV_HT_CTX_SIZE / KV_HT_THR_CTX_SIZE )
+/* the maximum thread contexts with the extended ctx region, geom.ctx_count */
+#define KV_MAX_CTX_COUNT    4096
 /* shm_attach( shm_string ) */
 #define KV_DEFAULT_SHM      "sysv:raikv.shm"
+/* moves of a breadth first cuckoo path search, geom.cuckoo_path_depth is
+ * copied to hdr.cuckoo_path_depth at create, 0 is the random walk */
+#define KV_CUCKOO_PATH_DEPTH 6
+#define KV_CUCKOO_PATH_MAX   16
+/* min ht[] positions scanned for an entry to evict when db is over quota */
+#define KV_QUOTA_EVICT_SCAN 1024
+/* max ht[] positions scanned by one evict, a sparse db is swept over calls */
+#define KV_QUOTA_EVICT_SCAN_MAX ( 16 * KV_QUOTA_EVICT_SCAN )
 /* sizeof magic at first byte */
 #define KV_SIG_SIZE         16
 /* env for options -m sysv:raikv.shm -s 2048 -k 0.25 -c 2+4 -o ug+rw -v 2048 */
@@ -85,8 +108,12 @@ typedef enum kv_facility_e {
 #define KV_MAXFD_ENV       "KV_MAXFD"
 #define KV_KEEPALIVE_ENV   "KV_KEEPALIVE"
 #define KV_PREFETCH_ENV    "KV_PREFETCH"
+#define KV_COALESCE_ENV    "KV_COALESCE"
+#define KV_SEND_MEM_ENV    "KV_SEND_MEM"
+#define KV_SHED_POLICY_ENV "KV_SHED_POLICY"
 #define KV_REUSEPORT_ENV   "KV_REUSEPORT"
 #define KV_NUM_THREADS_ENV "KV_NUM_THREADS"
+#define KV_ROUTE_BUS_ENV   "KV_ROUTE_BUS"
 #define KV_IPV4_ONLY_ENV   "KV_IPV4_ONLY"
 #define KV_IPC_NAME_ENV    "KV_IPC"
 
@@ -113,6 +140,9 @@ static const size_t HT_FILE_HDR_SIZE      = KV_HT_FILE_HDR_SIZE, /* 1024 */
                     MAX_CTX_ID            = HT_CTX_SIZE /        /* 128 k / */
                                             HT_THR_CTX_SIZE,     /* 1024 = 128*/
                     MAX_STAT_ID           = KV_STAT_COUNT,
+                    /* HashStats[] for each ThrCtx[] = 8 */
+                    STAT_PER_CTX          = MAX_STAT_ID / MAX_CTX_ID,
+                    MAX_CTX_COUNT         = KV_MAX_CTX_COUNT,
                     /* FileHdr::name[] size */
                     MAX_FILE_HDR_NAME_LEN = 64/*sig hdr*/ - 16/*sig*/;
 /* hdr size should be 256b */
@@ -129,7 +159,7 @@ struct FileHdr {
   uint8_t    load_percent,           /* current_load * 100 / critical_load */
              critical_load,
              ht_read_only,
-             pad0;
+             cuckoo_path_depth;      /* 0 = random walk, N = bfs depth */
   AtomUInt16 next_ctx;               /* next free ctx[] */
   AtomUInt16 ctx_used;               /* number of ctx used */
   uint32_t   max_immed_value_size;   /* sizeof value in entry, including key */
@@ -141,8 +171,10 @@ struct FileHdr {
 
              /* third 64b useful read only data, referenced a lot */
              ht_size,         /* calculated size of ht[] */
-             pad1,
-             pad2,
+             ht_off;          /* offset of ht[], 0 = no extended ctx */
+  uint32_t   ctx_count,       /* count of ctx[], 0 = MAX_CTX_ID */
+             stat_count;      /* count of stats[], 0 = MAX_STAT_ID */
+  uint64_t
              ht_mod_mask,     /* mask of bits used for mod */
              ht_mod_fraction; /* fraction of mask used in ht */
   uint32_t   seg_size_val,    /* size of segment[] ( val << seg_align_shift ) */
@@ -158,9 +190,19 @@ struct FileHdr {
   /* when db attached to thr ctx[], db_opened[] is set */
   static const uint64_t DB_OPENED_SIZE = DB_COUNT / 64;
   uint64_t   db_opened[ DB_OPENED_SIZE ];
+  /* segment data released is stamped with read_epoch, it is reclaimed after
+   * the readers pinned at or before the stamp are unpinned */
+  AtomUInt32 read_epoch,     /* current epoch, advanced by gc when blocked */
+             read_epoch_min, /* lower bound of the epochs pinned by readers */
+             pin_ctx_count,  /* count of ctx[] with a pinned read */
+             read_pad;
+  /* set by the last create or attach with KV_HUGE_AUTO */
+  uint32_t   prefault_ms;     /* time to fault the map pages */
+  uint16_t   prefault_threads;/* threads used to fault them */
+  uint16_t   prefault_pad;
   /* spin locks */
   static const uint64_t LOCKQ_SIZE =
-    ( KV_HT_FILE_HDR_SIZE - 64 * 3 ) / sizeof( uint64_t ) - DB_OPENED_SIZE;
+    ( KV_HT_FILE_HDR_SIZE - 64 * 3 ) / sizeof( uint64_t ) - DB_OPENED_SIZE - 3;
   uint64_t   lockq[ LOCKQ_SIZE ];
 
   /* max( ht load, value load ) */
@@ -239,12 +281,13 @@ struct ThrCtxHdr {
                          ctx_thrid, /* thread id (syscall(SYS_gettid)) */
                          db_stat_hd,/* list of db stat */
                          db_stat_tl,
-                         ctx_seqno, /* least recently used counter */
-                         pad1;
+                         ctx_seqno; /* least recently used counter */
+  AtomUInt32             pin_epoch; /* read epoch pinned, 0 = not pinned */
   uint16_t               seg_num,   /* use seg until exhausted */
-                         ctx_flags; /* whether busy or need signal */
+                         ctx_flags; /* CTX_PIN_READ, whether busy or signal */
   rand::xoroshiro128plus rng;       /* rand state initialized on creation */
   /* 4*7=28(int32) 2*2=4(int16) + 8*2=16(int64) + 16(rng) = 64 */
+  static const uint16_t CTX_PIN_READ = 1; /* counted in pin_ctx_count */
 };
 
 struct ThrCtxEntry : public ThrCtxHdr {
@@ -304,19 +347,12 @@ struct ThrCtx : public ThrCtxEntry { /* each thread needs one of these */
   }
 };
 
+struct HashTab;
 struct ThrCtxOwner { /* closure for MCSLock to find the owner of a lock */
-  ThrCtx * ctx;
-  ThrCtxOwner( ThrCtx *p ) : ctx( p ) {}
-  ThrMCSLock& owner( const uint64_t mcs_id ) {
-    return this->ctx[ mcs_id >> ThrCtxEntry::MCS_SHIFT ].get_mcs_lock( mcs_id );
-  }
-  bool is_active( uint64_t mcs_id ) {
-    uint32_t ctx_id = (uint32_t) ( mcs_id >> ThrCtxEntry::MCS_SHIFT );
-    if ( ctx_id >= MAX_CTX_ID )
-      return false;
-    return ( this->ctx[ ctx_id ].mcs_used &
-             ( (uint64_t) 1 << ( mcs_id & ThrCtxEntry::MCS_MASK ) ) ) != 0;
-  }
+  HashTab & ht;
+  ThrCtxOwner( HashTab &t ) : ht( t ) {}
+  ThrMCSLock& owner( const uint64_t mcs_id );
+  bool is_active( uint64_t mcs_id );
 };
 
 struct ThrStatLink {
@@ -348,16 +384,76 @@ struct HashSeed {
     h[ 0 ] = this->hash1; h[ 1 ] = this->hash2;
     KeyFragment::hash4( kb, kb2, kb3, kb4, h );
   }
+  /* h[] is count * 2, h[ i*2 ], h[ i*2+1 ] is the hash of kb[ i ] */
+  void hash( KeyFragment **kb,  uint64_t *h,  size_t count ) const {
+    h[ 0 ] = this->hash1; h[ 1 ] = this->hash2;
+    KeyFragment::hash_array( kb, h, count );
+  }
+};
+
+/* dead process lock recovery, updated by HashTab::recover_dead_ctx() */
+struct CtxRecoverStats {
+  AtomUInt64 owner;      /* pid running the recovery, 0 = none */
+  uint64_t   check_cnt,  /* number of times ctx[] were checked */
+             dead_ctx,   /* ctx found with a dead pid */
+             lock_recov, /* mcs locks recovered, entries unlocked */
+             lock_wait,  /* mcs locks not recovered, waiting on others */
+             ctx_detach, /* dead ctx detached after all locks recovered */
+             last_stamp, /* time of last recovery */
+             pad;
+};
+
+/* optional limits on the ht[] entries and segment bytes used by a db, the
+ * usage is only tracked while a limit is set, HashTab::set_db_quota() counts
+ * the current usage when it is enabled; the counters are signed, data added
+ * before the quota and dropped after can take them below zero; evictions
+ * are counted in HashCounters::htevict and refusals in afail of the db */
+struct DBQuota {
+  uint64_t   max_bytes,   /* limit of segment bytes, 0 = no limit */
+             max_entries; /* limit of ht[] entries, 0 = no limit */
+  AtomUInt64 bytes,       /* segment bytes used, when max_bytes != 0 */
+             entries;     /* ht[] entries used, when max_entries != 0 */
+  uint64_t   evict_pos;   /* ht[] position where the next evict scan starts */
+
+  bool is_set( void ) const {
+    return ( this->max_bytes | this->max_entries ) != 0;
+  }
+  void incr_entries( void ) {
+    if ( this->max_entries != 0 ) this->entries.add( 1 );
+  }
+  void decr_entries( void ) {
+    if ( this->max_entries != 0 ) this->entries.sub( 1 );
+  }
+  void incr_bytes( uint64_t n ) {
+    if ( this->max_bytes != 0 ) this->bytes.add( n );
+  }
+  void decr_bytes( uint64_t n ) {
+    if ( this->max_bytes != 0 ) this->bytes.sub( n );
+  }
+  /* true if adding n entries or n bytes is over the limit */
+  bool over_entries( uint64_t n ) const {
+    return this->max_entries != 0 &&
+      (int64_t) this->entries.load() + (int64_t) n >
+      (int64_t) this->max_entries;
+  }
+  bool over_bytes( uint64_t n ) const {
+    return this->max_bytes != 0 &&
+      (int64_t) this->bytes.load() + (int64_t) n > (int64_t) this->max_bytes;
+  }
 };
 
 struct DBHdr {
   HashSeed     seed[ DB_COUNT ];         /* db hash seeds 4 K */
   HashCounters db_stat[ DB_COUNT ];      /* one for each db            32 K */
   ThrStatLink  stat_link[ MAX_STAT_ID ]; /* one for each open db       16 K */
+  CtxRecoverStats recover;               /* dead ctx recovery counters  64 */
+  DBQuota      db_quota[ DB_COUNT ];     /* per db limits              10 K */
 
-  uint8_t pad[ DB_HDR_SIZE - /* 12 K */
-    ( ( sizeof( HashCounters ) + sizeof( uint64_t ) * 2 ) * DB_COUNT
-    + ( sizeof( ThrStatLink ) * MAX_STAT_ID ) ) ];
+  uint8_t pad[ DB_HDR_SIZE - /* 2 K */
+    ( ( sizeof( HashCounters ) + sizeof( uint64_t ) * 2 +
+        sizeof( DBQuota ) ) * DB_COUNT
+    + ( sizeof( ThrStatLink ) * MAX_STAT_ID )
+    + sizeof( CtxRecoverStats ) ) ];
 
   void get_hash_seed( uint8_t db_num,  HashSeed &hs ) const {
     hs = this->seed[ db_num ];
@@ -382,20 +478,69 @@ struct HashTab {
   /* tab size is this->hdr.ht_size * this->hdr.hash_entry_size,
      determined by total shm size */
 public:
+  /* the ctx[] and stats[] above are extended when ctx_count > MAX_CTX_ID,
+   * ext region follows stats[], then ht[] at hdr.ht_off */
+  static const uint64_t EXT_OFF = HT_HDR_SIZE + HT_CTX_SIZE + HT_STATS_SIZE;
+  static uint64_t ext_size( uint32_t ctx_count ) {
+    if ( ctx_count <= MAX_CTX_ID )
+      return 0;
+    uint64_t n = ctx_count - MAX_CTX_ID;
+    return align<uint64_t>( n * sizeof( ThrCtx ) + n * STAT_PER_CTX *
+                         ( sizeof( HashCounters ) + sizeof( ThrStatLink ) ),
+                            4096 );
+  }
+  uint32_t max_ctx_count( void ) const {
+    return this->hdr.ctx_count == 0 ? (uint32_t) MAX_CTX_ID :
+           this->hdr.ctx_count;
+  }
+  uint32_t max_stat_count( void ) const {
+    return this->hdr.stat_count == 0 ? (uint32_t) MAX_STAT_ID :
+           this->hdr.stat_count;
+  }
+  /* stat ids above MAX_STAT_ID skip it, it is the null link */
+  static uint32_t stat_id( uint32_t i ) {
+    return i < MAX_STAT_ID ? i : i + 1;
+  }
+  ThrCtx &get_ctx( uint32_t ctx_id ) const {
+    if ( ctx_id < MAX_CTX_ID )
+      return ((ThrCtx *) this->ctx)[ ctx_id ];
+    ThrCtx *ext = (ThrCtx *) (void *) &((uint8_t *) (void *) this)[ EXT_OFF ];
+    return ext[ ctx_id - MAX_CTX_ID ];
+  }
+  HashCounters &get_stats( uint32_t id ) const {
+    if ( id < MAX_STAT_ID )
+      return ((HashCounters *) this->stats)[ id ];
+    HashCounters *ext = (HashCounters *) (void *)
+      &((uint8_t *) (void *) this)[ EXT_OFF + ( this->max_ctx_count() -
+                                      MAX_CTX_ID ) * sizeof( ThrCtx ) ];
+    return ext[ id - ( MAX_STAT_ID + 1 ) ];
+  }
+  ThrStatLink &get_stat_link( uint32_t id ) const {
+    if ( id < MAX_STAT_ID )
+      return ((ThrStatLink *) this->hdr.stat_link)[ id ];
+    uint64_t n = this->max_ctx_count() - MAX_CTX_ID;
+    ThrStatLink *ext = (ThrStatLink *) (void *)
+      &((uint8_t *) (void *) this)[ EXT_OFF + n * sizeof( ThrCtx ) +
+                                   n * STAT_PER_CTX * sizeof( HashCounters ) ];
+    return ext[ id - ( MAX_STAT_ID + 1 ) ];
+  }
+  uint8_t *ht_start( void ) const {
+    uint64_t off = this->hdr.ht_off;
+    if ( off == 0 )
+      off = EXT_OFF;
+    return &((uint8_t *) (void *) this)[ off ];
+  }
   static HashEntry *get_entry( void *ht_base,  uint64_t i,
                                uint32_t hash_entry_size ) {
     return (HashEntry *) (void *)
       &((uint8_t *) ht_base)[ i * (uint64_t) hash_entry_size ];
   }
   HashEntry *get_entry( uint64_t i,  uint32_t hash_entry_size ) const {
-    return get_entry( &((uint8_t *) (void *) this)[ HT_HDR_SIZE + HT_CTX_SIZE +
-                                                    HT_STATS_SIZE ],
-                      i, hash_entry_size );
+    return get_entry( this->ht_start(), i, hash_entry_size );
   }
   uint64_t get_entry_pos( const HashEntry *entry,
                           uint32_t hash_entry_size ) const {
-    const uint8_t *start =
-      &((uint8_t *) (void *) this)[ HT_HDR_SIZE + HT_CTX_SIZE + HT_STATS_SIZE ];
+    const uint8_t *start = this->ht_start();
     return ( (const uint8_t *) (const void *) entry - start ) / hash_entry_size;
   }
   HashEntry *get_entry( uint64_t i ) {
@@ -445,6 +590,10 @@ public:
   void detach_db( uint32_t ctx_id,  uint8_t db ) noexcept;
   /* free the shared usage context */
   void detach_ctx( uint32_t ctx_id ) noexcept;
+  /* find ctx[] owned by dead processes, recover the entries they have locked
+   * and detach them, return the number of dead ctx found; only one process
+   * runs this at a time, others return 0 while it is busy */
+  uint32_t recover_dead_ctx( bool verbose = false ) noexcept;
   /* calculate load of ht and set this->hdr.current_load */
   void update_load( void ) noexcept;
   /* accumulate stats just for ctx_id with delta change */
@@ -454,6 +603,31 @@ public:
                         HashCounters &tot,  uint8_t db ) noexcept;
   /* accumulate stats just for db */
   bool get_db_stats( HashCounters &tot,  uint8_t db_num ) noexcept;
+  /* pin the read epoch of ctx, the segment data a reader can find is not
+   * moved or reclaimed by gc until unpin_read(), pins do not nest */
+  void pin_read( uint32_t ctx_id ) noexcept;
+  void unpin_read( uint32_t ctx_id ) noexcept;
+  /* true if data released at stamp can be reused, refresh the lower bound
+   * of pinned epochs from ctx[] when it is not */
+  bool is_read_reclaimable( uint32_t stamp,  bool &refreshed ) {
+    if ( stamp == 0 || this->hdr.pin_ctx_count == 0 ||
+         (int32_t) ( stamp - this->hdr.read_epoch_min ) < 0 )
+      return true;
+    if ( refreshed )
+      return false;
+    refreshed = true;
+    return (int32_t) ( stamp - this->update_read_epoch() ) < 0;
+  }
+  /* advance read_epoch, scan ctx[] for the oldest pin, return read_epoch_min */
+  uint32_t update_read_epoch( void ) noexcept;
+  /* limit the bytes and entries of db, zero removes the limit, usage is
+   * counted by scanning ht[] when a limit is enabled; a lower limit evicts
+   * gradually as new entries and data are added to the db */
+  void set_db_quota( uint8_t db,  uint64_t max_bytes,
+                     uint64_t max_entries ) noexcept;
+  DBQuota &db_quota( uint8_t db ) {
+    return this->hdr.db_quota[ db ];
+  }
   /* accumulate memory usage stats of each segment and return true if changed
    * stats[] should be sized by this->hdr.nsegs */
   bool sum_mem_deltas( MemDeltaCounters *stats,  MemCounters &chg,
@@ -478,6 +652,23 @@ public:
   }
 };
 
+inline ThrMCSLock &
+ThrCtxOwner::owner( const uint64_t mcs_id )
+{
+  uint32_t ctx_id = (uint32_t) ( mcs_id >> ThrCtxEntry::MCS_SHIFT );
+  return this->ht.get_ctx( ctx_id ).get_mcs_lock( mcs_id );
+}
+
+inline bool
+ThrCtxOwner::is_active( uint64_t mcs_id )
+{
+  uint32_t ctx_id = (uint32_t) ( mcs_id >> ThrCtxEntry::MCS_SHIFT );
+  if ( ctx_id >= this->ht.max_ctx_count() )
+    return false;
+  return ( this->ht.get_ctx( ctx_id ).mcs_used &
+           ( (uint64_t) 1 << ( mcs_id & ThrCtxEntry::MCS_MASK ) ) ) != 0;
+}
+
 struct EvShm {
   HashTab    * map;
   uint32_t     ctx_id,
@@ -486,13 +677,13 @@ struct EvShm {
              * ctx_name;
 
   EvShm( const char *nm,  HashTab *m = 0 )
-    : map( m ), ctx_id( MAX_CTX_ID ), dbx_id( MAX_STAT_ID ), ipc_name( 0 ),
+    : map( m ), ctx_id( KV_NO_CTX_ID ), dbx_id( MAX_STAT_ID ), ipc_name( 0 ),
       ctx_name( nm ) {}
   EvShm( const char *nm,  EvShm &m )
     : map( m.map ), ctx_id( m.ctx_id ), dbx_id( m.dbx_id ),
       ipc_name( m.ipc_name ), ctx_name( nm ) {}
   EvShm( EvShm &m,  bool cpy )
-    : map( m.map ), ctx_id( MAX_CTX_ID ), dbx_id( MAX_STAT_ID ),
+    : map( m.map ), ctx_id( KV_NO_CTX_ID ), dbx_id( MAX_STAT_ID ),
       ipc_name( m.ipc_name ), ctx_name( m.ctx_name ) {
     if ( cpy ) {
       this->ctx_id = m.ctx_id;
@@ -539,6 +730,8 @@ float kv_update_load( kv_hash_tab_t *ht );
 uint32_t kv_attach_ctx( kv_hash_tab_t *ht,  uint64_t key );
 /* deattach a thread context */
 void kv_detach_ctx( kv_hash_tab_t *ht,  uint32_t ctx_id );
+/* recover locks of ctx owned by dead processes, return count of dead ctx */
+uint32_t kv_recover_dead_ctx( kv_hash_tab_t *ht );
 /* attach a thread context, return ctx_id, which is an index to ht->ctx[], key is arbitrary */
 uint32_t kv_attach_db( kv_hash_tab_t *ht,  uint32_t ctx_id,  uint8_t db );
 /* deattach a thread context */
@@ -0,0 +1,73 @@
+#ifndef __rai__raikv__topic_log_h__
+#define __rai__raikv__topic_log_h__
+
+/* also include stdint.h, string.h */
+#include <raikv/shm_ht.h>
+#include <raikv/key_buf.h>
+
+#ifdef __cplusplus
+namespace rai {
+namespace kv {
+
+/* A message log for each subject, stored as a message list value in the
+ * shm map, the subject is the key:
+ *
+ *   TopicLog log( *map, dbx_id );
+ *   log.publish( "subject", 7, data, data_len, seqno );
+ *
+ * Any process attached to the map can read it without other IPC:
+ *
+ *   uint64_t   seqno = last_seqno + 1, cnt = 64;
+ *   void     * msg[ 64 ];
+ *   msg_size_t msg_sz[ 64 ];
+ *   if ( log.read( "subject", 7, seqno, msg, msg_sz, cnt ) == KEY_OK )
+ *     ... msg[ 0 .. cnt-1 ] are seqno -> seqno + cnt - 1
+ *
+ * Writers serialize through the key lock, so multiple processes can publish
+ * to the same subject.  Readers use a copy on read find(), msg[] references
+ * are valid until the next read().  When max_size is set, the log is a
+ * chain of max_size msg lists, when the chain is full the oldest list is
+ * dropped, so between 2 * max_size and 4 * max_size of the newest msgs are
+ * kept.  The log is not connected to the KV publish path, publishers call
+ * it directly. */
+struct TopicLog {
+  HashTab   & map;
+  uint64_t    max_size;   /* trim log when larger than this, 0 = no limit */
+  KeyBuf      kbuf;       /* subject key */
+  WorkAlloc8k wrk;        /* copy on read space */
+  KeyCtx      kctx;       /* key ctx of subject */
+  HashSeed    hs;         /* seed for the db */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  TopicLog( HashTab &m,  uint32_t dbx_id,  uint64_t max_sz = 0 ) noexcept;
+
+  /* set the subject key, false if subject is too long */
+  bool set_subject( const char *sub,  size_t sublen ) noexcept;
+  /* append msg, seqno is set to the sequence of the msg */
+  KeyStatus publish( const char *sub,  size_t sublen,  const void *msg,
+                     msg_size_t msg_size,  uint64_t &seqno ) noexcept {
+    void * p = (void *) msg;
+    return this->publish_vector( sub, sublen, 1, &p, &msg_size, seqno );
+  }
+  /* append count msgs, seqno is set to the sequence of msg[ 0 ] */
+  KeyStatus publish_vector( const char *sub,  size_t sublen,  uint64_t count,
+                            void **msg,  msg_size_t *msg_size,
+                            uint64_t &seqno ) noexcept;
+  /* read up to count msgs starting at seqno, if seqno was trimmed, it is
+   * advanced to the first available, count is set to the number read */
+  KeyStatus read( const char *sub,  size_t sublen,  uint64_t &seqno,
+                  void **msg,  msg_size_t *msg_size,
+                  uint64_t &count ) noexcept;
+  /* the first and last seqno available, first > last when empty */
+  KeyStatus bounds( const char *sub,  size_t sublen,  uint64_t &first,
+                    uint64_t &last ) noexcept;
+  /* remove msgs before seqno, msgs are freed by chain, so some msgs before
+   * seqno may still be available */
+  KeyStatus trim( const char *sub,  size_t sublen,  uint64_t seqno ) noexcept;
+};
+
+}
+}
+#endif
+#endif
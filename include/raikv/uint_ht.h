@@ -229,6 +229,130 @@ void size_tab( IntHashTab *&xht,  size_t cnt )
   if ( xht == NULL || xht->tab_size() != sz )
     resize_tab<IntHashTab>( xht, sz );
 }
+/* Robin Hood probing:  the elems of a chain are ordered by their natural
+ * position, an elem is never further from its natural position than the elems
+ * that follow it in the chain;  find() stops at the first elem that is closer
+ * to its natural position than the hash probed would be, and that is also the
+ * position returned for set() on a miss, where the rest of the chain is
+ * shifted forward by one to make room */
+template <class IntHashTab>
+size_t probe_dist( const IntHashTab &x,  size_t pos )
+{
+  return ( pos - ( x.tab[ pos ].hash & x.tab_mask ) ) & x.tab_mask;
+}
+template <class IntHashTab, class Int>
+bool rh_find_tab( const IntHashTab &x,  const Int &h,  size_t &pos )
+{
+  const void * u = x.used_c();
+  size_t dist = 0;
+  for ( pos = h & x.tab_mask; ; pos = ( pos + 1 ) & x.tab_mask ) {
+    if ( ! x.is_used( pos, u ) )
+      return false;
+    if ( x.tab[ pos ].hash == h )
+      return true;
+    if ( probe_dist<IntHashTab>( x, pos ) < dist ) /* h would be here */
+      return false;
+    dist++;
+  }
+}
+/* make room at pos by moving the chain forward to the next empty slot */
+template <class IntHashTab>
+void rh_insert_tab( IntHashTab &x,  size_t pos )
+{
+  void * u   = x.used();
+  size_t end = pos;
+  while ( x.test_set( end, u ) ) /* find the end of the chain and use it */
+    end = ( end + 1 ) & x.tab_mask;
+  while ( end != pos ) {
+    size_t prev = ( end - 1 ) & x.tab_mask;
+    x.tab[ end ] = x.tab[ prev ];
+    end = prev;
+  }
+}
+/* remove pos by moving the elems that follow it back by one, until an empty
+ * slot or an elem at its natural position */
+template <class IntHashTab>
+void rh_remove_tab( IntHashTab &x,  size_t pos )
+{
+  void * u = x.used();
+  for (;;) {
+    size_t next = ( pos + 1 ) & x.tab_mask;
+    if ( ! x.is_used( next, u ) || probe_dist<IntHashTab>( x, next ) == 0 ) {
+      x.clear( pos, u );
+      return;
+    }
+    x.tab[ pos ] = x.tab[ next ];
+    pos = next;
+  }
+}
+template <class IntHashTab>
+void rh_copy_tab( IntHashTab &dest,  const IntHashTab &src )
+{
+  const size_t cpy_size = src.tab_size();
+  const void * cpy_u    = src.used_c();
+  for ( size_t i = 0; i < cpy_size; i++ ) {
+    if ( src.is_used( i, cpy_u ) ) {
+      size_t new_pos;
+      rh_find_tab( dest, src.tab[ i ].hash, new_pos );
+      rh_insert_tab<IntHashTab>( dest, new_pos );
+      dest.tab[ new_pos ] = src.tab[ i ];
+    }
+  }
+}
+/* the probe policy used by the tables below, LinearProbe is the default */
+struct LinearProbe {
+  template <class IntHashTab, class Int>
+  static bool find( const IntHashTab &x,  const Int &h,  size_t &pos ) {
+    const void * u = x.used_c();
+    for ( pos = h & x.tab_mask; ; pos = ( pos + 1 ) & x.tab_mask ) {
+      if ( ! x.is_used( pos, u ) )
+        return false;
+      if ( x.tab[ pos ].hash == h )
+        return true;
+    }
+  }
+  /* pos is an empty slot or the slot of h */
+  template <class IntHashTab, class Int>
+  static void insert( IntHashTab &x,  const Int &,  size_t pos ) {
+    x.test_set( pos, x.used() );
+  }
+  template <class IntHashTab>
+  static void remove( IntHashTab &x,  size_t pos ) {
+    remove_tab<IntHashTab>( x, pos );
+  }
+  template <class IntHashTab>
+  static void copy( IntHashTab &dest,  const IntHashTab &src ) {
+    copy_tab<IntHashTab>( dest, src );
+  }
+  static size_t max_count( size_t sz ) { return sz / 2 + sz / 4; } /* 75% */
+};
+
+struct RobinHoodProbe {
+  template <class IntHashTab, class Int>
+  static bool find( const IntHashTab &x,  const Int &h,  size_t &pos ) {
+    return rh_find_tab( x, h, pos );
+  }
+  /* pos is an empty slot, the slot of h, or the slot h displaces */
+  template <class IntHashTab, class Int>
+  static void insert( IntHashTab &x,  const Int &h,  size_t pos ) {
+    if ( x.is_used( pos, x.used() ) && x.tab[ pos ].hash == h )
+      return;
+    rh_insert_tab<IntHashTab>( x, pos );
+  }
+  template <class IntHashTab>
+  static void remove( IntHashTab &x,  size_t pos ) {
+    rh_remove_tab<IntHashTab>( x, pos );
+  }
+  template <class IntHashTab>
+  static void copy( IntHashTab &dest,  const IntHashTab &src ) {
+    rh_copy_tab<IntHashTab>( dest, src );
+  }
+  /* chains are short enough to run fuller */
+  static size_t max_count( size_t sz ) {
+    return sz / 2 + sz / 4 + sz / 8; /* 87.5% */
+  }
+};
+
 /* usage:
  *
  * typedef IntHashTabT<uint,uint> MyHT;
@@ -240,7 +364,7 @@ void size_tab( IntHashTab *&xht,  size_t cnt )
  *   MyHt::check_resize( ht );
  * }
  */
-template <class Int, class Value>
+template <class Int, class Value, class Probe = LinearProbe>
 struct IntHashTabT : public IntHashUsage
 {
   struct Elem {
@@ -252,6 +376,7 @@ struct IntHashTabT : public IntHashUsage
   void * operator new( size_t, void *ptr ) { return ptr; }
   void operator delete( void *ptr ) { ::free( ptr ); }
   IntHashTabT( size_t sz ) : IntHashUsage( sz ) {
+    this->max_count = Probe::max_count( sz );
     this->clear_all_elems( this->used() );
   }
   void * used( void ) { return &this->tab[ this->tab_size() ]; }
@@ -261,7 +386,7 @@ struct IntHashTabT : public IntHashUsage
   }
   /* set the hash at pos, which should be located using find() */
   void set( Int h,  size_t pos,  Value v ) {
-    this->test_set( pos, this->used() );
+    Probe::insert( *this, h, pos );
     this->tab[ pos ].hash = h;
     this->tab[ pos ].val  = v;
   }
@@ -293,7 +418,7 @@ struct IntHashTabT : public IntHashUsage
   }
   /* copy from cpy into this, does not check for duplicate entries or resize */
   void copy( const IntHashTabT &cpy ) {
-    copy_tab<IntHashTabT>( *this, cpy );
+    Probe::copy( *this, cpy );
   }
   /* iterate through elements */
   bool first( size_t &pos ) const {
@@ -306,13 +431,7 @@ struct IntHashTabT : public IntHashUsage
   }
   /* find hash by scanning chain, return it's position and the value if found */
   bool find( Int h,  size_t &pos ) const {
-    const void * u = this->used_c();
-    for ( pos = h & this->tab_mask; ; pos = ( pos + 1 ) & this->tab_mask ) {
-      if ( ! this->is_used( pos, u ) )
-        return false;
-      if ( this->tab[ pos ].hash == h )
-        return true;
-    }
+    return Probe::find( *this, h, pos );
   }
   bool find( Int h,  size_t &pos,  Value &val ) const {
     if ( ! this->find( h, pos ) )
@@ -332,7 +451,7 @@ struct IntHashTabT : public IntHashUsage
   }
   /* remove at pos */
   void remove( size_t pos ) {
-    remove_tab<IntHashTabT>( *this, pos );
+    Probe::remove( *this, pos );
   }
   bool find_remove( Int h ) {
     size_t pos;
@@ -358,6 +477,8 @@ struct IntHashTabT : public IntHashUsage
 };
 typedef IntHashTabT<uint32_t, uint32_t> UIntHashTab;
 typedef IntHashTabT<uint64_t, uint64_t> UInt64HashTab;
+typedef IntHashTabT<uint32_t, uint32_t, RobinHoodProbe> UIntHashTabRH;
+typedef IntHashTabT<uint64_t, uint64_t, RobinHoodProbe> UInt64HashTabRH;
 
 /* allocates the tab elems separately, slightly slower, but less clutter,
  * no need to call check_resize()
@@ -369,7 +490,7 @@ typedef IntHashTabT<uint64_t, uint64_t> UInt64HashTab;
  * if ( ht.find( x, pos ) )
  *   ht.remove( pos );
  */
-template <class Int, class Value>
+template <class Int, class Value, class Probe = LinearProbe>
 struct IntHashTabX : public IntHashUsage
 {
   struct Elem {
@@ -382,6 +503,7 @@ struct IntHashTabX : public IntHashUsage
   void * operator new( size_t, void *ptr ) { return ptr; }
   void operator delete( void *ptr ) { ::free( ptr ); }
   IntHashTabX( void *p,  size_t sz ) : IntHashUsage( sz ) {
+    this->max_count = Probe::max_count( sz );
     this->tab = (Elem *) p;
     this->clear_all_elems( this->used() );
   }
@@ -414,9 +536,11 @@ struct IntHashTabX : public IntHashUsage
   const void * used_c( void ) const { return &this->tab[ this->tab_size() ]; }
   /* set the hash at pos, which should be located using find() */
   void set( Int h,  size_t pos,  Value v ) {
+    size_t cnt = this->elem_count;
+    Probe::insert( *this, h, pos );
     this->tab[ pos ].hash = h;
     this->tab[ pos ].val  = v;
-    if ( ! this->test_set( pos, this->used() ) ) {
+    if ( cnt != this->elem_count ) {
       if ( this->elem_count >= this->max_count )
         this->resize( this->tab_size() * 2 );
     }
@@ -443,7 +567,7 @@ struct IntHashTabX : public IntHashUsage
   }
   /* copy from cpy into this, does not check for duplicate entries or resize */
   void copy( const IntHashTabX &cpy ) {
-    copy_tab<IntHashTabX>( *this, cpy );
+    Probe::copy( *this, cpy );
   }
   /* iterate through elements */
   bool first( size_t &pos ) const {
@@ -456,13 +580,7 @@ struct IntHashTabX : public IntHashUsage
   }
   /* find hash by scanning chain, return it's position and the value if found */
   bool find( Int h,  size_t &pos ) const {
-    const void * u = this->used_c();
-    for ( pos = h & this->tab_mask; ; pos = ( pos + 1 ) & this->tab_mask ) {
-      if ( ! this->is_used( pos, u ) )
-        return false;
-      if ( this->tab[ pos ].hash == h )
-        return true;
-    }
+    return Probe::find( *this, h, pos );
   }
   bool find( Int h,  size_t &pos,  Value &val ) const {
     if ( ! this->find( h, pos ) )
@@ -478,7 +596,7 @@ struct IntHashTabX : public IntHashUsage
   }
   /* remove at pos */
   void remove( size_t pos ) {
-    remove_tab<IntHashTabX>( *this, pos );
+    Probe::remove( *this, pos );
     if ( this->elem_count < this->min_count )
       this->resize( this->tab_size() / 2 );
   }
@@ -498,7 +616,7 @@ struct IntHashTabX : public IntHashUsage
  *   MyHt::check_resize( ht );
  * }
  */
-template <class Int>
+template <class Int, class Probe = LinearProbe>
 struct IntHashTabU : public IntHashUsage
 {
   struct Elem {
@@ -509,6 +627,7 @@ struct IntHashTabU : public IntHashUsage
   void * operator new( size_t, void *ptr ) { return ptr; }
   void operator delete( void *ptr ) { ::free( ptr ); }
   IntHashTabU( size_t sz ) : IntHashUsage( sz ) {
+    this->max_count = Probe::max_count( sz );
     this->clear_all_elems( this->used() );
   }
   void * used( void ) { return &this->tab[ this->tab_size() ]; }
@@ -518,7 +637,7 @@ struct IntHashTabU : public IntHashUsage
   }
   /* set the hash at pos, which should be located using find() */
   void set( Int h,  size_t pos ) {
-    this->test_set( pos, this->used() );
+    Probe::insert( *this, h, pos );
     this->tab[ pos ].hash = h;
   }
   static void set_rsz( IntHashTabU *&xht,  Int h,  size_t pos ) {
@@ -548,7 +667,7 @@ struct IntHashTabU : public IntHashUsage
   }
   /* copy from cpy into this, does not check for duplicate entries or resize */
   void copy( const IntHashTabU &cpy ) {
-    copy_tab<IntHashTabU>( *this, cpy );
+    Probe::copy( *this, cpy );
   }
   /* iterate through elements */
   bool first( size_t &pos ) const {
@@ -561,13 +680,7 @@ struct IntHashTabU : public IntHashUsage
   }
   /* find hash by scanning chain, return it's position and the value if found */
   bool find( Int h,  size_t &pos ) const {
-    const void * u = this->used_c();
-    for ( pos = h & this->tab_mask; ; pos = ( pos + 1 ) & this->tab_mask ) {
-      if ( ! this->is_used( pos, u ) )
-        return false;
-      if ( this->tab[ pos ].hash == h )
-        return true;
-    }
+    return Probe::find( *this, h, pos );
   }
   /* udpate or insert hash */
   void upsert( Int h ) {
@@ -581,7 +694,7 @@ struct IntHashTabU : public IntHashUsage
   }
   /* remove at pos */
   void remove( size_t pos ) {
-    remove_tab<IntHashTabU>( *this, pos );
+    Probe::remove( *this, pos );
   }
   size_t mem_size( void ) const {
     return IntHashTabU::alloc_size( this->tab_size() );
@@ -0,0 +1,150 @@
+#ifndef __rai_raikv__wild_match_h__
+#define __rai_raikv__wild_match_h__
+
+/* also include stdint.h, string.h */
+#include <raikv/array_space.h>
+#include <raikv/uint_ht.h>
+#include <raikv/pattern_cvt.h>
+
+namespace rai {
+namespace kv {
+
+/* Match the rv and glob patterns without pcre, the same subjects match as
+ * the pcre source from PatternCvt, including the (S,N) shard suffix which
+ * is stripped and the trailing wildcard prefix match:
+ *
+ *   rv:   *  = one or more chars, not '.'       a.*.c  a.b*
+ *         >  = one or more chars, a.> is a prefix of "a."
+ *   glob: *  = zero or more chars, a* is a prefix of "a"
+ *         ?  = one char
+ *         [] = one char of a set, [^] not in the set, [a-z] range
+ *         \  = escape next char */
+struct WildMatch {
+  static bool match_rv( const char *pat,  size_t patlen,
+                        const char *sub,  size_t sublen ) noexcept;
+  static bool match_glob( const char *pat,  size_t patlen,
+                          const char *sub,  size_t sublen ) noexcept;
+  static bool match( PatternFmt fmt,  const char *pat,  size_t patlen,
+                     const char *sub,  size_t sublen ) {
+    if ( fmt == GLOB_PATTERN_FMT )
+      return match_glob( pat, patlen, sub, sublen );
+    return match_rv( pat, patlen, sub, sublen );
+  }
+};
+
+/* pattern which is not matched by the trie segments alone */
+struct WildPattern {
+  uint32_t   id;
+  uint16_t   len;
+  PatternFmt fmt;
+  char       pat[ 4 ];
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  WildPattern( uint32_t i,  const char *p,  size_t l,  PatternFmt f )
+      : id( i ), len( (uint16_t) l ), fmt( f ) {
+    ::memcpy( this->pat, p, l );
+    this->pat[ l ] = '\0';
+  }
+  static WildPattern *create( uint32_t i,  const char *p,  size_t l,
+                              PatternFmt f ) {
+    void * m = ::malloc( sizeof( WildPattern ) + l );
+    if ( m == NULL )
+      return NULL;
+    return new ( m ) WildPattern( i, p, l, f );
+  }
+};
+
+typedef ArrayCount<uint32_t, 4>      WildIdList;
+typedef ArrayCount<WildPattern *, 4> WildPatList;
+
+/* trie node for each subject segment */
+struct WildNode {
+  char      * seg;      /* segment text, for hash collision check */
+  uint64_t    key;      /* key in WildTrie::child, hash of parent + seg */
+  uint32_t    parent,   /* node index of parent */
+              star,     /* child which matches any segment, 0 = none */
+              ref;      /* count of ids and children using node */
+  uint16_t    seg_len;
+  bool        is_star;  /* is the star child of parent */
+  WildIdList  term,     /* patterns ending at this node */
+              tail;     /* patterns ending in .> or .* at this node */
+  WildPatList other;    /* patterns with wildcards inside a segment */
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  WildNode() : seg( 0 ), key( 0 ), parent( 0 ), star( 0 ), ref( 0 ),
+               seg_len( 0 ), is_star( false ) {}
+  ~WildNode() {
+    if ( this->seg != NULL )
+      ::free( this->seg );
+    for ( size_t i = 0; i < this->other.count; i++ )
+      delete this->other.ptr[ i ];
+  }
+};
+
+typedef IntHashTabX<uint64_t, uint32_t> WildChildHT;
+typedef ArrayCount<uint32_t, 64>        WildMatchIds;
+
+struct NotifyPattern;
+
+/* A set of patterns indexed by subject segments, a match walks the trie
+ * once and returns the ids of all patterns that match:
+ *
+ *   WildTrie t;
+ *   t.add( "quote.*.NYSE", 12, RV_PATTERN_FMT, 1 );
+ *   t.add( "quote.>", 7, RV_PATTERN_FMT, 2 );
+ *   t.add( "quote.IBM*", 10, GLOB_PATTERN_FMT, 3 );
+ *   WildMatchIds ids;
+ *   t.match( "quote.IBM.NYSE", 14, ids ); -- ids = 1, 2, 3
+ *
+ * The rv segments that are literal, a single *, or a trailing > follow the
+ * trie.  The glob patterns follow the literal segments up to the first
+ * wildcard, a trailing .* is a prefix match, other wildcards are checked
+ * with WildMatch at the node where the literal segments end.
+ *
+ * This is not a BloomDetail, the bloom route stays a filter: the details
+ * are fixed size and encoded to peers with the bloom, they have the prefix
+ * hash and a suffix hash or shard range, not the pattern, so a suffix
+ * detail of a.*.c also passes a.x.y.c.  The consumer of the route adds the
+ * NotifyPattern of each psub to a WildTrie and matches the subjects that
+ * pass the bloom with it, instead of evaluating pcre for each pattern. */
+struct WildTrie {
+  ArrayCount<WildNode *, 64> node;      /* node[ 0 ] is the root */
+  ArrayCount<uint32_t, 64>   free_node; /* unused node[] indexes */
+  WildChildHT                child;     /* hash( parent, seg ) -> node[] */
+  size_t                     pattern_count;
+
+  WildTrie() noexcept;
+  ~WildTrie() noexcept;
+  /* add pattern with id, false if pattern is empty or alloc failed */
+  bool add( const char *pat,  size_t patlen,  PatternFmt fmt,
+            uint32_t id ) noexcept;
+  bool add( const NotifyPattern &pat,  uint32_t id ) noexcept;
+  /* remove pattern added with id, false if not found */
+  bool remove( const char *pat,  size_t patlen,  PatternFmt fmt,
+               uint32_t id ) noexcept;
+  bool remove( const NotifyPattern &pat,  uint32_t id ) noexcept;
+  /* append ids of patterns matching sub to ids, return count appended */
+  size_t match( const char *sub,  size_t sublen,
+                WildMatchIds &ids ) const noexcept;
+  /* remove all patterns */
+  void release( void ) noexcept;
+
+  /* which list of a node the pattern is in */
+  enum WildKind { WILD_TERM = 0, WILD_TAIL = 1, WILD_OTHER = 2 };
+  /* walk pattern segments to the node, creating it when do_add */
+  uint32_t find_node( const char *pat,  size_t patlen,  PatternFmt fmt,
+                      bool do_add,  WildKind &kind ) noexcept;
+  uint32_t find_child( uint32_t n,  const char *seg,
+                       size_t seglen ) const noexcept;
+  uint32_t add_child( uint32_t n,  const char *seg,  size_t seglen,
+                      bool is_star ) noexcept;
+  void release_node( uint32_t n ) noexcept;
+  void match_node( uint32_t n,  const char *sub,  size_t sublen,
+                   size_t off,  bool at_end,
+                   WildMatchIds &ids ) const noexcept;
+};
+
+}
+}
+#endif
@@ -329,6 +329,108 @@ BloomCodec::encode( const uint32_t *pref,  size_t npref,
   this->finalize();
 }
 
+struct DeltaOpCmp {
+  static uint64_t key( BloomDeltaOp &op ) {
+    return ( (uint64_t) op.prefix_len << 32 ) | (uint64_t) op.hash;
+  }
+  static bool less( BloomDeltaOp &op1,  BloomDeltaOp &op2 ) {
+    return key( op1 ) < key( op2 );
+  }
+};
+
+static const uint32_t BLOOM_DELTA_VERSION = 0xb1c0de1aU,
+                      DELTA_DEL_FLAG      = 0x100,
+                      DELTA_CNT_FLAG      = 0x200,
+                      DELTA_HASH_MASK     = 0x3fffffffU;
+
+uint32_t
+BloomCodec::merge_ops( BloomDeltaOp *ops,  uint32_t nops ) noexcept
+{
+  DeltaOpCmp cmp;
+  uint32_t   i, j;
+  RadixSort<BloomDeltaOp, uint64_t, DeltaOpCmp> sort( cmp );
+  sort.init( ops, nops, 0, false );
+  sort.sort();
+  /* sum the adds and removes of the same hash, drop those that cancel */
+  for ( i = 0, j = 0; i < nops; i++ ) {
+    if ( j > 0 && ops[ j - 1 ].hash == ops[ i ].hash &&
+         ops[ j - 1 ].prefix_len == ops[ i ].prefix_len ) {
+      ops[ j - 1 ].cnt += ops[ i ].cnt;
+      if ( ops[ j - 1 ].cnt == 0 )
+        j--;
+    }
+    else {
+      ops[ j++ ] = ops[ i ];
+    }
+  }
+  return j;
+}
+
+void
+BloomCodec::encode_ops( uint64_t from_seqno,  BloomDeltaOp *ops,
+                        uint32_t nops ) noexcept
+{
+  uint32_t   values[ MAX_VALUES ], nvals = 0,
+             i, j, k, m, n, sz,
+           * code = this->make( 3 );
+  code[ 0 ] = BLOOM_DELTA_VERSION;
+  code[ 1 ] = (uint32_t) from_seqno;
+  code[ 2 ] = (uint32_t) ( from_seqno >> 32 );
+  this->code_sz = 3;
+  this->idx     = 0;
+
+  nops = merge_ops( ops, nops );
+  for ( i = 0; i < nops; i = j ) {
+    for ( j = i + 1; j < nops && ops[ j ].prefix_len == ops[ i ].prefix_len; )
+      j++;
+    /* the adds then the removes of prefix_len, grouped by hash bucket */
+    for ( uint32_t del = 0; del <= DELTA_DEL_FLAG; del += DELTA_DEL_FLAG ) {
+      for ( k = i; k < j; k = m ) {
+        uint32_t bucket = ops[ k ].hash >> 30,
+                 hdr    = ( (uint32_t) ops[ k ].prefix_len << 16 ) |
+                          del | bucket;
+        n = 0;
+        for ( m = k; m < j && ( ops[ m ].hash >> 30 ) == bucket; m++ ) {
+          if ( ( ops[ m ].cnt < 0 ) == ( del != 0 ) ) {
+            n++;
+            if ( ops[ m ].cnt > 1 || ops[ m ].cnt < -1 )
+              hdr |= DELTA_CNT_FLAG;
+          }
+        }
+        if ( n == 0 )
+          continue;
+        sz   = this->code_sz;
+        code = this->make( sz + 2 );
+        code[ sz ]     = hdr;
+        code[ sz + 1 ] = n;
+        this->code_sz += 2;
+        this->last     = 0;
+        for ( uint32_t x = k; x < m; x++ ) {
+          if ( ( ops[ x ].cnt < 0 ) == ( del != 0 ) ) {
+            values[ nvals++ ] = ops[ x ].hash & DELTA_HASH_MASK;
+            if ( nvals == MAX_VALUES )
+              this->encode_delta( values, nvals );
+          }
+        }
+        if ( nvals > 0 )
+          this->encode_delta( values, nvals );
+        if ( ( hdr & DELTA_CNT_FLAG ) == 0 )
+          continue;
+        for ( uint32_t x = k; x < m; x++ ) {
+          if ( ( ops[ x ].cnt < 0 ) == ( del != 0 ) ) {
+            int32_t cnt = ( ops[ x ].cnt < 0 ? -ops[ x ].cnt : ops[ x ].cnt );
+            values[ nvals++ ] = (uint32_t) cnt - 1;
+            if ( nvals == MAX_VALUES )
+              this->encode_int( values, nvals );
+          }
+        }
+        if ( nvals > 0 )
+          this->encode_int( values, nvals );
+      }
+    }
+  }
+}
+
 uint32_t
 BloomCodec::decode_pref( const uint32_t *code,  size_t len,  uint32_t *pref,
                          size_t npref ) noexcept
@@ -600,3 +702,77 @@ BloomCodec::decode_count( BloomBits &bits,  uint8_t n,  const uint32_t *buf,
   return true;
 }
 
+
+bool
+BloomCodec::decode_ops( uint64_t &from_seqno,  BloomDeltaOps &ops,
+                        const void *code_ptr,  size_t len ) noexcept
+{
+  ArraySpace<uint32_t, 1> tmp;
+  const uint32_t * code;
+  if ( ( (uintptr_t) code_ptr & 3 ) == 0 )
+    code = (const uint32_t *) code_ptr;
+  else {
+    uint32_t * p = tmp.make( len );
+    ::memcpy( p, code_ptr, len * sizeof( uint32_t ) );
+    code = p;
+  }
+  if ( len < 3 || code[ 0 ] != BLOOM_DELTA_VERSION )
+    return false;
+  from_seqno = ( (uint64_t) code[ 2 ] << 32 ) | (uint64_t) code[ 1 ];
+
+  for ( uint32_t off = 3; off < len; ) {
+    if ( off + 2 > len )
+      return false;
+    uint32_t hdr    = code[ off ],
+             n      = code[ off + 1 ],
+             start  = (uint32_t) ops.count,
+             bucket = ( hdr & 3 ) << 30,
+             last   = 0,
+             cnt    = 0,
+             nvals;
+    uint16_t prefix_len = (uint16_t) ( hdr >> 16 );
+    off += 2;
+    if ( n > ( len - off ) * MAX_DELTA_CODE_LENGTH ) {
+      fprintf( stderr, "invalid delta count %u\n", n );
+      return false;
+    }
+    uint32_t * values = this->make( n );
+    /* hashes, delta coded */
+    while ( cnt < n ) {
+      uint32_t sz = ( off < len ? code[ off ] : 0 );
+      if ( sz == 0 || off + sz + 1 > len ||
+           cnt + DeltaCoder::decode_stream_length( sz, &code[ off + 1 ] ) > n ) {
+        fprintf( stderr, "invalid delta size %u\n", sz );
+        return false;
+      }
+      nvals = DeltaCoder::decode_stream( sz, &code[ off + 1 ], last,
+                                         &values[ cnt ] );
+      cnt  += nvals;
+      last  = values[ cnt - 1 ];
+      off  += sz + 1;
+    }
+    for ( uint32_t i = 0; i < n; i++ ) {
+      BloomDeltaOp & op = ops.push();
+      op.hash       = values[ i ] | bucket;
+      op.prefix_len = prefix_len;
+      op.cnt        = ( ( hdr & DELTA_DEL_FLAG ) != 0 ? -1 : 1 );
+    }
+    if ( ( hdr & DELTA_CNT_FLAG ) == 0 )
+      continue;
+    /* counts greater than one, int coded */
+    for ( cnt = 0; cnt < n; ) {
+      uint32_t sz = ( off < len ? code[ off ] : 0 );
+      if ( sz == 0 || off + sz + 1 > len ||
+           cnt + IntCoder::decode_stream_length( sz, &code[ off + 1 ] ) > n ) {
+        fprintf( stderr, "invalid count size %u\n", sz );
+        return false;
+      }
+      nvals = IntCoder::decode_stream( sz, &code[ off + 1 ], values );
+      for ( uint32_t i = 0; i < nvals; i++ )
+        ops.ptr[ start + cnt + i ].cnt *= (int32_t) ( values[ i ] + 1 );
+      cnt += nvals;
+      off += sz + 1;
+    }
+  }
+  return true;
+}
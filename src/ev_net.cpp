@@ -20,6 +20,7 @@
 #endif
 #include <raikv/ev_net.h>
 #include <raikv/ev_key.h>
+#include <raikv/ev_publish.h>
 #include <raikv/kv_pubsub.h>
 #include <raikv/timer_queue.h>
 
@@ -27,19 +28,29 @@ using namespace rai;
 using namespace kv;
 
 EvPoll::EvPoll() noexcept
-  : sock( 0 ), ev( 0 ), prefetch_queue( 0 ), prio_tick( 0 ),
+  : sock( 0 ), ev( 0 ), flush_timer( *this, false ),
+    pause_timer( *this, true ), prefetch_queue( 0 ),
+    prio_tick( 0 ),
     wr_timeout_ns( DEFAULT_NS_WRTIMEOUT ),
     conn_timeout_ns( DEFAULT_NS_CONNECT_TIMEOUT ),
     so_keepalive_ns( DEFAULT_NS_KEEPALIVE ),
     blocked_read_rate( DEFAULT_BLOCKED_READ_RATE ),
     next_id( 0 ), now_ns( 0 ), init_ns( 0 ), mono_ns( 0 ),
-    coarse_ns( 0 ), coarse_mono( 0 ),
+    coarse_ns( 0 ), coarse_mono( 0 ), wr_coalesce_ns( 0 ), wr_hold_cnt( 0 ),
+    wr_flush_cnt( 0 ), wr_send_cnt( 0 ), send_mem( 0 ), send_mem_peak( 0 ),
+    send_mem_max( 0 ),
+    shed_drop_cnt( 0 ), conflate_cnt( 0 ), shed_close_cnt( 0 ),
+    shed_pause_cnt( 0 ), pause_start_ns( 0 ), pause_recv( 0 ),
+    shed_slow_ns( 0 ),
+    subj_opt_mask( 0 ), subj_opt_ht( 0 ),
+    shed_policy( SHED_DROP_LOSSY | SHED_CLOSE_SLOW | SHED_PAUSE_READ ),
     fdcnt( 0 ), wr_count( 0 ), maxfd( 0 ), nfds( 0 ),
     send_highwater( StreamBuf::SND_BUFSIZE - 256 ),
     recv_highwater( DEFAULT_RCV_BUFSIZE - 256 ),
+    wr_coalesce_size( DEFAULT_COALESCE_SIZE ),
     efd( -1 ), null_fd( -1 ), quit( 0 ),
     prefetch_pending( 0 ), sub_route( *this ), sock_mem( 0 ),
-    sock_mem_left( 0 ), free_buf( 0 )
+    sock_mem_left( 0 ), zref_free( 0 ), free_buf( 0 )
 {
   ::memset( this->sock_type_str, 0, sizeof( this->sock_type_str ) );
   ::memset( this->state_ns, 0, sizeof( this->state_ns ) );
@@ -49,6 +60,24 @@ EvPoll::EvPoll() noexcept
 #endif
 }
 
+void
+EvPoll::poll_stats( PollStats &ps ) const noexcept
+{
+  ps.send_cnt      = this->wr_send_cnt;
+  ps.wr_hold       = this->wr_hold_cnt;
+  ps.wr_flush      = this->wr_flush_cnt;
+  ps.conflated     = this->conflate_cnt;
+  ps.send_mem      = this->send_mem;
+  ps.send_mem_peak = this->send_mem_peak;
+  ps.cache_hit     = this->sub_route.cache.hit_cnt;
+  ps.cache_miss    = this->sub_route.cache.miss_cnt;
+  ps.cache_inval   = this->sub_route.cache.inval_cnt;
+  ps.cache_evict   = this->sub_route.cache.evict_cnt;
+  ps.shed_drop     = this->shed_drop_cnt;
+  ps.shed_close    = this->shed_close_cnt;
+  ps.shed_pause    = this->shed_pause_cnt;
+}
+
 bool rai::kv::ev_would_block( int err ) noexcept {
   return ( err == EINTR || err == EAGAIN || err == EWOULDBLOCK ||
            err == EINPROGRESS );
@@ -60,7 +89,7 @@ RoutePDB::RoutePDB( EvPoll &p ) noexcept
 RoutePublish::RoutePublish( EvPoll &p,  const char *svc,  uint32_t svc_num,
                             uint32_t rte_id ) noexcept
             : RouteDB( p.g_bloom_db ), poll( p ), map( 0 ), pubsub( 0 ),
-              keyspace( 0 ), service_name( svc ), svc_id( svc_num ),
+              bus( 0 ), keyspace( 0 ), service_name( svc ), svc_id( svc_num ),
               route_id( rte_id ), ctx_id( (uint32_t) -1 ),
               dbx_id( (uint32_t) -1 ), key_flags( 0 ) {}
 
@@ -249,6 +278,7 @@ EvPoll::wait( int ms ) noexcept
       this->remove_poll( s ); /* a EPOLLERR, can't write, close it */
       this->remove_event_queue( s );
       this->remove_write_queue( s );
+      this->remove_flush_queue( s );
       do_event = EV_CLOSE;
     }
     else {
@@ -450,6 +480,9 @@ EvPoll::remove_sock( EvSocket *s ) noexcept
   /* remove from queues, if in them */
   this->remove_event_queue( s );
   this->remove_write_queue( s );
+  this->remove_flush_queue( s );
+  if ( s->pause_ns != 0 )
+    this->remove_pause( s );
   s->popall();
 
   if ( s->in_list( IN_ACTIVE_LIST ) ) {
@@ -459,6 +492,8 @@ EvPoll::remove_sock( EvSocket *s ) noexcept
   }
   /* release memory buffers */
   s->release();
+  this->release_conflate( s->fd );
+  this->sub_route.close_route( (uint32_t) s->fd );
   s->fd = -1;
 }
 
@@ -470,10 +505,192 @@ EvPoll::idle_close( EvSocket *s,  uint64_t ns ) noexcept
   this->remove_poll( s );
   this->remove_event_queue( s );
   this->remove_write_queue( s );
+  this->remove_flush_queue( s );
   s->popall();
   s->idle_push( EV_CLOSE );
 }
 
+/* subjects which are lossy or conflated when socks are backed up */
+void
+EvPoll::add_subj_opt( const char *sub,  size_t len,  bool is_prefix,
+                      uint32_t opt ) noexcept
+{
+  uint16_t pre = SUB_RTE;
+  uint32_t h, val;
+  size_t   pos;
+  if ( is_prefix ) {
+    if ( len >= MAX_PRE )
+      len = MAX_PRE - 1;
+    pre = (uint16_t) len;
+    h   = kv_crc_c( sub, len, this->sub_route.prefix_seed( len ) );
+    this->subj_opt_mask |= (uint64_t) 1 << len;
+  }
+  else {
+    h = kv_crc_c( sub, len, 0 );
+  }
+  if ( this->subj_opt_ht == NULL )
+    this->subj_opt_ht = UIntHashTab::resize( NULL );
+  if ( this->subj_opt_ht->find( h, pos, val ) && ( val & 0xff ) == pre )
+    opt |= val >> 8;
+  this->subj_opt_ht->set( h, pos, ( opt << 8 ) | pre );
+  UIntHashTab::check_resize( this->subj_opt_ht );
+}
+
+/* the EvSubjOpt bits of the subject and the prefixes that match it */
+uint32_t
+EvPoll::subj_opt( const EvPublish &pub ) noexcept
+{
+  size_t   pos;
+  uint32_t val, opt = 0;
+  if ( this->subj_opt_ht == NULL )
+    return 0;
+  if ( this->subj_opt_ht->find( pub.subj_hash, pos, val ) &&
+       ( val & 0xff ) == SUB_RTE )
+    opt |= val >> 8;
+  for ( uint64_t m = this->subj_opt_mask; m != 0; m &= m - 1 ) {
+    uint16_t len = (uint16_t) ( kv_ffsl( m ) - 1 );
+    if ( len > pub.subject_len )
+      break;
+    uint32_t h = kv_crc_c( pub.subject, len,
+                           this->sub_route.prefix_seed( len ) );
+    if ( this->subj_opt_ht->find( h, pos, val ) && ( val & 0xff ) == len )
+      opt |= val >> 8;
+  }
+  return opt;
+}
+
+/* while a sock is write blocked, a conflated subject replaces the msg held
+ * for it;  over send_mem_max, the queued bytes of a sock are not framed, so
+ * the msgs already queued can't be dropped, the new lossy msgs to a sock
+ * over send_highwater are */
+bool
+EvPoll::hold_msg( EvSocket &s,  EvPublish &pub ) noexcept
+{
+  bool blocked = ( s.test2( EV_WRITE_POLL, EV_WRITE_HI ) != 0 ||
+                   this->has_conflate( s.fd ) ),
+       over    = ( this->over_send_mem() &&
+                   ( this->shed_policy & SHED_DROP_LOSSY ) != 0 &&
+                   s.send_mem >= this->send_highwater );
+  if ( ! blocked && ! over )
+    return false;
+  uint32_t opt = this->subj_opt( pub );
+  if ( blocked && ( opt & SUBJ_CONFLATE ) != 0 ) {
+    if ( (uint32_t) s.fd >= this->conflate_q.size )
+      this->conflate_q.make( s.fd + 1, true );
+    ConflateQueue *& q = this->conflate_q.ptr[ s.fd ];
+    if ( q == NULL ) {
+      void * p = ::malloc( sizeof( ConflateQueue ) );
+      if ( p == NULL ) /* not held, sent as usual */
+        return false;
+      q = new ( p ) ConflateQueue( *this );
+    }
+    int held = q->hold( pub );
+    if ( held == ConflateQueue::HOLD_NO_MEM )
+      return false;
+    if ( ! q->bp_in_list() ) {
+      q->bp_fd = s.fd;
+      q->bp_id = s.start_ns;
+      this->bp_wait.push( s.fd, *q );
+    }
+    if ( held == ConflateQueue::HOLD_REPLACED ) {
+      s.msgs_conflated++;
+      this->conflate_cnt++;
+    }
+    return true;
+  }
+  if ( over && ( opt & SUBJ_LOSSY ) != 0 ) {
+    this->shed_drop_cnt++;
+    return true;
+  }
+  return false;
+}
+
+/* while over send_mem_max, reads are limited to blocked_read_rate, the read
+ * state of a sock over the rate is popped and pushed again by resume_read()
+ * when the rate is below, its other states are not paused */
+bool
+EvPoll::shed_read( EvSocket *s ) noexcept
+{
+  if ( ( this->shed_policy & SHED_PAUSE_READ ) == 0 || this->quit )
+    return false;
+  uint64_t ns = this->current_mono_ns();
+  if ( ! this->over_send_mem() ) {
+    this->pause_start_ns = 0;
+    return false;
+  }
+  if ( this->pause_start_ns == 0 ) {
+    this->pause_start_ns = ns;
+    this->pause_recv     = 0;
+    return false;
+  }
+  uint64_t allow = ( ( ns - this->pause_start_ns ) / 1000 ) *
+                   this->blocked_read_rate / 1000000;
+  if ( this->pause_recv <= allow )
+    return false;
+  uint64_t wait_ns = ( this->pause_recv - allow ) * ONE_NS /
+                     this->blocked_read_rate;
+  s->pop3( EV_READ, EV_READ_LO, EV_READ_HI );
+  if ( s->pause_ns == 0 ) {
+    this->pause_list.push( s );
+    this->shed_pause_cnt++;
+  }
+  s->pause_ns = ns + wait_ns;
+  if ( ! this->pause_timer.arm( s->pause_ns ) ) {
+    this->remove_pause( s ); /* no timer, can't pause */
+    s->push( EV_READ );
+    return false;
+  }
+  return true;
+}
+
+/* push the read state of the paused socks */
+void
+EvPoll::resume_read( void ) noexcept
+{
+  while ( this->pause_list.count > 0 ) {
+    EvSocket * s = this->pause_list.ptr[ --this->pause_list.count ];
+    s->pause_ns = 0;
+    s->idle_push( EV_READ );
+  }
+}
+
+void
+EvPoll::remove_pause( EvSocket *s ) noexcept
+{
+  for ( size_t i = 0; i < this->pause_list.count; i++ ) {
+    if ( this->pause_list.ptr[ i ] == s ) {
+      this->pause_list.ptr[ i ] =
+        this->pause_list.ptr[ --this->pause_list.count ];
+      break;
+    }
+  }
+  s->pause_ns = 0;
+}
+
+/* close the sock holding the most send mem, it is the slowest consumer,
+ * the scan runs at most once per SHED_SLOW_IVAL_NS, the buffers of a closed
+ * sock are freed before the next */
+void
+EvPoll::shed_slow( void ) noexcept
+{
+  EvSocket * slow = NULL;
+  uint64_t   max  = this->send_highwater;
+  if ( this->mono_ns - this->shed_slow_ns < SHED_SLOW_IVAL_NS )
+    return;
+  this->shed_slow_ns = this->mono_ns;
+  for ( EvSocket *s = this->active_list.hd; s != NULL;
+        s = (EvSocket *) s->next ) {
+    if ( s->send_mem > max && ! s->test( EV_CLOSE ) ) {
+      slow = s;
+      max  = s->send_mem;
+    }
+  }
+  if ( slow != NULL ) {
+    this->shed_close_cnt++;
+    slow->close_error( EV_ERR_SEND_MEM, 0 );
+  }
+}
+
 void *
 EvPoll::alloc_sock( size_t sz ) noexcept
 {
@@ -816,8 +1033,23 @@ EvPoll::dispatch( void ) noexcept
 
   if ( this->quit )
     this->process_quit();
+  if ( this->zref_pub.count != 0 ) /* pubs from outside of dispatch */
+    this->zero_copy_release_pub();
+  if ( ! this->ev_flush.is_empty() ) /* if busy, check held writes each call */
+    this->flush_held();
+  if ( this->over_send_mem() && ! this->quit ) {
+    if ( ( this->shed_policy & SHED_CLOSE_SLOW ) != 0 )
+      this->shed_slow();
+  }
+  else if ( this->pause_start_ns != 0 ) {
+    this->pause_start_ns = 0;
+    if ( this->pause_list.count != 0 ) /* under the cap, read again */
+      this->resume_read();
+  }
   for (;;) {
   next_tick:;
+    if ( this->zref_pub.count != 0 ) /* the fan-out of the event is done */
+      this->zero_copy_release_pub();
     if ( state != EV_NO_STATE ) {
       next_ns = this->current_mono_ns();
       this->state_ns[ state ] += next_ns - mark_ns;
@@ -857,6 +1089,15 @@ EvPoll::dispatch( void ) noexcept
           goto next_tick;
       }
 
+      /* held writes that are past wr_coalesce_ns are dispatched */
+      if ( ! this->ev_flush.is_empty() ) {
+        if ( this->flush_held() )
+          goto next_tick;
+        /* poll() waits until the oldest hold expires */
+        EvSocket * s = this->ev_flush.heap[ 0 ];
+        if ( ! this->flush_timer.arm( s->wr_hold_ns + this->wr_coalesce_ns ) )
+          ret |= DISPATCH_BUSY;
+      }
       if ( start != this->prio_tick )
         ret |= DISPATCH_BUSY;
       return ret;
@@ -879,6 +1120,14 @@ EvPoll::dispatch( void ) noexcept
       case EV_READ:
       case EV_READ_LO:
       case EV_READ_HI:
+        if ( this->pause_start_ns != 0 || this->over_send_mem() ) {
+          if ( this->shed_read( s ) )
+            break; /* read is paused, other states are dispatched */
+          uint64_t recv = s->bytes_recv;
+          s->read();
+          this->pause_recv += s->bytes_recv - recv;
+          break;
+        }
         s->read();
         break;
       case EV_PROCESS:
@@ -889,8 +1138,12 @@ EvPoll::dispatch( void ) noexcept
         this->prefetch_pending++;
         goto next_tick; /* skip putting s back into event queue */
       case EV_WRITE:
+        if ( this->wr_coalesce_ns != 0 && this->hold_write( s ) )
+          goto next_tick; /* in flush queue, until more data or expires */
+        /* FALLTHRU */
       case EV_WRITE_HI:
       case EV_WRITE_POLL:
+        s->wr_hold_ns = 0;
         s->write();
         break;
       case EV_SHUTDOWN:
@@ -927,12 +1180,93 @@ EvPoll::dispatch( void ) noexcept
   }
 }
 
+/* a low priority write is held when it is small, more msgs may be appended
+ * by the next dispatch cycles before the wr_coalesce_ns budget expires */
+bool
+EvPoll::hold_write( EvSocket *s ) noexcept
+{
+  /* other states are not delayed, except a low prio read */
+  if ( s->sock_base != EV_CONNECTION_BASE || this->quit ||
+       ( s->sock_state & ~( ( 1U << EV_WRITE ) | ( 1U << EV_READ_LO ) ) ) != 0 )
+    return false;
+  EvConnection * c = (EvConnection *) s;
+  if ( c->StreamBuf::pending() >= this->wr_coalesce_size )
+    return false;
+  if ( s->wr_hold_ns == 0 )
+    s->wr_hold_ns = this->mono_ns;
+  else if ( this->mono_ns - s->wr_hold_ns >= this->wr_coalesce_ns )
+    return false;
+  this->push_flush_queue( s );
+  this->wr_hold_cnt++;
+  return true;
+}
+
+/* move the held writes which have expired back to the event queue */
+bool
+EvPoll::flush_held( void ) noexcept
+{
+  uint64_t ns    = this->current_mono_ns();
+  bool     found = false;
+  while ( ! this->ev_flush.is_empty() ) {
+    EvSocket * s = this->ev_flush.heap[ 0 ];
+    if ( ns - s->wr_hold_ns < this->wr_coalesce_ns )
+      break;
+    this->remove_flush_queue( s );
+    s->prio_cnt = this->prio_tick;
+    this->push_event_queue( s );
+    this->wr_flush_cnt++;
+    found = true;
+  }
+  return found;
+}
+
+/* arm a timer at ns, unless one fires before it */
+bool
+EvFlushTimer::arm( uint64_t ns ) noexcept
+{
+  uint64_t now, delta;
+  bool     b;
+  if ( this->expires_ns != 0 && this->expires_ns <= ns )
+    return true;
+  if ( this->poll.timer.queue == NULL ||
+       ns <= (now = this->poll.current_mono_ns()) )
+    return false;
+  delta = ns - now;
+  this->timer_id++;
+  if ( delta <= MAX_TIMER_RANGE )
+    b = this->poll.timer.add_timer_nanos( *this, (uint32_t) delta,
+                                          this->timer_id, 0 );
+  else
+    b = this->poll.timer.add_timer_micros( *this,
+                     (uint32_t) min_int<uint64_t>( delta / 1000 + 1,
+                                                   MAX_TIMER_RANGE ),
+                                           this->timer_id, 0 );
+  if ( ! b )
+    return false;
+  this->expires_ns = ns;
+  return true;
+}
+
+bool
+EvFlushTimer::timer_cb( uint64_t tid,  uint64_t ) noexcept
+{
+  if ( tid == this->timer_id )
+    this->expires_ns = 0;
+  if ( this->is_pause )
+    this->poll.resume_read();
+  else
+    this->poll.flush_held();
+  return false;
+}
+
 /* shutdown and close all open socks */
 void
 EvPoll::process_quit( void ) noexcept
 {
   if ( this->quit ) {
     EvSocket *s = this->active_list.hd;
+    if ( this->pause_list.count != 0 ) /* read until closed */
+      this->resume_read();
     if ( s == NULL ) { /* no more sockets open */
       this->quit = 5;
       return;
@@ -941,6 +1275,7 @@ EvPoll::process_quit( void ) noexcept
     do {
       if ( this->quit >= 5 ) {
         this->remove_event_queue( s );
+        this->remove_flush_queue( s );
         if ( s->sock_state != 0 )
           s->popall();
         s->push( EV_CLOSE );
@@ -1195,11 +1530,11 @@ EvConnection::client_list( char *buf,  size_t buflen ) noexcept
   int i = this->EvSocket::client_list( buf, buflen );
   if ( i >= 0 && (size_t) i < buflen - 1 ) {
     i += ::snprintf( &buf[ i ], buflen - (size_t) i,
-      "rbuf=%u rsz=%u imsg=%" PRIu64 " br=%" PRIu64 " wbuf=%" PRIu64 " wsz=%" PRIu64 " omsg=%" PRIu64 " bs=%" PRIu64 " ",
+      "rbuf=%u rsz=%u imsg=%" PRIu64 " br=%" PRIu64 " wbuf=%" PRIu64 " wsz=%" PRIu64 " omsg=%" PRIu64 " bs=%" PRIu64 " wcnt=%" PRIu64 " ",
       this->len - this->off, this->recv_size, this->msgs_recv, this->bytes_recv,
       this->wr_pending,
       this->tmp.fast_len + this->tmp.block_cnt * this->tmp.alloc_size,
-      this->msgs_sent, this->bytes_sent );
+      this->msgs_sent, this->bytes_sent, this->send_count );
   }
   return min_int( i, (int) buflen - 1 );
 }
@@ -1207,10 +1542,11 @@ EvConnection::client_list( char *buf,  size_t buflen ) noexcept
 void
 EvSocket::client_stats( PeerStats &ps ) noexcept
 {
-  ps.bytes_recv += this->bytes_recv;
-  ps.bytes_sent += this->bytes_sent;
-  ps.msgs_recv  += this->msgs_recv;
-  ps.msgs_sent  += this->msgs_sent;
+  ps.bytes_recv     += this->bytes_recv;
+  ps.bytes_sent     += this->bytes_sent;
+  ps.msgs_recv      += this->msgs_recv;
+  ps.msgs_sent      += this->msgs_sent;
+  ps.msgs_conflated += this->msgs_conflated;
   if ( this->active_ns > ps.active_ns )
     ps.active_ns = this->active_ns;
   if ( this->read_ns > ps.read_ns )
@@ -1220,11 +1556,12 @@ EvSocket::client_stats( PeerStats &ps ) noexcept
 void
 EvSocket::retired_stats( PeerStats &ps ) noexcept
 {
-  ps.bytes_recv += this->poll.peer_stats.bytes_recv;
-  ps.bytes_sent += this->poll.peer_stats.bytes_sent;
-  ps.msgs_recv  += this->poll.peer_stats.msgs_recv;
-  ps.msgs_sent  += this->poll.peer_stats.msgs_sent;
-  ps.accept_cnt += this->poll.peer_stats.accept_cnt;
+  ps.bytes_recv     += this->poll.peer_stats.bytes_recv;
+  ps.bytes_sent     += this->poll.peer_stats.bytes_sent;
+  ps.msgs_recv      += this->poll.peer_stats.msgs_recv;
+  ps.msgs_sent      += this->poll.peer_stats.msgs_sent;
+  ps.accept_cnt     += this->poll.peer_stats.accept_cnt;
+  ps.msgs_conflated += this->poll.peer_stats.msgs_conflated;
 }
 
 bool
@@ -1423,7 +1760,7 @@ EvConnection::resize_recv_buf( size_t new_size ) noexcept
     new_size    = sizeof( this->recv_buf );
   }
   else {
-    ex_recv_buf = EvPoll::ev_poll_alloc( this, new_size );
+    ex_recv_buf = this->poll.poll_alloc( *this, new_size );
     if ( ex_recv_buf == NULL ) {
       this->set_sock_err( EV_ERR_ALLOC, errno );
       return false;
@@ -1465,10 +1802,10 @@ EvPoll::zero_copy_ref( uint32_t src_route,  const void *msg,
 
   bool is_new = false;
   if ( conn.zref_index == 0 ) {
-    conn.zref_index = this->zref.count + 1;
+    conn.zref_index = this->zero_copy_alloc();
     is_new = true;
   }
-  ZeroRef & zr = this->zref[ conn.zref_index - 1 ];
+  ZeroRef & zr = this->zref.ptr[ conn.zref_index - 1 ];
   if ( is_new ) {
     zr.buf       = conn.recv;
     zr.ref_count = 1;
@@ -1507,23 +1844,82 @@ EvPoll::zero_copy_deref( uint32_t zref_index,  bool owner ) noexcept
   }
 release_buf:;
   this->poll_free( zr.buf, zr.buf_size );
-  if ( zref_index == this->zref.count ) {
-    this->zref.count--;
-    while ( this->zref.count > 0 &&
-            this->zref.ptr[ this->zref.count - 1 ].ref_count == 0 )
-      this->zref.count--;
+  zr.buf          = NULL;
+  zr.buf_size     = 0;
+  zr.ref_count    = 0;
+  zr.owner        = this->zref_free;
+  this->zref_free = zref_index;
+}
+
+uint32_t
+EvPoll::zero_copy_alloc( void ) noexcept
+{
+  uint32_t zref_index = this->zref_free;
+  if ( zref_index != 0 ) {
+    this->zref_free = this->zref.ptr[ zref_index - 1 ].owner;
+    return zref_index;
+  }
+  this->zref.push();
+  return (uint32_t) this->zref.count;
+}
+
+/* the msg is referenced in the recv buffer of the publisher when possible,
+ * otherwise it is copied once to a pool buffer, held by the poll until the
+ * event that published it is done, each writer derefs after it is sent */
+uint32_t
+EvPoll::zero_copy_pub( EvPublish &pub ) noexcept
+{
+  uint32_t zref_index = pub.msg_ref;
+  if ( zref_index != 0 ) {
+    ZeroRef & zr = this->zref.ptr[ zref_index - 1 ];
+    /* a copy of pub may have a different msg, or a ref already freed */
+    if ( zr.ref_count != 0 && (const char *) pub.msg >= zr.buf &&
+         &((const char *) pub.msg)[ pub.msg_len ] <= &zr.buf[ zr.buf_size ] ) {
+      zr.ref_count++;
+      return zref_index;
+    }
+  }
+  zref_index = this->zero_copy_ref( (uint32_t) pub.src_route.fd, pub.msg,
+                                    pub.msg_len );
+  if ( zref_index == 0 ) {
+    void * buf = NULL;
+    if ( pub.msg_len <= FREE_BUF_MAX_SIZE ) {
+      if ( this->free_buf == NULL )
+        this->free_buf = new ( ::malloc( sizeof( Balloc16k_2m ) ) )
+                         Balloc16k_2m();
+      buf = this->free_buf->try_alloc( pub.msg_len );
+    }
+    if ( buf == NULL && (buf = ::malloc( pub.msg_len )) == NULL )
+      return 0;
+    ::memcpy( buf, pub.msg, pub.msg_len );
+    zref_index = this->zero_copy_alloc();
+    ZeroRef & zr = this->zref.ptr[ zref_index - 1 ];
+    zr.buf       = (char *) buf;
+    zr.ref_count = 2; /* poll and caller */
+    zr.owner     = ZREF_POOL;
+    zr.buf_size  = pub.msg_len;
+    this->zref_pub.push( zref_index );
+    pub.msg = buf;
   }
+  pub.msg_ref = zref_index;
+  return zref_index;
+}
+
+void
+EvPoll::zero_copy_release_pub( void ) noexcept
+{
+  for ( size_t i = 0; i < this->zref_pub.count; i++ )
+    this->zero_copy_deref( this->zref_pub.ptr[ i ], true );
+  this->zref_pub.count = 0;
 }
 
 void *
-EvPoll::ev_poll_alloc( void *cl,  size_t size ) noexcept
+EvPoll::poll_alloc( EvSocket &sock,  size_t size ) noexcept
 {
-  EvSocket & sock = *(EvSocket *) cl;
-  EvPoll   & poll = sock.poll;
   if ( size <= FREE_BUF_MAX_SIZE ) {
-    if ( poll.free_buf == NULL )
-      poll.free_buf = new ( ::malloc( sizeof( Balloc16k_2m ) ) ) Balloc16k_2m();
-    void * ptr = poll.free_buf->try_alloc( size );
+    if ( this->free_buf == NULL )
+      this->free_buf = new ( ::malloc( sizeof( Balloc16k_2m ) ) ) Balloc16k_2m();
+    void * ptr = this->free_buf->try_alloc( size );
     if ( ptr != NULL )
       return ptr;
   }
@@ -1532,6 +1928,22 @@ EvPoll::ev_poll_alloc( void *cl,  size_t size ) noexcept
   return ::malloc( size );
 }
 
+/* the send buffers of StreamBuf, accounted in send_mem */
+void *
+EvPoll::ev_poll_alloc( void *cl,  size_t size ) noexcept
+{
+  EvSocket & sock = *(EvSocket *) cl;
+  EvPoll   & poll = sock.poll;
+  void     * ptr  = poll.poll_alloc( sock, size );
+  if ( ptr != NULL ) {
+    sock.send_mem += size;
+    poll.send_mem += size;
+    if ( poll.send_mem > poll.send_mem_peak )
+      poll.send_mem_peak = poll.send_mem;
+  }
+  return ptr;
+}
+
 void
 EvPoll::poll_free( void *ptr,  size_t size ) noexcept
 {
@@ -1546,6 +1958,8 @@ void
 EvPoll::ev_poll_free( void *cl,  void *ptr,  size_t size ) noexcept
 {
   EvSocket & sock = *(EvSocket *) cl;
+  sock.send_mem      -= size;
+  sock.poll.send_mem -= size;
   sock.poll.poll_free( ptr, size );
 }
 
@@ -1607,6 +2021,7 @@ write_notify:;
     strm.wr_free    += nbytes;
     this->bytes_sent += nbytes;
     this->send_count++;
+    this->poll.wr_send_cnt++;
     nb += nbytes;
     this->active_ns = this->poll.now_ns;
     this->sock_wroff = 0;
@@ -1925,6 +2340,7 @@ EvSocket::err_string( EvSockErr err ) noexcept
     case EV_ERR_ADD_MCAST:     return "EV_ERR_ADD_MCAST, join multicast network";
     case EV_ERR_CONN_SELF:     return "EV_ERR_CONN_SELF, connected to self";
     case EV_ERR_READ_OVERFLOW: return "EV_ERR_READ_OVERFLOW, overflow read buf";
+    case EV_ERR_SEND_MEM:      return "EV_ERR_SEND_MEM, closed over send mem";
     default:                   return NULL;
   }
 }
@@ -2003,6 +2419,16 @@ EvSocket::idle_push( EvState s ) noexcept
     return;
   /* if no state, not currently in the queue */
   if ( ! this->in_poll( IN_EPOLL_WRITE ) ) {
+    if ( this->in_queue( IN_FLUSH_QUEUE ) ) {
+      /* already holding a write, append to it until it is large enough */
+      if ( s == EV_WRITE && ( this->sock_base != EV_CONNECTION_BASE ||
+                              ((EvConnection *) this)->StreamBuf::pending() <
+                                this->poll.wr_coalesce_size ) ) {
+        this->push( s );
+        return;
+      }
+      this->poll.remove_flush_queue( this );
+    }
     if ( ! this->in_queue( IN_EVENT_QUEUE ) ) {
     do_push:;
       this->push( s );
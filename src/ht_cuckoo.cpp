@@ -15,6 +15,7 @@ static const uint32_t MAX_CUCKOO_RETRY = 5;
 static const uint64_t cuckoo_position_8k = 8 * 1024;
 static const uint64_t cuckoo_position_mask = cuckoo_position_8k - 1;
 static const uint64_t cuckoo_hash_seed     = _U64( 0x9e3779b9U, 0x7f4a7c13U );
+static const uint32_t cuckoo_bfs_max_nodes = 64 * 1024; /* 2MB of nodes */
 
 /* xoroshiro128plus */
 static void
@@ -78,6 +79,90 @@ CuckooAltHash::calc_hash( KeyCtx &kctx,  const uint64_t key,
   }
 }
 
+bool
+CuckooVisitBuf::grow( uint32_t max_size ) noexcept
+{
+  if ( this->size >= max_size )
+    return false;
+  uint32_t      sz = ( this->size * 2 < max_size ? this->size * 2 : max_size );
+  CuckooVisit * p  = (CuckooVisit *) ::malloc( sz * sizeof( CuckooVisit ) );
+  if ( p == NULL )
+    return false;
+  ::memcpy( (void *) p, this->ptr, this->size * sizeof( CuckooVisit ) );
+  if ( this->ptr != this->stk )
+    ::free( this->ptr );
+  this->ptr  = p;
+  this->size = sz;
+  return true;
+}
+
+bool
+CuckooVisitSet::test_set( uint64_t pos ) noexcept
+{
+  const uint64_t v = pos + 1;
+  for (;;) {
+    uint32_t i = (uint32_t) ( ( v * cuckoo_hash_seed ) >> 32 ) & this->mask;
+    for ( ; this->tab[ i ] != 0; i = ( i + 1 ) & this->mask )
+      if ( this->tab[ i ] == v )
+        return true;
+    /* keep the table less than half full */
+    if ( ( this->cnt + 1 ) * 2 <= this->mask + 1 ) {
+      this->tab[ i ] = v;
+      this->cnt++;
+      return false;
+    }
+    if ( ! this->grow() )
+      return true; /* no mem, don't search it */
+  }
+}
+
+bool
+CuckooVisitSet::grow( void ) noexcept
+{
+  uint32_t   sz  = ( this->mask + 1 ) * 2;
+  uint64_t * tab = (uint64_t *) ::calloc( sz, sizeof( uint64_t ) );
+  if ( tab == NULL )
+    return false;
+  for ( uint32_t j = 0; j <= this->mask; j++ ) {
+    uint64_t v = this->tab[ j ];
+    if ( v != 0 ) {
+      uint32_t i = (uint32_t) ( ( v * cuckoo_hash_seed ) >> 32 ) & ( sz - 1 );
+      while ( tab[ i ] != 0 )
+        i = ( i + 1 ) & ( sz - 1 );
+      tab[ i ] = v;
+    }
+  }
+  if ( this->tab != this->init_tab )
+    ::free( this->tab );
+  this->tab  = tab;
+  this->mask = sz - 1;
+  return true;
+}
+
+/* nodes queued by a bfs of depth moves, each of the arity * buckets roots
+ * fans out to the other positions of the key it holds */
+static uint32_t
+cuckoo_bfs_nodes( uint32_t arity,  uint32_t buckets,  uint32_t depth )
+{
+  uint64_t level = (uint64_t) arity * buckets,
+           fan   = ( level > 1 ? level - 1 : 1 ),
+           n     = level;
+  for ( uint32_t d = 1; d < depth && n < cuckoo_bfs_max_nodes; d++ ) {
+    level *= fan;
+    n     += level;
+  }
+  return n < cuckoo_bfs_max_nodes ? (uint32_t) n : cuckoo_bfs_max_nodes;
+}
+
+/* search for an empty slot by moving keys to one of their alternates:
+ * hdr.cuckoo_path_depth == 0 randomly walks the positions on a stack,
+ * otherwise the node[] array is a queue, searched breadth first so the
+ * shortest path is found, no deeper than cuckoo_path_depth moves, each
+ * position is queued once and the queue grows to the nodes the depth needs;
+ * the bfs is deterministic, so when it doesn't find a path the retries use
+ * the random walk; the search only fetches entries, after an empty slot is
+ * found the path is locked one pair at a time and moved from the tail back
+ * to the key's position */
 KeyStatus
 CuckooAltHash::find_cuckoo_path( CuckooPosition &cp ) noexcept
 {
@@ -88,20 +173,27 @@ CuckooAltHash::find_cuckoo_path( CuckooPosition &cp ) noexcept
   const uint32_t     arity     = kctx.cuckoo_arity,
                      buckets   = kctx.cuckoo_buckets;
   const uint64_t     ht_size   = kctx.ht_size;
+  const uint32_t     max_depth = kctx.ht.hdr.cuckoo_path_depth,
+                     max_nodes = ( max_depth == 0 ? node_size :
+                               cuckoo_bfs_nodes( arity, buckets, max_depth ) );
   KeyCtx             to_kctx( kctx ),
                      fr_kctx( kctx );
   WorkAllocT<1024>   wrk, wrk2;
-  CuckooVisit        node[ node_size ],
+  CuckooVisit        node_stk[ node_size ],
+                   * node,
                    * vis;
+  CuckooVisitBuf     nbuf( node_stk, node_size );
+  CuckooVisitSet     visited;
+  bool               bfs;
   uint32_t           stk[ stk_size ];
    /*= (CuckooVisit *) kctx.wrk->alloc( node_size * sizeof( CuckooVisit ) ),*/
    /*= (uint32_t *) kctx.wrk->alloc( stk_size * sizeof( uint32_t ) );*/
   CuckooAltHash    * h   = CuckooAltHash::create( kctx );
-  ThrCtx           & ctx = kctx.ht.ctx[ kctx.ctx_id ];
+  ThrCtx           & ctx = kctx.ht.get_ctx( kctx.ctx_id );
   rand::xoroshiro128plus
                    & rng = ctx.rng;
   uint64_t           key, key2, p, rng_bits, boff;
-  uint32_t           inc, off, tos, maxtos, tos_bits,
+  uint32_t           inc, off, tos, maxtos, tos_bits, head,
                      fetch_cnt = 0, acquire_cnt = 0, move_cnt = 0,
                      /*busy_cnt = 0,*/ retry;
   KeyStatus          status;
@@ -112,14 +204,20 @@ CuckooAltHash::find_cuckoo_path( CuckooPosition &cp ) noexcept
 
   for ( retry = 0; retry < MAX_CUCKOO_RETRY; retry++ ) {
     PositionBits<cuckoo_position_8k> bits( this->num, arity );
-    tos = 0;
-    off = 0;
+    tos  = 0;
+    off  = 0;
+    node = nbuf.ptr;
+    bfs  = ( max_depth != 0 && retry == 0 );
+    if ( bfs )
+      visited.reset();
 
     for ( inc = 0; inc < arity; inc++ ) {
       p    = this->pos[ inc ];
       boff = 0;
       while ( boff < buckets ) {
-        node[ off ].set( ZOMBIE64, 0, p, inc, (uint16_t) boff++, -1 );
+        if ( bfs )
+          visited.test_set( p );
+        node[ off ].set( ZOMBIE64, 0, p, inc, (uint16_t) boff++, -1, 0 );
         if ( ++p == ht_size )
           p = 0;
         stk[ tos ] = off;
@@ -130,12 +228,18 @@ CuckooAltHash::find_cuckoo_path( CuckooPosition &cp ) noexcept
     to_kctx.set( KEYCTX_IS_CUCKOO_ACQUIRE );
     fr_kctx.set( KEYCTX_IS_CUCKOO_ACQUIRE );
     maxtos = tos;
-    while ( tos > 0 ) {
+    head   = 0;
+    while ( bfs ? head < off : tos > 0 ) {
+      /* breadth first, the next in the queue */
+      if ( bfs )
+        vis = &node[ head++ ];
       /* randomly choose an entry to move, idx = rng % tos, rng >>= tos_bits */
-      uint32_t idx = fpmod.mod( tos, (uint32_t) rng_bits, tos_bits );
-      rng_bits   >>= tos_bits;
-      vis          = &node[ stk[ idx ] ];
-      stk[ idx ]   = stk[ --tos ];
+      else {
+        uint32_t idx = fpmod.mod( tos, (uint32_t) rng_bits, tos_bits );
+        rng_bits   >>= tos_bits;
+        vis          = &node[ stk[ idx ] ];
+        stk[ idx ]   = stk[ --tos ];
+      }
 
       /* p is the position that needs to be moved to create space */
       p      = vis->to_pos;
@@ -173,9 +277,28 @@ CuckooAltHash::find_cuckoo_path( CuckooPosition &cp ) noexcept
 	fetch_cnt++;
         /* if another key to move, push it to the search stack */
         if ( status == KEY_OK ) {
-	  if ( off < node_size && tos < stk_size ) {
+          if ( bfs ) {
+            if ( (uint32_t) vis->depth + 1 < max_depth &&
+                 ! visited.test_set( p ) ) {
+              if ( off == nbuf.size ) {
+                size_t i = vis - node;
+                if ( nbuf.grow( max_nodes ) ) {
+                  node = nbuf.ptr;
+                  vis  = &node[ i ];
+                }
+              }
+              if ( off < nbuf.size ) {
+                node[ off ].set( vis->to_pos, key, p, inc, (uint16_t) boff,
+                                 (int32_t) ( vis - node ),
+                                 (uint8_t) ( vis->depth + 1 ) );
+                off++;
+              }
+            }
+          }
+	  else if ( off < node_size && tos < stk_size ) {
 	    node[ off ].set( vis->to_pos, key, p, inc, (uint16_t) boff,
-                             (int32_t) ( vis - node ) );
+                             (int32_t) ( vis - node ),
+                             (uint8_t) ( vis->depth + 1 ) );
 	    stk[ tos ] = off;
 	    off++; tos++;
 	  }
@@ -428,7 +551,7 @@ KeyCtx::multi_acquire_cuckoo( const uint64_t k,
       return KEY_OK;
     /* check if I own the lock as cp.pos */
     if ( status == KEY_BUSY ) {
-      ThrCtx & ctx = this->ht.ctx[ this->ctx_id ];
+      ThrCtx & ctx = this->ht.get_ctx( this->ctx_id );
       if ( ! ctx.is_my_lock( cp.pos ) ) /* skip over the lock */
         return KEY_BUSY;
       status = cp.acquire_incr( ++this->chains, is_next, false );
@@ -544,7 +667,7 @@ KeyCtx::get_pos_info( uint64_t &natural_pos,  uint64_t &pos_off ) noexcept
 KeyStatus
 KeyCtx::try_acquire_position( const uint64_t i ) noexcept
 {
-  ThrCtx    & ctx = this->ht.ctx[ this->ctx_id ];
+  ThrCtx    & ctx = this->ht.get_ctx( this->ctx_id );
   HashEntry * el;          /* current ht[] ptr */
   uint64_t    cur_mcs_id,  /* MCS lock queue for the current element */
               h,           /* hash val at the current element */
@@ -564,7 +687,7 @@ KeyCtx::try_acquire_position( const uint64_t i ) noexcept
       this->db_num = el->db;
     if ( el->test( FL_DROPPED ) ) {
       this->drop_key   = h;
-      this->drop_key2  = el->hash2;
+      this->drop_key2  = el->get_hash2( this->hash_entry_size );
       this->drop_flags = el->flags;
       el->flags        = FL_NO_ENTRY;
       h                = 0;
@@ -573,7 +696,7 @@ KeyCtx::try_acquire_position( const uint64_t i ) noexcept
     this->clear( KEYCTX_IS_READ_ONLY );
     this->pos    = i;
     this->key    = h;
-    this->key2   = el->hash2;
+    this->key2   = el->get_hash2( this->hash_entry_size );
     this->lock   = h;
     this->mcs_id = cur_mcs_id;
     this->serial = el->value_ctr( this->hash_entry_size ).get_serial();
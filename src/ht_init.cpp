@@ -16,6 +16,7 @@
 #include <sys/stat.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <pthread.h>
 #endif
 
 #include <raikv/shm_ht.h>
@@ -51,11 +52,11 @@ static void remove_closed( void *p ) {
 const char HashTab::shared_mem_sig[ KV_SIG_SIZE /* 16 */ ]  = "rai 0.1 xxxxxxx";
 static const int SHM_TYPE_IDX  = 8;
 static const int SHM_TYPE_SIZE = 8;
-static const char * shm_type[ 4 ][ 3 ] = {
-  { "allc+4k", "allc+2m", "allc+1g" },
-  { "file+4k", "file+2m", "file+1g" },
-  { "posx+4k", "posx+2m", "posx+1g" },
-  { "sysv+4k", "sysv+2m", "sysv+1g" }
+static const char * shm_type[ 4 ][ 4 ] = {
+  { "allc+4k", "allc+2m", "allc+1g", "allc+th" },
+  { "file+4k", "file+2m", "file+1g", "file+th" },
+  { "posx+4k", "posx+2m", "posx+1g", "posx+th" },
+  { "sysv+4k", "sysv+2m", "sysv+1g", "sysv+th" }
 };
 static const uint8_t/*ALLOC_TYPE = 0, types that go in the SHM_TYPE_IDX pos: */
                      FILE_TYPE  = 1, /* 1g, 2m, 4k */
@@ -63,7 +64,8 @@ static const uint8_t/*ALLOC_TYPE = 0, types that go in the SHM_TYPE_IDX pos: */
                      SYSV_TYPE  = 3,
                      P2M        = 1, /* shm_type[ SYSV_TYPE ][ P2M ] */
                      P1G        = 2,
-                     P4K        = 0;
+                     P4K        = 0,
+                     PTH        = 3; /* 4k with madvise( MADV_HUGEPAGE ) */
 
 /* the constructor initializes the memory, only used in one thread context */
 HashTab::HashTab( const char *map_name,  const HashTabGeom &geom ) noexcept
@@ -87,7 +89,8 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
            max_idx,
            el_cnt;
   uint32_t i, j,
-           nsegs;     /* number of seg[] entries */
+           nsegs,     /* number of seg[] entries */
+           ctx_count; /* number of ctx[] entries */
   uint16_t szlog2;
   uint8_t  shift;
 
@@ -101,6 +104,22 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
   ::memcpy( this->hdr.sig, HashTab::shared_mem_sig, KV_SIG_SIZE );
   ::memset( (void *) &this->ctx[ 0 ], 0, HT_CTX_SIZE );
   ::memset( (void *) &this->stats[ 0 ], 0, HT_STATS_SIZE );
+  /* more than MAX_CTX_ID uses the extended ctx region, sig is 0.2 so that
+   * older versions do not attach it */
+  ctx_count = geom.ctx_count;
+  if ( ctx_count > MAX_CTX_ID ) {
+    if ( ctx_count > MAX_CTX_COUNT )
+      ctx_count = MAX_CTX_COUNT;
+    this->hdr.sig[ 6 ]    = '2';
+    this->hdr.ctx_count  = ctx_count;
+    this->hdr.stat_count = ctx_count * STAT_PER_CTX;
+    this->hdr.ht_off     = EXT_OFF + HashTab::ext_size( ctx_count );
+    ::memset( (void *) &((uint8_t *) (void *) this)[ EXT_OFF ], 0,
+              HashTab::ext_size( ctx_count ) );
+  }
+  else {
+    ctx_count = MAX_CTX_ID;
+  }
 
   /* sig is set later, it indicates the mapping type (malloc, posix, sysv) */
   ::strcpy( this->hdr.name, map_name ); /* length checked before calling */
@@ -114,8 +133,9 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
   this->hdr.max_value_size   = geom.max_value_size;
   this->hdr.cuckoo_buckets   = geom.cuckoo_buckets;
   this->hdr.cuckoo_arity     = geom.cuckoo_arity;
+  this->hdr.cuckoo_path_depth = geom.cuckoo_path_depth;
 
-  data_area = geom.map_size - ( HT_HDR_SIZE + HT_CTX_SIZE + HT_STATS_SIZE );
+  data_area = geom.map_size - ( EXT_OFF + HashTab::ext_size( ctx_count ) );
   el_cnt    = (uint64_t) ( geom.hash_value_ratio * (double) data_area ) /
                            (uint64_t) geom.hash_entry_size;
   sz = el_cnt;
@@ -179,13 +199,17 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
 
   if ( nsegs > 0 ) {
     /* calculate the segment offsets */
-    seg_off  = HT_HDR_SIZE + HT_CTX_SIZE + HT_STATS_SIZE + tab_size;
+    seg_off  = EXT_OFF + HashTab::ext_size( ctx_count ) + tab_size;
     while ( ( seg_off >> this->hdr.seg_align_shift ) > ( (uint64_t) 1 << 32 ) )
       this->hdr.seg_align_shift++;
     /* calc segment size */
     seg_size = ( data_size / nsegs ) & ~( this->hdr.seg_align() - 1 ); /*floor*/
     while ( ( seg_size >> this->hdr.seg_align_shift ) > ( (uint64_t) 1 << 32 ) )
       this->hdr.seg_align_shift++;
+    /* an odd number of compact 32 byte entries leaves the seg start
+     * unaligned, round it up and take the pad from the seg data */
+    data_size -= align<uint64_t>( seg_off, this->hdr.seg_align() ) - seg_off;
+    seg_off    = align<uint64_t>( seg_off, this->hdr.seg_align() );
     seg_size = ( data_size / nsegs ) & ~( this->hdr.seg_align() - 1 ); /*floor*/
 
     this->hdr.seg_start_val = (uint32_t) ( seg_off >> this->hdr.seg_align_shift );
@@ -214,11 +238,21 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
   rand::fill_urandom_bytes( buf, sizeof( buf ) );
   i = 0;
   for ( j = 0; j < MAX_CTX_ID; j++ ) {
-    rand::xoroshiro128plus &rng = this->ctx[ j ].rng;
+    rand::xoroshiro128plus &rng = this->get_ctx( j ).rng;
     rng.init( (void *) &buf[ i ], sizeof( uint64_t ) * 2 );
     i += 2;
     if ( nsegs > 0 )
-      this->ctx[ j ].seg_num = (uint16_t) ( rng.next() % nsegs );
+      this->get_ctx( j ).seg_num = (uint16_t) ( rng.next() % nsegs );
+  }
+  /* extended ctx are seeded from the first ctx[] */
+  for ( ; j < ctx_count; j++ ) {
+    rand::xoroshiro128plus &rng = this->get_ctx( j ).rng;
+    uint64_t seed[ 2 ];
+    seed[ 0 ] = this->get_ctx( j % MAX_CTX_ID ).rng.next();
+    seed[ 1 ] = this->get_ctx( j % MAX_CTX_ID ).rng.next();
+    rng.init( (void *) seed, sizeof( seed ) );
+    if ( nsegs > 0 )
+      this->get_ctx( j ).seg_num = (uint16_t) ( rng.next() % nsegs );
   }
   for ( j = 0; j < DB_COUNT; j++ ) {
     this->hdr.seed[ j ].hash1 = buf[ i ];
@@ -234,24 +268,63 @@ HashTab::initialize( const char *map_name,  const HashTabGeom &geom ) noexcept
     assert( (uint8_t *) this->seg_data( nsegs, 0 ) <=
             &((uint8_t *) (void *) this)[ geom.map_size ] );
   }
-  /* check hash_entry_size is valid */
-  assert( geom.hash_entry_size % 64 == 0 );
-
-  this->hdr.max_immed_value_size = geom.hash_entry_size -
-    ( sizeof( HashEntry ) + sizeof( ValueCtr ) );
+  /* check hash_entry_size is valid, 32 is the compact entry */
+  assert( geom.hash_entry_size == 32 || geom.hash_entry_size % 64 == 0 );
+
+  if ( HashEntry::is_compact( geom.hash_entry_size ) )
+    this->hdr.max_immed_value_size = 0;
+  else
+    this->hdr.max_immed_value_size = geom.hash_entry_size -
+      ( sizeof( HashEntry ) + sizeof( ValueCtr ) );
   if ( nsegs > 0 ) {
     assert( this->hdr.seg_size() > sizeof( MsgHdr ) );
     this->hdr.max_segment_value_size = this->hdr.seg_size() -
       ( sizeof( MsgHdr ) + sizeof( ValueCtr ) ); /* msg hdr */
+    /* compact entry value size is 16 bits of alignment units */
+    if ( HashEntry::is_compact( geom.hash_entry_size ) &&
+         this->hdr.max_segment_value_size >
+           ( (uint64_t) 0xffff << this->hdr.seg_align_shift ) -
+           ( sizeof( MsgHdr ) + sizeof( ValueCtr ) ) )
+      this->hdr.max_segment_value_size =
+        ( (uint64_t) 0xffff << this->hdr.seg_align_shift ) -
+        ( sizeof( MsgHdr ) + sizeof( ValueCtr ) );
   }
   /* zero the ht[] array */
   sz = (uint64_t) geom.hash_entry_size * this->hdr.ht_size;
   ::memset( this->get_entry( 0 ), 0, sz );
 }
 
+/* ctx_count 0 -> MAX_CTX_ID uses the ctx[] in the hdr, more than that uses
+ * the ext region, which must leave at least half the map for ht[] and data,
+ * the bfs depth of the cuckoo path search is limited */
+static bool
+check_geom( const HashTabGeom &geom ) noexcept
+{
+  if ( geom.cuckoo_path_depth > KV_CUCKOO_PATH_MAX ) {
+    fprintf( stderr, "cuckoo_path_depth %u is larger than %u\n",
+             (uint32_t) geom.cuckoo_path_depth, (uint32_t) KV_CUCKOO_PATH_MAX );
+    return false;
+  }
+  if ( geom.ctx_count > MAX_CTX_COUNT ) {
+    fprintf( stderr, "ctx_count %u is larger than %u\n",
+             (uint32_t) geom.ctx_count, (uint32_t) MAX_CTX_COUNT );
+    return false;
+  }
+  if ( geom.ctx_count > MAX_CTX_ID &&
+       HashTab::EXT_OFF + HashTab::ext_size( geom.ctx_count ) >
+       geom.map_size / 2 ) {
+    fprintf( stderr, "ctx_count %u is too large for map_size %" PRIu64 "\n",
+             (uint32_t) geom.ctx_count, geom.map_size );
+    return false;
+  }
+  return true;
+}
+
 HashTab *
 HashTab::alloc_map( HashTabGeom &geom ) noexcept
 {
+  if ( ! check_geom( geom ) )
+    return NULL;
   void * p = ::malloc( geom.map_size );
   if ( p == NULL )
     return NULL;
@@ -260,14 +333,23 @@ HashTab::alloc_map( HashTabGeom &geom ) noexcept
   return ht;
 }
 
+/* "rai 0.1 " or "rai 0.2 ", the latter has the extended ctx region */
+static bool
+match_sig( const char *sig )
+{
+  return ::memcmp( sig, HashTab::shared_mem_sig, 6 ) == 0 &&
+         ( sig[ 6 ] == '1' || sig[ 6 ] == '2' ) &&
+         sig[ 7 ] == HashTab::shared_mem_sig[ 7 ];
+}
+
 static uint8_t
 parse_map_name( const char *&fn )
 {
   uint8_t facility = 0, i = 0;
 
-  /* one of file:  file2m:  file1g:
-   *        sysv:  sysv2m:  sysv1g:
-   *        posix: posix2m: posix1g: */
+  /* one of file:  file2m:  file1g:  fileauto:
+   *        sysv:  sysv2m:  sysv1g:  sysvauto:
+   *        posix: posix2m: posix1g: posixauto: */
   if ( fn != NULL ) {
     if ( ::strncmp( fn, "file", 4 ) == 0 ) {
       facility = KV_FILE_MMAP;
@@ -294,6 +376,10 @@ parse_map_name( const char *&fn )
         fn = &fn[ i + 3 ];
         return facility | KV_HUGE_2MB;
       }
+      if ( ::strncmp( &fn[ i ], "auto:", 5 ) == 0 ) {
+        fn = &fn[ i + 5 ];
+        return facility | KV_HUGE_AUTO;
+      }
     }
   }
   fprintf( stderr, "Default to file mmap for map name \"%s\"\n", fn );
@@ -340,6 +426,82 @@ static const int MAP_PAGE_2M = MAP_HUGETLB | ( 21 << MAP_HUGE_SHIFT ),
 #endif
 static const int SHM_PAGE_2M = SHM_HUGETLB | ( 21 << SHM_HUGE_SHIFT ),
                  SHM_PAGE_1G = SHM_HUGETLB | ( 30 << SHM_HUGE_SHIFT );
+#if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
+#ifndef MADV_HUGEPAGE
+/* advise transparent huge pages */
+#define MADV_HUGEPAGE 14
+#endif
+#ifndef MADV_POPULATE_WRITE
+/* fault pages writable without modifying them (5.14) */
+#define MADV_POPULATE_WRITE 23
+#endif
+static const uint64_t PREFAULT_MIN_PART  = 64 * 1024 * 1024;
+static const uint32_t PREFAULT_MAX_THR   = 64;
+static const uint64_t PREFAULT_TOUCH_SIZE = 4096;
+
+/* a part of the map faulted by a thread */
+struct PrefaultPart {
+  pthread_t tid;
+  uint8_t * ptr;
+  uint64_t  len;
+};
+
+static void *
+prefault_part( void *arg )
+{
+  PrefaultPart & pt = *(PrefaultPart *) arg;
+  /* if the kernel does not have it, touch each page with an atomic add,
+   * another process may be using the map, step by 4k since the huge pages
+   * from MADV_HUGEPAGE are advisory and the map may be small pages */
+  if ( ::madvise( pt.ptr, pt.len, MADV_POPULATE_WRITE ) != 0 ) {
+    for ( uint64_t off = 0; off < pt.len; off += PREFAULT_TOUCH_SIZE )
+      kv_sync_add( (volatile uint64_t *) (void *) &pt.ptr[ off ],
+                   (uint64_t) 0 );
+  }
+  return NULL;
+}
+
+/* fault the pages of the map in parallel, so that the first touch of ht[]
+ * and the segments is not taken by request traffic, return millisecs */
+static uint32_t
+prefault_map( void *p,  uint64_t map_size,  int huge,
+              uint16_t &nthreads ) noexcept
+{
+  PrefaultPart part[ PREFAULT_MAX_THR ];
+  uint64_t     page_size = ( huge == P1G ? (uint64_t) 1 << 30 :
+                             huge == P4K ? (uint64_t) ::sysconf( _SC_PAGESIZE )
+                                         : (uint64_t) 1 << 21 ),
+               start     = current_monotonic_time_ns(),
+               part_len, off;
+  long         ncpu      = ::sysconf( _SC_NPROCESSORS_ONLN );
+  uint32_t     nthr      = ( ncpu > 0 ? (uint32_t) ncpu : 1 ), i;
+
+  if ( nthr > PREFAULT_MAX_THR )
+    nthr = PREFAULT_MAX_THR;
+  if ( nthr > map_size / PREFAULT_MIN_PART )
+    nthr = (uint32_t) ( map_size / PREFAULT_MIN_PART );
+  if ( nthr == 0 )
+    nthr = 1;
+  part_len = align<uint64_t>( map_size / nthr, page_size );
+  for ( i = 0, off = 0; i < nthr && off < map_size; i++, off += part_len ) {
+    part[ i ].ptr       = &((uint8_t *) p)[ off ];
+    part[ i ].len       = ( map_size - off < part_len ? map_size - off :
+                            part_len );
+    if ( i + 1 == nthr ||
+         ::pthread_create( &part[ i ].tid, NULL, prefault_part,
+                           &part[ i ] ) != 0 ) {
+      prefault_part( &part[ i ] ); /* last part or no thread, do it here */
+      part[ i ].ptr = NULL;
+    }
+  }
+  nthr = i;
+  for ( i = 0; i < nthr; i++ )
+    if ( part[ i ].ptr != NULL )
+      ::pthread_join( part[ i ].tid, NULL );
+  nthreads = (uint16_t) nthr;
+  return (uint32_t) ( ( current_monotonic_time_ns() - start ) / 1000000 );
+}
+#endif
 
 /* XXX this needs synchronization so that clients don't attach before
    server initializes */
@@ -372,6 +534,8 @@ HashTab::create_map( const char *map_name,  uint8_t facility,
     fprintf( stderr, "map name \"%s\" too large\n", map_name );
     return NULL;
   }
+  if ( ! check_geom( geom ) )
+    return NULL;
 
 #if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
   int    j,
@@ -381,10 +545,15 @@ HashTab::create_map( const char *map_name,  uint8_t facility,
          mode_flags,
          excl,
          huge;
-  bool   is_file_mmap;
+  bool     is_file_mmap;
+  uint32_t pf_ms  = 0;
+  uint16_t pf_thr = 0;
 
   for ( j = 0; j < 3; j++ )
     flags[ j ] = 0;
+  /* auto tries 1g, 2m, then normal pages */
+  if ( ( facility & KV_HUGE_AUTO ) != 0 )
+    facility = (uint8_t) ( facility & ~( KV_HUGE_2MB | KV_HUGE_1GB ) );
   
   /* need a pid file or a lck file fo exclusive access as server */
   /* if normal files */
@@ -434,7 +603,9 @@ HashTab::create_map( const char *map_name,  uint8_t facility,
         show_perror( "ftruncate", map_name );
       }
       else {
-        flags[ 0 ] = MAP_SHARED | MAP_POPULATE;
+        flags[ 0 ] = MAP_SHARED;
+        if ( ( facility & KV_HUGE_AUTO ) == 0 )
+          flags[ 0 ] |= MAP_POPULATE; /* otherwise prefault_map() below */
         if ( ( facility & KV_HUGE_2MB ) != 0 )
           flags[ 0 ] |= MAP_PAGE_2M;
         else if ( ( facility & KV_HUGE_1GB ) != 0 )
@@ -541,7 +712,14 @@ HashTab::create_map( const char *map_name,  uint8_t facility,
       break;
     }
   }
+  if ( ( facility & KV_HUGE_AUTO ) != 0 ) {
+    if ( huge == P4K && ::madvise( p, map_size, MADV_HUGEPAGE ) == 0 )
+      huge = PTH;
+    pf_ms = prefault_map( p, map_size, huge, pf_thr );
+  }
   ht = new ( p ) HashTab( map_name, geom );
+  ht->hdr.prefault_ms      = pf_ms;
+  ht->hdr.prefault_threads = pf_thr;
 
   /* try to lock memory */
   if ( ::mlock( p, map_size ) != 0 )
@@ -617,6 +795,9 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
   
   for ( j = 0; j < 3; j++ )
     flags[ j ] = 0;
+  /* auto tries 1g, 2m, then normal pages */
+  if ( ( facility & KV_HUGE_AUTO ) != 0 )
+    facility = (uint8_t) ( facility & ~( KV_HUGE_2MB | KV_HUGE_1GB ) );
   switch ( facility & ( KV_FILE_MMAP | KV_POSIX_SHM | KV_SYSV_SHM ) ) {
     default:
       fprintf( stderr, "attach: bad facility 0x%x\n", facility );
@@ -674,7 +855,7 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
         ::usleep( 1 ); /* wait for initialize to finish */
       }
       map_size = align<uint64_t>( hdr.map_size, page_align );
-      if ( ::memcmp( hdr.sig, HashTab::shared_mem_sig, SHM_TYPE_IDX ) != 0 ) {
+      if ( ! match_sig( hdr.sig ) ) {
         fprintf( stderr, "shm sig doesn't match: [%s][%s]",
                  HashTab::shared_mem_sig, hdr.sig );
         ::shmdt( p );
@@ -710,7 +891,7 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
           break;
         ::usleep( 1 ); /* wait for initialize to finish */
       }
-      if ( ::memcmp( hdr.sig, HashTab::shared_mem_sig, SHM_TYPE_IDX ) != 0 ) {
+      if ( ! match_sig( hdr.sig ) ) {
         fprintf( stderr, "shm sig doesn't match: [%s][%s]",
                  HashTab::shared_mem_sig, hdr.sig );
         ::close( fd );
@@ -718,7 +899,9 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
       }
       map_size = align<uint64_t>( hdr.map_size, page_align );
 
-      flags[ 0 ] = MAP_SHARED | MAP_POPULATE;
+      flags[ 0 ] = MAP_SHARED;
+      if ( ( facility & KV_HUGE_AUTO ) == 0 )
+        flags[ 0 ] |= MAP_POPULATE; /* otherwise prefault_map() below */
       if ( ( facility & KV_HUGE_2MB ) != 0 )
         flags[ 0 ] |= MAP_PAGE_2M;
       else if ( ( facility & KV_HUGE_1GB ) != 0 )
@@ -743,6 +926,18 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
         return NULL;
       break;
   }
+  if ( ( facility & KV_HUGE_AUTO ) != 0 ) {
+    /* the page size the creator got, "posx+1g" */
+    const char * pg = &hdr.sig[ SHM_TYPE_IDX + 5 ];
+    int huge = ( pg[ 0 ] == '1' ? P1G : pg[ 0 ] == '2' ? P2M :
+                 pg[ 0 ] == 't' ? PTH : P4K );
+    if ( huge == PTH )
+      ::madvise( p, map_size, MADV_HUGEPAGE );
+    uint16_t pf_thr = 0;
+    uint32_t pf_ms  = prefault_map( p, map_size, huge, pf_thr );
+    ((HashTab *) p)->hdr.prefault_ms      = pf_ms;
+    ((HashTab *) p)->hdr.prefault_threads = pf_thr;
+  }
   ::mlock( p, map_size ); /* ignore the warning, the create() will show it */
 
 #else
@@ -775,6 +970,8 @@ HashTab::attach_map( const char *map_name,  uint8_t facility,
   geom.hash_value_ratio = hdr.hash_value_ratio;
   geom.cuckoo_buckets   = hdr.cuckoo_buckets;
   geom.cuckoo_arity     = hdr.cuckoo_arity;
+  geom.cuckoo_path_depth = hdr.cuckoo_path_depth;
+  geom.ctx_count        = (uint16_t) hdr.ctx_count;
 
   /*if ( ::mlock( p, map_size ) != 0 )*/
     /*show_perror( "warning: mlock()", map_name )*/;
@@ -909,7 +1106,8 @@ uint32_t
 HashTab::attach_ctx( uint64_t key ) noexcept
 {
   const uint64_t bizyid = ZOMBIE64 | key;
-  uint32_t i     = this->hdr.next_ctx.add( 1 ) % MAX_CTX_ID,
+  uint32_t cnt   = this->max_ctx_count(),
+           i     = this->hdr.next_ctx.add( 1 ) % cnt,
            start = i;
   uint64_t val;
   bool     second_time = false;
@@ -918,11 +1116,11 @@ HashTab::attach_ctx( uint64_t key ) noexcept
     return KV_NO_CTX_ID;
 
   for (;;) {
-    ThrCtx & el = this->ctx[ i ];
+    ThrCtx & el = this->get_ctx( i );
     while ( ( (val = el.key.xchg( bizyid )) & ZOMBIE64 ) != 0 )
       kv_sync_pause();
     /* keep used entries around for history, unless there are no more spots */
-    if ( el.ctx_pid == 0 || ( second_time && el.ctx_id >= MAX_CTX_ID ) ) {
+    if ( el.ctx_pid == 0 || ( second_time && el.ctx_id >= cnt ) ) {
       el.zero();
       el.ctx_id     = i;
       el.ctx_pid    = ::getpid();
@@ -937,7 +1135,7 @@ HashTab::attach_ctx( uint64_t key ) noexcept
       return el.ctx_id;
     }
     el.key.xchg( val ); /* unlock */
-    i = ( i + 1 ) % MAX_CTX_ID;
+    i = ( i + 1 ) % cnt;
     /* checked all slots */
     if ( i == start ) {
       if ( second_time )
@@ -950,34 +1148,35 @@ HashTab::attach_ctx( uint64_t key ) noexcept
 uint32_t
 HashTab::attach_db( uint32_t ctx_id,  uint8_t db ) noexcept
 {
-  ThrCtx      & el = this->ctx[ ctx_id ];
+  ThrCtx      & el = this->get_ctx( ctx_id );
   ThrStatLink * link;
-  uint32_t      i,
+  uint32_t      i, d,
                 j = el.db_stat_hd;
 
   for (;;) {
     if ( j == MAX_STAT_ID ) /* db not found */
       break;
-    link = &this->hdr.stat_link[ j ];
+    link = &this->get_stat_link( j );
     if ( link->db_num == db )
       return j;
     j = link->next;
   }
   this->hdr.set_db_opened( db );
-  j = ctx_id;
+  d = ctx_id; /* dense index, j is the stat id, which skips MAX_STAT_ID */
   i = 0;
   for (;;) {
-    link = &this->hdr.stat_link[ j ];
+    j    = HashTab::stat_id( d );
+    link = &this->get_stat_link( j );
     while ( link->busy.xchg( 1 ) != 0 )
       kv_sync_pause();
     if ( link->used == 0 ) /* if found a free link */
       break;
     link->busy.xchg( 0 );
-    if ( ++i == MAX_STAT_ID * 3 )
+    if ( ++i == this->max_stat_count() * 3 )
       return KV_NO_DBSTAT_ID;
-    j += MAX_CTX_ID;       /* step by ctx */
-    if ( j >= MAX_STAT_ID )
-      j = ( j + 1 ) % MAX_STAT_ID;
+    d += this->max_ctx_count();       /* step by ctx */
+    if ( d >= this->max_stat_count() )
+      d = ( d + 1 ) % this->max_stat_count();
   }
   link->used.xchg( 1 );
   link->ctx_id = ctx_id;
@@ -987,7 +1186,7 @@ HashTab::attach_db( uint32_t ctx_id,  uint8_t db ) noexcept
   if ( el.db_stat_tl == MAX_STAT_ID )
     el.db_stat_hd = j;
   else {
-    ThrStatLink & tl = this->hdr.stat_link[ el.db_stat_tl ];
+    ThrStatLink & tl = this->get_stat_link( el.db_stat_tl );
     tl.next = j;
   }
   el.db_stat_tl = j;
@@ -998,14 +1197,14 @@ HashTab::attach_db( uint32_t ctx_id,  uint8_t db ) noexcept
 void
 HashTab::detach_db( uint32_t ctx_id,  uint8_t db ) noexcept
 {
-  ThrCtx      & el   = this->ctx[ ctx_id ];
+  ThrCtx      & el   = this->get_ctx( ctx_id );
   ThrStatLink * link = NULL;
   uint32_t      j    = el.db_stat_hd;
 
   for (;;) {
      if ( j == MAX_STAT_ID ) /* db not found */
        return;
-     link = &this->hdr.stat_link[ j ];
+     link = &this->get_stat_link( j );
      if ( link->db_num == db )
        break;
      j = link->next;
@@ -1013,20 +1212,20 @@ HashTab::detach_db( uint32_t ctx_id,  uint8_t db ) noexcept
   if ( link->back == MAX_STAT_ID )
     el.db_stat_hd = link->next;
   else {
-    ThrStatLink & back = this->hdr.stat_link[ link->back ];
+    ThrStatLink & back = this->get_stat_link( link->back );
     back.next = link->next;
   }
   if ( link->next == MAX_STAT_ID )
     el.db_stat_tl = link->back;
   else {
-    ThrStatLink & next = this->hdr.stat_link[ link->next ];
+    ThrStatLink & next = this->get_stat_link( link->next );
     next.back = link->back;
   }
   link->next = MAX_STAT_ID;
   link->back = MAX_STAT_ID;
 
   HashCounters & dbst = this->hdr.db_stat[ db ];
-  HashCounters & stat = this->stats[ j ],
+  HashCounters & stat = this->get_stats( j ),
                  tmp  = stat;
   this->hdr.ht_spin_lock( db );
   stat.zero();
@@ -1036,18 +1235,118 @@ HashTab::detach_db( uint32_t ctx_id,  uint8_t db ) noexcept
   link->used.xchg( 0 );
 }
 
+/* set the limits of db, count the usage when a limit is enabled; entries
+ * locked while scanning are counted as they were before */
+void
+HashTab::set_db_quota( uint8_t db,  uint64_t max_bytes,
+                       uint64_t max_entries ) noexcept
+{
+  DBQuota      & q         = this->hdr.db_quota[ db ];
+  const bool     cnt_bytes = ( max_bytes != 0 && q.max_bytes == 0 ),
+                 cnt_ents  = ( max_entries != 0 && q.max_entries == 0 );
+  const uint32_t hsz       = this->hdr.hash_entry_size;
+  uint64_t       bytes     = 0,
+                 ents      = 0;
+
+  /* start tracking before the scan, so adds and drops are not lost */
+  if ( max_bytes == 0 || cnt_bytes )
+    q.bytes = 0;
+  if ( max_entries == 0 || cnt_ents )
+    q.entries = 0;
+  q.max_bytes   = max_bytes;
+  q.max_entries = max_entries;
+  if ( ! cnt_bytes && ! cnt_ents )
+    return;
+  for ( uint64_t i = 0; i < this->hdr.ht_size; i++ ) {
+    HashEntry & el = *this->get_entry( i, hsz );
+    if ( ( el.hash & ~ZOMBIE64 ) <= DROPPED_HASH || el.db != db ||
+         el.test( FL_DROPPED ) )
+      continue;
+    ents++;
+    if ( el.test( FL_SEGMENT_VALUE ) ) {
+      ValueGeom geom;
+      el.get_value_geom( hsz, geom, this->hdr.seg_align_shift );
+      bytes += geom.size;
+    }
+  }
+  if ( cnt_bytes )
+    q.bytes.add( bytes );
+  if ( cnt_ents )
+    q.entries.add( ents );
+}
+
+/* pin the current read epoch, the ctx is counted in pin_ctx_count until it
+ * is unpinned, which stops gc from moving values while pinned readers exist */
+void
+HashTab::pin_read( uint32_t ctx_id ) noexcept
+{
+  ThrCtx & el = this->get_ctx( ctx_id );
+  if ( ( el.ctx_flags & ThrCtxHdr::CTX_PIN_READ ) == 0 ) {
+    el.ctx_flags = (uint16_t) ( el.ctx_flags | ThrCtxHdr::CTX_PIN_READ );
+    this->hdr.pin_ctx_count.add( 1 );
+    this->hdr.read_epoch.cmpxchg( 0, 1 ); /* zero is not pinned */
+  }
+  /* the pin is visible before the value is located, recheck the epoch in
+   * case gc advanced it and did not see the pin */
+  for (;;) {
+    uint32_t e = this->hdr.read_epoch;
+    el.pin_epoch = e;
+    kv_sync_mfence();
+    if ( e == this->hdr.read_epoch )
+      break;
+  }
+}
+
+/* drop the pin, gc moves and resize overwrites when no pins are left */
+void
+HashTab::unpin_read( uint32_t ctx_id ) noexcept
+{
+  ThrCtx & el = this->get_ctx( ctx_id );
+  kv_release_fence();
+  el.pin_epoch = 0;
+  if ( ( el.ctx_flags & ThrCtxHdr::CTX_PIN_READ ) != 0 ) {
+    el.ctx_flags = (uint16_t) ( el.ctx_flags & ~ThrCtxHdr::CTX_PIN_READ );
+    this->hdr.pin_ctx_count.sub( 1 );
+  }
+}
+
+/* advance the epoch so new releases are stamped after current pins, then
+ * find the oldest pin, data stamped before it is not referenced */
+uint32_t
+HashTab::update_read_epoch( void ) noexcept
+{
+  uint32_t e = this->hdr.read_epoch, min;
+  while ( ! this->hdr.read_epoch.cmpxchg( e, ( e + 1 == 0 ? 1 : e + 1 ) ) )
+    e = this->hdr.read_epoch;
+  kv_sync_mfence();
+  min = this->hdr.read_epoch;
+  for ( uint32_t id = 0; id < this->max_ctx_count(); id++ ) {
+    uint32_t p = this->get_ctx( id ).pin_epoch;
+    if ( p != 0 && (int32_t) ( p - min ) < 0 )
+      min = p;
+  }
+  for (;;) {
+    e = this->hdr.read_epoch_min;
+    if ( (int32_t) ( min - e ) <= 0 )
+      return e;
+    if ( this->hdr.read_epoch_min.cmpxchg( e, min ) )
+      return min;
+  }
+}
+
 /* detach thread */
 void
 HashTab::detach_ctx( uint32_t ctx_id ) noexcept
 {
-  ThrCtx       & el     = this->ctx[ ctx_id ];
+  ThrCtx       & el     = this->get_ctx( ctx_id );
   const uint64_t bizyid = ZOMBIE64 | ctx_id;
 
-  if ( ctx_id >= MAX_CTX_ID )
+  if ( ctx_id >= this->max_ctx_count() )
     return;
 
   while ( el.db_stat_hd != MAX_STAT_ID )
-    this->detach_db( ctx_id, this->hdr.stat_link[ el.db_stat_hd ].db_num );
+    this->detach_db( ctx_id, this->get_stat_link( el.db_stat_hd ).db_num );
+  this->unpin_read( ctx_id );
   while ( ( el.key.xchg( bizyid ) & ZOMBIE64 ) != 0 )
     kv_sync_pause();
   if ( ++el.ctx_seqno == 0 )
@@ -1058,6 +1357,99 @@ HashTab::detach_ctx( uint32_t ctx_id ) noexcept
   el.key.xchg( 0 );
 }
 
+/* recover the locks held by a dead ctx, return mask of mcs recovered */
+static uint64_t
+recover_ctx_locks( HashTab &map,  uint32_t ctx_id,  uint64_t used,
+                   bool verbose ) noexcept
+{
+  ThrCtx       & el              = map.get_ctx( ctx_id );
+  uint32_t       hash_entry_size = map.hdr.hash_entry_size;
+  uint64_t       recovered       = 0;
+  ThrCtxOwner    closure( map );
+
+  for ( uint32_t id = 0; id < 64; id++ ) {
+    if ( ( used & ( (uint64_t) 1 << id ) ) == 0 )
+      continue;
+    uint64_t     mcs_id = ( (uint64_t) ctx_id << ThrCtxEntry::MCS_SHIFT ) | id;
+    ThrMCSLock & mcs    = el.get_mcs_lock( mcs_id );
+    MCSStatus    status;
+    if ( verbose )
+      printf(
+      "ctx %u: pid %u, mcs %u, val 0x%" PRIx64 ", lock 0x%" PRIx64 ", next 0x%" PRIx64 ", link %" PRIu64 "\n",
+               ctx_id, el.ctx_pid, id, mcs.val.load(), mcs.lock.load(),
+               mcs.next.load(), mcs.lock_id );
+    if ( mcs.lock_id == 0 )
+      continue;
+    HashEntry *entry = map.get_entry( mcs.lock_id - 1, hash_entry_size );
+    status = mcs.recover_lock( entry->hash, ZOMBIE64, mcs_id, closure );
+    if ( status == MCS_OK ) {
+      ValueCtr &ctr = entry->value_ctr( hash_entry_size );
+      if ( ctr.seal == 0 )
+        ctr.seal = 1; /* these are lost with the context thread */
+      status = mcs.recover_unlock( entry->hash, ZOMBIE64, mcs_id, closure );
+      if ( status == MCS_OK ) {
+        if ( verbose )
+          printf( "mcs_id %u:%u recovered\n", ctx_id, id );
+        recovered |= ( (uint64_t) 1 << id );
+      }
+    }
+    if ( status != MCS_OK && verbose )
+      printf( "mcs_id %u:%u status %s\n", ctx_id, id,
+              status == MCS_WAIT ? "MCS_WAIT" : "MCS_INACTIVE" );
+  }
+  return recovered;
+}
+
+uint32_t
+HashTab::recover_dead_ctx( bool verbose ) noexcept
+{
+  CtxRecoverStats & rs  = this->hdr.recover;
+  const uint64_t    me  = (uint64_t) ::getpid();
+  uint64_t          own = rs.owner;
+  uint32_t          cnt = 0;
+
+  /* one at a time, take over when the owner died while recovering */
+  if ( own != 0 && ( own == me || pidexists( (uint32_t) own ) != 0 ) )
+    return 0;
+  if ( ! rs.owner.cmpxchg( own, me ) )
+    return 0;
+  rs.check_cnt++;
+  for ( uint32_t ctx_id = 1; ctx_id < this->max_ctx_count(); ctx_id++ ) {
+    ThrCtx & el    = this->get_ctx( ctx_id );
+    uint32_t pid   = el.ctx_pid,
+             seqno = el.ctx_seqno;
+    /* dead only when kill( pid, 0 ) is ESRCH, EPERM is running */
+    if ( pid == 0 || el.ctx_id == KV_NO_CTX_ID || pidexists( pid ) != 0 )
+      continue;
+    if ( verbose )
+      printf( "ctx %u: pid %u is not running\n", ctx_id, pid );
+    cnt++;
+    rs.dead_ctx++;
+
+    uint64_t used, recovered = 0;
+    if ( (used = el.mcs_used) != 0 ) {
+      recovered = recover_ctx_locks( *this, ctx_id, used, verbose );
+      el.mcs_used &= ~recovered;
+      rs.lock_recov += kv_popcountl( recovered );
+    }
+    if ( used != recovered ) {
+      if ( verbose )
+        printf( "ctx %u still has locks\n", ctx_id );
+      rs.lock_wait += kv_popcountl( used & ~recovered );
+    }
+    /* the same ctx that was seen dead, not detached and attached again */
+    else if ( el.ctx_id == ctx_id && el.ctx_pid == pid &&
+              el.ctx_seqno == seqno ) {
+      this->detach_ctx( ctx_id );
+      rs.ctx_detach++;
+    }
+  }
+  if ( cnt > 0 )
+    rs.last_stamp = current_realtime_ns();
+  rs.owner.xchg( 0 );
+  return cnt;
+}
+
 int
 EvShm::open( const char *map_name,  uint8_t db_num ) noexcept
 {
@@ -1080,6 +1472,8 @@ EvShm::open_rdonly( void ) noexcept
   geom.hash_value_ratio = 1;
   geom.cuckoo_buckets   = 0;
   geom.cuckoo_arity     = 0;
+  geom.cuckoo_path_depth = 0;
+  geom.ctx_count        = 0;
   this->map = HashTab::alloc_map( geom );
   if ( this->map != NULL ) {
     this->map->hdr.ht_read_only = 1;
@@ -1097,6 +1491,7 @@ EvShm::create( const char *map_name,  kv_geom_t *geom,  int map_mode,
   kv_geom_t default_geom;
   if ( geom == NULL ) {
     ::memset( &default_geom, 0, sizeof( default_geom ) );
+    default_geom.cuckoo_path_depth = KV_CUCKOO_PATH_DEPTH;
     geom = &default_geom;
   }
   if ( geom->map_size == 0 )
@@ -1162,7 +1557,7 @@ EvShm::attach( uint8_t db_num ) noexcept
   uint64_t k;
   k = ::getthrid();
   this->ctx_id = this->map->attach_ctx( k );
-  if ( this->ctx_id < MAX_CTX_ID ) {
+  if ( this->ctx_id != KV_NO_CTX_ID ) {
     this->dbx_id = this->map->attach_db( this->ctx_id, db_num );
     return 0;
   }
@@ -1173,9 +1568,9 @@ void
 EvShm::detach( void ) noexcept
 {
   if ( this->map != NULL ) {
-    if ( this->ctx_id < MAX_CTX_ID ) {
+    if ( this->ctx_id != KV_NO_CTX_ID ) {
       this->map->detach_ctx( this->ctx_id );
-      this->ctx_id = MAX_CTX_ID;
+      this->ctx_id = KV_NO_CTX_ID;
     }
   }
 }
@@ -1238,6 +1633,12 @@ kv_detach_ctx( kv_hash_tab_t *ht,  uint32_t ctx_id )
   reinterpret_cast<HashTab *>( ht )->detach_ctx( ctx_id );
 }
 
+uint32_t
+kv_recover_dead_ctx( kv_hash_tab_t *ht )
+{
+  return reinterpret_cast<HashTab *>( ht )->recover_dead_ctx( false );
+}
+
 uint32_t
 kv_attach_db( kv_hash_tab_t *ht,  uint32_t ctx_id,  uint8_t db )
 {
@@ -92,7 +92,7 @@ KeyCtx::multi_acquire_linear_probe( const uint64_t k,
     status = this->acquire<LinearPosition, false>( lp );
     if ( status != KEY_BUSY )
       return status;
-    ThrCtx & ctx = this->ht.ctx[ this->ctx_id ];
+    ThrCtx & ctx = this->ht.get_ctx( this->ctx_id );
     if ( ! ctx.is_my_lock( lp.pos ) ) /* skip over the lock */
       return KEY_BUSY;
     status = lp.acquire_incr( ++this->chains, is_next, false );
@@ -187,7 +187,7 @@ KeyCtx::fetch_position( const uint64_t i,  const bool is_scan ) noexcept
       this->set( KEYCTX_IS_READ_ONLY );
       this->pos    = i;
       this->key    = h;
-      this->key2   = cpy->hash2;
+      this->key2   = cpy->get_hash2( this->hash_entry_size );
       this->lock   = h;
       this->serial = cpy->value_ctr( this->hash_entry_size ).get_serial();
       this->entry  = cpy;
@@ -213,7 +213,7 @@ KeyCtx::drop( void )
   if ( (status = this->tombstone()) != KEY_OK )
     return status;
 
-  ThrCtxOwner    closure( this->ht.ctx );
+  ThrCtxOwner    closure( this->ht );
   ThrCtx       & ctx       = this->thr_ctx;
   const uint64_t half_size = this->ht_size / 2;
   HashEntry    * el,
@@ -124,12 +124,12 @@ HashTab::sum_ht_thr_delta( HashDeltaCounters &stat,  HashCounters &ops,
   tmp.zero();
   ops.zero();
   tot.zero();
-  if ( this->ctx[ ctx_id ].ctx_id != ctx_id )
+  if ( this->get_ctx( ctx_id ).ctx_id != ctx_id )
     return false;
   /* presumes that the caller owns the thread */
-  for ( i = this->ctx[ ctx_id ].db_stat_hd; i != MAX_STAT_ID;
-        i = this->hdr.stat_link[ i ].next ) {
-    tmp += this->stats[ i ];
+  for ( i = this->get_ctx( ctx_id ).db_stat_hd; i != MAX_STAT_ID;
+        i = this->get_stat_link( i ).next ) {
+    tmp += this->get_stats( i );
   }
   stat.get_ht_delta( tmp );
   ops = stat.delta;
@@ -141,7 +141,7 @@ bool
 HashTab::sum_ht_db_delta( HashDeltaCounters &stat,  HashCounters &ops,
                           HashCounters &tot,  uint8_t db ) noexcept
 {
-  uint32_t i;
+  uint32_t i, j;
   HashCounters tmp;
 
   ops.zero();
@@ -156,10 +156,11 @@ HashTab::sum_ht_db_delta( HashDeltaCounters &stat,  HashCounters &ops,
   /* sum retired stats */
   tmp = this->hdr.db_stat[ db ];
   /* still mutating the stat_link[] are the active contexts */
-  for ( i = 0; i < MAX_STAT_ID; i++ ) {
-    ThrStatLink & link = this->hdr.stat_link[ i ];
+  for ( j = 0; j < this->max_stat_count(); j++ ) {
+    i = HashTab::stat_id( j );
+    ThrStatLink & link = this->get_stat_link( i );
     if ( link.used == 1 && link.db_num == db )
-      tmp += this->stats[ i ];
+      tmp += this->get_stats( i );
   }
   /* unlock db */
   this->hdr.ht_spin_unlock( db );
@@ -173,7 +174,7 @@ HashTab::sum_ht_db_delta( HashDeltaCounters &stat,  HashCounters &ops,
 bool
 HashTab::get_db_stats( HashCounters &tot,  uint8_t db ) noexcept
 {
-  uint32_t i;
+  uint32_t i, j;
 
   if ( ! this->hdr.test_db_opened( db ) ) {
     tot.zero();
@@ -184,10 +185,11 @@ HashTab::get_db_stats( HashCounters &tot,  uint8_t db ) noexcept
   /* sum retired stats */
   tot = this->hdr.db_stat[ db ];
   /* still mutating the stat_link[] are the active contexts */
-  for ( i = 0; i < MAX_STAT_ID; i++ ) {
-    ThrStatLink & link = this->hdr.stat_link[ i ];
+  for ( j = 0; j < this->max_stat_count(); j++ ) {
+    i = HashTab::stat_id( j );
+    ThrStatLink & link = this->get_stat_link( i );
     if ( link.used == 1 && link.db_num == db )
-      tot += this->stats[ i ];
+      tot += this->get_stats( i );
   }
   /* unlock db */
   this->hdr.ht_spin_unlock( db );
@@ -248,10 +250,11 @@ HashTab::update_load( void ) noexcept
     total_drop += db[ i ].drop;
   }
 
-  for ( i = 0; i < MAX_STAT_ID; i++ ) {
-    if ( this->hdr.stat_link[ i ].used ) {
-      total_add  += this->stats[ i ].add;
-      total_drop += this->stats[ i ].drop;
+  for ( uint32_t j = 0; j < this->max_stat_count(); j++ ) {
+    uint32_t k = HashTab::stat_id( j );
+    if ( this->get_stat_link( k ).used ) {
+      total_add  += this->get_stats( k ).add;
+      total_drop += this->get_stats( k ).drop;
     }
   }
   /* unlock dbs */
@@ -317,10 +320,10 @@ HashTabStats::fetch( void ) noexcept
   for ( i = 0; i < DB_COUNT; i++ )
     db[ i ] = this->ht.hdr.db_stat[ i ];
   /* still mutating the stat_link[] are the active contexts */
-  for ( i = 0; i < MAX_STAT_ID; i++ ) {
-    ThrStatLink & link = this->ht.hdr.stat_link[ i ];
+  for ( uint32_t j = 0; j < this->ht.max_stat_count(); j++ ) {
+    ThrStatLink & link = this->ht.get_stat_link( HashTab::stat_id( j ) );
     if ( link.used == 1 )
-      db[ link.db_num ] += this->ht.stats[ i ];
+      db[ link.db_num ] += this->ht.get_stats( HashTab::stat_id( j ) );
   }
   /* unlock dbs */
   for ( i = 0; i < DB_COUNT; i += 64 )
@@ -13,7 +13,7 @@ using namespace kv;
 /* KeyFragment b is usually null */
 KeyCtx::KeyCtx( HashTab &t,  uint32_t xid,  KeyFragment *b ) noexcept
   : ht( t )
-  , ctx_id( t.hdr.stat_link[ xid ].ctx_id )
+  , ctx_id( t.get_stat_link( xid ).ctx_id )
   , dbx_id( xid )
   , kbuf( b )
   , ht_size( t.hdr.ht_size )
@@ -21,12 +21,12 @@ KeyCtx::KeyCtx( HashTab &t,  uint32_t xid,  KeyFragment *b ) noexcept
   , cuckoo_buckets( t.hdr.cuckoo_buckets )
   , cuckoo_arity( t.hdr.cuckoo_arity )
   , seg_align_shift( t.hdr.seg_align_shift )
-  , db_num( t.hdr.stat_link[ xid ].db_num )
+  , db_num( t.get_stat_link( xid ).db_num )
   , inc( 0 )
   , msg_chain_size( 0 )
   , drop_flags( 0 )
   , flags( KEYCTX_IS_READ_ONLY | t.hdr.ht_read_only )
-  , stat( t.stats[ xid ] )
+  , stat( t.get_stats( xid ) )
   , max_chains( t.hdr.ht_size )
 {
   this->zero();
@@ -50,7 +50,7 @@ KeyCtx::KeyCtx( HashTab &t, uint32_t cid,  uint32_t xid,  uint8_t dbn,
   , flags( KEYCTX_IS_READ_ONLY )
   , entry( 0 )
   , msg( 0 )
-  , stat( t.stats[ xid ] )
+  , stat( t.get_stats( xid ) )
   , max_chains( t.hdr.ht_size )
 {
   this->zero();
@@ -90,7 +90,7 @@ void
 KeyCtx::set_hash( uint64_t k,  uint64_t k2 ) noexcept
 {
   this->key   = k;
-  this->key2  = k2;
+  this->key2  = k2 & HashEntry::hash2_mask( this->hash_entry_size );
   this->start = this->ht.hdr.ht_mod( k );
 }
 
@@ -101,6 +101,7 @@ KeyCtx::set_key_hash( KeyFragment &b ) noexcept
   this->ht.hdr.get_hash_seed( this->db_num, hs );
   this->set_key( b );
   hs.hash( b, this->key, this->key2 );
+  this->key2 &= HashEntry::hash2_mask( this->hash_entry_size );
   this->start = this->ht.hdr.ht_mod( this->key );
 }
 
@@ -131,12 +132,15 @@ KeyCtx::acquire( void ) noexcept
     switch ( this->test( KEYCTX_IS_SINGLE_THREAD | KEYCTX_MULTI_KEY_ACQUIRE |
                          KEYCTX_EVICT_ACQUIRE | KEYCTX_HT_READ_ONLY ) ) {
       case 0:
-        return this->acquire_linear_probe( this->key, this->start );
+        status = this->acquire_linear_probe( this->key, this->start );
+        break;
       case KEYCTX_MULTI_KEY_ACQUIRE:
-        return this->multi_acquire_linear_probe( this->key, this->start );
+        status = this->multi_acquire_linear_probe( this->key, this->start );
+        break;
       case KEYCTX_IS_SINGLE_THREAD: /* single thread version */
-        return this->acquire_linear_probe_single_thread( this->key,
-                                                         this->start );
+        status = this->acquire_linear_probe_single_thread( this->key,
+                                                           this->start );
+        break;
       default:
         return KEY_HT_FULL;
       case KEYCTX_EVICT_ACQUIRE:
@@ -148,11 +152,14 @@ KeyCtx::acquire( void ) noexcept
     switch ( this->test( KEYCTX_IS_SINGLE_THREAD | KEYCTX_MULTI_KEY_ACQUIRE |
                          KEYCTX_EVICT_ACQUIRE | KEYCTX_HT_READ_ONLY ) ) {
       case 0:
-        return this->acquire_cuckoo( this->key, this->start );
+        status = this->acquire_cuckoo( this->key, this->start );
+        break;
       case KEYCTX_MULTI_KEY_ACQUIRE:
-        return this->multi_acquire_cuckoo( this->key, this->start );
+        status = this->multi_acquire_cuckoo( this->key, this->start );
+        break;
       case KEYCTX_IS_SINGLE_THREAD: /* single thread version */
-        return this->acquire_cuckoo_single_thread( this->key, this->start );
+        status = this->acquire_cuckoo_single_thread( this->key, this->start );
+        break;
       default:
         return KEY_HT_FULL;
       case KEYCTX_EVICT_ACQUIRE:
@@ -177,6 +184,15 @@ KeyCtx::acquire( void ) noexcept
       this->key  = k;
       this->key2 = k2;
     }
+    /* make room for the new entry, evicting others of the same db */
+    else if kv_unlikely( this->ht.hdr.db_quota[ this->db_num ].max_entries
+                         != 0 ) {
+      if ( ! this->evict_db_quota( 0 ) ) {
+        this->incr_afail();
+        this->release();
+        return KEY_HT_FULL;
+      }
+    }
   }
   return status;
 }
@@ -227,12 +243,13 @@ KeyCtx::tombstone( void ) noexcept
   this->entry->clear( FL_EXPIRE_STAMP | FL_UPDATE_STAMP |
                       FL_SEQNO | FL_MSG_LIST );
   if ( this->lock != 0 ) { /* if it's not new */
+    this->ht.hdr.db_quota[ this->entry->db ].decr_entries();
     if ( this->entry->db == this->db_num )
       this->incr_drop();
     else {
       uint32_t id = this->ht.attach_db( this->ctx_id, this->entry->db );
       if ( id != KV_NO_DBSTAT_ID )
-        this->ht.stats[ id ].drop++;
+        this->ht.get_stats( id ).drop++;
     }
     this->drop_key   = this->lock;
     this->drop_key2  = this->key2;
@@ -254,6 +271,7 @@ KeyCtx::expire( void ) noexcept
   this->entry->clear( FL_EXPIRE_STAMP | FL_UPDATE_STAMP |
                       FL_SEQNO | FL_MSG_LIST );
   if ( this->lock != 0 ) {
+    this->ht.hdr.db_quota[ this->entry->db ].decr_entries();
     if ( this->entry->db == this->db_num ) {
       this->incr_drop();
       this->incr_expire();
@@ -261,8 +279,8 @@ KeyCtx::expire( void ) noexcept
     else {
       uint32_t id = this->ht.attach_db( this->ctx_id, this->entry->db );
       if ( id != KV_NO_DBSTAT_ID ) {
-        this->ht.stats[ id ].drop++;
-        this->ht.stats[ id ].expire++;
+        this->ht.get_stats( id ).drop++;
+        this->ht.get_stats( id ).expire++;
       }
     }
     this->drop_key   = this->lock;
@@ -273,6 +291,62 @@ KeyCtx::expire( void ) noexcept
   return KEY_OK;
 }
 
+/* scan ht[] like a clock hand, tombstone the entries of the db which are
+ * not locked until it is under quota, the oldest positions are swept first;
+ * when a limit was lowered, two entries are evicted for each new one, the
+ * scan is longer when the entries of the db are sparse in ht[], up to
+ * KV_QUOTA_EVICT_SCAN_MAX, the next scan continues at evict_pos */
+bool
+KeyCtx::evict_db_quota( uint64_t need_bytes ) noexcept
+{
+  DBQuota & q     = this->ht.hdr.db_quota[ this->db_num ];
+  KeyCtx    ev( *this );
+  uint64_t  i     = q.evict_pos,
+            scan  = KV_QUOTA_EVICT_SCAN;
+  uint32_t  count = 0;
+  bool      b     = false;
+
+  if ( q.max_entries != 0 && this->ht_size / q.max_entries * 8 > scan )
+    scan = this->ht_size / q.max_entries * 8;
+  if ( scan > KV_QUOTA_EVICT_SCAN_MAX )
+    scan = KV_QUOTA_EVICT_SCAN_MAX;
+  if ( scan > this->ht_size )
+    scan = this->ht_size;
+  for ( uint64_t cnt = 0; cnt < scan; cnt++ ) {
+    if ( need_bytes == 0 ? ( ! q.over_entries( 1 ) || count > 1 ) :
+                           ! q.over_bytes( need_bytes ) ) {
+      b = true;
+      break;
+    }
+    if ( ++i >= this->ht_size )
+      i = 0;
+    if ( this->entry != NULL && i == this->pos )
+      continue;
+    /* check without locking first */
+    HashEntry &el = *this->ht.get_entry( i, this->hash_entry_size );
+    if ( ( el.hash & ~ZOMBIE64 ) <= DROPPED_HASH || el.db != this->db_num ||
+         el.test( FL_DROPPED ) ||
+         ( need_bytes != 0 && ! el.test( FL_SEGMENT_VALUE ) ) )
+      continue;
+    KeyStatus status = ev.try_acquire_position( i );
+    if ( status == KEY_OK && el.db == this->db_num ) {
+      if ( this->evict_cb != NULL )
+        (*this->evict_cb)( (kv_key_ctx_t *) &ev, this->cl );
+      if ( ev.tombstone() == KEY_OK ) {
+        this->incr_htevict();
+        count++;
+      }
+    }
+    if ( status == KEY_OK || status == KEY_IS_NEW )
+      ev.release();
+  }
+  if ( ! b )
+    b = ( need_bytes == 0 ? ( ! q.over_entries( 1 ) || count > 0 ) :
+                            ! q.over_bytes( need_bytes ) );
+  q.evict_pos = i;
+  return b;
+}
+
 void
 KeyCtx::copy_acquire_state( const KeyCtx &kctx )
 {
@@ -392,8 +466,8 @@ KeyCtx::release( void ) noexcept
     return;
   }
   HashEntry & el   = *this->entry;
-  ThrCtx    & ctx  = this->ht.ctx[ this->ctx_id ];
-  ThrCtxOwner closure( this->ht.ctx );
+  ThrCtx    & ctx  = this->ht.get_ctx( this->ctx_id );
+  ThrCtxOwner closure( this->ht );
   uint64_t    spin = 0,
               k    = this->key;
   /* if no data was inserted, mark the entry as tombstone */
@@ -417,9 +491,10 @@ KeyCtx::release( void ) noexcept
       goto done; /* skip over the seals, they will be tossed */
     }
     this->incr_add(); /* counter for added elements */
+    this->ht.hdr.db_quota[ this->db_num ].incr_entries();
   }
   /* allow readers to access */
-  el.hash2 = this->key2;
+  el.set_hash2( this->hash_entry_size, this->key2 );
   el.set_cuckoo_inc( this->inc );
   el.seal_entry( this->hash_entry_size, this->serial, this->db_num );
   if ( el.test( FL_SEGMENT_VALUE ) )
@@ -463,9 +538,10 @@ KeyCtx::release_single_thread( void ) noexcept
       goto done; /* skip over the seals, they will be tossed */
     }
     this->incr_add(); /* counter for added elements */
+    this->ht.hdr.db_quota[ this->db_num ].incr_entries();
   }
   /* allow readers to access */
-  el.hash2 = this->key2;
+  el.set_hash2( this->hash_entry_size, this->key2 );
   el.set_cuckoo_inc( this->inc );
   el.seal_entry( this->hash_entry_size, this->serial, this->db_num );
   if ( el.test( FL_SEGMENT_VALUE ) )
@@ -596,9 +672,11 @@ KeyCtx::release_data( void ) noexcept
               if ( tmp->check_seal( this->key, this->key2, mchain.serial,
                                      (uint32_t) mchain.size, tmp_size ) ) {
                 Segment &seg = this->ht.segment( mchain.segment );
-                tmp->release();
+                tmp->release_stamped( this->ht.hdr.pin_ctx_count,
+                                      this->ht.hdr.read_epoch );
                 seg.msg_count -= 1;
                 seg.avail_size += mchain.size;
+                this->ht.hdr.db_quota[ el.db ].decr_bytes( mchain.size );
               }
             }
           }
@@ -606,15 +684,17 @@ KeyCtx::release_data( void ) noexcept
       }
       /* release segment data */
       Segment &seg = this->ht.segment( this->geom.segment );
-      this->msg->release();
+      this->msg->release_stamped( this->ht.hdr.pin_ctx_count,
+                                  this->ht.hdr.read_epoch );
       this->msg = NULL;
       this->msg_chain_size = 0;
       /* clear hash entry geometry */
       el.clear( FL_SEGMENT_VALUE );
-      el.value_ptr( this->hash_entry_size ).zero();
+      el.zero_value_geom( this->hash_entry_size );
       el.value_ctr( this->hash_entry_size ).size = 0;
       seg.msg_count  -= 1;
       seg.avail_size += this->geom.size;
+      this->ht.hdr.db_quota[ el.db ].decr_bytes( this->geom.size );
       break;
     }
     case FL_IMMEDIATE_VALUE: {
@@ -648,7 +728,7 @@ KeyCtx::release_evict( void )
       Segment &seg = this->ht.segment( this->geom.segment );
       tmp->release();
       this->drop_flags &= ~FL_SEGMENT_VALUE;
-      el.value_ptr( this->hash_entry_size ).zero();
+      el.zero_value_geom( this->hash_entry_size );
       el.value_ctr( this->hash_entry_size ).size = 0;
       seg.msg_count  -= 1;
       seg.avail_size += this->geom.size;
@@ -719,8 +799,9 @@ KeyCtx::update_entry( void *res,  uint64_t size,  HashEntry &el ) noexcept
       el.set( FL_IMMEDIATE_KEY | FL_UPDATED );
     }
     else {
-      /* only part of the key fits */
-      if ( el.test( FL_PART_KEY ) == 0 )
+      /* only part of the key fits, compact entry uses keylen for value */
+      if ( el.test( FL_PART_KEY ) == 0 &&
+           ! HashEntry::is_compact( this->hash_entry_size ) )
         el.key.keylen = kb.keylen;
       el.clear( FL_IMMEDIATE_VALUE | FL_IMMEDIATE_KEY | FL_DROPPED );
       el.set( FL_PART_KEY | FL_UPDATED );
@@ -735,7 +816,8 @@ KeyCtx::update_entry( void *res,  uint64_t size,  HashEntry &el ) noexcept
     return KEY_ALLOC_FAILED;
   }
   /* only part of the key fits */
-  if ( el.test( FL_PART_KEY ) == 0 )
+  if ( el.test( FL_PART_KEY ) == 0 &&
+       ! HashEntry::is_compact( this->hash_entry_size ) )
     el.key.keylen = kb.keylen;
   el.clear( FL_IMMEDIATE_KEY | FL_DROPPED );
   el.set( FL_PART_KEY | FL_IMMEDIATE_VALUE | FL_UPDATED );
@@ -791,12 +873,26 @@ KeyCtx::alloc( void *res,  uint64_t size,  bool copy ) noexcept
   status = this->update_entry( res, size, el );
 
   if ( status == KEY_SEG_VALUE ) {
+    bool quota_ok = true;
+    /* make room in the db quota, alloc_segment() enforces it */
+    if kv_unlikely( this->ht.hdr.db_quota[ this->db_num ].max_bytes != 0 ) {
+      uint64_t need = MsgHdr::alloc_size(
+        (uint32_t) MsgHdr::hdr_size( *this->kbuf ), size, this->seg_align(),
+        this->msg_chain_size );
+      if ( this->ht.hdr.db_quota[ this->db_num ].over_bytes( need ) )
+        quota_ok = this->evict_db_quota( need );
+    }
     /* allocate mem from a segment */
     MsgCtx msg_ctx( *this );
     msg_ctx.set_key( *this->kbuf );
     msg_ctx.set_hash( this->key, this->key2 );
-    if ( (status = msg_ctx.alloc_segment( res, size,
-                                          this->msg_chain_size )) == KEY_OK ) {
+    if ( ! quota_ok ) { /* not enough of the db evicted in one scan */
+      status = KEY_ALLOC_FAILED;
+      this->incr_afail();
+    }
+    else if ( (status = msg_ctx.alloc_segment( res, size,
+                                               this->msg_chain_size ))
+              == KEY_OK ) {
       el.set( FL_SEGMENT_VALUE );
       msg_ctx.geom.serial = this->serial;
       this->geom = msg_ctx.geom;
@@ -833,10 +929,12 @@ KeyCtx::alloc( void *res,  uint64_t size,  bool copy ) noexcept
     if ( cp.msg != NULL ) {
       /* release segment data */
       Segment &seg = this->ht.segment( cp.geom.segment );
-      cp.msg->release();
+      cp.msg->release_stamped( this->ht.hdr.pin_ctx_count,
+                               this->ht.hdr.read_epoch );
       /* clear hash entry geometry */
       seg.msg_count  -= 1;
       seg.avail_size += cp.geom.size;
+      this->ht.hdr.db_quota[ el.db ].decr_bytes( cp.geom.size );
     }
   }
   return status;
@@ -857,8 +955,8 @@ KeyCtx::load( MsgCtx &msg_ctx ) noexcept
   el.set( FL_SEGMENT_VALUE );
   el.clear( FL_CLOCK );
   this->next_serial( ValueCtr::SERIAL_MASK );
-  msg_ctx.geom.serial = el.value_ptr( this->hash_entry_size ).
-                         set_serial( this->serial );
+  msg_ctx.geom.serial = el.set_value_serial( this->hash_entry_size,
+                                             this->serial );
   el.set_value_geom( this->hash_entry_size, msg_ctx.geom,
                      this->seg_align_shift );
   el.value_ctr( this->hash_entry_size ).size = 0;
@@ -889,7 +987,7 @@ KeyCtx::add_msg_chain( MsgCtx &msg_ctx ) noexcept
     this->geom.zero();
     this->msg = NULL;
     el.clear( FL_SEGMENT_VALUE );
-    el.value_ptr( this->hash_entry_size ).zero();
+    el.zero_value_geom( this->hash_entry_size );
     el.value_ctr( this->hash_entry_size ).size = 0;
   }
   this->update_entry( NULL, 0, el );
@@ -936,10 +1034,12 @@ KeyCtx::resize( void *res,  uint64_t size,  bool copy ) noexcept
       uint64_t hdr_size   = MsgHdr::hdr_size( this->msg->key );
       uint64_t alloc_size = MsgHdr::alloc_size( (uint32_t) hdr_size, size,
                                                 this->seg_align() );
-      if ( alloc_size == this->msg->size ) {
+      /* pinned readers keep the old copy, don't overwrite it */
+      if ( alloc_size == this->msg->size &&
+           this->ht.hdr.pin_ctx_count == 0 ) {
         this->next_serial( ValueCtr::SERIAL_MASK );
-        this->geom.serial = el.value_ptr( this->hash_entry_size ).
-                               set_serial( this->serial );
+        this->geom.serial = el.set_value_serial( this->hash_entry_size,
+                                                 this->serial );
         this->msg->msg_size = (uint32_t) size;
         *(void **) res = this->msg->ptr( (uint32_t) hdr_size );
         return KEY_OK;
@@ -955,6 +1055,18 @@ KeyCtx::resize( void *res,  uint64_t size,  bool copy ) noexcept
   return status;
 }
 
+void
+KeyCtx::pin_read( void ) noexcept
+{
+  this->ht.pin_read( this->ctx_id );
+}
+
+void
+KeyCtx::unpin_read( void ) noexcept
+{
+  this->ht.unpin_read( this->ctx_id );
+}
+
 /* get the value associated with the key */
 KeyStatus
 KeyCtx::value( void *data,  uint64_t &size ) noexcept
@@ -1025,8 +1137,8 @@ KeyCtx::value_update( void *data,  uint64_t &size ) noexcept
            ( (mstatus = this->attach_msg( ATTACH_WRITE )) != KEY_OK ) )
         return mstatus;
       this->next_serial( ValueCtr::SERIAL_MASK );
-      this->geom.serial = el.value_ptr( this->hash_entry_size ).
-                             set_serial( this->serial );
+      this->geom.serial = el.set_value_serial( this->hash_entry_size,
+                                               this->serial );
       /* fetch the sizes before testing is_msg_valid() */
       uint64_t hdr_size = this->msg->hdr_size();
       size = this->msg->msg_size;
@@ -1102,7 +1214,7 @@ KeyCtx::value_copy( void *data,  uint64_t &size,  void *cp,
 /* append a vector of size[ i ] elements: vec[ i ] -> msg @ size[ i ] */
 KeyStatus
 KeyCtx::append_vector( uint64_t count,  void *vec,  msg_size_t *size,
-                       uint64_t max_size ) noexcept
+                       uint64_t max_size,  bool is_trimmed ) noexcept
 {
   if ( this->test( KEYCTX_IS_READ_ONLY ) )
     return KEY_WRITE_ILLEGAL;
@@ -1170,8 +1282,8 @@ KeyCtx::append_vector( uint64_t count,  void *vec,  msg_size_t *size,
                                                 this->msg_chain_size );
       if ( alloc_size == this->msg->size ) {
         this->more_serial( count, ValueCtr::SERIAL_MASK );
-        this->geom.serial = el.value_ptr( this->hash_entry_size ).
-                               set_serial( this->serial );
+        this->geom.serial = el.set_value_serial( this->hash_entry_size,
+                                                 this->serial );
         /*this->msg->msg_size = msg_size;*/
         buf = (uint8_t *) this->msg->ptr( (uint32_t) ( hdr_size + msg_off ) );
         goto copy_vector;
@@ -1179,8 +1291,16 @@ KeyCtx::append_vector( uint64_t count,  void *vec,  msg_size_t *size,
       /* split into chains at 16k, 2x32k, 4x64, 8x128... (total 384M) */
       if ( this->msg_chain_size < 0xff ) {
         if ( max_size != 0 ) {
-          if ( this->msg_chain_size > 2 ) /* no more than 2 * max_size */
-            return KEY_MSG_LIST_FULL;
+          if ( this->msg_chain_size > 2 ) { /* no more than 2 * max_size */
+            if ( ! is_trimmed )
+              return KEY_MSG_LIST_FULL;
+            /* unless the oldest were trimmed, the trimmed chains are at the
+             * end and are not copied to the next */
+            ValueGeom mchain;
+            this->msg->get_next( 2, mchain, this->seg_align_shift );
+            if ( mchain.size != 0 )
+              return KEY_MSG_LIST_FULL;
+          }
         }
         else {
           next_size += 16 * 1024;
@@ -1197,8 +1317,8 @@ KeyCtx::append_vector( uint64_t count,  void *vec,  msg_size_t *size,
                                      this->msg_chain_size + 1 )) == KEY_OK ) {
           this->add_msg_chain( mctx );
           this->more_serial( count, ValueCtr::SERIAL_MASK );
-          this->geom.serial = el.value_ptr( this->hash_entry_size ).
-                                 set_serial( this->serial );
+          this->geom.serial = el.set_value_serial( this->hash_entry_size,
+                                                   this->serial );
           /*this->msg->msg_size = msg_size;*/
           buf = (uint8_t *) this->msg->ptr( (uint32_t) hdr_size );
           goto copy_vector;
@@ -1331,9 +1451,12 @@ MsgIter::trim_old_chains( void ) noexcept
            tmp->check_seal( this->kctx.key, this->kctx.key2, mchain.serial,
                             (uint32_t) mchain.size, tmp_size ) ) {
         Segment &seg = this->kctx.ht.segment( mchain.segment );
-        tmp->release();
+        tmp->release_stamped( this->kctx.ht.hdr.pin_ctx_count,
+                              this->kctx.ht.hdr.read_epoch );
         seg.msg_count -= 1;
         seg.avail_size += mchain.size;
+        this->kctx.ht.hdr.db_quota[ this->kctx.entry->db ].decr_bytes(
+          mchain.size );
       }
       mchain.size = 0;
       this->kctx.msg->set_next( (uint8_t) i, mchain, this->kctx.seg_align_shift );
@@ -1429,8 +1552,9 @@ KeyCtx::trim_msg( uint64_t new_seqno ) noexcept
     new_seqno = iter.seqno;
     iter.trim_old_chains(); /* some msgs in list used */
   }
-  if ( el.test( FL_SEQNO ) == 0 )
-    this->reorganize_entry( el, FL_SEQNO );
+  if ( el.test( FL_SEQNO ) == 0 &&
+       (status = this->reorganize_entry( el, FL_SEQNO )) != KEY_OK )
+    return status;
   el.seqno( this->hash_entry_size ) = new_seqno;
   return KEY_OK;
 }
@@ -1447,7 +1571,9 @@ KeyCtx::update_stamps( uint64_t exp_ns,  uint64_t upd_ns ) noexcept
     uint32_t fl = 0;
     if ( exp_ns != 0 ) fl |= FL_EXPIRE_STAMP;
     if ( upd_ns != 0 ) fl |= FL_UPDATE_STAMP;
-    this->reorganize_entry( el, fl );
+    KeyStatus status = this->reorganize_entry( el, fl );
+    if ( status != KEY_OK )
+      return status;
   }
   RelativeStamp & rela = el.rela_stamp( this->hash_entry_size );
   /* insert stamps that are not zero */
@@ -1484,6 +1610,9 @@ KeyCtx::update_stamps( uint64_t exp_ns,  uint64_t upd_ns ) noexcept
 KeyStatus
 KeyCtx::reorganize_entry( HashEntry &el,  uint32_t new_fl ) noexcept
 {
+  /* no room for the seqno or stamps trailers in a compact entry */
+  if ( HashEntry::is_compact( this->hash_entry_size ) )
+    return KEY_ALLOC_FAILED;
   HashEntry *cpy = (HashEntry *) this->copy_data( &el, this->hash_entry_size );
   if ( cpy == NULL )
     return KEY_ALLOC_FAILED;
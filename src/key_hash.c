@@ -1116,8 +1116,7 @@ static const uint8_t ALIGN_ARR( MeowS3Init[] ) =
  * the Len8 is size & 7,
  * the Len128 is size & 0x30, which is ( 32 | 16 ) */
 static inline __m128i
-Meow_AESDECx2_Partial( __m128i R, const uint8_t *S, uint32_t Len8,
-                       uint32_t Len128 )
+Meow_Load_Partial( const uint8_t *S, uint32_t Len8, uint32_t Len128 )
 {
   __m128i         Partial;
   const uint8_t * Overhang = S + Len128;
@@ -1143,7 +1142,14 @@ Meow_AESDECx2_Partial( __m128i R, const uint8_t *S, uint32_t Len8,
       _mm_and_si128( *(__m128i *) Overhang,
         _mm_loadu_si128( (__m128i *) &MeowMaskLen[ 16 - Len8 ] ) );
   }
-  return Meow_AESDECx2( R, Partial );
+  return Partial;
+}
+
+static inline __m128i
+Meow_AESDECx2_Partial( __m128i R, const uint8_t *S, uint32_t Len8,
+                       uint32_t Len128 )
+{
+  return Meow_AESDECx2( R, Meow_Load_Partial( S, Len8, Len128 ) );
 }
 
 #define Declare_Meow( S0, S1, S2, S3 ) \
@@ -2019,5 +2025,181 @@ kv_hash_meow128_8_same_length( const void *p, const void *p2, const void *p3,
   x[15 ] = _mm_extract_epi64( S28, 1 );
 }
 
+#if defined( __VAES__ ) && defined( __AVX2__ )
+/* VAES packs two keys in each ymm reg, key i in the low lane and key i+N/2
+ * in the high lane; lanes with different lengths are updated under a mask */
+static inline __m256i
+Meow_AESDECx2_256( __m256i R, __m256i S )
+{
+  R = _mm256_aesdec_epi128( R, S );
+  R = _mm256_aesdec_epi128( R, S );
+  return R;
+}
+
+static inline __m256i
+Meow_AESDECx2_256_Mask( __m256i R, __m128i Lo, __m128i Hi, int a, int b )
+{
+  __m256i Q    = _mm256_set_m128i( Hi, Lo ),
+          Mask = _mm256_set_epi64x( -(int64_t) b, -(int64_t) b,
+                                    -(int64_t) a, -(int64_t) a );
+  return _mm256_blendv_epi8( R, Meow_AESDECx2_256( R, Q ), Mask );
+}
+
+static inline __m128i
+Meow_Load_Lane( int on, const uint8_t *S )
+{
+  return on ? _mm_loadu_si128( (__m128i *) S ) : _mm_setzero_si128();
+}
+
+static inline void
+Meow_N_Diff_Length_256( const void **p, const size_t *sz, uint64_t k1,
+                        uint64_t k2, uint64_t *x, const size_t N )
+{
+  const size_t    H = N / 2;
+  __m256i         S[ 4 ][ 4 ],
+                  Mixer[ 4 ];
+  const uint8_t * Source[ 8 ];
+  size_t          Len[ 8 ],
+                  i, j;
+  int             active;
+
+  for ( i = 0; i < N; i++ ) {
+    Source[ i ] = (const uint8_t *) p[ i ];
+    Len[ i ]    = sz[ i ];
+  }
+  for ( i = 0; i < H; i++ ) {
+    Mixer[ i ] = _mm256_set_epi64x( k2 + sz[ i + H ] + 1, k1 - sz[ i + H ],
+                                    k2 + sz[ i ] + 1, k1 - sz[ i ] );
+    S[ i ][ 0 ] = _mm256_xor_si256( Mixer[ i ],
+                  _mm256_broadcastsi128_si256( *(__m128i *) MeowS0Init ) );
+    S[ i ][ 1 ] = _mm256_xor_si256( Mixer[ i ],
+                  _mm256_broadcastsi128_si256( *(__m128i *) MeowS1Init ) );
+    S[ i ][ 2 ] = _mm256_xor_si256( Mixer[ i ],
+                  _mm256_broadcastsi128_si256( *(__m128i *) MeowS2Init ) );
+    S[ i ][ 3 ] = _mm256_xor_si256( Mixer[ i ],
+                  _mm256_broadcastsi128_si256( *(__m128i *) MeowS3Init ) );
+  }
+  do {
+    active = 0;
+    for ( i = 0; i < H; i++ ) {
+      const int a = ( Len[ i ] >= 64 ),
+                b = ( Len[ i + H ] >= 64 );
+      if ( a | b ) {
+        for ( j = 0; j < 4; j++ )
+          S[ i ][ j ] = Meow_AESDECx2_256_Mask( S[ i ][ j ],
+                          Meow_Load_Lane( a, Source[ i ] + j * 16 ),
+                          Meow_Load_Lane( b, Source[ i + H ] + j * 16 ), a, b );
+        if ( a ) { Len[ i ] -= 64; Source[ i ] += 64; }
+        if ( b ) { Len[ i + H ] -= 64; Source[ i + H ] += 64; }
+        active = 1;
+      }
+    }
+  } while ( active );
+
+  for ( i = 0; i < H; i++ ) {
+    const uint32_t Len8    = (uint32_t) sz[ i ] & 15,
+                   Len128  = (uint32_t) sz[ i ] & 48,
+                   Len8b   = (uint32_t) sz[ i + H ] & 15,
+                   Len128b = (uint32_t) sz[ i + H ] & 48;
+    if ( ( Len8 | Len8b ) != 0 ) {
+      __m128i Lo = _mm_setzero_si128(),
+              Hi = _mm_setzero_si128();
+      if ( Len8 != 0 )
+        Lo = Meow_Load_Partial( Source[ i ], Len8, Len128 );
+      if ( Len8b != 0 )
+        Hi = Meow_Load_Partial( Source[ i + H ], Len8b, Len128b );
+      S[ i ][ 3 ] = Meow_AESDECx2_256_Mask( S[ i ][ 3 ], Lo, Hi,
+                                            Len8 != 0, Len8b != 0 );
+    }
+    /* S2 if Len128 == 48, S1 if Len128 >= 32, S0 if Len128 >= 16 */
+    for ( j = 0; j < 3; j++ ) {
+      const int a = ( Len128 >= ( j + 1 ) * 16 ),
+                b = ( Len128b >= ( j + 1 ) * 16 );
+      if ( a | b )
+        S[ i ][ j ] = Meow_AESDECx2_256_Mask( S[ i ][ j ],
+                        Meow_Load_Lane( a, Source[ i ] + j * 16 ),
+                        Meow_Load_Lane( b, Source[ i + H ] + j * 16 ), a, b );
+    }
+  }
+  for ( i = 0; i < H; i++ ) { /* Mix_Meow, Compress_Meow2, Compress_Meow */
+    S[ i ][ 3 ] = _mm256_aesdec_epi128( S[ i ][ 3 ], Mixer[ i ] );
+    S[ i ][ 2 ] = _mm256_aesdec_epi128( S[ i ][ 2 ], Mixer[ i ] );
+    S[ i ][ 1 ] = _mm256_aesdec_epi128( S[ i ][ 1 ], Mixer[ i ] );
+    S[ i ][ 0 ] = _mm256_aesdec_epi128( S[ i ][ 0 ], Mixer[ i ] );
+  }
+  for ( i = 0; i < H; i++ ) {
+    S[ i ][ 2 ] = _mm256_aesdec_epi128( S[ i ][ 2 ], S[ i ][ 3 ] );
+    S[ i ][ 0 ] = _mm256_aesdec_epi128( S[ i ][ 0 ], S[ i ][ 1 ] );
+    S[ i ][ 2 ] = _mm256_aesdec_epi128( S[ i ][ 2 ], Mixer[ i ] );
+  }
+  for ( i = 0; i < H; i++ ) {
+    S[ i ][ 0 ] = _mm256_aesdec_epi128( S[ i ][ 0 ], S[ i ][ 2 ] );
+    S[ i ][ 0 ] = _mm256_aesdec_epi128( S[ i ][ 0 ], Mixer[ i ] );
+  }
+  for ( i = 0; i < H; i++ ) {
+    __m128i Lo = _mm256_castsi256_si128( S[ i ][ 0 ] ),
+            Hi = _mm256_extracti128_si256( S[ i ][ 0 ], 1 );
+    x[ i * 2 ]             = _mm_extract_epi64( Lo, 0 );
+    x[ i * 2 + 1 ]         = _mm_extract_epi64( Lo, 1 );
+    x[ ( i + H ) * 2 ]     = _mm_extract_epi64( Hi, 0 );
+    x[ ( i + H ) * 2 + 1 ] = _mm_extract_epi64( Hi, 1 );
+  }
+}
+#define Meow_N_Diff_Length_Wide Meow_N_Diff_Length_256
+#else
+/* without VAES, 4 keys * 4 states are interleaved in xmm regs */
+static inline void
+Meow_N_Diff_Length_Wide( const void **p, const size_t *sz, uint64_t k1,
+                         uint64_t k2, uint64_t *x, const size_t N )
+{
+  size_t i;
+  for ( i = 0; i < N; i += 4 ) {
+    x[ i * 2 ] = k1; x[ i * 2 + 1 ] = k2;
+    kv_hash_meow128_4_diff_length( p[ i ], sz[ i ], p[ i + 1 ], sz[ i + 1 ],
+                                   p[ i + 2 ], sz[ i + 2 ],
+                                   p[ i + 3 ], sz[ i + 3 ], &x[ i * 2 ] );
+  }
+}
+#endif
+
+void
+kv_hash_meow128_4_diff_length_a( const void **p, const size_t *sz,
+                                 uint64_t *x )
+{
+  Meow_N_Diff_Length_Wide( p, sz, x[ 0 ], x[ 1 ], x, 4 );
+}
+
+void
+kv_hash_meow128_8_diff_length_a( const void **p, const size_t *sz,
+                                 uint64_t *x )
+{
+  Meow_N_Diff_Length_Wide( p, sz, x[ 0 ], x[ 1 ], x, 8 );
+}
+
+void
+kv_hash_meow128_array( const void **p, const size_t *sz, uint64_t *x,
+                       size_t count )
+{
+  const uint64_t k1 = x[ 0 ], k2 = x[ 1 ];
+  size_t i = 0;
+
+  for ( ; i + 8 <= count; i += 8 )
+    Meow_N_Diff_Length_Wide( &p[ i ], &sz[ i ], k1, k2, &x[ i * 2 ], 8 );
+  if ( i + 4 <= count ) {
+    Meow_N_Diff_Length_Wide( &p[ i ], &sz[ i ], k1, k2, &x[ i * 2 ], 4 );
+    i += 4;
+  }
+  if ( i + 2 <= count ) {
+    x[ i * 2 ] = k1; x[ i * 2 + 1 ] = k2;
+    kv_hash_meow128_2_diff_length( p[ i ], sz[ i ], p[ i + 1 ], sz[ i + 1 ],
+                                   &x[ i * 2 ] );
+    i += 2;
+  }
+  if ( i < count ) {
+    x[ i * 2 ] = k1; x[ i * 2 + 1 ] = k2;
+    kv_hash_meow128( p[ i ], sz[ i ], &x[ i * 2 ], &x[ i * 2 + 1 ] );
+  }
+}
+
 #endif /* USE_KV_MEOW_HASH */
 
@@ -41,8 +41,10 @@ KvPubSub::KvPubSub( RoutePublish &sr,  PsCtrlFile &cf,  const char *ipc_nm,
 
 KvPubSubPeer::KvPubSubPeer( EvPoll &p,  uint8_t st,  KvPubSub &m ) noexcept
   : EvConnection( p, st ), sub_route( m.sub_route ), me( m ),
-    ctrl( m.ctrl ), bloom_rt( 0 ), time_ns( 0 ), sub_seqno( 0 ),
-    ctx_id( KVPS_CTRL_CTX_SIZE ), is_shutdown( false ), next( 0 ), back( 0 )
+    ctrl( m.ctrl ), bloom_rt( 0 ), sent_seqno( 0 ), recv_seqno( 0 ),
+    time_ns( 0 ), sub_seqno( 0 ),
+    ctx_id( KVPS_CTRL_CTX_SIZE ), is_shutdown( false ), in_process( false ),
+    next( 0 ), back( 0 )
 {
 }
 
@@ -306,25 +308,39 @@ KvPubSub::send_hello( KvPubSubPeer &c ) noexcept
         continue;
       BloomCodec code;
       ref->encode( code );
-      size_t len = ::strlen( ref->name ) + 1;
-
-      KvEst e;
-      e.name( len )
-       .ref_num()
-       .data( code.code_sz * 4 );
-
-      KvMsg &m = *(new ( c.alloc_temp( e.len() ) ) KvMsg( KV_MSG_BLOOM ) );
-      m.name( ref->name, len )
-       .ref_num( ref->ref_num )
-       .data( code.ptr, code.code_sz * 4 );
-
-      c.append_iov( (void *) m.msg(), m.len() );
-      c.msgs_sent++;
+      this->send_bloom( c, *ref, code,
+                        ref->delta != NULL ? ref->delta_seqno() : 0 );
     }
   }
   c.idle_push_write();
 }
 
+void
+KvPubSub::send_bloom( KvPubSubPeer &c,  BloomRef &ref,  BloomCodec &code,
+                      uint64_t seqno ) noexcept
+{
+  size_t len = ::strlen( ref.name ) + 1;
+
+  KvEst e;
+  e.name( len )
+   .ref_num()
+   .data( code.code_sz * 4 );
+  if ( seqno != 0 )
+    e.bloom_seqno();
+
+  KvMsg &m = *(new ( c.alloc_temp( e.len() ) ) KvMsg( KV_MSG_BLOOM ) );
+  m.name( ref.name, len )
+   .ref_num( ref.ref_num )
+   .data( code.ptr, code.code_sz * 4 );
+  /* the seqno that deltas follow */
+  if ( seqno != 0 ) {
+    m.bloom_seqno( seqno );
+    c.set_bloom_seqno( c.sent_seqno, ref.ref_num, seqno );
+  }
+  c.append_iov( (void *) m.msg(), m.len() );
+  c.msgs_sent++;
+}
+
 void
 KvPubSub::bcast_msg( KvMsg &m ) noexcept
 {
@@ -434,7 +450,9 @@ KvMsgIn::decode( const char *msg,  uint32_t msglen ) noexcept
 bool
 KvPubSubPeer::on_msg( EvPublish &pub ) noexcept
 {
-  if ( pub.is_pub_type( PUB_TYPE_KV ) )
+  /* the source thread forwarded bus pubs, the bus routes to this process */
+  if ( pub.is_pub_type( PUB_TYPE_KV ) || pub.is_pub_type( PUB_TYPE_BUS ) ||
+       ( this->in_process && this->sub_route.bus != NULL ) )
     return true;
   KvEst e;
   e.subject    ( pub.subject_len )
@@ -444,15 +462,32 @@ KvPubSubPeer::on_msg( EvPublish &pub ) noexcept
    .pub_status ()
    .data       ( pub.msg_len );
 
-  KvMsg &m = *(new ( this->alloc_temp( e.len() ) ) KvMsg( KV_MSG_FWD ));
+  uint32_t ref_idx = 0;
+  size_t   len     = e.len();
+  /* reference the data in the publisher recv buffer or the pool buffer
+   * shared with the other peers instead of copying */
+  if ( pub.msg_len >= KV_ZERO_COPY_MIN_SIZE ) {
+    ref_idx = this->poll.zero_copy_pub( pub );
+    if ( ref_idx != 0 )
+      len -= pub.msg_len;
+  }
+  KvMsg &m = *(new ( this->alloc_temp( len ) ) KvMsg( KV_MSG_FWD ));
   m.subject  ( pub.subject, pub.subject_len )
    .reply    ( pub.reply, pub.reply_len )
    .subj_hash( pub.subj_hash )
    .msg_enc  ( pub.msg_enc );
   if ( pub.pub_status != 0 )
     m.pub_status( pub.pub_status );
-  m.data     ( pub.msg, pub.msg_len );
-  this->append_iov( (void *) m.msg(), m.len() );
+  if ( ref_idx != 0 ) {
+    m.data_ref ( pub.msg_len );
+    /* the estimate counts pub_status, which may not be used */
+    this->append_iov( (void *) m.msg(), m.len() - pub.msg_len );
+    this->append_ref_iov( NULL, 0, pub.msg, pub.msg_len, ref_idx );
+  }
+  else {
+    m.data   ( pub.msg, pub.msg_len );
+    this->append_iov( (void *) m.msg(), m.len() );
+  }
   this->msgs_sent++;
   return this->idle_push_write();
 }
@@ -498,7 +533,8 @@ static const struct {
   { KV_FLD_DATA,        0, 0, "data" },
   { KV_FLD_REF_NUM,     4, 1, "ref_num" },
   { KV_FLD_NAME,        0, 1, "name" },
-  { KV_FLD_PUB_STATUS,  2, 1, "pub_status" }
+  { KV_FLD_PUB_STATUS,  2, 1, "pub_status" },
+  { KV_FLD_BLOOM_SEQNO, 8, 1, "bloom_seqno" }
 };
 static const char * print_msg_name[] = kv_msg_name;
 
@@ -558,6 +594,10 @@ KvPubSubPeer::hello_msg( KvMsgIn &msg ) noexcept
 
   if ( msg.is_field_missing() )
     return;
+  if ( this->ctx_id < KVPS_CTRL_CTX_SIZE &&
+       this->me.ctx_id < KVPS_CTRL_CTX_SIZE )
+    this->in_process = ( this->ctrl.ctx[ this->ctx_id ].pid ==
+                         this->ctrl.ctx[ this->me.ctx_id ].pid );
   /*this->me.peer_set.add( this->fd );*/
   if ( kv_ps_debug )
     msg.print();
@@ -598,7 +638,70 @@ KvPubSubPeer::bloom_msg( KvMsgIn &msg ) noexcept
       this->bloom_rt = this->sub_route.create_bloom_route( this->fd, ref, 0 );
     else if ( ! ref->has_route( this->bloom_rt ) )
       this->bloom_rt->add_bloom_ref( ref );
+    if ( msg.is_set( KV_FLD_BLOOM_SEQNO ) )
+      this->set_bloom_seqno( this->recv_seqno, ref_num,
+                             msg.get<uint64_t>( KV_FLD_BLOOM_SEQNO ) );
+    else
+      this->del_bloom_seqno( this->recv_seqno, ref_num );
+  }
+}
+
+void
+KvPubSubPeer::bloom_delta_msg( KvMsgIn &msg ) noexcept
+{
+  uint32_t ref_num = msg.get<uint32_t>( KV_FLD_REF_NUM );
+  uint64_t seqno   = msg.get<uint64_t>( KV_FLD_BLOOM_SEQNO ),
+           last_seqno,
+           from_seqno;
+  uint32_t delta_len;
+  void   * delta = (void *) msg.get_field( KV_FLD_DATA, delta_len );
+
+  if ( msg.is_field_missing() )
+    return;
+  if ( kv_ps_debug )
+    msg.print();
+
+  BloomRef    * ref = this->bloom_db[ ref_num ];
+  BloomCodec    code;
+  BloomDeltaOps ops;
+  if ( ref == NULL ||
+       ! this->get_bloom_seqno( this->recv_seqno, ref_num, last_seqno ) ||
+       ! code.decode_ops( from_seqno, ops, delta, delta_len / 4 ) ||
+       from_seqno != last_seqno ) {
+    fprintf( stderr, "kv_pubsub: bloom delta %u not in sequence\n", ref_num );
+    return;
   }
+  ref->apply_delta( ops );
+  this->set_bloom_seqno( this->recv_seqno, ref_num, seqno );
+}
+
+void
+KvPubSubPeer::set_bloom_seqno( UInt64HashTab *&ht,  uint32_t ref_num,
+                               uint64_t seqno ) noexcept
+{
+  size_t pos;
+  if ( ht == NULL )
+    ht = UInt64HashTab::resize( NULL );
+  if ( ht->find( ref_num, pos ) )
+    ht->set( ref_num, pos, seqno );
+  else
+    ht->set_rsz( ht, ref_num, pos, seqno );
+}
+
+bool
+KvPubSubPeer::get_bloom_seqno( UInt64HashTab *ht,  uint32_t ref_num,
+                               uint64_t &seqno ) noexcept
+{
+  size_t pos;
+  return ht != NULL && ht->find( ref_num, pos, seqno );
+}
+
+void
+KvPubSubPeer::del_bloom_seqno( UInt64HashTab *&ht,  uint32_t ref_num ) noexcept
+{
+  size_t pos;
+  if ( ht != NULL && ht->find( ref_num, pos ) )
+    ht->remove_rsz( ht, pos );
 }
 
 void
@@ -611,6 +714,7 @@ KvPubSubPeer::bloom_del_msg( KvMsgIn &msg ) noexcept
   if ( kv_ps_debug )
     msg.print();
 
+  this->del_bloom_seqno( this->recv_seqno, ref_num );
   BloomRef * ref = this->bloom_db[ ref_num ];
   if ( ref != NULL && this->bloom_rt != NULL ) {
     this->bloom_rt->del_bloom_ref( ref );
@@ -650,6 +754,10 @@ KvPubSubPeer::drop_bloom_refs( void ) noexcept
     this->sub_route.remove_bloom_route( this->bloom_rt );
     this->bloom_rt = NULL;
   }
+  if ( this->recv_seqno != NULL ) {
+    delete this->recv_seqno;
+    this->recv_seqno = NULL;
+  }
 }
 
 void
@@ -797,8 +905,12 @@ KvPubSubPeer::release( void ) noexcept
     printf( "kv_pubsub: release %u %" PRIx64 "\n", this->ctx_id, this->time_ns );
   if ( this->time_ns != 0 )
     fprintf( stderr, "kv_pubsub: peer did not msg bye\n" );
-  if ( this->bloom_rt != NULL )
+  if ( this->bloom_rt != NULL || this->recv_seqno != NULL )
     this->drop_bloom_refs();
+  if ( this->sent_seqno != NULL ) {
+    delete this->sent_seqno;
+    this->sent_seqno = NULL;
+  }
   if ( this->time_ns != 0 )
     this->drop_sub_tab();
   if ( this->me.peer_set.is_member( this->fd ) ) {
@@ -1308,25 +1420,52 @@ KvPubSub::on_reassert( uint32_t ,  RouteVec<RouteSub> &,
 void
 KvPubSub::on_bloom_ref( BloomRef &ref ) noexcept
 {
-  BloomCodec code;
-  ref.encode( code );
-  size_t len = ::strlen( ref.name ) + 1;
-
-  KvEst e;
-  e.name( len )
-   .ref_num()
-   .data( code.code_sz * 4 );
+  BloomCodec code,        /* full bloom, if a peer needs it */
+             delta;       /* changes after delta_from */
+  uint64_t   seqno      = ref.delta_seqno(),
+             delta_from = 0,
+             from;
 
   for ( KvPubSubPeer * c = this->peer_list.hd; c != NULL; c = c->next ) {
-    KvMsg &m = *(new ( c->alloc_temp( e.len() ) ) KvMsg( KV_MSG_BLOOM ) );
-    m.name( ref.name, len )
-     .ref_num( ref.ref_num )
-     .data( code.ptr, code.code_sz * 4 );
-
-    c->append_iov( (void *) m.msg(), m.len() );
+    bool use_delta = false;
+    if ( c->get_bloom_seqno( c->sent_seqno, ref.ref_num, from ) &&
+         ref.can_delta( from ) ) {
+      if ( from == seqno ) /* peer is up to date */
+        continue;
+      /* usually all peers are at the same seqno, encode once */
+      if ( delta_from != from ) {
+        ref.encode_delta( from, delta );
+        delta_from = from;
+      }
+      /* the full bloom is about the size of the bits, or smaller */
+      use_delta = ( (size_t) delta.code_sz * 4 < ref.bits->width );
+    }
+    if ( use_delta ) {
+      KvEst e;
+      e.ref_num()
+       .bloom_seqno()
+       .data( delta.code_sz * 4 );
+
+      KvMsg &m = *(new ( c->alloc_temp( e.len() ) )
+                   KvMsg( KV_MSG_BLOOM_DELTA ) );
+      m.ref_num( ref.ref_num )
+       .bloom_seqno( seqno )
+       .data( delta.ptr, delta.code_sz * 4 );
+
+      c->set_bloom_seqno( c->sent_seqno, ref.ref_num, seqno );
+      c->append_iov( (void *) m.msg(), m.len() );
+      c->msgs_sent++;
+    }
+    else {
+      if ( code.code_sz == 0 )
+        ref.encode( code );
+      this->send_bloom( *c, ref, code, seqno );
+    }
     this->msgs_sent++;
     c->idle_push_write();
   }
+  /* all peers are at seqno, new peers get the full bloom */
+  ref.delta->trim( seqno );
 }
 
 void
@@ -1341,6 +1480,7 @@ KvPubSub::on_bloom_deref( BloomRef &ref ) noexcept
     KvMsg &m = *(new ( c->alloc_temp( e.len() ) ) KvMsg( KV_MSG_BLOOM_DEL ) );
     m.name( ref.name, len )
      .ref_num( ref.ref_num );
+    c->del_bloom_seqno( c->sent_seqno, ref.ref_num );
 
     c->append_iov( (void *) m.msg(), m.len() );
     this->msgs_sent++;
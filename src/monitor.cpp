@@ -66,7 +66,7 @@ Monitor::print_stats( void )
   if ( b || ( this->stats_counter == 0 && this->hts.ival > 0 ) ) {
     /* print hdr if stats counter == 0 */
     if ( this->stats_counter == 0 ) {
-      fputs( print_map_geom( &this->map, MAX_CTX_ID ), stdout );
+      fputs( print_map_geom( &this->map, KV_NO_CTX_ID ), stdout );
       for ( uint32_t db = 0; db < DB_COUNT; db++ ) {
         if ( this->map.hdr.test_db_opened( db ) ) {
           printf( "db[ %u ].entry_cnt:%s %" PRIu64 "\n", db,
@@ -136,68 +136,41 @@ Monitor::print_ops( void )
 void
 Monitor::check_broken_locks( void )
 {
-  uint32_t hash_entry_size = this->map.hdr.hash_entry_size;
-  for ( uint32_t ctx_id = 1; ctx_id < MAX_CTX_ID; ctx_id++ ) {
-    uint32_t pid = this->map.ctx[ ctx_id ].ctx_pid;
-    if ( pid == 0 || this->map.ctx[ ctx_id ].ctx_id == KV_NO_CTX_ID )
-      continue;
-#if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
-    if ( ::kill( pid, 0 ) == 0 )
-      continue;
-    if ( errno == EPERM )
-      continue;
-    printf( "ctx %u: pid %u = kill errno %d/%s\n",
-            ctx_id, pid, errno, strerror( errno ) );
-#else
-    HANDLE process = OpenProcess( SYNCHRONIZE, FALSE, pid );
-    DWORD  ret     = WaitForSingleObject( process, 0 );
-    CloseHandle( process );
-    if ( ret == WAIT_TIMEOUT )
-      continue;
-    printf( "ctx %u: pid %u = wait status %ld\n",
-            ctx_id, pid, ret );
-#endif
+  this->map.recover_dead_ctx( true );
+}
 
-    uint64_t used, recovered = 0;
-    if ( (used = this->map.ctx[ ctx_id ].mcs_used) != 0 ) {
-      for ( uint32_t id = 0; id < 64; id++ ) {
-        if ( ( used & ( (uint64_t) 1 << id ) ) == 0 )
-          continue;
-        uint64_t mcs_id = ( ctx_id << ThrCtxEntry::MCS_SHIFT ) | id;
-        ThrMCSLock &mcs = this->map.ctx[ ctx_id ].get_mcs_lock( mcs_id );
-        MCSStatus status;
-        printf(
-        "ctx %u: pid %u, mcs %u, val 0x%" PRIx64 ", lock 0x%" PRIx64 ", next 0x%" PRIx64 ", link %" PRIu64 "\n",
-                 ctx_id, pid, id, mcs.val.load(), mcs.lock.load(),
-                 mcs.next.load(), mcs.lock_id );
-        if ( mcs.lock_id != 0 ) {
-          HashEntry *el = this->map.get_entry( mcs.lock_id - 1,
-                                         this->map.hdr.hash_entry_size );
-          ThrCtxOwner  closure( this->map.ctx );
-          status = mcs.recover_lock( el->hash, ZOMBIE64, mcs_id, closure );
-          if ( status == MCS_OK ) {
-            ValueCtr &ctr = el->value_ctr( hash_entry_size );
-            if ( ctr.seal == 0 )
-              ctr.seal = 1; /* these are lost with the context thread */
-            status = mcs.recover_unlock( el->hash, ZOMBIE64, mcs_id, closure );
-            if ( status == MCS_OK ) {
-              printf( "mcs_id %u:%u recovered\n", ctx_id, id );
-              recovered |= ( (uint64_t) 1 << id );
-            }
-          }
-          if ( status != MCS_OK ) {
-            printf( "mcs_id %u:%u status %s\n", ctx_id, id,
-                    status == MCS_WAIT ? "MCS_WAIT" : "MCS_INACTIVE" );
-          }
-        }
-      }
-      this->map.ctx[ ctx_id ].mcs_used &= ~recovered;
-    }
-    if ( used != recovered ) {
-      printf( "ctx %u still has locks\n", ctx_id );
-    }
-    else {
-      this->map.detach_ctx( ctx_id );
-    }
+EvCtxRecover::EvCtxRecover( EvPoll &p,  HashTab &m ) noexcept
+  : poll( p ), map( m ), timer_id( 0 ), dead_cnt( 0 ), ival_ms( 0 ),
+    is_running( false )
+{
+}
+
+bool
+EvCtxRecover::start( uint32_t ival ) noexcept
+{
+  this->stop();
+  this->ival_ms = ival;
+  this->timer_id++;
+  if ( ! this->poll.timer.add_timer_millis( *this, ival, this->timer_id, 0 ) )
+    return false;
+  this->is_running = true;
+  return true;
+}
+
+void
+EvCtxRecover::stop( void ) noexcept
+{
+  if ( this->is_running ) {
+    this->poll.timer.remove_timer_cb( *this, this->timer_id, 0 );
+    this->is_running = false;
   }
 }
+
+bool
+EvCtxRecover::timer_cb( uint64_t tid,  uint64_t ) noexcept
+{
+  if ( tid != this->timer_id || ! this->is_running )
+    return false;
+  this->dead_cnt += this->map.recover_dead_ctx( false );
+  return true;
+}
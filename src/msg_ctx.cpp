@@ -116,6 +116,7 @@ struct GCRunCtx {
                    pos,
                    i,
                    j; /* i is leading edge, j is trailing edge */
+  bool             epoch_refreshed; /* update_read_epoch() called once */
   uint16_t         seg_lock[ seg_lock_max ], seg_lock_cnt;
   uint64_t         seg_lock_pos[ seg_lock_max ];
   WorkAllocT<1024> wrk;
@@ -129,7 +130,7 @@ struct GCRunCtx {
     seg( map.segment( segment_num ) ),
     segptr( (uint8_t *) map.seg_data( segment_num, 0 ) ),
     frag( 0 ), frag_start( 0 ), frag_size( 0 ),
-    pos( 0 ), i( 0 ), j( 0 ), seg_lock_cnt( 0 ) {}
+    pos( 0 ), i( 0 ), j( 0 ), epoch_refreshed( false ), seg_lock_cnt( 0 ) {}
 
 
   /* used when space is allocated */
@@ -145,7 +146,8 @@ struct GCRunCtx {
     seg( s ),
     segptr( sptr ),
     frag( 0 ), frag_start( 0 ), frag_size( 0 ),
-    pos( 0 ), i( hd ), j( tl ), seg_lock_cnt( 0 ) {}
+    pos( 0 ), i( hd ), j( tl ), epoch_refreshed( false ),
+    seg_lock_cnt( 0 ) {}
 
   bool lock( void ) {
     return this->seg.try_lock( this->algn_shft, this->pos );
@@ -181,8 +183,13 @@ struct GCRunCtx {
         mv_kctx.set( KEYCTX_IS_GC_ACQUIRE );
         if ( mv_kctx.try_acquire( &wrk ) <= KEY_IS_NEW ) {
           mv_kctx.db_num = mv_kctx.get_db();
+          /* pinned readers may have a pointer to the value, don't move */
+          if ( this->ht.hdr.pin_ctx_count != 0 ) {
+            stats.pinned++;
+            stats.pinned_size += msgsize;
+          }
           /* make sure it didn't move */
-          if ( mv_kctx.entry->test( FL_SEGMENT_VALUE ) ) {
+          else if ( mv_kctx.entry->test( FL_SEGMENT_VALUE ) ) {
             mv_kctx.entry->get_value_geom( this->hash_entry_size,
                                            mv_kctx.geom, this->algn_shft );
             uint8_t  do_mv_msg      = 0;
@@ -323,6 +330,15 @@ struct GCRunCtx {
         stats.compact_size += msgsize;
       }
     }
+    else if ( ! this->ht.is_read_reclaimable( msgptr.release_stamp(),
+                                              this->epoch_refreshed ) ) {
+      /* released after a reader pinned, skip over it like immovable */
+      this->i += msgsize;
+      this->j  = this->i;
+      this->frag = NULL;
+      stats.pinned++;
+      stats.pinned_size += msgsize;
+    }
     else {
       stats.zombie++;
       stats.zombie_size += msgsize;
@@ -334,6 +350,7 @@ struct GCRunCtx {
       }
       else {
         this->frag = &msgptr;
+        this->frag->hash2 = 0; /* stamp no longer needed */
         this->frag_start = this->i;
         this->frag_size  = msgsize;
       }
@@ -363,13 +380,21 @@ MsgCtx::alloc_segment( void *res,  uint64_t size,
                                                   seg_algn, chain_size );
   if ( alloc_size > seg_size )
     return KEY_TOO_BIG;
+  /* compact hash entry has 16 bits for size */
+  if ( HashEntry::is_compact( this->ht.hdr.hash_entry_size ) &&
+       ( alloc_size >> algn_shft ) > 0xffff )
+    return KEY_TOO_BIG;
 
   const uint32_t max_tries      = (uint32_t) nsegs * 4;
-  const uint32_t ctx_id         = this->ht.hdr.stat_link[ this->dbx_id ].ctx_id;
+  const uint32_t ctx_id         = this->ht.get_stat_link( this->dbx_id ).ctx_id;
+  DBQuota      & q              = this->ht.hdr.db_quota[
+                                  this->ht.get_stat_link( this->dbx_id ).db_num ];
   uint32_t       spins          = 0;
   uint8_t        how_aggressive = 3;
 
-  this->geom.segment = this->ht.ctx[ ctx_id ].seg_num;
+  if kv_unlikely( q.over_bytes( alloc_size ) )
+    return KEY_ALLOC_FAILED;
+  this->geom.segment = this->ht.get_ctx( ctx_id ).seg_num;
   this->geom.size    = alloc_size;
 
   for (;;) {
@@ -380,10 +405,13 @@ MsgCtx::alloc_segment( void *res,  uint64_t size,
     if ( seg.try_alloc( how_aggressive, alloc_size, seg_size, algn_shft,
                         tl, pos ) ) {
       MsgHdr & msgptr = *(MsgHdr *) (void *) &segptr[ tl ];
+      bool     refreshed = false;
       hd = msgptr.size;
       if ( hd == 0 )
         hd = seg_size;  /* end of segment */
-      else if ( msgptr.hash == ZOMBIE64 )
+      else if ( msgptr.hash == ZOMBIE64 &&
+                this->ht.is_read_reclaimable( msgptr.release_stamp(),
+                                              refreshed ) )
         hd += tl;       /* free msg space from tl -> hd */
       else
         hd = tl;        /* nothing free, need to find space  */
@@ -423,6 +451,7 @@ MsgCtx::alloc_segment( void *res,  uint64_t size,
         /* set up flags and entry index into segment */
         seg.avail_size -= alloc_size;
         seg.msg_count += 1;
+        q.incr_bytes( alloc_size );
         seg.release( tl, algn_shft );
         return KEY_OK;
       }
@@ -436,8 +465,8 @@ MsgCtx::alloc_segment( void *res,  uint64_t size,
       /*ctx.incr_htevict( htevict );*/
       return KEY_ALLOC_FAILED;
     }
-    uint16_t seg_num = (uint16_t) ( this->ht.ctx[ ctx_id ].rng.next() % nsegs );
-    this->ht.ctx[ ctx_id ].seg_num = seg_num;
+    uint16_t seg_num = (uint16_t) ( this->ht.get_ctx( ctx_id ).rng.next() % nsegs );
+    this->ht.get_ctx( ctx_id ).seg_num = seg_num;
     this->geom.segment = seg_num;
     if ( spins >= (uint32_t) nsegs / 4 ) {
       this->ht.update_load();
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <raikv/msg_cursor.h>
+
+using namespace rai;
+using namespace kv;
+
+MsgCursor::MsgCursor( HashTab &m,  uint32_t dbx_id ) noexcept
+  : map( m ), kctx( m, dbx_id, &this->kbuf ), seqno( 0 ), pos( 0 ),
+    msg_off( 0 ), hdr_off( 0 ), cache_hit( 0 ), cache_miss( 0 ), chain_size( 0 ),
+    is_cached( false )
+{
+  this->kbuf.zero();
+  this->geom.zero();
+  m.hdr.get_hash_seed( this->kctx.db_num, this->hs );
+}
+
+bool
+MsgCursor::set_key( const void *key,  size_t keylen,  bool add_null ) noexcept
+{
+  uint64_t h1, h2;
+  size_t   len = keylen + ( add_null ? 1 : 0 );
+  if ( len > KeyBuf::MAX_BUF_SIZE )
+    return false;
+  ::memcpy( this->kbuf.u.buf, key, keylen );
+  if ( add_null ) /* same as TopicLog::set_subject() */
+    this->kbuf.u.buf[ keylen ] = '\0';
+  this->kbuf.keylen = (uint16_t) len;
+  this->hs.hash( this->kbuf, h1, h2 );
+  this->kctx.set_hash( h1, h2 );
+  this->is_cached = false;
+  return true;
+}
+
+KeyStatus
+MsgCursor::read( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                 uint64_t &count ) noexcept
+{
+  if ( this->is_cached ) {
+    uint64_t  cnt = count;
+    KeyStatus status = this->read_cached( first, msg, msg_size, cnt );
+    if ( status != KEY_MUTATED ) {
+      count = cnt;
+      return status;
+    }
+    this->is_cached = false;
+  }
+  return this->read_find( first, msg, msg_size, count );
+}
+
+KeyStatus
+MsgCursor::read_cached( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                        uint64_t &count ) noexcept
+{
+  volatile MsgHdr * hdr;
+  uint8_t         * p;
+  uint64_t          ser, msz, len, off, n;
+  uint16_t          chain;
+  ValueGeom         cur;
+
+  this->wrk.reset();
+  /* when a chain is added, the old head is still sealed, check the entry
+   * points to the head msg, it is locked or moved when not equal */
+  HashEntry &el = *this->map.get_entry( this->pos,
+                                        this->kctx.hash_entry_size );
+  if ( el.hash != this->kctx.key ||
+       el.get_hash2( this->kctx.hash_entry_size ) != this->kctx.key2 ||
+       el.test( FL_SEGMENT_VALUE ) == 0 )
+    return KEY_MUTATED;
+  el.get_value_geom( this->kctx.hash_entry_size, cur,
+                     this->kctx.seg_align_shift );
+  if ( cur.segment != this->geom.segment || cur.offset != this->geom.offset ||
+       cur.size != this->geom.size )
+    return KEY_MUTATED;
+  hdr = (MsgHdr *) this->map.seg_data( this->geom.segment, this->geom.offset );
+  if ( hdr == NULL ||
+       hdr->size != this->geom.size || hdr->hash != this->kctx.key ||
+       hdr->hash2 != this->kctx.key2 || ( hdr->flags & FL_BUSY ) != 0 )
+    return KEY_MUTATED;
+  kv_acquire_fence();
+  ValueCtr &ctr = hdr->value_ctr_v();
+  ser = ctr.get_serial();
+  if ( ctr.seal != 1 || ctr.size != this->chain_size ||
+       (uint32_t) ser != hdr->seriallo )
+    return KEY_MUTATED;
+  /* the serial is the last seqno appended */
+  if ( ( ( ser - this->kctx.key ) & ValueCtr::SERIAL_MASK ) < this->seqno ) {
+    count = 0;
+    return KEY_NOT_FOUND;
+  }
+  msz = hdr->msg_size;
+  if ( this->hdr_off + msz > this->geom.size || msz <= this->msg_off )
+    return KEY_MUTATED;
+  /* copy the msgs appended since last read and check seal again */
+  len = msz - this->msg_off;
+  if ( (p = (uint8_t *) this->wrk.alloc( len )) == NULL )
+    return KEY_ALLOC_FAILED;
+  ::memcpy( p, (uint8_t *) hdr + this->hdr_off + this->msg_off, len );
+  kv_acquire_fence();
+  if ( ! hdr->check_seal( this->kctx.key, this->kctx.key2, ser,
+                          (uint32_t) this->geom.size, chain ) ||
+       chain != this->chain_size )
+    return KEY_MUTATED;
+
+  for ( n = 0, off = 0; n < count && off + sizeof( msg_size_t ) <= len; n++ ) {
+    msg_size_t sz = *(msg_size_t *) (void *) &p[ off ];
+    off += sizeof( msg_size_t );
+    if ( off + sz > len )
+      return KEY_MUTATED;
+    msg[ n ]      = &p[ off ];
+    msg_size[ n ] = sz;
+    off += align<uint64_t>( sz, sizeof( msg_size_t ) );
+  }
+  first          = this->seqno;
+  count          = n;
+  this->seqno   += n;
+  this->msg_off += off;
+  this->cache_hit++;
+  return KEY_OK;
+}
+
+KeyStatus
+MsgCursor::read_find( uint64_t &first,  void **msg,  msg_size_t *msg_size,
+                      uint64_t &count ) noexcept
+{
+  KeyStatus status;
+  uint64_t  to_idx = this->seqno + count;
+
+  count = 0;
+  first = this->seqno;
+  this->cache_miss++;
+  this->wrk.reset();
+  if ( (status = this->kctx.find( &this->wrk )) != KEY_OK )
+    return status;
+  if ( (status = this->kctx.msg_value( first, to_idx, msg,
+                                       msg_size )) != KEY_OK )
+    return status;
+  count       = to_idx - first;
+  this->seqno = to_idx;
+  /* all msgs read, the next are appended to the head msg */
+  if ( this->kctx.msg != NULL && this->kctx.entry->test( FL_SEGMENT_VALUE ) &&
+       to_idx == this->kctx.get_serial_count( ValueCtr::SERIAL_MASK ) + 1 ) {
+    this->geom       = this->kctx.geom;
+    this->pos        = this->kctx.pos;
+    this->hdr_off    = this->kctx.msg->hdr_size();
+    this->msg_off    = align<uint64_t>( this->kctx.msg->msg_size,
+                                        sizeof( msg_size_t ) );
+    this->chain_size = this->kctx.msg_chain_size;
+    this->is_cached  = true;
+  }
+  return KEY_OK;
+}
+
+EvMsgCursor::EvMsgCursor( EvPoll &p,  HashTab &m,  uint32_t dbx_id ) noexcept
+  : poll( p ), cur( m, dbx_id ), timer_id( 0 ), ival_us( 0 ),
+    is_running( false )
+{
+}
+
+bool
+EvMsgCursor::start( uint32_t ival ) noexcept
+{
+  this->stop();
+  this->ival_us = ival;
+  this->timer_id++;
+  if ( ! this->poll.timer.add_timer_micros( *this, ival, this->timer_id, 0 ) )
+    return false;
+  this->is_running = true;
+  return true;
+}
+
+void
+EvMsgCursor::stop( void ) noexcept
+{
+  if ( this->is_running ) {
+    this->poll.timer.remove_timer_cb( *this, this->timer_id, 0 );
+    this->is_running = false;
+  }
+}
+
+uint64_t
+EvMsgCursor::read_all( void ) noexcept
+{
+  void     * msg[ READ_BATCH ];
+  msg_size_t msg_size[ READ_BATCH ];
+  uint64_t   first, cnt, total = 0;
+  for (;;) {
+    cnt = READ_BATCH;
+    if ( this->cur.read( first, msg, msg_size, cnt ) != KEY_OK || cnt == 0 )
+      break;
+    this->on_msgs( first, msg, msg_size, cnt );
+    total += cnt;
+  }
+  return total;
+}
+
+bool
+EvMsgCursor::timer_cb( uint64_t tid,  uint64_t ) noexcept
+{
+  if ( tid != this->timer_id || ! this->is_running )
+    return false;
+  this->read_all();
+  return true;
+}
+
+void
+EvMsgCursor::on_msgs( uint64_t,  void **,  msg_size_t *,  uint64_t ) noexcept
+{
+}
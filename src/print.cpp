@@ -59,6 +59,9 @@ rai::kv::print_map_geom( HashTab *map,  uint32_t ctx_id,  char *buf,
   size_t sz = buflen;
   xnprintf( b, sz, "kv_version:           %s\n", get_kv_version() );
   xnprintf( b, sz, "map_sig:              %s\n", map->hdr.sig );
+  if ( map->hdr.prefault_threads != 0 )
+    xnprintf( b, sz, "prefault:             %u ms, %u threads (auto)\n",
+              map->hdr.prefault_ms, map->hdr.prefault_threads );
   xnprintf( b, sz, "map_name:             %s\n", map->hdr.name );
   xnprintf( b, sz, "map_size:             %" PRIu64 " (%.3fMB) (config)\n",
             map->hdr.map_size,
@@ -89,6 +92,10 @@ rai::kv::print_map_geom( HashTab *map,  uint32_t ctx_id,  char *buf,
   xnprintf( b, sz, "cuckoo_arity+buckets: %u+%u (config%s)\n",
             map->hdr.cuckoo_arity, map->hdr.cuckoo_buckets,
          ( map->hdr.cuckoo_buckets <= 1 ? " == linear probe" : " == cuckoo" ) );
+  if ( map->hdr.cuckoo_buckets > 1 )
+    xnprintf( b, sz, "cuckoo_path_depth:    %u (%s)\n",
+              map->hdr.cuckoo_path_depth,
+              map->hdr.cuckoo_path_depth == 0 ? "random walk" : "bfs" );
   xnprintf( b, sz, "seg_size:             %" PRIu64 " (total-size %.3fMB) (calc)\n",
           map->hdr.seg_size(),
 	  (double) ( map->hdr.seg_size() *
@@ -106,12 +113,27 @@ rai::kv::print_map_geom( HashTab *map,  uint32_t ctx_id,  char *buf,
   xnprintf( b, sz, "value_load:           %.3f%%\n",
             map->hdr.value_load * 100.0 );
   xnprintf( b, sz, "load_pecent:          %u%%\n", map->hdr.load_percent );
-  if ( ctx_id != MAX_CTX_ID )
-    xnprintf( b, sz, "ctx_id:               %u (in use %u of %" PRIu64 " max)\n",
-	    ctx_id, (uint32_t) (uint16_t) map->hdr.ctx_used, MAX_CTX_ID );
+  if ( ctx_id < map->max_ctx_count() )
+    xnprintf( b, sz, "ctx_id:               %u (in use %u of %u max)\n",
+	    ctx_id, (uint32_t) (uint16_t) map->hdr.ctx_used,
+            map->max_ctx_count() );
   else
-    xnprintf( b, sz, "ctx_id:               (none) (in use %u of %" PRIu64 " max)\n",
-	    (uint32_t) (uint16_t) map->hdr.ctx_used, MAX_CTX_ID );
+    xnprintf( b, sz, "ctx_id:               (none) (in use %u of %u max)\n",
+	    (uint32_t) (uint16_t) map->hdr.ctx_used, map->max_ctx_count() );
+  if ( map->hdr.recover.check_cnt != 0 )
+    xnprintf( b, sz, "ctx_recover:          %" PRIu64 " checks, %" PRIu64
+              " dead, %" PRIu64 " locks, %" PRIu64 " waiting, %" PRIu64
+              " detached\n", map->hdr.recover.check_cnt,
+              map->hdr.recover.dead_ctx, map->hdr.recover.lock_recov,
+              map->hdr.recover.lock_wait, map->hdr.recover.ctx_detach );
+  for ( uint32_t db = 0; db < KV_DB_COUNT; db++ ) {
+    const DBQuota & q = map->hdr.db_quota[ db ];
+    if ( q.is_set() )
+      xnprintf( b, sz, "db_quota[ %u ]:        %" PRId64 " of %" PRIu64
+                " bytes, %" PRId64 " of %" PRIu64 " entries\n", db,
+                (int64_t) q.bytes.load(), q.max_bytes,
+                (int64_t) q.entries.load(), q.max_entries );
+  }
   return buf;
 }
 
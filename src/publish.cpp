@@ -14,6 +14,15 @@ uint32_t rai::kv::kv_pub_debug;
 
 namespace rai {
 namespace kv {
+/* conflated or lossy msgs are held or dropped to backed up socks */
+static inline bool
+sock_on_msg( EvPoll &poll,  EvSocket *s,  EvPublish &pub )
+{
+  if ( poll.subj_opt_ht != NULL && poll.hold_msg( *s, pub ) )
+    return true;
+  return s->on_msg( pub );
+}
+
 struct ForwardBase {
   RoutePublish & sub_route;
   uint32_t       total;
@@ -40,7 +49,7 @@ struct ForwardAll : public ForwardBase {
       this->total++;
       if ( kv_pub_debug )
         this->debug_subject( pub, s, "fwd_all" );
-      return s->on_msg( pub );
+      return sock_on_msg( this->sub_route.poll, s, pub );
     }
     return true;
   }
@@ -59,7 +68,7 @@ struct ForwardSome : public ForwardBase {
         this->total++;
         if ( kv_pub_debug )
           this->debug_subject( pub, s, "fwd_som" );
-        return s->on_msg( pub );
+        return sock_on_msg( this->sub_route.poll, s, pub );
       }
     }
     return true;
@@ -76,7 +85,7 @@ struct ForwardSet : public ForwardBase {
       this->total++;
       if ( kv_pub_debug )
         this->debug_subject( pub, s, "fwd_set" );
-      return s->on_msg( pub );
+      return sock_on_msg( this->sub_route.poll, s, pub );
     }
     return true;
   }
@@ -92,7 +101,7 @@ struct ForwardExcept : public ForwardBase {
       this->total++;
       if ( kv_pub_debug )
         this->debug_subject( pub, s, "fwd_exc" );
-      return s->on_msg( pub );
+      return sock_on_msg( this->sub_route.poll, s, pub );
     }
     return true;
   }
@@ -108,7 +117,7 @@ struct ForwardNotFd : public ForwardBase {
       this->total++;
       if ( kv_pub_debug )
         this->debug_subject( pub, s, "fwd_not" );
-      return s->on_msg( pub );
+      return sock_on_msg( this->sub_route.poll, s, pub );
     }
     return true;
   }
@@ -125,7 +134,7 @@ struct ForwardNotFd2 : public ForwardBase {
       this->total++;
       if ( kv_pub_debug )
         this->debug_subject( pub, s, "fwd_nt2" );
-      return s->on_msg( pub );
+      return sock_on_msg( this->sub_route.poll, s, pub );
     }
     return true;
   }
@@ -357,6 +366,157 @@ EvSocket::bp_retire( BPData &data ) noexcept
     this->poll.bp_wait.pop( data.bp_fd, data );
 }
 
+size_t
+ConflateMsg::alloc_size( const EvPublish &pub ) noexcept
+{
+  return sizeof( ConflateMsg ) - sizeof( ((ConflateMsg *) 0)->buf ) +
+         align<size_t>( pub.msg_len, 8 ) +
+         (size_t) pub.prefix_cnt * ( sizeof( uint32_t ) + 1 ) +
+         pub.subject_len + pub.reply_len;
+}
+
+void
+ConflateMsg::set( const EvPublish &pub ) noexcept
+{
+  this->sub_route    = &pub.sub_route;
+  this->src_route    = pub.src_route;
+  this->msg_len      = pub.msg_len;
+  this->subj_hash    = pub.subj_hash;
+  this->msg_enc      = pub.msg_enc;
+  this->shard        = pub.shard;
+  this->hdr_len      = pub.hdr_len;
+  this->suf_len      = pub.suf_len;
+  this->pub_host     = pub.pub_host;
+  this->subject_len  = pub.subject_len;
+  this->reply_len    = pub.reply_len;
+  this->pub_status   = pub.pub_status;
+  this->publish_type = pub.publish_type;
+  this->prefix_cnt   = pub.prefix_cnt;
+  this->cnt          = pub.cnt;
+
+  char * p = this->buf;
+  ::memcpy( p, pub.msg, pub.msg_len );
+  p = &p[ align<size_t>( pub.msg_len, 8 ) ];
+  ::memcpy( p, pub.hash, sizeof( uint32_t ) * pub.prefix_cnt );
+  p = &p[ sizeof( uint32_t ) * pub.prefix_cnt ];
+  ::memcpy( p, pub.prefix, pub.prefix_cnt );
+  p = &p[ pub.prefix_cnt ];
+  ::memcpy( p, pub.subject, pub.subject_len );
+  ::memcpy( &p[ pub.subject_len ], pub.reply, pub.reply_len );
+}
+
+int
+ConflateQueue::hold( EvPublish &pub ) noexcept
+{
+  size_t        sz = ConflateMsg::alloc_size( pub ), pos;
+  uint32_t      i;
+  ConflateMsg * m;
+
+  if ( this->ht == NULL )
+    this->ht = UIntHashTab::resize( NULL );
+  if ( this->ht->find( pub.subj_hash, pos, i ) ) {
+    m = this->msg.ptr[ i ];
+    if ( m->buf_size < sz ) {
+      void * p = ::realloc( (void *) m, sz );
+      if ( p == NULL ) { /* drop the old msg, the new one is not held */
+        ::free( m );
+        this->msg.ptr[ i ] = NULL;
+        this->ht->remove( pos );
+        return HOLD_NO_MEM;
+      }
+      m = (ConflateMsg *) p;
+      m->buf_size = (uint32_t) sz;
+      this->msg.ptr[ i ] = m;
+    }
+    m->set( pub );
+    return HOLD_REPLACED;
+  }
+  if ( (m = (ConflateMsg *) ::malloc( sz )) == NULL )
+    return HOLD_NO_MEM;
+  m->buf_size = (uint32_t) sz;
+  m->set( pub );
+  this->ht->set( pub.subj_hash, pos, (uint32_t) this->msg.count );
+  UIntHashTab::check_resize( this->ht );
+  this->msg.push( m );
+  return HOLD_NEW;
+}
+
+/* send the held msgs in the order they arrived, stop if blocked again */
+void
+ConflateQueue::flush( EvSocket &s ) noexcept
+{
+  size_t i = 0, j, n;
+  while ( i < this->msg.count ) {
+    ConflateMsg * m = this->msg.ptr[ i++ ];
+    if ( m == NULL ) /* dropped by hold() */
+      continue;
+    char        * p = &m->buf[ align<size_t>( m->msg_len, 8 ) ];
+    uint32_t    * hash   = (uint32_t *) (void *) p;
+    uint8_t     * prefix = (uint8_t *) &p[ sizeof( uint32_t ) * m->prefix_cnt ];
+    const char  * sub    = (const char *) &prefix[ m->prefix_cnt ];
+
+    EvPublish pub( sub, m->subject_len, &sub[ m->subject_len ], m->reply_len,
+                   m->buf, m->msg_len, *m->sub_route, m->src_route,
+                   m->subj_hash, m->msg_enc, (EvPubType) m->publish_type,
+                   m->pub_status, m->pub_host, m->cnt );
+    pub.shard   = m->shard;
+    pub.hdr_len = m->hdr_len;
+    pub.suf_len = m->suf_len;
+    EvPubTmp tmp_hash( pub, hash, prefix, m->prefix_cnt );
+    s.on_msg( pub );
+    ::free( m );
+    if ( s.test2( EV_WRITE_POLL, EV_WRITE_HI ) )
+      break;
+  }
+  this->ht->clear_all();
+  /* blocked, move the rest to the front and reindex */
+  for ( n = 0, j = i; j < this->msg.count; j++ ) {
+    if ( this->msg.ptr[ j ] != NULL ) {
+      this->msg.ptr[ n ] = this->msg.ptr[ j ];
+      this->ht->upsert( this->msg.ptr[ n ]->subj_hash, (uint32_t) n );
+      n++;
+    }
+  }
+  this->msg.count = n;
+  if ( n > 0 ) {
+    this->bp_id = s.start_ns;
+    this->poll.bp_wait.push( s.fd, *this );
+  }
+  UIntHashTab::check_resize( this->ht );
+}
+
+void
+ConflateQueue::release( void ) noexcept
+{
+  if ( this->bp_in_list() )
+    this->poll.bp_wait.pop( this->bp_fd, *this );
+  for ( size_t i = 0; i < this->msg.count; i++ )
+    ::free( this->msg.ptr[ i ] );
+  this->msg.count = 0;
+  if ( this->ht != NULL )
+    this->ht->clear_all();
+}
+
+void
+ConflateQueue::on_write_ready( void ) noexcept
+{
+  EvSocket * s;
+  if ( (uint32_t) this->bp_fd > this->poll.maxfd ||
+       (s = this->poll.sock[ this->bp_fd ]) == NULL ||
+       s->sock_state == 0 || s->test( EV_CLOSE ) ) {
+    this->release(); /* closing, notified by process_close() */
+    return;
+  }
+  this->flush( *s );
+}
+
+void
+EvPoll::release_conflate( uint32_t fd ) noexcept
+{
+  if ( fd < this->conflate_q.size && this->conflate_q.ptr[ fd ] != NULL )
+    this->conflate_q.ptr[ fd ]->release();
+}
+
 bool
 BPData::has_back_pressure( EvPoll &poll, uint32_t fd ) noexcept
 {
@@ -401,7 +561,8 @@ test_back_pressure_multi( BPData &bp,  EvPoll &poll,  Fanout &m ) noexcept
   return false;
 }
 
-RoutePublishContext::RoutePublishContext( RouteDB &db,  EvPublish &p ) noexcept
+RoutePublishContext::RoutePublishContext( RoutePublish &db,
+                                          EvPublish &p ) noexcept
   : RouteLookup( p.subject, p.subject_len, p.subj_hash, p.shard ),
     pub( p ), rdb( db ), set( db, *this ), save_type( p.publish_type )
 {
@@ -549,33 +710,40 @@ RoutePublishContext::select_queue( QueueDB &q,  RouteQueueSet &qset,
   prune_set.init();
   prune_set.n = 1;
   if ( rcnt > 1 ) {
-    uint32_t refcnt = 0, refmax = 0;
-    for ( i = 0; i < rcnt; i++ ) {
-      refmax |= routes[ i ].refcnt;
-      refcnt += routes[ i ].refcnt;
-    }
-    if ( refmax == 1 ) {
-      q_select = q.next_route++ % rcnt;
+    switch ( q.select ) {
+      case QUEUE_LEAST_LOAD:
+        q_select = this->select_least_load( q, routes, rcnt );
+        break;
+      case QUEUE_TWO_CHOICE:
+        q_select = this->select_two_choice( q, routes, rcnt );
+        break;
+      default:
+        q_select = this->select_rotate( q, routes, rcnt );
+        break;
     }
-    else {
-      uint32_t nextref = q.next_route++ % refcnt;
-      refcnt = 0;
-      for ( q_select = 0; q_select < rcnt; q_select++ ) {
-        refcnt += routes[ q_select ].refcnt;
-        if ( refcnt > nextref )
-          break;
-      }
+    uint64_t load = this->queue_load( routes[ q_select ].r );
+    q.stats.select_cnt++;
+    if ( load >= QUEUE_BP_LOAD ) {
+      q.stats.bp_cnt++;
+      load -= QUEUE_BP_LOAD;
     }
+    q.stats.pending_sum += load;
   }
   r = routes[ q_select ].r;
   prune_set.min_fd = prune_set.max_fd = r;
+  /* the prune set is on the stack of add_queues(), the route added to the
+   * publish set must outlive it */
+  RouteRef sel_ref( this->rdb.zip, (uint16_t) ( 55 + db.group_num ) );
+  uint32_t * sel = sel_ref.route_spc.make( 1 );
+  sel[ 0 ] = r;
+  this->add_ref( sel_ref );
 
   if ( qset.rpd[ 0 ].rcount != 0 ) {
     if ( qset.rpd[ 0 ].is_member( r ) ) {
       RoutePublishData & prune_data = prune_set.rpd[ 0 ];
       prune_data.prefix = qset.rpd[ 0 ].prefix;
       prune_data.hash   = qset.rpd[ 0 ].hash;
-      prune_data.routes = &prune_set.min_fd;
+      prune_data.routes = sel;
       prune_data.rcount = 1;
     }
     else {
@@ -590,7 +758,7 @@ RoutePublishContext::select_queue( QueueDB &q,  RouteQueueSet &qset,
         RoutePublishData & prune_data = prune_set.rpd[ pref + 1 ];
         prune_data.prefix = data.prefix;
         prune_data.hash   = data.hash;
-        prune_data.routes = &prune_set.min_fd;
+        prune_data.routes = sel;
         prune_data.rcount = 1;
       }
       else {
@@ -600,6 +768,91 @@ RoutePublishContext::select_queue( QueueDB &q,  RouteQueueSet &qset,
   }
 }
 
+/* round robin, a member with more subscriptions or weight is selected more */
+uint32_t
+RoutePublishContext::select_rotate( QueueDB &q,  QueueRef *routes,
+                                    uint32_t rcnt ) noexcept
+{
+  uint64_t refcnt = 0;
+  uint32_t refmax = 0, i;
+  if ( q.select == QUEUE_WEIGHTED ) {
+    for ( i = 0; i < rcnt; i++ )
+      refcnt += (uint64_t) routes[ i ].refcnt * q.get_weight( routes[ i ].r );
+    if ( refcnt == 0 ) /* all zero weight */
+      return q.next_route++ % rcnt;
+  }
+  else {
+    for ( i = 0; i < rcnt; i++ ) {
+      refmax |= routes[ i ].refcnt;
+      refcnt += routes[ i ].refcnt;
+    }
+    if ( refmax == 1 )
+      return q.next_route++ % rcnt;
+  }
+  uint64_t nextref = q.next_route++ % refcnt;
+  refcnt = 0;
+  for ( i = 0; i < rcnt - 1; i++ ) {
+    uint64_t w = routes[ i ].refcnt;
+    if ( q.select == QUEUE_WEIGHTED )
+      w *= q.get_weight( routes[ i ].r );
+    if ( (refcnt += w) > nextref )
+      break;
+  }
+  return i;
+}
+
+/* scan all members for the least pending, starting at a rotating offset so
+ * that idle members with the same load share the msgs */
+uint32_t
+RoutePublishContext::select_least_load( QueueDB &q,  QueueRef *routes,
+                                        uint32_t rcnt ) noexcept
+{
+  uint32_t j = q.next_route++ % rcnt,
+           q_select = j;
+  uint64_t min_load = this->queue_load( routes[ j ].r );
+  for ( uint32_t i = 1; i < rcnt && min_load != 0; i++ ) {
+    if ( ++j == rcnt )
+      j = 0;
+    uint64_t load = this->queue_load( routes[ j ].r );
+    if ( load < min_load ) {
+      min_load = load;
+      q_select = j;
+    }
+  }
+  q.next_route = q_select + 1; /* next scan starts after the selected */
+  return q_select;
+}
+
+/* power of two choices, the less loaded of two random members */
+uint32_t
+RoutePublishContext::select_two_choice( QueueDB &q,  QueueRef *routes,
+                                        uint32_t rcnt ) noexcept
+{
+  uint32_t a = q.next_rand() % rcnt,
+           b = q.next_rand() % ( rcnt - 1 );
+  if ( b >= a )
+    b++;
+  if ( this->queue_load( routes[ b ].r ) < this->queue_load( routes[ a ].r ) )
+    return b;
+  return a;
+}
+
+uint64_t
+RoutePublishContext::queue_load( uint32_t r ) noexcept
+{
+  EvPoll   & poll = this->rdb.poll;
+  EvSocket * s;
+  uint64_t   load = 0;
+  if ( r > poll.maxfd || (s = poll.sock[ r ]) == NULL )
+    return 0;
+  if ( s->sock_base == EV_CONNECTION_BASE )
+    load = ( (EvConnection *) s )->StreamBuf::pending();
+  /* same test as BPData::has_back_pressure() */
+  if ( s->test2( EV_WRITE_POLL, EV_WRITE_HI ) )
+    load += QUEUE_BP_LOAD;
+  return load;
+}
+
 template<class Forward>
 static bool
 forward_message( EvPublish &pub,  RoutePublish &sub_route,
@@ -765,7 +1018,7 @@ RoutePublish::forward_set_no_route( EvPublish &pub,
         if ( fd > this->poll.maxfd )
           break;
         if ( (s = this->poll.sock[ fd ]) != NULL ) {
-          flow_good &= s->on_msg( pub );
+          flow_good &= sock_on_msg( this->poll, s, pub );
           if ( kv_pub_debug ) {
             printf( "fwd_set %u\n", fd );
             cnt++;
@@ -799,7 +1052,7 @@ RoutePublish::forward_set_no_route_not_fd( EvPublish &pub,  const BitSpace &fdse
         if ( fd > this->poll.maxfd )
           break;
         if ( (s = this->poll.sock[ fd ]) != NULL ) {
-          flow_good &= s->on_msg( pub );
+          flow_good &= sock_on_msg( this->poll, s, pub );
           if ( kv_pub_debug ) {
             printf( "fwd_not_%u %u\n", not_fd, fd );
             cnt++;
@@ -846,7 +1099,7 @@ RoutePublish::forward_to( EvPublish &pub,  uint32_t fd,  BPData *data ) noexcept
       if ( data->has_back_pressure( this->poll, fd ) && ! data->bp_fwd() )
         return false;
     }
-    b = s->on_msg( pub );
+    b = sock_on_msg( this->poll, s, pub );
     if ( kv_pub_debug ) {
       printf( "fwd_to_%u ok\n", fd );
     }
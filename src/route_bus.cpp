@@ -0,0 +1,569 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
+#include <unistd.h>
+#else
+#include <raikv/win.h>
+#endif
+#include <raikv/route_bus.h>
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+#include <raikv/ev_publish.h>
+#include <raikv/bloom.h>
+#include <raikv/pattern_cvt.h>
+
+using namespace rai;
+using namespace kv;
+
+RouteBusMsg *
+RouteBusMsg::create( uint8_t t,  const char *sub,  size_t sublen,
+                     const void *rep,  size_t replen,
+                     const void *data,  size_t datalen ) noexcept
+{
+  size_t off = data_off( sublen, replen );
+  void * p   = ::malloc( sizeof( RouteBusMsg ) + off + datalen );
+  if ( p == NULL )
+    return NULL;
+  RouteBusMsg * m = new ( p ) RouteBusMsg( t );
+  m->subject_len = (uint16_t) sublen;
+  m->reply_len   = (uint16_t) replen;
+  m->msg_len     = (uint32_t) datalen;
+  ::memcpy( m->buf, sub, sublen );
+  if ( replen > 0 )
+    ::memcpy( &m->buf[ sublen ], rep, replen );
+  if ( datalen > 0 )
+    ::memcpy( &m->buf[ off ], data, datalen );
+  return m;
+}
+
+RouteBus *
+RouteBus::create( uint32_t nthr ) noexcept
+{
+  void * p = ::malloc( sizeof( RouteBus ) );
+  if ( p == NULL )
+    return NULL;
+  RouteBus * bus = new ( p ) RouteBus();
+  size_t n = (size_t) nthr * nthr;
+  bus->ring = (RouteBusRing *) aligned_malloc( sizeof( RouteBusRing ) * n );
+  bus->port = (RouteBusPort **) ::malloc( sizeof( RouteBusPort * ) * nthr );
+  if ( bus->ring == NULL || bus->port == NULL ) {
+    perror( "alloc route bus" );
+    bus->release();
+    delete bus;
+    return NULL;
+  }
+  ::memset( (void *) bus->ring, 0, sizeof( RouteBusRing ) * n );
+  ::memset( bus->port, 0, sizeof( RouteBusPort * ) * nthr );
+  bus->nthreads = nthr;
+  /* the eventfds are owned by the bus, a producer may signal after the
+   * consumer thread exits */
+  for ( size_t i = 0; i < n; i++ ) {
+#ifdef HAVE_EVENTFD
+    if ( i / nthr != i % nthr ) {
+      bus->ring[ i ].wake_fd = ::eventfd( 0, EFD_NONBLOCK );
+      if ( bus->ring[ i ].wake_fd == -1 ) {
+        perror( "eventfd() failed" );
+        bus->release();
+        delete bus;
+        return NULL;
+      }
+      continue;
+    }
+#endif
+    bus->ring[ i ].wake_fd = -1;
+  }
+  return bus;
+}
+
+RouteBusPort *
+RouteBus::attach( EvPoll &p,  uint32_t thr ) noexcept
+{
+  if ( thr >= this->nthreads || this->port[ thr ] != NULL )
+    return NULL;
+  void * m = ::malloc( sizeof( RouteBusPort ) );
+  if ( m == NULL )
+    return NULL;
+  RouteBusPort * pt = new ( m ) RouteBusPort( *this, p, thr );
+  pt->peer = (RouteBusPeer **)
+             ::malloc( sizeof( RouteBusPeer * ) * this->nthreads );
+  if ( pt->peer == NULL ) {
+    pt->~RouteBusPort();
+    ::free( pt );
+    return NULL;
+  }
+  ::memset( pt->peer, 0, sizeof( RouteBusPeer * ) * this->nthreads );
+  this->port[ thr ] = pt;
+  for ( uint32_t i = 0; i < this->nthreads; i++ ) {
+    if ( i != thr ) {
+      if ( (pt->peer[ i ] = RouteBusPeer::create( p, *pt, i )) == NULL )
+        return NULL;
+    }
+  }
+  p.sub_route.bus = pt;
+  p.sub_route.add_route_notify( *pt );
+  return pt;
+}
+
+void
+RouteBus::release( void ) noexcept
+{
+  size_t i, n = (size_t) this->nthreads * this->nthreads;
+  if ( this->port != NULL ) {
+    for ( i = 0; i < this->nthreads; i++ ) {
+      RouteBusPort * pt = this->port[ i ];
+      if ( pt == NULL )
+        continue;
+      pt->poll.sub_route.remove_route_notify( *pt );
+      pt->poll.sub_route.bus = NULL;
+      for ( uint32_t j = 0; j < this->nthreads; j++ ) {
+        RouteBusPeer * c = pt->peer[ j ];
+        if ( c != NULL ) {
+          if ( c->fd >= 0 ) /* if not closed by poll */
+            pt->poll.remove_sock( c );
+          c->~RouteBusPeer();
+          aligned_free( c );
+        }
+      }
+      ::free( pt->peer );
+      pt->~RouteBusPort();
+      ::free( pt );
+    }
+    ::free( this->port );
+    this->port = NULL;
+  }
+  if ( this->ring != NULL ) {
+    for ( i = 0; i < n; i++ ) {
+      RouteBusRing & r = this->ring[ i ];
+      RouteBusMsg  * m;
+      while ( (m = r.pop()) != NULL )
+        delete m;
+#ifdef HAVE_EVENTFD
+      if ( r.wake_fd >= 0 )
+        ::close( r.wake_fd );
+#endif
+    }
+    aligned_free( this->ring );
+    this->ring = NULL;
+  }
+  this->nthreads = 0;
+}
+
+RouteBusPort::RouteBusPort( RouteBus &b,  EvPoll &p,  uint32_t t ) noexcept
+  : RouteNotify( p.sub_route ), bus( b ), poll( p ), peer( 0 ), thr( t )
+{
+}
+
+void
+RouteBusPort::bcast_sub( uint8_t type,  const char *sub,  size_t sublen,
+                         uint32_t h,  BloomRef *bref,  uint8_t fmt ) noexcept
+{
+  for ( uint32_t i = 0; i < this->bus.nthreads; i++ ) {
+    if ( this->peer[ i ] == NULL )
+      continue;
+    RouteBusMsg * m = RouteBusMsg::create( type, sub, sublen, NULL, 0,
+                                           NULL, 0 );
+    if ( m == NULL )
+      continue;
+    m->subj_hash = h;
+    m->pat_fmt   = fmt;
+    if ( bref != NULL )
+      m->ref_num = bref->ref_num;
+    this->peer[ i ]->send( m );
+  }
+}
+
+void
+RouteBusPort::on_sub( NotifySub &sub ) noexcept
+{
+  if ( sub.src_type == 'K' ) /* came from another process */
+    return;
+  this->bcast_sub( BUS_MSG_SUB, sub.subject, sub.subject_len, sub.subj_hash,
+                   sub.bref, 0 );
+}
+
+void
+RouteBusPort::on_unsub( NotifySub &sub ) noexcept
+{
+  if ( sub.src_type == 'K' )
+    return;
+  this->bcast_sub( BUS_MSG_UNSUB, sub.subject, sub.subject_len, sub.subj_hash,
+                   sub.bref, 0 );
+}
+
+void
+RouteBusPort::on_psub( NotifyPattern &pat ) noexcept
+{
+  if ( pat.src_type == 'K' )
+    return;
+  this->bcast_sub( BUS_MSG_PSUB, pat.pattern, pat.pattern_len,
+                   pat.prefix_hash, pat.bref, (uint8_t) pat.cvt.fmt );
+}
+
+void
+RouteBusPort::on_punsub( NotifyPattern &pat ) noexcept
+{
+  if ( pat.src_type == 'K' )
+    return;
+  this->bcast_sub( BUS_MSG_PUNSUB, pat.pattern, pat.pattern_len,
+                   pat.prefix_hash, pat.bref, (uint8_t) pat.cvt.fmt );
+}
+
+void
+RouteBusPort::on_bloom_ref( BloomRef &ref ) noexcept
+{
+  /* only the blooms of this thread, the same as kv pubsub hello */
+  if ( &ref.bloom_db != &this->poll.g_bloom_db )
+    return;
+  BloomCodec code;
+  ref.encode( code );
+  for ( uint32_t i = 0; i < this->bus.nthreads; i++ ) {
+    if ( this->peer[ i ] == NULL )
+      continue;
+    RouteBusMsg * m = RouteBusMsg::create( BUS_MSG_BLOOM, ref.name,
+                                           ::strlen( ref.name ), NULL, 0,
+                                           code.ptr, code.code_sz * 4 );
+    if ( m == NULL )
+      continue;
+    m->ref_num = ref.ref_num;
+    this->peer[ i ]->send( m );
+  }
+}
+
+void
+RouteBusPort::on_bloom_deref( BloomRef &ref ) noexcept
+{
+  if ( &ref.bloom_db != &this->poll.g_bloom_db )
+    return;
+  for ( uint32_t i = 0; i < this->bus.nthreads; i++ ) {
+    if ( this->peer[ i ] == NULL )
+      continue;
+    RouteBusMsg * m = RouteBusMsg::create( BUS_MSG_BLOOM_DEL, NULL, 0, NULL, 0,
+                                           NULL, 0 );
+    if ( m == NULL )
+      continue;
+    m->ref_num = ref.ref_num;
+    this->peer[ i ]->send( m );
+  }
+}
+
+RouteBusPeer::RouteBusPeer( EvPoll &p,  RouteBusPort &pt,
+                            uint32_t peer ) noexcept
+  : EvSocket( p, p.register_type( "route_bus" ) ), port( pt ),
+    in( pt.bus.get_ring( peer, pt.thr ) ),
+    out( pt.bus.get_ring( pt.thr, peer ) ),
+    bloom_rt( 0 ), sub_ref( 0 ), ovf_hd( 0 ), ovf_tl( 0 ), peer_thr( peer )
+{
+#ifdef HAVE_EVENTFD
+  this->sock_opts = OPT_READ_HI | OPT_NO_CLOSE;
+#else
+  this->sock_opts = OPT_NO_POLL;
+#endif
+}
+
+RouteBusPeer *
+RouteBusPeer::create( EvPoll &p,  RouteBusPort &pt,  uint32_t peer ) noexcept
+{
+  int efd;
+#ifdef HAVE_EVENTFD
+  efd = pt.bus.get_ring( peer, pt.thr ).wake_fd;
+#else
+  efd = p.get_null_fd();
+#endif
+  void * m = aligned_malloc( sizeof( RouteBusPeer ) );
+  if ( m == NULL ) {
+    perror( "alloc route bus peer" );
+    return NULL;
+  }
+  RouteBusPeer * c = new ( m ) RouteBusPeer( p, pt, peer );
+  char name[ 32 ];
+  ::snprintf( name, sizeof( name ), "bus%u", peer );
+  c->PeerData::init_peer( p.get_next_id(), efd, -1, NULL, "route_bus" );
+  c->PeerData::set_name( name, ::strlen( name ) );
+  c->sub_ref  = p.sub_route.create_bloom_ref( peer, name, c->sub_db );
+  c->bloom_rt = p.sub_route.create_bloom_route( efd, c->sub_ref, 0 );
+#ifndef HAVE_EVENTFD
+  c->push( EV_BUSY_POLL );
+#else
+  /* msgs may be queued before attach */
+  c->push( EV_PROCESS );
+#endif
+  if ( p.add_sock( c ) < 0 ) {
+    fprintf( stderr, "failed to add route bus peer %d\n", efd );
+    c->drop_bloom_refs();
+    c->~RouteBusPeer();
+    aligned_free( c );
+    return NULL;
+  }
+  return c;
+}
+
+void
+RouteBusPeer::send( RouteBusMsg *m ) noexcept
+{
+  if ( this->fd < 0 || kv_sync_load( &this->out.closed ) != 0 ) {
+    delete m;
+    return;
+  }
+  this->msgs_sent++;
+  if ( this->ovf_hd == NULL ) {
+    if ( this->out.push( m ) ) {
+      if ( this->out.need_wake() )
+        this->wake();
+      return;
+    }
+    this->ovf_hd = m;
+    this->idle_push( EV_WRITE );
+  }
+  else {
+    this->ovf_tl->next = m;
+  }
+  this->ovf_tl = m;
+}
+
+void
+RouteBusPeer::wake( void ) noexcept
+{
+#ifdef HAVE_EVENTFD
+  uint64_t one = 1;
+  if ( ::write( this->out.wake_fd, &one, sizeof( one ) ) < 0 &&
+       errno != EAGAIN )
+    perror( "write route bus" );
+#endif
+}
+
+void
+RouteBusPeer::write( void ) noexcept
+{
+  bool pushed = false;
+  if ( kv_sync_load( &this->out.closed ) != 0 ) {
+    while ( this->ovf_hd != NULL ) {
+      RouteBusMsg * m = this->ovf_hd;
+      this->ovf_hd = m->next;
+      delete m;
+    }
+  }
+  while ( this->ovf_hd != NULL ) {
+    RouteBusMsg * m = this->ovf_hd;
+    if ( ! this->out.push( m ) )
+      break;
+    pushed = true;
+    this->ovf_hd = m->next;
+    m->next = NULL;
+  }
+  if ( pushed && this->out.need_wake() )
+    this->wake();
+  /* stays in write state until the consumer makes room */
+  if ( this->ovf_hd == NULL ) {
+    this->ovf_tl = NULL;
+    this->pop( EV_WRITE );
+  }
+}
+
+void
+RouteBusPeer::read( void ) noexcept
+{
+#ifdef HAVE_EVENTFD
+  uint64_t cnt;
+  if ( ::read( this->fd, &cnt, sizeof( cnt ) ) < 0 ) {
+    if ( errno != EINTR && errno != EAGAIN ) {
+      perror( "read route bus" );
+      this->popall();
+      this->push( EV_CLOSE );
+      return;
+    }
+  }
+  this->read_ns = this->poll.now_ns;
+#endif
+  this->pop3( EV_READ, EV_READ_LO, EV_READ_HI );
+  this->push( EV_PROCESS );
+}
+
+uint32_t
+RouteBusPeer::drain( void ) noexcept
+{
+  RouteBusMsg * m;
+  uint32_t      n = 0;
+  this->in.clear_wake();
+  while ( n < RECV_BATCH && (m = this->in.pop()) != NULL ) {
+    this->recv_msg( *m );
+    delete m;
+    n++;
+  }
+  return n;
+}
+
+void
+RouteBusPeer::process( void ) noexcept
+{
+  /* if less than a batch, the ring is empty, otherwise yield to others */
+  if ( this->drain() < RECV_BATCH )
+    this->pop( EV_PROCESS );
+}
+
+bool
+RouteBusPeer::busy_poll( void ) noexcept
+{
+  return this->drain() > 0;
+}
+
+BloomRef *
+RouteBusPeer::get_ref( uint32_t ref_num ) noexcept
+{
+  if ( ref_num == (uint32_t) -1 )
+    return this->sub_ref;
+  if ( ref_num < this->bloom_db.count )
+    return this->bloom_db.ptr[ ref_num ];
+  return NULL;
+}
+
+void
+RouteBusPeer::recv_msg( RouteBusMsg &m ) noexcept
+{
+  BloomRef * ref;
+  switch ( m.type ) {
+    case BUS_MSG_PUB: {
+      EvPublish pub( m.subject(), m.subject_len, m.reply(), m.reply_len,
+                     m.data(), m.msg_len, this->poll.sub_route, *this,
+                     m.subj_hash, m.msg_enc, PUB_TYPE_BUS );
+      pub.pub_status = m.pub_status;
+      this->msgs_recv++;
+      this->poll.sub_route.forward_msg( pub );
+      break;
+    }
+    case BUS_MSG_SUB:
+      if ( (ref = this->get_ref( m.ref_num )) != NULL )
+        ref->add( m.subj_hash );
+      break;
+    case BUS_MSG_UNSUB:
+      if ( (ref = this->get_ref( m.ref_num )) != NULL )
+        ref->del( m.subj_hash );
+      break;
+    case BUS_MSG_PSUB:
+      this->recv_psub( m, true );
+      break;
+    case BUS_MSG_PUNSUB:
+      this->recv_psub( m, false );
+      break;
+    case BUS_MSG_BLOOM:
+      this->recv_bloom( m );
+      break;
+    case BUS_MSG_BLOOM_DEL:
+      this->recv_bloom_del( m );
+      break;
+    default:
+      break;
+  }
+}
+
+void
+RouteBusPeer::recv_psub( RouteBusMsg &m,  bool is_sub ) noexcept
+{
+  BloomRef * ref = this->get_ref( m.ref_num );
+  PatternCvt cvt;
+  BloomDetail d;
+  if ( ref == NULL )
+    return;
+  if ( m.pat_fmt == RV_PATTERN_FMT )
+    cvt.convert_rv( m.subject(), m.subject_len );
+  else
+    cvt.convert_glob( m.subject(), m.subject_len );
+  uint16_t pref_len = (uint16_t) cvt.prefixlen;
+  if ( ! d.from_pattern( cvt ) )
+    return;
+  if ( d.detail_type == NO_DETAIL ) {
+    if ( is_sub )
+      ref->add_route( pref_len, m.subj_hash );
+    else
+      ref->del_route( pref_len, m.subj_hash );
+  }
+  else if ( d.detail_type == SUFFIX_MATCH ) {
+    if ( is_sub )
+      ref->add_suffix_route( pref_len, m.subj_hash, d.u.suffix );
+    else
+      ref->del_suffix_route( pref_len, m.subj_hash, d.u.suffix );
+  }
+  else if ( d.detail_type == SHARD_MATCH ) {
+    if ( is_sub )
+      ref->add_shard_route( pref_len, m.subj_hash, d.u.shard );
+    else
+      ref->del_shard_route( pref_len, m.subj_hash, d.u.shard );
+  }
+}
+
+void
+RouteBusPeer::recv_bloom( RouteBusMsg &m ) noexcept
+{
+  char name[ 32 ];
+  size_t len = min_int<size_t>( m.subject_len, sizeof( name ) - 1 );
+  ::memcpy( name, m.subject(), len );
+  name[ len ] = '\0';
+  BloomRef * ref = this->poll.sub_route.update_bloom_ref( m.data(), m.msg_len,
+                                                          m.ref_num, name,
+                                                          this->bloom_db );
+  if ( ref != NULL && ! ref->has_route( this->bloom_rt ) )
+    this->bloom_rt->add_bloom_ref( ref );
+}
+
+void
+RouteBusPeer::recv_bloom_del( RouteBusMsg &m ) noexcept
+{
+  if ( m.ref_num >= this->bloom_db.count )
+    return;
+  BloomRef * ref = this->bloom_db.ptr[ m.ref_num ];
+  if ( ref != NULL ) {
+    this->bloom_rt->del_bloom_ref( ref );
+    this->bloom_db.ptr[ m.ref_num ] = NULL;
+    if ( ref->nlinks == 0 )
+      this->poll.sub_route.remove_bloom_ref( ref );
+  }
+}
+
+void
+RouteBusPeer::drop_bloom_refs( void ) noexcept
+{
+  if ( this->bloom_rt != NULL ) {
+    BloomRef * ref;
+    while ( (ref = this->bloom_rt->del_bloom_ref( NULL )) != NULL ) {
+      if ( ref->nlinks == 0 )
+        this->poll.sub_route.remove_bloom_ref( ref );
+    }
+    this->poll.sub_route.remove_bloom_route( this->bloom_rt );
+    this->bloom_rt = NULL;
+  }
+}
+
+void
+RouteBusPeer::release( void ) noexcept
+{
+  /* producer drops msgs after this */
+  kv_sync_store( &this->in.closed, (uint32_t) 1 );
+  while ( this->ovf_hd != NULL ) {
+    RouteBusMsg * m = this->ovf_hd;
+    this->ovf_hd = m->next;
+    delete m;
+  }
+  this->ovf_tl = NULL;
+  this->drop_bloom_refs();
+}
+
+bool
+RouteBusPeer::on_msg( EvPublish &pub ) noexcept
+{
+  /* kv is forwarded by the other process, bus by the source thread */
+  if ( pub.is_pub_type( PUB_TYPE_KV ) || pub.is_pub_type( PUB_TYPE_BUS ) )
+    return true;
+  RouteBusMsg * m = RouteBusMsg::create( BUS_MSG_PUB, pub.subject,
+                                         pub.subject_len, pub.reply,
+                                         pub.reply_len, pub.msg, pub.msg_len );
+  if ( m == NULL )
+    return true;
+  m->subj_hash  = pub.subj_hash;
+  m->msg_enc    = pub.msg_enc;
+  m->pub_status = pub.pub_status;
+  this->send( m );
+  return true;
+}
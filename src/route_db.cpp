@@ -61,6 +61,21 @@ RouteDB::RouteDB( BloomDB &g_db ) noexcept
 {
 }
 
+RouteDB::~RouteDB() noexcept
+{
+  for ( size_t i = 0; i < this->queue_db.count; i++ )
+    this->queue_db.ptr[ i ].release();
+  if ( this->q_ht != NULL )
+    delete this->q_ht;
+}
+
+void
+RouteDB::close_route( uint32_t r ) noexcept
+{
+  for ( size_t i = 0; i < this->queue_db.count; i++ )
+    this->queue_db.ptr[ i ].del_weight( r );
+}
+
 QueueName *
 QueueNameDB::get_queue_name( const QueueName &qn ) noexcept
 {
@@ -117,57 +132,136 @@ QueueDB::init( RouteCache &c,  RouteZip &z,  BloomGroup &b,  QueueName *qn,
   qn->refs++;
   this->q_name      = qn;
   this->route_group = new ( m ) RouteGroup( c, z, b, gn );
+  this->weight_ht   = NULL;
+  this->rand_state  = ( (uint64_t) qn->queue_hash << 32 ) | ( gn + 1 );
   this->next_route  = 0;
+  this->select      = QUEUE_ROUND_ROBIN;
+  ::memset( &this->stats, 0, sizeof( this->stats ) );
+}
+
+void
+QueueDB::set_weight( uint32_t r,  uint32_t w ) noexcept
+{
+  if ( this->weight_ht == NULL )
+    this->weight_ht = UIntHashTab::resize( NULL );
+  this->weight_ht->upsert_rsz( this->weight_ht, r, w );
+}
+
+void
+QueueDB::del_weight( uint32_t r ) noexcept
+{
+  if ( this->weight_ht != NULL )
+    this->weight_ht->find_remove_rsz( this->weight_ht, r );
+}
+
+void
+QueueDB::release( void ) noexcept
+{
+  if ( this->weight_ht != NULL ) {
+    delete this->weight_ht;
+    this->weight_ht = NULL;
+  }
 }
 
-RouteGroup &
-RouteDB::get_queue_group( const QueueName &qn ) noexcept
+QueueDB &
+RouteDB::get_queue_db( const QueueName &qn ) noexcept
 {
   size_t   pos;
   uint32_t i;
   if ( this->q_ht != NULL && this->q_ht->find( qn.queue_hash, pos, i ) )
-    return *this->queue_db.ptr[ i ].route_group;
+    return this->queue_db.ptr[ i ];
 
   i = this->queue_db.count;
   QueueName * q_ptr = this->g_bloom_db.q_db.get_queue_name( qn );
   QueueDB   & el    = this->queue_db.push();
-  el.init( this->cache, this->zip, this->bloom, q_ptr, i );
+  /* group_num 0 is this, it is part of the route cache key */
+  el.init( this->cache, this->zip, this->bloom, q_ptr, i + 1 );
   if ( this->q_ht == NULL )
     this->q_ht = UIntHashTab::resize( NULL );
   this->q_ht->upsert_rsz( this->q_ht, qn.queue_hash, i );
-  return *el.route_group;
+  return el;
 }
 
 RouteCache::RouteCache() noexcept
 {
-  this->ht         = RteCacheTab::resize( NULL );
-  this->end        = 0;
-  this->free       = 0;
-  this->count      = 0;
-  this->busy       = 0;
-  this->need       = 0;
-  this->hit_cnt    = 0;
-  this->miss_cnt   = 0;
-  this->max_cnt    = 0;
-  this->max_size   = 0;
-  this->is_invalid = false;
+  this->ht        = RteCacheTab::resize( NULL );
+  this->end       = 0;
+  this->free      = 0;
+  this->count     = 0;
+  this->busy      = 0;
+  this->need      = 0;
+  this->hit_cnt   = 0;
+  this->miss_cnt  = 0;
+  this->inval_cnt = 0;
+  this->evict_cnt = 0;
+  this->max_cnt   = 0;
+  this->max_size  = 0;
+  this->gen       = 0;
+  this->is_full   = false;
 }
 
 bool
 RouteCache::reset( void ) noexcept
 {
   if ( this->busy ) {
-    this->need       = 0;
-    this->is_invalid = true;
+    this->invalidate();
     return false;
   }
   this->ht->clear_all();
-  this->end        = 0;
-  this->free       = 0;
-  this->count      = 0;
-  this->busy       = 0;
-  this->need       = 0;
-  this->is_invalid = false;
+  this->end     = 0;
+  this->free    = 0;
+  this->count   = 0;
+  this->busy    = 0;
+  this->need    = 0;
+  this->is_full = false;
+  return true;
+}
+
+/* drop the stale entries and the entries not hit since the last evict(),
+ * keep up to half of MAX_CACHE of the others, compacted into new space */
+bool
+RouteCache::evict( void ) noexcept
+{
+  if ( this->busy )
+    return false;
+  static const size_t KEEP = RouteCache::MAX_CACHE / 2;
+  RteCacheTab * xht = RteCacheTab::resize( NULL );
+  RouteSpace    tmp;
+  size_t        pos, off = 0, cnt = 0;
+  uint64_t      h;
+  RteCacheVal   val;
+
+  if ( this->ht->first( pos ) ) {
+    do {
+      this->ht->get( pos, h, val );
+      if ( val.gen != this->gen )
+        continue;
+      if ( val.ref == 0 || off + val.rcnt > KEEP || cnt >= KEEP ) {
+        this->evict_cnt++;
+        continue;
+      }
+      uint32_t * ptr = tmp.make( off + val.rcnt + 1024 );
+      ::memcpy( &ptr[ off ], &this->spc.ptr[ val.off ],
+                sizeof( ptr[ 0 ] ) * val.rcnt );
+      val.off = (uint32_t) off;
+      val.ref = 0;
+      off    += val.rcnt;
+      cnt++;
+      RteCacheTab::upsert_rsz( xht, h, val );
+    } while ( this->ht->next( pos ) );
+  }
+  delete this->ht;
+  this->ht = xht;
+  this->spc.reset();
+  this->spc.ptr  = tmp.ptr;
+  this->spc.size = tmp.size;
+  tmp.ptr        = NULL;
+  tmp.size       = 0;
+  this->end      = off;
+  this->free     = 0;
+  this->count    = cnt;
+  this->need     = 0;
+  this->is_full  = false;
   return true;
 }
 
@@ -1280,6 +1374,7 @@ RouteDB::remove_bloom_ref( BloomRef *ref ) noexcept
        this->g_bloom_db[ ref->ref_num ] == ref ) {
     this->g_bloom_db[ ref->ref_num ] = NULL;
     ref->ref_num = -1;
+    ref->release_delta();
     this->g_bloom_db.bloom_mem.release_if_alloced( ref, sizeof( BloomRef ) );
   }
 }
@@ -1287,7 +1382,7 @@ RouteDB::remove_bloom_ref( BloomRef *ref ) noexcept
 BloomRef::BloomRef( uint32_t seed,  const char *nm,  BloomDB &db ) noexcept
         : bits( 0 ), links( 0 ), details( 0 ), pref_mask( 0 ),
           detail_mask( 0 ), nlinks( 0 ), ndetails( 0 ), ref_num( db.count ),
-          bloom_db( db ), sub_detail( false )
+          bloom_db( db ), delta( 0 ), sub_detail( false )
 {
   size_t len = ::strlen( nm );
   len = min_int( len, sizeof( this->name ) - 1 );
@@ -1302,7 +1397,7 @@ BloomRef::BloomRef( BloomBits *b,  const uint32_t *pref,
                     const char *nm,  BloomDB &db,  uint32_t num ) noexcept
         : bits( 0 ), links( 0 ), details( 0 ), pref_mask( 0 ),
           detail_mask( 0 ), nlinks( 0 ), ndetails( 0 ),
-          queue_cnt( 0 ), bloom_db( db ), sub_detail( false )
+          queue_cnt( 0 ), bloom_db( db ), delta( 0 ), sub_detail( false )
 {
   size_t len = ::strlen( nm );
   len = min_int( len, sizeof( this->name ) - 1 );
@@ -1372,6 +1467,7 @@ BloomRef::zero( void ) noexcept
   this->detail_mask = 0;
   this->queue_cnt   = 0;
   this->sub_detail  = false;
+  this->delta_reset();
 }
 
 BloomRef *
@@ -1478,6 +1574,8 @@ BloomRef::add_route( uint16_t prefix_len,  uint32_t hash ) noexcept
     this->ref_pref_count( prefix_len );
   this->bits->add( hash );
   this->invalid( prefix_len, hash );
+  if ( this->delta != NULL )
+    this->delta_append( prefix_len, hash, 1 );
   return this->bits->test_resize();
 }
 
@@ -1500,6 +1598,7 @@ BloomRef::add_detail( uint16_t prefix_len,  uint32_t hash ) noexcept
     this->detail_mask |= (uint64_t) 1 << prefix_len;
   else
     this->sub_detail = true;
+  this->delta_reset(); /* details are only in the full encode */
   return d[ n ];
 }
 
@@ -1558,6 +1657,8 @@ BloomRef::del_route( uint16_t prefix_len,  uint32_t hash ) noexcept
     this->deref_pref_count( prefix_len );
   this->bits->remove( hash );
   this->invalid( prefix_len, hash );
+  if ( this->delta != NULL )
+    this->delta_append( prefix_len, hash, -1 );
 }
 
 template <class Match>
@@ -1588,6 +1689,7 @@ BloomRef::del_detail( uint16_t prefix_len,  uint32_t hash,  const Match &match,
       ::memmove( &this->details[ j ], &this->details[ j + 1 ],
                  sizeof( this->details[ 0 ] ) * ( n - j ) );
     this->ndetails = n;
+    this->delta_reset();
     if ( ! ( ( j > 0 && d[ j - 1 ].prefix_len == prefix_len ) ||
              ( j < n && d[ j ].prefix_len == prefix_len ) ) ) {
       if ( prefix_len < SUB_RTE )
@@ -1651,9 +1753,8 @@ BloomRef::deref_pref_count( uint16_t prefix_len ) noexcept
 void
 BloomRoute::invalid( void ) noexcept
 {
-  this->rdb.cache.need       = 0;
-  this->rdb.cache.is_invalid = true;
-  this->is_invalid           = true;
+  this->rdb.cache.invalidate();
+  this->is_invalid = true;
 }
 
 void
@@ -1662,13 +1763,13 @@ BloomRef::invalid( uint16_t prefix_len,  uint32_t hash ) noexcept
   bool upd_cache = ( (uint32_t) prefix_len | hash ) != 0;
   for ( uint32_t i = 0; i < this->nlinks; i++ ) {
     BloomRoute * b = this->links[ i ];
-    if ( upd_cache && b->in_list > 0 ) {
+    /* any shard routes are in the entries of every shard */
+    if ( upd_cache && b->in_list > 0 && b->in_list - 1 != ANY_SHARD ) {
       uint32_t shard = b->in_list - 1;
       b->rdb.cache_purge( prefix_len, hash, shard );
     }
     else {
-      b->rdb.cache.need       = 0;
-      b->rdb.cache.is_invalid = true;
+      b->rdb.cache.invalidate();
     }
     b->is_invalid = true;
   }
@@ -1726,11 +1827,92 @@ BloomRef::update_route( const uint32_t *pref_count,  BloomBits *bits,
   }
   if ( had_subs || this->bits->count != 0 )
     this->invalid( 0, 0 );
+  this->delta_reset();
   /*printf( "update fd %d ndetails %u mask %lx\n",
           this->nlinks > 0 ? this->links[ 0 ]->r : -1,
           ndetails, this->detail_mask );*/
 }
 
+void
+BloomDeltaLog::trim( uint64_t to_seqno ) noexcept
+{
+  if ( to_seqno <= this->base_seqno || to_seqno > this->seqno )
+    return;
+  size_t n = (size_t) ( to_seqno - this->base_seqno );
+  if ( n < this->log.count )
+    ::memmove( this->log.ptr, &this->log.ptr[ n ],
+               ( this->log.count - n ) * sizeof( this->log.ptr[ 0 ] ) );
+  this->log.count -= n;
+  this->base_seqno = to_seqno;
+}
+
+uint64_t
+BloomRef::delta_seqno( void ) noexcept
+{
+  if ( this->delta == NULL ) {
+    /* start at a time, a new ref with a reused ref_num won't match */
+    void * p = ::malloc( sizeof( BloomDeltaLog ) );
+    this->delta = new ( p )
+      BloomDeltaLog( kv_current_monotonic_time_ns(), *this->bits );
+  }
+  else if ( this->delta->seed != this->bits->seed ||
+            this->delta->width != this->bits->width ) {
+    this->delta->reset( *this->bits ); /* resized or reseeded */
+  }
+  return this->delta->seqno;
+}
+
+bool
+BloomRef::can_delta( uint64_t from_seqno ) noexcept
+{
+  return this->delta != NULL && this->delta->has_delta( from_seqno );
+}
+
+void
+BloomRef::delta_append( uint16_t prefix_len,  uint32_t hash,
+                        int32_t cnt ) noexcept
+{
+  BloomDeltaLog & d = *this->delta;
+  /* a full encode is smaller than a log longer than the bloom count */
+  if ( d.log.count >= 1024 && d.log.count >= this->bits->count )
+    d.reset( *this->bits );
+  d.append( prefix_len, hash, cnt );
+}
+
+void
+BloomRef::encode_delta( uint64_t from_seqno,  BloomCodec &code ) noexcept
+{
+  BloomDeltaLog & d = *this->delta;
+  ArraySpace<BloomDeltaOp, 64> tmp;
+  uint32_t off  = (uint32_t) ( from_seqno - d.base_seqno ),
+           nops = (uint32_t) ( d.seqno - from_seqno );
+  /* encode_ops() sorts and merges the ops, the log is kept */
+  BloomDeltaOp * ops = tmp.make( nops );
+  ::memcpy( ops, &d.log.ptr[ off ], sizeof( ops[ 0 ] ) * nops );
+  code.encode_ops( from_seqno, ops, nops );
+}
+
+void
+BloomRef::apply_delta( const BloomDeltaOps &ops ) noexcept
+{
+  for ( size_t i = 0; i < ops.count; i++ ) {
+    const BloomDeltaOp & op = ops.ptr[ i ];
+    for ( int32_t j = 0; j < op.cnt; j++ )
+      this->add_route( op.prefix_len, op.hash );
+    for ( int32_t j = 0; j > op.cnt; j-- )
+      this->del_route( op.prefix_len, op.hash );
+  }
+}
+
+void
+BloomRef::release_delta( void ) noexcept
+{
+  if ( this->delta != NULL ) {
+    delete this->delta;
+    this->delta = NULL;
+  }
+}
+
 void
 BloomRef::encode( BloomCodec &code ) noexcept
 {
@@ -1855,18 +2037,26 @@ RouteGroup::cache_save( uint16_t prefix_len,  uint32_t hash,
                         uint32_t *routes,  uint32_t rcnt,
                         uint32_t shard ) noexcept
 {
-  if ( this->cache.is_invalid ) {
-do_reset:;
-    if ( ! this->cache.reset() )
-      return;
-  }
   uint32_t  * ptr;
   RteCacheVal val;
-  size_t      n = this->cache.end + rcnt;
+  size_t      pos,
+              n = this->cache.end + rcnt;
 
-  if ( ! this->cache.busy ) { /* no refs, ok to realloc() */
+  if ( n > RouteCache::MAX_CACHE ||
+       this->cache.ht->elem_count >= RouteCache::MAX_CACHE ) {
+    if ( ! this->cache.evict() ) { /* busy, evict when refs are released */
+      this->cache.is_full = true;
+      return;
+    }
+    n = this->cache.end + rcnt;
     if ( n > RouteCache::MAX_CACHE )
-      goto do_reset;
+      return;
+  }
+  if ( ! this->cache.busy ) { /* no refs, ok to realloc() */
+    if ( this->cache.is_full ) {
+      this->cache.evict();
+      n = this->cache.end + rcnt;
+    }
     ptr = this->cache.spc.make( n + 1024 );
   }
   else {
@@ -1880,18 +2070,21 @@ do_reset:;
   }
   val.rcnt = rcnt;
   val.off  = (uint32_t) this->cache.end;
+  val.gen  = this->cache.gen;
+  val.ref  = 0;
   this->cache.end += rcnt;
   ::memcpy( &ptr[ val.off ], routes, sizeof( routes[ 0 ] ) * rcnt );
 
   uint64_t h = ( (uint64_t) this->group_num << 48 ) |
                ( (uint64_t) shard << 40 ) |
                ( (uint64_t) prefix_len << 32 ) | (uint64_t) hash;
-  this->cache.ht->upsert( h, val ); /* save rcnt, off at hash */
-  this->cache.count++;
+  if ( this->cache.ht->find( h, pos ) ) /* replace a stale entry */
+    this->cache.free += this->cache.ht->tab[ pos ].val.rcnt;
+  else
+    this->cache.count++;
+  this->cache.ht->set( h, pos, val ); /* save rcnt, off at hash */
 
   if ( this->cache.ht->elem_count >= this->cache.ht->max_count ) {
-    if ( this->cache.ht->elem_count > RouteCache::MAX_CACHE )
-      goto do_reset;
     if ( this->cache.ht->elem_count >= this->cache.max_cnt )
       this->cache.max_cnt = this->cache.ht->elem_count;
     if ( this->cache.end >= this->cache.max_size )
@@ -1903,6 +2096,8 @@ do_reset:;
 void
 RouteGroup::cache_need( void ) noexcept
 {
+  if ( this->cache.is_full )
+    this->cache.evict();
   this->cache.spc.make( this->cache.end + this->cache.need );
   this->cache.need = 0;
 }
@@ -1911,18 +2106,18 @@ void
 RouteGroup::cache_purge( uint16_t prefix_len,  uint32_t hash,
                          uint32_t shard ) noexcept
 {
-  if ( ! this->cache.is_invalid ) {
-    uint64_t h = ( (uint64_t) this->group_num << 48 ) |
-             ( (uint64_t) shard << 40 ) |
-             ( (uint64_t) prefix_len << 32 ) | (uint64_t) hash;
-    size_t pos;
-    RteCacheVal val;
+  uint64_t h = ( (uint64_t) this->group_num << 48 ) |
+               ( (uint64_t) shard << 40 ) |
+               ( (uint64_t) prefix_len << 32 ) | (uint64_t) hash;
+  size_t pos;
+  RteCacheVal val;
 
-    if ( this->cache.ht->find( h, pos, val ) ) {
-      this->cache.free += val.rcnt;
-      this->cache.count--;
-      this->cache.ht->remove( pos );
-    }
+  if ( this->cache.ht->find( h, pos, val ) ) {
+    this->cache.free += val.rcnt;
+    this->cache.count--;
+    if ( val.gen == this->cache.gen )
+      this->cache.inval_cnt++;
+    this->cache.ht->remove( pos );
   }
 }
 
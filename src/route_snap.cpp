@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <raikv/route_db.h>
+#include <raikv/os_file.h>
+
+using namespace rai;
+using namespace kv;
+
+/* route snapshot file, every section is position independent:
+ *
+ *   RouteSnapHdr                  <- magic, file size, section count
+ *   RouteSnapSect + data          <- 8 byte aligned sections
+ *     SNAP_QUEUE    id = idx      <- queue name string
+ *     SNAP_ZIP_HT   val = 0       <- zip.zht image
+ *     SNAP_ZIP_CODE val = free    <- zip.code_buf[ 0 -> code_end ]
+ *     SNAP_GROUP    id = group    <- val = entry_count, queue name if id > 0
+ *     SNAP_RT_HASH  id = prefix   <- rt_hash[ prefix ] image of last group
+ *     SNAP_BLOOM    id = ref_num  <- name[ 32 ] + BloomCodec
+ *     SNAP_END
+ *
+ * the hash table images are the same as the malloc()ed tables, so attaching
+ * is a copy without rehashing any of the subjects */
+static const uint64_t SNAP_MAGIC   = 0x31706e73657472ULL; /* "rtesnp1" */
+static const uint32_t SNAP_VERSION = 1;
+
+enum SnapType {
+  SNAP_QUEUE    = 1,
+  SNAP_ZIP_HT   = 2,
+  SNAP_ZIP_CODE = 3,
+  SNAP_GROUP    = 4,
+  SNAP_RT_HASH  = 5,
+  SNAP_BLOOM    = 6,
+  SNAP_END      = 7
+};
+
+struct RouteSnapHdr {
+  uint64_t magic,
+           file_size;
+  uint32_t version,
+           sect_count;
+};
+
+struct RouteSnapSect {
+  uint32_t type, /* SnapType */
+           id;   /* prefix_len, group, ref_num */
+  uint64_t val,  /* entry_count, code_free */
+           size; /* size of data following */
+};
+
+static const size_t SNAP_NAME_SIZE = 32;
+
+static inline size_t snap_align( size_t sz ) {
+  return ( sz + 7 ) & ~(size_t) 7;
+}
+
+struct SnapOut {
+  int          fd;
+  uint64_t     off;
+  uint32_t     sect_count;
+  bool         ok;
+
+  SnapOut( int f ) : fd( f ), off( 0 ), sect_count( 0 ), ok( f >= 0 ) {}
+
+  void put( const void *data,  size_t len ) {
+    const char * p = (const char *) data;
+    while ( this->ok && len > 0 ) {
+      ssize_t n = os_write( this->fd, p, len );
+      if ( n <= 0 ) {
+        if ( n < 0 && errno == EINTR )
+          continue;
+        this->ok = false;
+        break;
+      }
+      p = &p[ n ]; len -= n; this->off += n;
+    }
+  }
+  void sect( uint32_t type,  uint32_t id,  uint64_t val,  const void *data,
+             size_t size,  const void *data2 = NULL,  size_t size2 = 0 ) {
+    static const uint64_t zero = 0;
+    RouteSnapSect s;
+    s.type = type;
+    s.id   = id;
+    s.val  = val;
+    s.size = size + size2;
+    this->put( &s, sizeof( s ) );
+    this->put( data, size );
+    this->put( data2, size2 );
+    this->put( &zero, snap_align( s.size ) - s.size );
+    this->sect_count++;
+  }
+};
+
+static bool
+snap_tab_ok( const RouteSnapSect &s ) noexcept
+{
+  const UIntHashTab * xht = (const UIntHashTab *) (const void *) &(&s)[ 1 ];
+  size_t sz;
+  if ( s.size < sizeof( UIntHashTab ) )
+    return false;
+  sz = xht->tab_size();
+  return sz >= 2 && ( sz & ( sz - 1 ) ) == 0 &&
+         xht->elem_count <= sz &&
+         UIntHashTab::alloc_size( sz ) == s.size;
+}
+
+static UIntHashTab *
+snap_copy_tab( const RouteSnapSect &s ) noexcept
+{
+  void * p = ::malloc( s.size );
+  if ( p != NULL )
+    ::memcpy( p, &(&s)[ 1 ], s.size );
+  return (UIntHashTab *) p;
+}
+
+uint32_t
+RouteRemap::remap( uint32_t r ) noexcept
+{
+  return r;
+}
+
+bool
+RouteDB::save_snap( const char *path ) noexcept
+{
+  char tmp[ 1024 ];
+  size_t i;
+  uint32_t k;
+  ::snprintf( tmp, sizeof( tmp ), "%s.tmp", path );
+
+  SnapOut out( os_open( tmp, O_CREAT | O_WRONLY | O_TRUNC, 0666 ) );
+  if ( ! out.ok ) {
+    perror( tmp );
+    return false;
+  }
+  RouteSnapHdr hdr;
+  ::memset( &hdr, 0, sizeof( hdr ) );
+  out.put( &hdr, sizeof( hdr ) );
+
+  QueueNameDB & q_db = this->g_bloom_db.q_db;
+  for ( i = 0; i < q_db.queue_name.count; i++ ) {
+    QueueName * qn = q_db.queue_name.ptr[ i ];
+    if ( qn != NULL )
+      out.sect( SNAP_QUEUE, (uint32_t) i, qn->queue_hash, qn->queue,
+                qn->queue_len );
+  }
+  out.sect( SNAP_ZIP_HT, 0, 0, this->zip.zht, this->zip.zht->mem_size() );
+  out.sect( SNAP_ZIP_CODE, 0, this->zip.code_free, this->zip.code_buf.ptr,
+            this->zip.code_end * sizeof( uint32_t ) );
+
+  for ( i = 0; i <= this->queue_db.count; i++ ) {
+    RouteGroup * g = this;
+    const void * name = NULL;
+    size_t       name_len = 0;
+    if ( i > 0 ) {
+      QueueDB & q = this->queue_db.ptr[ i - 1 ];
+      g        = q.route_group;
+      name     = q.q_name->queue;
+      name_len = q.q_name->queue_len;
+    }
+    out.sect( SNAP_GROUP, (uint32_t) i, g->entry_count, name, name_len );
+    for ( k = 0; k < MAX_RTE; k++ ) {
+      UIntHashTab * xht = g->rt_hash[ k ];
+      if ( ! xht->is_empty() )
+        out.sect( SNAP_RT_HASH, k, xht->elem_count, xht, xht->mem_size() );
+    }
+  }
+  for ( i = 0; i < this->g_bloom_db.count; i++ ) {
+    BloomRef * ref = this->g_bloom_db.ptr[ i ];
+    if ( ref != NULL && ref->bits != NULL ) {
+      char       name[ SNAP_NAME_SIZE ];
+      BloomCodec code;
+      ::memset( name, 0, sizeof( name ) );
+      ::memcpy( name, ref->name, sizeof( ref->name ) );
+      ref->encode( code );
+      out.sect( SNAP_BLOOM, (uint32_t) i, 0, name, sizeof( name ),
+                code.ptr, code.code_sz * sizeof( uint32_t ) );
+    }
+  }
+  out.sect( SNAP_END, 0, 0, NULL, 0 );
+
+  hdr.magic      = SNAP_MAGIC;
+  hdr.file_size  = out.off;
+  hdr.version    = SNAP_VERSION;
+  hdr.sect_count = out.sect_count;
+  if ( out.ok ) {
+    /* header is written last, a partial file does not have magic */
+    if ( ::lseek( out.fd, 0, SEEK_SET ) != 0 )
+      out.ok = false;
+    out.put( &hdr, sizeof( hdr ) );
+  }
+  if ( os_close( out.fd ) != 0 )
+    out.ok = false;
+  if ( ! out.ok || os_rename( tmp, path ) != 0 ) {
+    perror( path );
+    os_unlink( tmp );
+    return false;
+  }
+  return true;
+}
+
+bool
+RouteDB::attach_snap( const char *path ) noexcept
+{
+  if ( this->entry_count != 0 || this->queue_db.count != 0 ||
+       this->zip.code_end != 0 ) {
+    fprintf( stderr, "route snap %s: db not empty\n", path );
+    return false;
+  }
+  MapFile map( path );
+  if ( ! map.open() ) {
+    perror( path );
+    return false;
+  }
+  const RouteSnapHdr * hdr = (const RouteSnapHdr *) map.map;
+  if ( map.map_size < sizeof( RouteSnapHdr ) || hdr->magic != SNAP_MAGIC ||
+       hdr->version != SNAP_VERSION || hdr->file_size > map.map_size ) {
+    fprintf( stderr, "route snap %s: bad header\n", path );
+    return false;
+  }
+  const char  * start = (const char *) map.map,
+              * end   = &start[ hdr->file_size ],
+              * p     = &start[ sizeof( RouteSnapHdr ) ];
+  RouteGroup  * g     = this;
+  QueueNameDB & q_db  = this->g_bloom_db.q_db;
+  uint32_t      n;
+  bool          ok    = false;
+
+  for ( n = 0; n < hdr->sect_count; n++ ) {
+    const RouteSnapSect & s = *(const RouteSnapSect *) (const void *) p;
+    const char * data = (const char *) &(&s)[ 1 ];
+    if ( (size_t) ( end - p ) < sizeof( RouteSnapSect ) ||
+         s.size > (size_t) ( end - data ) )
+      break;
+    p = &data[ snap_align( s.size ) ];
+
+    if ( s.type == SNAP_END ) {
+      ok = true;
+      break;
+    }
+    switch ( s.type ) {
+      case SNAP_QUEUE:
+        q_db.get_queue_str( data, s.size );
+        break;
+      case SNAP_ZIP_HT:
+        if ( ! snap_tab_ok( s ) )
+          goto bad_sect;
+        delete this->zip.zht;
+        this->zip.zht = snap_copy_tab( s );
+        break;
+      case SNAP_ZIP_CODE:
+        if ( ( s.size % sizeof( uint32_t ) ) != 0 )
+          goto bad_sect;
+        this->zip.code_end  = s.size / sizeof( uint32_t );
+        this->zip.code_free = s.val;
+        ::memcpy( this->zip.code_buf.make( this->zip.code_end ), data,
+                  s.size );
+        break;
+      case SNAP_GROUP:
+        if ( s.id == 0 )
+          g = this;
+        else {
+          QueueName * qn = q_db.get_queue_str( data, s.size );
+          if ( qn == NULL )
+            goto bad_sect;
+          g = &this->get_queue_group( *qn );
+        }
+        g->entry_count = (uint32_t) s.val;
+        break;
+      case SNAP_RT_HASH:
+        if ( s.id >= MAX_RTE || ! snap_tab_ok( s ) )
+          goto bad_sect;
+        delete g->rt_hash[ s.id ];
+        g->rt_hash[ s.id ] = snap_copy_tab( s );
+        if ( ! g->rt_hash[ s.id ]->is_empty() )
+          g->add_prefix_len( (uint16_t) s.id, true );
+        break;
+      case SNAP_BLOOM: {
+        char name[ SNAP_NAME_SIZE ];
+        if ( s.size < sizeof( name ) )
+          goto bad_sect;
+        ::memcpy( name, data, sizeof( name ) );
+        name[ sizeof( name ) - 1 ] = '\0';
+        if ( this->update_bloom_ref( &data[ sizeof( name ) ],
+                                     s.size - sizeof( name ), s.id, name,
+                                     this->g_bloom_db ) == NULL )
+          goto bad_sect;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  if ( ! ok )
+    fprintf( stderr, "route snap %s: truncated\n", path );
+  return ok;
+bad_sect:;
+  fprintf( stderr, "route snap %s: bad section %u\n", path, n );
+  return false;
+}
+
+uint32_t
+RouteGroup::remap_routes( RouteRemap &map ) noexcept
+{
+  ArrayCount<uint32_t, 1024> hashes;
+  RouteSpace spc;
+  uint32_t   count = 0;
+
+  for ( uint16_t prefix_len = 0; prefix_len < MAX_RTE; prefix_len++ ) {
+    UIntHashTab * xht = this->rt_hash[ prefix_len ];
+    size_t        pos;
+    uint32_t      i, j, h, val, rcnt, xcnt;
+    /* collect hashes first, since entries are removed and moved */
+    hashes.count = 0;
+    if ( xht->first( pos ) ) {
+      do {
+        hashes.push( xht->tab[ pos ].hash );
+      } while ( xht->next( pos ) );
+    }
+    for ( i = 0; i < hashes.count; i++ ) {
+      h = hashes.ptr[ i ];
+      if ( ! xht->find( h, pos, val ) )
+        continue;
+      RouteRef rte( this->zip, prefix_len );
+      rcnt = rte.decompress( val, 0 );
+      uint32_t * routes = spc.make( rcnt );
+      for ( j = 0, xcnt = 0; j < rcnt; j++ ) {
+        uint32_t r = map.remap( rte.routes[ j ] );
+        if ( ( r & 0xc0000000 ) == 0 ) /* not illegal_route() */
+          xcnt = insert_route( r, routes, xcnt );
+      }
+      if ( xcnt == rcnt &&
+           ::memcmp( routes, rte.routes, rcnt * sizeof( uint32_t ) ) == 0 )
+        continue;
+      this->cache_purge( prefix_len, h, 0 );
+      if ( xcnt == 0 ) {
+        xht->remove( pos );
+        if ( xht->is_empty() )
+          this->del_prefix_len( prefix_len, true );
+        this->entry_count--;
+      }
+      else {
+        rte.copy( routes, xcnt );
+        xht->set( h, pos, rte.compress() );
+      }
+      rte.deref_coderef();
+      count++;
+    }
+    if ( UIntHashTab::check_resize( xht ) )
+      this->rt_hash[ prefix_len ] = xht;
+  }
+  return count;
+}
+
+uint32_t
+RouteDB::remap_snap( RouteRemap &map ) noexcept
+{
+  uint32_t count = this->remap_routes( map );
+  for ( size_t i = 0; i < this->queue_db.count; i++ )
+    count += this->queue_db.ptr[ i ].route_group->remap_routes( map );
+  return count;
+}
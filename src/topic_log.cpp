@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <raikv/topic_log.h>
+
+using namespace rai;
+using namespace kv;
+
+TopicLog::TopicLog( HashTab &m,  uint32_t dbx_id,  uint64_t max_sz ) noexcept
+  : map( m ), max_size( max_sz ), kctx( m, dbx_id, &this->kbuf )
+{
+  this->kbuf.zero();
+  m.hdr.get_hash_seed( this->kctx.db_num, this->hs );
+}
+
+bool
+TopicLog::set_subject( const char *sub,  size_t sublen ) noexcept
+{
+  uint64_t h1, h2;
+  /* null terminated, same as a string key */
+  if ( sublen + 1 > KeyBuf::MAX_BUF_SIZE )
+    return false;
+  ::memcpy( this->kbuf.u.buf, sub, sublen );
+  this->kbuf.u.buf[ sublen ] = '\0';
+  this->kbuf.keylen = (uint16_t) ( sublen + 1 );
+  this->hs.hash( this->kbuf, h1, h2 );
+  this->kctx.set_hash( h1, h2 );
+  return true;
+}
+
+KeyStatus
+TopicLog::publish_vector( const char *sub,  size_t sublen,  uint64_t count,
+                          void **msg,  msg_size_t *msg_size,
+                          uint64_t &seqno ) noexcept
+{
+  KeyStatus status;
+  if ( ! this->set_subject( sub, sublen ) )
+    return KEY_TOO_BIG;
+  this->wrk.reset();
+  if ( (status = this->kctx.acquire( &this->wrk )) > KEY_IS_NEW )
+    return status;
+  status = this->kctx.append_vector( count, msg, msg_size, this->max_size,
+                                     true );
+  if ( status == KEY_MSG_LIST_FULL ) {
+    /* release chain 2 and older, the oldest msgs, if there is no chain 2
+     * (alloc failed) release the whole list, the seqno continues */
+    uint64_t new_seqno =
+      this->kctx.get_serial_count( ValueCtr::SERIAL_MASK ) + 1;
+    if ( this->kctx.msg != NULL && this->kctx.msg_chain_size > 2 ) {
+      ValueGeom mchain;
+      this->kctx.msg->get_next( 2, mchain, this->kctx.seg_align_shift );
+      if ( mchain.size != 0 ) /* trim after the last msg of chain 2 */
+        new_seqno = ( ( mchain.serial - this->kctx.key ) &
+                      ValueCtr::SERIAL_MASK ) + 1;
+    }
+    if ( this->kctx.trim_msg( new_seqno ) == KEY_OK )
+      status = this->kctx.append_vector( count, msg, msg_size,
+                                         this->max_size, true );
+  }
+  if ( status == KEY_OK ) /* serial is inclusive, the seqno of the last msg */
+    seqno = this->kctx.get_serial_count( ValueCtr::SERIAL_MASK ) + 1 - count;
+  this->kctx.release();
+  return status;
+}
+
+KeyStatus
+TopicLog::read( const char *sub,  size_t sublen,  uint64_t &seqno,
+                void **msg,  msg_size_t *msg_size,  uint64_t &count ) noexcept
+{
+  KeyStatus status;
+  uint64_t  to_idx = seqno + count;
+  count = 0;
+  if ( ! this->set_subject( sub, sublen ) )
+    return KEY_TOO_BIG;
+  this->wrk.reset();
+  if ( (status = this->kctx.find( &this->wrk )) != KEY_OK )
+    return status;
+  if ( (status = this->kctx.msg_value( seqno, to_idx, msg,
+                                       msg_size )) == KEY_OK )
+    count = to_idx - seqno;
+  return status;
+}
+
+KeyStatus
+TopicLog::bounds( const char *sub,  size_t sublen,  uint64_t &first,
+                  uint64_t &last ) noexcept
+{
+  KeyStatus status;
+  if ( ! this->set_subject( sub, sublen ) )
+    return KEY_TOO_BIG;
+  this->wrk.reset();
+  if ( (status = this->kctx.find( &this->wrk )) != KEY_OK )
+    return status;
+  MsgIter iter( this->kctx );
+  last = this->kctx.get_serial_count( ValueCtr::SERIAL_MASK );
+  if ( ! iter.init( 0 ) )
+    return iter.status;
+  first = iter.seqno;
+  return KEY_OK;
+}
+
+KeyStatus
+TopicLog::trim( const char *sub,  size_t sublen,  uint64_t seqno ) noexcept
+{
+  KeyStatus status;
+  if ( ! this->set_subject( sub, sublen ) )
+    return KEY_TOO_BIG;
+  this->wrk.reset();
+  if ( (status = this->kctx.acquire( &this->wrk )) > KEY_IS_NEW )
+    return status;
+  if ( status == KEY_IS_NEW ) {
+    this->kctx.tombstone(); /* don't leave an empty key */
+    status = KEY_NOT_FOUND;
+  }
+  else
+    status = this->kctx.trim_msg( seqno );
+  this->kctx.release();
+  return status;
+}
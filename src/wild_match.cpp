@@ -0,0 +1,466 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <raikv/wild_match.h>
+#include <raikv/key_hash.h>
+#include <raikv/route_db.h>
+
+using namespace rai;
+using namespace kv;
+
+/* strip (S,N) from the end of pattern */
+static size_t
+strip_shard( const char *pat,  size_t patlen )
+{
+  if ( patlen > 0 ) {
+    PatternCvt cvt;
+    cvt.match_shard( pat, patlen );
+  }
+  return patlen;
+}
+
+/* * = [^.]+, > = .+, prefix when pattern ended with > */
+static bool
+rv_match( const char *p,  const char *pe,  const char *s,  const char *se,
+          bool is_prefix )
+{
+  while ( p < pe ) {
+    if ( *p == '*' || *p == '>' ) {
+      const bool any = ( *p++ == '>' );
+      /* one or more chars, then try the rest at each position */
+      if ( s == se || ( ! any && *s == '.' ) )
+        return false;
+      for ( s++; ; s++ ) {
+        if ( rv_match( p, pe, s, se, is_prefix ) )
+          return true;
+        if ( s == se || ( ! any && *s == '.' ) )
+          return false;
+      }
+    }
+    if ( s == se || *s != *p )
+      return false;
+    p++; s++;
+  }
+  return is_prefix || s == se;
+}
+
+bool
+WildMatch::match_rv( const char *pat,  size_t patlen,  const char *sub,
+                     size_t sublen ) noexcept
+{
+  bool is_prefix = false;
+  patlen = strip_shard( pat, patlen );
+  if ( patlen > 0 && PatternCvt::match_trail_wild<'>'>( pat, patlen ) ) {
+    patlen -= 1;
+    is_prefix = true;
+  }
+  return rv_match( pat, &pat[ patlen ], sub, &sub[ sublen ], is_prefix );
+}
+
+/* match c to [set], p is after '[', return false if no ']' */
+static bool
+glob_set( const char *&p,  const char *pe,  char c,  bool &is_match )
+{
+  bool neg = false, first = true;
+  is_match = false;
+  if ( p < pe && *p == '^' ) {
+    neg = true;
+    p++;
+  }
+  for ( ; p < pe; first = false ) {
+    char x = *p++;
+    if ( x == ']' && ! first ) {
+      if ( neg )
+        is_match = ! is_match;
+      return true;
+    }
+    if ( p + 1 < pe && *p == '-' && p[ 1 ] != ']' ) {
+      char y = p[ 1 ];
+      p += 2;
+      if ( (uint8_t) c >= (uint8_t) x && (uint8_t) c <= (uint8_t) y )
+        is_match = true;
+    }
+    else if ( c == x )
+      is_match = true;
+  }
+  return false;
+}
+
+/* * = .*, ? = ., [set], \x = x, prefix when pattern ended with * */
+static bool
+glob_match( const char *p,  const char *pe,  const char *s,  const char *se,
+            bool is_prefix )
+{
+  while ( p < pe ) {
+    switch ( *p ) {
+      case '*':
+        while ( p < pe && *p == '*' )
+          p++;
+        for (;;) {
+          if ( glob_match( p, pe, s, se, is_prefix ) )
+            return true;
+          if ( s == se )
+            return false;
+          s++;
+        }
+      case '?':
+        if ( s == se )
+          return false;
+        p++; s++;
+        break;
+      case '[': {
+        bool is_match;
+        if ( s == se )
+          return false;
+        p++;
+        if ( ! glob_set( p, pe, *s, is_match ) || ! is_match )
+          return false;
+        s++;
+        break;
+      }
+      case '\\':
+        if ( p + 1 < pe )
+          p++;
+        /* FALLTHRU */
+      default:
+        if ( s == se || *s != *p )
+          return false;
+        p++; s++;
+        break;
+    }
+  }
+  return is_prefix || s == se;
+}
+
+bool
+WildMatch::match_glob( const char *pat,  size_t patlen,  const char *sub,
+                       size_t sublen ) noexcept
+{
+  bool is_prefix = false;
+  patlen = strip_shard( pat, patlen );
+  if ( patlen > 0 && PatternCvt::match_trail_wild<'*'>( pat, patlen ) ) {
+    patlen -= 1;
+    is_prefix = true;
+  }
+  return glob_match( pat, &pat[ patlen ], sub, &sub[ sublen ], is_prefix );
+}
+
+static inline uint64_t
+seg_key( uint32_t n,  const char *seg,  size_t seglen )
+{
+  return kv_hash_murmur64( seg, seglen, n );
+}
+
+WildTrie::WildTrie() noexcept : pattern_count( 0 )
+{
+  void * p = ::malloc( sizeof( WildNode ) );
+  this->node.push( p == NULL ? NULL : new ( p ) WildNode() );
+}
+
+WildTrie::~WildTrie() noexcept
+{
+  this->release();
+  if ( this->node.count > 0 && this->node.ptr[ 0 ] != NULL )
+    delete this->node.ptr[ 0 ];
+}
+
+void
+WildTrie::release( void ) noexcept
+{
+  for ( size_t i = 1; i < this->node.count; i++ ) {
+    if ( this->node.ptr[ i ] != NULL )
+      delete this->node.ptr[ i ];
+  }
+  WildNode * root = this->node.ptr[ 0 ];
+  if ( root != NULL ) {
+    root->~WildNode();
+    new ( root ) WildNode();
+  }
+  this->node.count = 1;
+  this->free_node.count = 0;
+  this->child.clear_all();
+  this->pattern_count = 0;
+}
+
+uint32_t
+WildTrie::find_child( uint32_t n,  const char *seg,
+                      size_t seglen ) const noexcept
+{
+  size_t   pos;
+  uint32_t c;
+  if ( ! this->child.find( seg_key( n, seg, seglen ), pos, c ) )
+    return 0;
+  const WildNode & x = *this->node.ptr[ c ];
+  if ( x.parent != n || x.seg_len != seglen ||
+       ::memcmp( x.seg, seg, seglen ) != 0 )
+    return 0;
+  return c;
+}
+
+uint32_t
+WildTrie::add_child( uint32_t n,  const char *seg,  size_t seglen,
+                     bool is_star ) noexcept
+{
+  uint64_t key = 0;
+  size_t   pos;
+  uint32_t c;
+  if ( ! is_star ) {
+    key = seg_key( n, seg, seglen );
+    if ( seglen > 0xffffU || this->child.find( key, pos ) )
+      return 0; /* collision, different seg with same key */
+  }
+  void * p = ::malloc( sizeof( WildNode ) ),
+       * s = ::malloc( seglen + 1 );
+  if ( p == NULL || s == NULL ) {
+    if ( p != NULL ) ::free( p );
+    if ( s != NULL ) ::free( s );
+    return 0;
+  }
+  WildNode * x = new ( p ) WildNode();
+  ::memcpy( s, seg, seglen );
+  ((char *) s)[ seglen ] = '\0';
+  x->seg     = (char *) s;
+  x->seg_len = (uint16_t) seglen;
+  x->key     = key;
+  x->parent  = n;
+  x->is_star = is_star;
+  if ( this->free_node.count > 0 )
+    c = this->free_node.ptr[ --this->free_node.count ];
+  else {
+    c = (uint32_t) this->node.count;
+    this->node.push( (WildNode *) NULL );
+  }
+  this->node.ptr[ c ] = x;
+  if ( is_star )
+    this->node.ptr[ n ]->star = c;
+  else
+    this->child.upsert( key, c );
+  this->node.ptr[ n ]->ref++;
+  return c;
+}
+
+void
+WildTrie::release_node( uint32_t n ) noexcept
+{
+  /* remove nodes which are no longer used, up to the root */
+  while ( n != 0 && this->node.ptr[ n ]->ref == 0 ) {
+    WildNode * x = this->node.ptr[ n ];
+    uint32_t   p = x->parent;
+    if ( x->is_star )
+      this->node.ptr[ p ]->star = 0;
+    else {
+      size_t pos;
+      if ( this->child.find( x->key, pos ) )
+        this->child.remove( pos );
+    }
+    delete x;
+    this->node.ptr[ n ] = NULL;
+    this->free_node.push( n );
+    this->node.ptr[ p ]->ref--;
+    n = p;
+  }
+}
+
+uint32_t
+WildTrie::find_node( const char *pat,  size_t patlen,  PatternFmt fmt,
+                     bool do_add,  WildKind &kind ) noexcept
+{
+  const char * wild = ( fmt == GLOB_PATTERN_FMT ? "*?[]\\" : "*>" );
+  const char * dot;
+  uint32_t     n = 0, c;
+  size_t       off = 0, end, len,
+               walk_len = patlen; /* segments to walk */
+  bool         has_seg  = true;   /* if walk_len == 0, an empty seg */
+
+  kind = WILD_TERM;
+  /* a.> a.* > * end at a prefix of the subject, a* a.b* do not */
+  if ( ( fmt == GLOB_PATTERN_FMT &&
+         PatternCvt::match_trail_wild<'*'>( pat, patlen ) ) ||
+       ( fmt == RV_PATTERN_FMT &&
+         PatternCvt::match_trail_wild<'>'>( pat, patlen ) ) ) {
+    patlen -= 1;
+    if ( patlen == 0 || pat[ patlen - 1 ] == '.' ) {
+      kind     = WILD_TAIL;
+      has_seg  = ( patlen > 0 );
+      walk_len = ( has_seg ? patlen - 1 : 0 );
+    }
+    else {
+      /* walk the segments before the last, which is matched by pattern */
+      kind = WILD_OTHER;
+      for ( walk_len = patlen; walk_len > 0; walk_len-- )
+        if ( pat[ walk_len - 1 ] == '.' )
+          break;
+      has_seg  = ( walk_len > 0 );
+      walk_len = ( has_seg ? walk_len - 1 : 0 );
+    }
+  }
+  while ( has_seg ) {
+    const char * seg = &pat[ off ];
+    dot = (const char *) ::memchr( seg, '.', walk_len - off );
+    end = ( dot == NULL ? walk_len : (size_t) ( dot - pat ) );
+    len = end - off;
+    bool is_star = ( fmt == RV_PATTERN_FMT && len == 1 && seg[ 0 ] == '*' );
+    if ( ! is_star ) {
+      for ( size_t i = 0; i < len; i++ ) {
+        if ( ::strchr( wild, seg[ i ] ) != NULL ) {
+          kind = WILD_OTHER; /* matched by pattern at this node */
+          return n;
+        }
+      }
+      c = this->find_child( n, seg, len );
+    }
+    else {
+      c = this->node.ptr[ n ]->star;
+    }
+    /* not found, or a collision when adding, the pattern is at this node */
+    if ( c == 0 &&
+         ( ! do_add || (c = this->add_child( n, seg, len, is_star )) == 0 ) ) {
+      kind = WILD_OTHER;
+      return n;
+    }
+    n = c;
+    if ( dot == NULL )
+      break;
+    off = end + 1;
+  }
+  return n;
+}
+
+bool
+WildTrie::add( const char *pat,  size_t patlen,  PatternFmt fmt,
+               uint32_t id ) noexcept
+{
+  WildKind kind = WILD_TERM;
+  uint32_t n;
+  size_t   len = strip_shard( pat, patlen );
+
+  if ( len == 0 || patlen > 0xffffU || this->node.ptr[ 0 ] == NULL )
+    return false;
+  n = this->find_node( pat, len, fmt, true, kind );
+  WildNode & x = *this->node.ptr[ n ];
+  if ( kind == WILD_OTHER ) {
+    WildPattern * w = WildPattern::create( id, pat, patlen, fmt );
+    if ( w == NULL ) {
+      this->release_node( n );
+      return false;
+    }
+    x.other.push( w );
+  }
+  else if ( kind == WILD_TAIL )
+    x.tail.push( id );
+  else
+    x.term.push( id );
+  x.ref++;
+  this->pattern_count++;
+  return true;
+}
+
+template <class List, class El>
+static bool
+list_remove( List &list,  El el )
+{
+  for ( size_t i = 0; i < list.count; i++ ) {
+    if ( list.ptr[ i ] == el ) {
+      list.ptr[ i ] = list.ptr[ --list.count ];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+WildTrie::remove( const char *pat,  size_t patlen,  PatternFmt fmt,
+                  uint32_t id ) noexcept
+{
+  WildKind kind = WILD_TERM;
+  uint32_t n;
+  size_t   len = strip_shard( pat, patlen );
+  bool     found = false;
+
+  if ( len == 0 || this->node.ptr[ 0 ] == NULL )
+    return false;
+  n = this->find_node( pat, len, fmt, false, kind );
+  WildNode & x = *this->node.ptr[ n ];
+  if ( kind == WILD_OTHER ) {
+    for ( size_t i = 0; i < x.other.count; i++ ) {
+      WildPattern * w = x.other.ptr[ i ];
+      if ( w->id == id && w->fmt == fmt && w->len == patlen &&
+           ::memcmp( w->pat, pat, patlen ) == 0 ) {
+        delete w;
+        x.other.ptr[ i ] = x.other.ptr[ --x.other.count ];
+        found = true;
+        break;
+      }
+    }
+  }
+  else if ( kind == WILD_TAIL )
+    found = list_remove( x.tail, id );
+  else
+    found = list_remove( x.term, id );
+  if ( ! found )
+    return false;
+  x.ref--;
+  this->pattern_count--;
+  this->release_node( n );
+  return true;
+}
+
+bool
+WildTrie::add( const NotifyPattern &pat,  uint32_t id ) noexcept
+{
+  return this->add( pat.pattern, pat.pattern_len, pat.cvt.fmt, id );
+}
+
+bool
+WildTrie::remove( const NotifyPattern &pat,  uint32_t id ) noexcept
+{
+  return this->remove( pat.pattern, pat.pattern_len, pat.cvt.fmt, id );
+}
+
+void
+WildTrie::match_node( uint32_t n,  const char *sub,  size_t sublen,
+                      size_t off,  bool at_end,
+                      WildMatchIds &ids ) const noexcept
+{
+  const WildNode & x = *this->node.ptr[ n ];
+  size_t i;
+  if ( at_end ) {
+    for ( i = 0; i < x.term.count; i++ )
+      ids.push( x.term.ptr[ i ] );
+  }
+  else {
+    for ( i = 0; i < x.tail.count; i++ )
+      ids.push( x.tail.ptr[ i ] );
+  }
+  /* other patterns have at least one more segment, except at the root */
+  if ( ! at_end || n == 0 ) {
+    for ( i = 0; i < x.other.count; i++ ) {
+      const WildPattern & w = *x.other.ptr[ i ];
+      if ( WildMatch::match( w.fmt, w.pat, w.len, sub, sublen ) )
+        ids.push( w.id );
+    }
+  }
+  if ( at_end )
+    return;
+  const char * seg = &sub[ off ];
+  const char * dot = (const char *) ::memchr( seg, '.', sublen - off );
+  size_t       end = ( dot == NULL ? sublen : (size_t) ( dot - sub ) ),
+               len = end - off;
+  uint32_t     c;
+  if ( (c = this->find_child( n, seg, len )) != 0 )
+    this->match_node( c, sub, sublen, end + 1, dot == NULL, ids );
+  if ( x.star != 0 && len > 0 )
+    this->match_node( x.star, sub, sublen, end + 1, dot == NULL, ids );
+}
+
+size_t
+WildTrie::match( const char *sub,  size_t sublen,
+                 WildMatchIds &ids ) const noexcept
+{
+  size_t cnt = ids.count;
+  if ( this->node.count == 0 || this->node.ptr[ 0 ] == NULL )
+    return 0;
+  this->match_node( 0, sub, sublen, 0, false, ids );
+  return ids.count - cnt;
+}
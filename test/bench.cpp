@@ -12,7 +12,7 @@ using namespace kv;
 
 HashTabGeom geom;
 HashTab   * map;
-uint32_t    ctx_id = MAX_CTX_ID;
+uint32_t    ctx_id = KV_NO_CTX_ID;
 
 static const uint64_t MAP_SIZE = 8 * 1024 * 1024;
 
@@ -39,13 +39,16 @@ shm_open( void )
 static void
 shm_close( void )
 {
-  if ( ctx_id != MAX_CTX_ID ) {
-    HashCounters & stat = map->ctx[ ctx_id ].stat;
+  if ( ctx_id < map->max_ctx_count() ) { /* KV_NO_CTX_ID if not attached */
+    HashDeltaCounters stats;
+    HashCounters      ops, stat;
+    stats.zero();
+    map->sum_ht_thr_delta( stats, ops, stat, ctx_id );
     printf( "rd %" PRIu64 ", wr %" PRIu64 ", "
             "sp %" PRIu64 ", ch %" PRIu64 "\n",
             stat.rd, stat.wr, stat.spins, stat.chains );
     map->detach_ctx( ctx_id );
-    ctx_id = MAX_CTX_ID;
+    ctx_id = KV_NO_CTX_ID;
   }
   /*if ( map != NULL )
     map->close();*/
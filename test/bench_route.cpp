@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <math.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#else
+#include <raikv/win.h>
+#endif
+#include <raikv/ev_net.h>
+#include <raikv/route_db.h>
+#include <raikv/ev_publish.h>
+#include <raikv/delta_coder.h>
+#include <raikv/zipf.h>
+#include <raikv/util.h>
+
+using namespace rai;
+using namespace kv;
+
+/* Synthetic subscription populations timed through the route db:
+ *   subjects are s.<i/10000>.<i/100>.<i>, i < subj count
+ *   exact subs on subjects drawn uniform or zipf, random fd
+ *   wildcard subs on s.> or the first 1 .. depth segments after s.
+ * Publish uses RoutePublish::forward_msg() to sockets which count msgs */
+
+static const char *
+get_arg( int argc, char *argv[], int b, const char *f, const char *def )
+{
+  for ( int i = 1; i < argc - b; i++ )
+    if ( ::strcmp( f, argv[ i ] ) == 0 )
+      return argv[ i + b ];
+  return def; /* default value */
+}
+
+/* endpoint that counts the msgs forwarded to it */
+struct BenchSub : public EvSocket {
+  uint64_t msg_count;
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  BenchSub( EvPoll &p,  uint8_t t ) : EvSocket( p, t ), msg_count( 0 ) {
+    this->sock_opts = OPT_NO_POLL;
+  }
+  virtual bool on_msg( EvPublish & ) noexcept {
+    this->msg_count++;
+    return true;
+  }
+  virtual void write( void ) noexcept {}
+  virtual void read( void ) noexcept {}
+  virtual void process( void ) noexcept {}
+  virtual void release( void ) noexcept {}
+};
+
+struct BenchResult {
+  const char * name;
+  uint64_t     count;    /* operations */
+  double       ns_op,    /* nanos per operation */
+               hit_rate, /* cache hits / lookups, -1 if not used */
+               fanout;   /* msgs forwarded per publish, -1 if not used */
+};
+
+struct BenchRun {
+  BenchResult res[ 16 ];
+  size_t      nres;
+  uint64_t    start_ns,
+              hit_cnt,
+              miss_cnt;
+  RouteCache * cache;
+
+  BenchRun( RouteCache *c ) : nres( 0 ), start_ns( 0 ), hit_cnt( 0 ),
+                              miss_cnt( 0 ), cache( c ) {}
+  void start( void ) {
+    if ( this->cache != NULL ) {
+      this->hit_cnt  = this->cache->hit_cnt;
+      this->miss_cnt = this->cache->miss_cnt;
+    }
+    this->start_ns = current_monotonic_time_ns();
+  }
+  BenchResult &stop( const char *name,  uint64_t count,
+                     bool use_cache = false ) {
+    uint64_t     ns = current_monotonic_time_ns() - this->start_ns;
+    BenchResult &r  = this->res[ this->nres++ ];
+    r.name     = name;
+    r.count    = count;
+    r.ns_op    = ( count > 0 ? (double) ns / (double) count : 0 );
+    r.hit_rate = -1;
+    r.fanout   = -1;
+    if ( use_cache && this->cache != NULL ) {
+      uint64_t hit  = this->cache->hit_cnt - this->hit_cnt,
+               miss = this->cache->miss_cnt - this->miss_cnt;
+      if ( hit + miss > 0 )
+        r.hit_rate = (double) hit / (double) ( hit + miss );
+    }
+    return r;
+  }
+};
+
+/* subject i, or the prefix s.[seg.] of depth segments when depth < 3 */
+static size_t
+make_subject( char *buf,  uint64_t i,  uint32_t depth )
+{
+  uint64_t seg[ 3 ] = { i / 10000, i / 100, i };
+  size_t   len = 2;
+  buf[ 0 ] = 's';
+  buf[ 1 ] = '.';
+  for ( uint32_t k = 0; k < 3; k++ ) {
+    if ( k == depth )
+      return len;
+    len += uint64_to_string( seg[ k ], &buf[ len ] );
+    if ( k < 2 )
+      buf[ len++ ] = '.';
+  }
+  buf[ len ] = '\0';
+  return len;
+}
+
+template <class Gen>
+static void
+gen_index( Gen &gen,  uint64_t *idx,  uint64_t count )
+{
+  for ( uint64_t i = 0; i < count; i++ )
+    idx[ i ] = gen.next();
+}
+
+struct UniformGen {
+  rand::xoroshiro128plus & r;
+  uint64_t cnt;
+  UniformGen( uint64_t c,  rand::xoroshiro128plus &rng ) : r( rng ), cnt( c ) {}
+  uint64_t next( void ) { return this->r.next() % this->cnt; }
+};
+
+int
+main( int argc, char *argv[] )
+{
+  const char * su = get_arg( argc, argv, 1, "-s", "100000" ),
+             * sj = get_arg( argc, argv, 1, "-n", "1000000" ),
+             * wi = get_arg( argc, argv, 1, "-w", "1000" ),
+             * de = get_arg( argc, argv, 1, "-d", "2" ),
+             * fd = get_arg( argc, argv, 1, "-f", "64" ),
+             * pu = get_arg( argc, argv, 1, "-p", "1000000" ),
+             * zi = get_arg( argc, argv, 0, "-z", 0 ),
+             * js = get_arg( argc, argv, 0, "-j", 0 ),
+             * he = get_arg( argc, argv, 0, "-h", 0 );
+  if ( he != NULL ) {
+    fprintf( stderr,
+      "%s [-s subs] [-n subjects] [-w wild] [-d depth] [-f fds] [-p pubs] "
+      "[-z] [-j]\n"
+      "  -s subs     : exact subscriptions (%s)\n"
+      "  -n subjects : subject space the subs are drawn from (%s)\n"
+      "  -w wild     : wildcard subscriptions (%s)\n"
+      "  -d depth    : max segments in a wildcard prefix, 0 -> 2 (%s)\n"
+      "  -f fds      : endpoints the subs are spread over (%s)\n"
+      "  -p pubs     : publishes (%s)\n"
+      "  -z          : zipf distribution, otherwise uniform\n"
+      "  -j          : print results as json\n",
+      argv[ 0 ], su, sj, wi, de, fd, pu );
+    return 1;
+  }
+  uint64_t sub_cnt  = strtoull( su, NULL, 0 ),
+           subj_cnt = strtoull( sj, NULL, 0 ),
+           wild_cnt = strtoull( wi, NULL, 0 ),
+           pub_cnt  = strtoull( pu, NULL, 0 );
+  uint64_t i, j, n;
+  uint32_t depth    = (uint32_t) atoi( de ),
+           fd_cnt   = (uint32_t) atoi( fd );
+  bool     is_zipf  = ( zi != NULL ),
+           is_json  = ( js != NULL );
+
+  if ( subj_cnt == 0 )
+    subj_cnt = 1;
+  if ( depth > 2 ) depth = 2;
+  if ( fd_cnt < 1 ) fd_cnt = 1;
+
+  EvPoll poll;
+  if ( poll.init( 5, false ) != 0 )
+    return 1;
+  RoutePublish & rp   = poll.sub_route;
+  uint8_t        type = poll.register_type( "bench_sub" );
+  BenchSub    ** sock = (BenchSub **) ::malloc( sizeof( BenchSub * ) * fd_cnt );
+  uint32_t     * fds  = (uint32_t *) ::malloc( sizeof( uint32_t ) * fd_cnt );
+  for ( i = 0; i < fd_cnt; i++ ) {
+    int nfd = poll.get_null_fd();
+    if ( nfd < 0 ) {
+      fprintf( stderr, "out of fds at %" PRIu64 "\n", i );
+      return 1;
+    }
+    sock[ i ] = new ( ::malloc( sizeof( BenchSub ) ) ) BenchSub( poll, type );
+    sock[ i ]->PeerData::init_peer( poll.get_next_id(), nfd, -1, NULL, "bench" );
+    if ( poll.add_sock( sock[ i ] ) != 0 )
+      return 1;
+    fds[ i ] = (uint32_t) nfd;
+  }
+
+  rand::xoroshiro128plus rng;
+  rng.static_init();
+  uint64_t   idx_cnt = ( sub_cnt > pub_cnt ? sub_cnt : pub_cnt );
+  uint64_t * idx     = (uint64_t *) ::malloc( sizeof( uint64_t ) *
+                                              ( idx_cnt + 1 ) );
+  uint32_t * hash    = (uint32_t *) ::malloc( sizeof( uint32_t ) *
+                                              ( idx_cnt + 1 ) );
+  uint32_t * route   = (uint32_t *) ::malloc( sizeof( uint32_t ) *
+                                              ( idx_cnt + 1 ) );
+  char       buf[ 64 ];
+  size_t     len;
+  BenchRun   run( &rp.cache );
+
+  if ( is_zipf ) {
+    ZipfianGen<99,100,rand::xoroshiro128plus> zgen( subj_cnt, rng );
+    gen_index( zgen, idx, idx_cnt );
+  }
+  else {
+    UniformGen ugen( subj_cnt, rng );
+    gen_index( ugen, idx, idx_cnt );
+  }
+  /* exact subs */
+  for ( i = 0; i < sub_cnt; i++ ) {
+    len = make_subject( buf, idx[ i ], 3 );
+    hash[ i ]  = kv_crc_c( buf, len, 0 );
+    route[ i ] = fds[ rng.next() % fd_cnt ];
+  }
+  run.start();
+  for ( i = 0; i < sub_cnt; i++ )
+    rp.add_sub_route( hash[ i ], route[ i ] );
+  run.stop( "sub", sub_cnt );
+
+  /* wildcard subs, prefix hashes */
+  run.start();
+  for ( i = 0; i < wild_cnt; i++ ) {
+    len = make_subject( buf, rng.next() % subj_cnt,
+                        depth == 0 ? 0 : 1 + (uint32_t) ( rng.next() % depth ) );
+    rp.add_pattern_route_str( buf, (uint16_t) len, fds[ i % fd_cnt ] );
+  }
+  run.stop( "psub", wild_cnt );
+
+  /* publish to the subs subjects, first pass fills the cache */
+  PeerId src;
+  src.start_ns = 0;
+  src.fd       = -1;
+  src.route_id = 0;
+  uint64_t msg_count = 0;
+  for ( int pass = 0; pass < 2; pass++ ) {
+    if ( pass == 0 )
+      rp.cache.reset();
+    for ( j = 0; j < fd_cnt; j++ )
+      sock[ j ]->msg_count = 0;
+    run.start();
+    for ( i = 0; i < pub_cnt; i++ ) {
+      len = make_subject( buf, idx[ i ], 3 );
+      EvPublish pub( buf, len, NULL, 0, "x", 1, rp, src,
+                     kv_crc_c( buf, len, 0 ), 0 );
+      rp.forward_msg( pub );
+    }
+    BenchResult &r = run.stop( pass == 0 ? "publish_cold" : "publish",
+                               pub_cnt, true );
+    msg_count = 0;
+    for ( j = 0; j < fd_cnt; j++ )
+      msg_count += sock[ j ]->msg_count;
+    r.fanout = ( pub_cnt > 0 ? (double) msg_count / (double) pub_cnt : 0 );
+  }
+
+  /* route lookup without forwarding */
+  for ( i = 0; i < pub_cnt; i++ ) {
+    len = make_subject( buf, idx[ i ], 3 );
+    hash[ i ] = kv_crc_c( buf, len, 0 );
+  }
+  n = 0;
+  run.start();
+  for ( i = 0; i < pub_cnt; i++ ) {
+    RouteLookup look( NULL, 0, hash[ i ], 0 );
+    rp.get_sub_route( look );
+    n += look.rcount;
+    look.deref( rp );
+  }
+  run.stop( "get_sub_route", pub_cnt, true ).fanout =
+    ( pub_cnt > 0 ? (double) n / (double) pub_cnt : 0 );
+
+  /* unsub everything added above */
+  for ( i = 0; i < sub_cnt; i++ ) {
+    len = make_subject( buf, idx[ i ], 3 );
+    hash[ i ] = kv_crc_c( buf, len, 0 );
+  }
+  run.start();
+  for ( i = 0; i < sub_cnt; i++ )
+    rp.del_sub_route( hash[ i ], route[ i ] );
+  run.stop( "unsub", sub_cnt );
+
+  /* delta coding of route lists the size of the fd set */
+  DeltaCoder dc;
+  uint32_t   rcnt = ( fd_cnt < 1024 ? fd_cnt : 1024 ),
+             vals[ 1024 ], code[ 1024 ], out[ 1024 ], ccnt = 0;
+  uint64_t   iter = 100000;
+  for ( i = 0; i < rcnt; i++ )
+    vals[ i ] = fds[ i ];
+  run.start();
+  for ( i = 0; i < iter; i++ ) {
+    vals[ 0 ] = fds[ 0 ] - ( i & 1 );
+    ccnt = dc.encode_stream( rcnt, vals, 0, code );
+  }
+  run.stop( "delta_encode", iter );
+  run.start();
+  for ( i = 0; i < iter; i++ )
+    n = dc.decode_stream( ccnt, code, 0, out );
+  run.stop( "delta_decode", iter );
+
+  /* bloom routes, one filter per fd */
+  BloomDB   bdb;
+  RouteDB   bloom_rdb( bdb );
+  BloomRef ** bref = (BloomRef **) ::malloc( sizeof( BloomRef * ) * fd_cnt );
+  for ( j = 0; j < fd_cnt; j++ ) {
+    bref[ j ] = bloom_rdb.create_bloom_ref( (uint32_t) j, "bench", bdb );
+    bloom_rdb.create_bloom_route( fds[ j ], bref[ j ], 0 );
+  }
+  /* hash[] has the sub hashes from unsub, grow the filters when full */
+  for ( i = 0; i < sub_cnt; i++ ) {
+    for ( j = 0; fds[ j ] != route[ i ]; j++ )
+      ;
+    if ( bref[ j ]->add( hash[ i ] ) ) {
+      BloomBits * bits = BloomBits::resize( bref[ j ]->bits, (uint32_t) j, 20 );
+      for ( uint64_t k = 0; k <= i; k++ )
+        if ( route[ k ] == route[ i ] )
+          bits->add( hash[ k ] );
+      bref[ j ]->bits = bits;
+    }
+  }
+  for ( i = 0; i < pub_cnt; i++ ) {
+    len = make_subject( buf, idx[ i ], 3 );
+    hash[ i ] = kv_crc_c( buf, len, 0 );
+  }
+  bloom_rdb.cache.reset();
+  run.cache = &bloom_rdb.cache;
+  n = 0;
+  run.start();
+  for ( i = 0; i < pub_cnt; i++ ) {
+    RouteLookup look( NULL, 0, hash[ i ], 0 );
+    bloom_rdb.get_sub_route( look );
+    n += look.rcount;
+    look.deref( bloom_rdb );
+  }
+  run.stop( "bloom_route", pub_cnt, true ).fanout =
+    ( pub_cnt > 0 ? (double) n / (double) pub_cnt : 0 );
+
+  if ( is_json ) {
+    printf( "{\"config\":{\"subs\":%" PRIu64 ",\"subjects\":%" PRIu64
+            ",\"wild\":%" PRIu64 ",\"depth\":%u,\"fds\":%u,\"pubs\":%" PRIu64
+            ",\"dist\":\"%s\"},\n \"results\":[",
+            sub_cnt, subj_cnt, wild_cnt, depth, fd_cnt, pub_cnt,
+            is_zipf ? "zipf" : "uniform" );
+    for ( size_t k = 0; k < run.nres; k++ ) {
+      BenchResult &r = run.res[ k ];
+      printf( "%s\n  {\"name\":\"%s\",\"count\":%" PRIu64 ",\"ns_op\":%.1f",
+              k == 0 ? "" : ",", r.name, r.count, r.ns_op );
+      if ( r.hit_rate >= 0 )
+        printf( ",\"hit_rate\":%.4f", r.hit_rate );
+      if ( r.fanout >= 0 )
+        printf( ",\"fanout\":%.2f", r.fanout );
+      printf( "}" );
+    }
+    printf( "\n ]}\n" );
+  }
+  else {
+    printf( "subs %" PRIu64 " subjects %" PRIu64 " wild %" PRIu64
+            " depth %u fds %u pubs %" PRIu64 " %s\n",
+            sub_cnt, subj_cnt, wild_cnt, depth, fd_cnt, pub_cnt,
+            is_zipf ? "zipf" : "uniform" );
+    for ( size_t k = 0; k < run.nres; k++ ) {
+      BenchResult &r = run.res[ k ];
+      printf( "%-14s %10" PRIu64 " ops %10.1f ns/op", r.name, r.count,
+              r.ns_op );
+      if ( r.hit_rate >= 0 )
+        printf( "  hit %5.1f%%", r.hit_rate * 100.0 );
+      if ( r.fanout >= 0 )
+        printf( "  fanout %.2f", r.fanout );
+      printf( "\n" );
+    }
+  }
+  return 0;
+}
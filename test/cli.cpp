@@ -23,7 +23,7 @@ using namespace kv;
 
 HashTabGeom geom;
 HashTab   * map;
-uint32_t    ctx_id = MAX_CTX_ID,
+uint32_t    ctx_id = KV_NO_CTX_ID,
             dbx_id = MAX_STAT_ID,
             my_pid, no_pid = 666;
 uint8_t     db_num = 0;
@@ -104,9 +104,9 @@ static void
 shm_close( void )
 {
   print_stats();
-  if ( ctx_id != MAX_CTX_ID ) {
+  if ( ctx_id != KV_NO_CTX_ID ) {
     map->detach_ctx( ctx_id );
-    ctx_id = MAX_CTX_ID;
+    ctx_id = KV_NO_CTX_ID;
   }
   delete map;
 }
@@ -114,72 +114,21 @@ shm_close( void )
 static void
 fix_locks( void )
 {
-  uint32_t hash_entry_size = map->hdr.hash_entry_size;
-  for ( uint32_t c = 1; c < MAX_CTX_ID; c++ ) {
-    uint32_t pid = map->ctx[ c ].ctx_pid;
-    if ( pid == 0 || map->ctx[ c ].ctx_id == KV_NO_CTX_ID )
-      continue;
-    if ( pidexists( pid ) != 0 )
-      continue;
-
-    uint64_t used, recovered = 0;
-    if ( (used = map->ctx[ c ].mcs_used) == 0 )
-      continue;
-
-    for ( uint32_t id = 0; id < 64; id++ ) {
-      if ( ( used & ( (uint64_t) 1 << id ) ) == 0 )
-        continue;
-      uint64_t mcs_id = ( c << ThrCtxEntry::MCS_SHIFT ) | id;
-      ThrMCSLock &mcs = map->ctx[ c ].get_mcs_lock( mcs_id );
-      MCSStatus status;
-      xprintf(
-      "ctx %u: pid %u, mcs %u, val 0x%" PRIx64 ", lock 0x%" PRIx64 ", next 0x%" PRIx64 ", link %" PRIu64 "\n",
-               c, pid, id, mcs.val.load(), mcs.lock.load(), mcs.next.load(),
-               mcs.lock_id );
-      if ( mcs.lock_id != 0 ) {
-        HashEntry *el = map->get_entry( mcs.lock_id - 1,
-                                        map->hdr.hash_entry_size );
-        ThrCtxOwner  closure( map->ctx );
-        status = mcs.recover_lock( el->hash, ZOMBIE64, mcs_id, closure );
-        if ( status == MCS_OK ) {
-          ValueCtr &ctr = el->value_ctr( hash_entry_size );
-          if ( ctr.seal == 0 ) {
-            ctr.seal = 1; /* these are lost with the context thread */
-          }
-          status = mcs.recover_unlock( el->hash, ZOMBIE64, mcs_id, closure );
-          if ( status == MCS_OK ) {
-            xprintf( "mcs_id %u:%u recovered\n", c, id );
-            recovered |= ( (uint64_t) 1 << id );
-          }
-        }
-        if ( status != MCS_OK ) {
-          xprintf( "mcs_id %u:%u status %s\n", c, id,
-                   status == MCS_WAIT ? "MCS_WAIT" : "MCS_INACTIVE" );
-        }
-      }
-    }
-    map->ctx[ c ].mcs_used &= ~recovered;
-    if ( used != recovered ) {
-      xprintf( "ctx %u still has locks\n", c );
-    }
-    else {
-      map->detach_ctx( c );
-    }
-  }
+  map->recover_dead_ctx( true );
 }
 
 static void
 print_stats( uint32_t c )
 {
-  if ( c != MAX_CTX_ID ) {
+  if ( c != KV_NO_CTX_ID ) {
     int alive = 0;
     HashDeltaCounters stats;
     HashCounters ops, tot;
     stats.zero(); ops.zero(); tot.zero();
     map->sum_ht_thr_delta( stats, ops, tot, ctx_id );
-    uint32_t pid = map->ctx[ c ].ctx_pid;
+    uint32_t pid = map->get_ctx( c ).ctx_pid;
     if ( pid != 0 ) {
-      if ( map->ctx[ c ].ctx_id != KV_NO_CTX_ID ) {
+      if ( map->get_ctx( c ).ctx_id != KV_NO_CTX_ID ) {
         alive = 1;
         if ( pidexists( pid ) == 1 )
           alive = 2;
@@ -377,7 +326,8 @@ gc_seg( uint32_t s )
                 "orphans[%u]=%" PRIu64 " "
                 "immovable[%u]=%" PRIu64 "\n"
               "  msglist[%u]=%" PRIu64 "(%u) "
-                "compact[%u]=%" PRIu64 "\n",
+                "compact[%u]=%" PRIu64 " "
+                "pinned[%u]=%" PRIu64 "\n",
     stats.seg_pos, stats.new_pos,
     stats.moved, stats.moved_size, 
     stats.zombie, stats.zombie_size, 
@@ -386,7 +336,8 @@ gc_seg( uint32_t s )
     stats.orphans, stats.orphans_size, 
     stats.immovable, stats.immovable_size, 
     stats.msglist, stats.msglist_size,  stats.chains,
-    stats.compact, stats.compact_size ); 
+    stats.compact, stats.compact_size,
+    stats.pinned, stats.pinned_size ); 
 }
 
 static void
@@ -981,38 +932,38 @@ cli( void )
       cmd_char = last_cmd = cmd[ 0 ];
     switch ( cmd_char ) {
       case 'c': /* contexts */
-        for ( i = 0; i < MAX_CTX_ID; i++ ) {
-          if ( map->ctx[ i ].ctx_pid != 0 )
+        for ( i = 0; i < map->max_ctx_count(); i++ ) {
+          if ( map->get_ctx( i ).ctx_pid != 0 )
             print_stats( i );
         }
         break;
 
       case 'C': { /* open contexts */
-        ThrStatLink stat[ MAX_STAT_ID ];
-        ::memcpy( stat, map->hdr.stat_link, sizeof( stat ) );
-        for ( i = 0; i < MAX_CTX_ID; i++ ) {
-          if ( map->ctx[ i ].ctx_id != KV_NO_CTX_ID &&
-               map->ctx[ i ].ctx_pid != 0 ) {
+        for ( i = 0; i < map->max_ctx_count(); i++ ) {
+          if ( map->get_ctx( i ).ctx_id != KV_NO_CTX_ID &&
+               map->get_ctx( i ).ctx_pid != 0 ) {
             print_stats( i );
             xprintf( "db:" );
-            for ( j = 0; j < MAX_STAT_ID; j++ ) {
-              if ( stat[ j ].ctx_id == i && stat[ j ].used )
-                xprintf( " %u(ln=%u)", stat[ j ].db_num, j );
+            for ( j = 0; j < map->max_stat_count(); j++ ) {
+              ThrStatLink & link = map->get_stat_link( HashTab::stat_id( j ) );
+              if ( link.ctx_id == i && link.used )
+                xprintf( " %u(ln=%u)", link.db_num, HashTab::stat_id( j ) );
             }
             xprintf( "\n" );
             xprintf( "ln:" );
-            for ( j = map->ctx[ i ].db_stat_hd; j != MAX_STAT_ID; 
-                  j = stat[ j ].next ) {
-              xprintf( " %u(db=%u)", j, stat[ j ].db_num );
+            for ( j = map->get_ctx( i ).db_stat_hd; j != MAX_STAT_ID; 
+                  j = map->get_stat_link( j ).next ) {
+              xprintf( " %u(db=%u)", j, map->get_stat_link( j ).db_num );
             }
             xprintf( "\n" );
           }
         }
         xprintf( "stat used:" );
-        for ( i = 0; i < MAX_STAT_ID; i++ ) {
-          if ( stat[ i ].used )
-            xprintf( " %u(ctx=%u,db=%u)", i, stat[ i ].ctx_id,
-                                             stat[ i ].db_num );
+        for ( i = 0; i < map->max_stat_count(); i++ ) {
+          ThrStatLink & link = map->get_stat_link( HashTab::stat_id( i ) );
+          if ( link.used )
+            xprintf( " %u(ctx=%u,db=%u)", HashTab::stat_id( i ), link.ctx_id,
+                                             link.db_num );
         }
         xprintf( "\n" );
         break;
@@ -1486,12 +1437,12 @@ cli( void )
 
       case 'z': /* play dead */
         xprintf( "suspend ctx_id %u, pid %u\n", ctx_id, my_pid );
-        map->ctx[ ctx_id ].ctx_pid = no_pid;
+        map->get_ctx( ctx_id ).ctx_pid = no_pid;
         break;
 
       case 'Z': /* unplay dead */
         xprintf( "unsuspend ctx_id %u, pid %u\n", ctx_id, my_pid );
-        map->ctx[ ctx_id ].ctx_pid = my_pid;
+        map->get_ctx( ctx_id ).ctx_pid = my_pid;
         break;
 
       case 'y': /* fix locks */
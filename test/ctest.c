@@ -418,7 +418,7 @@ main( int argc,  char *argv[] )
   ht = kv_attach_map( mn, 0, &geom );
   if ( ht == NULL )
     perror( mn );
-  fputs( kv_print_map_geom( ht, KV_MAX_CTX_ID, NULL, 0 ), stdout );
+  fputs( kv_print_map_geom( ht, KV_NO_CTX_ID, NULL, 0 ), stdout );
   process_input_data( fn, num_thr );
   kv_close_map( ht );
   return 0;
@@ -110,7 +110,10 @@ main( int argc, char *argv[] )
        meow_x2_diff = false,
        meow_x4 = false,
        meow_x4_diff = false,
-       meow_x8 = false;
+       meow_x8 = false,
+       meow_x4_arr = false,
+       meow_x8_arr = false,
+       meow_ar = false;
 #elif defined( USE_KV_AES_HASH )
                "aes";
 #elif defined( USE_KV_SPOOKY_HASH )
@@ -143,6 +146,9 @@ cmd_error:;
              "meowx4_same "
              "meowx4_diff "
              "meowx8_same "
+             "meowx4_arr "
+             "meowx8_arr "
+             "meowar "
 #endif
 #if defined( USE_KV_SPOOKY_HASH )
              "spooky "
@@ -222,6 +228,18 @@ cmd_error:;
     func = NULL;
     meow_x8 = true;
   }
+  else if ( ::strcmp( name, "meowx4_arr" ) == 0 ) {
+    func = NULL;
+    meow_x4_arr = true;
+  }
+  else if ( ::strcmp( name, "meowx8_arr" ) == 0 ) {
+    func = NULL;
+    meow_x8_arr = true;
+  }
+  else if ( ::strcmp( name, "meowar" ) == 0 ) {
+    func = NULL;
+    meow_ar = true;
+  }
   else
 #endif
 #if defined( USE_KV_SPOOKY_HASH )
@@ -236,7 +254,8 @@ cmd_error:;
 #if defined( USE_KV_MEOW_HASH )
   if ( func == NULL &&
        ! meow_x2 && ! meow_x2_diff && ! meow_x4 && ! meow_x4_diff &&
-       ! meow_x8 && ! crc_hash && ! crcx2_hash && ! crcx4_hash && ! crcar_hash )
+       ! meow_x8 && ! meow_x4_arr && ! meow_x8_arr && ! meow_ar &&
+       ! crc_hash && ! crcx2_hash && ! crcx4_hash && ! crcar_hash )
 #else
   if ( func == NULL && ! crc_hash && ! crcx2_hash && ! crcx4_hash && ! crcar_hash )
 #endif
@@ -440,6 +459,34 @@ cmd_error:;
       }
     }
   }
+  /* array hash of different lengths eq to single key hash */
+  for ( n = 0; n < 128; n++ )
+    buf[ n ] = (char) ( n * 7 + 3 );
+  for ( n = 0; n < 200; n++ ) {
+    const void * ap[ 13 ];
+    size_t       asz[ 13 ];
+    uint64_t     ah[ 26 ], sh[ 2 ], ah4[ 8 ], ah8[ 16 ];
+    for ( size_t m = 0; m < 13; m++ ) {
+      asz[ m ] = ( n * 13 + m * 37 ) % 128;
+      ap[ m ]  = &buf[ 128 - asz[ m ] ];
+    }
+    ah[ 0 ]  = 10101; ah[ 1 ]  = 20202;
+    ah4[ 0 ] = 10101; ah4[ 1 ] = 20202;
+    ah8[ 0 ] = 10101; ah8[ 1 ] = 20202;
+    kv_hash_meow128_array( ap, asz, ah, 13 );
+    kv_hash_meow128_4_diff_length_a( ap, asz, ah4 );
+    kv_hash_meow128_8_diff_length_a( ap, asz, ah8 );
+    for ( size_t m = 0; m < 13; m++ ) {
+      sh[ 0 ] = 10101; sh[ 1 ] = 20202;
+      kv_hash_meow128( ap[ m ], asz[ m ], &sh[ 0 ], &sh[ 1 ] );
+      if ( sh[ 0 ] != ah[ m * 2 ] || sh[ 1 ] != ah[ m * 2 + 1 ] )
+        printf( "array diff %" PRIu64 " %" PRIu64 "\n", n, (uint64_t) m );
+      if ( m < 4 && ( sh[ 0 ] != ah4[ m * 2 ] || sh[ 1 ] != ah4[ m * 2 + 1 ] ) )
+        printf( "array4 diff %" PRIu64 " %" PRIu64 "\n", n, (uint64_t) m );
+      if ( m < 8 && ( sh[ 0 ] != ah8[ m * 2 ] || sh[ 1 ] != ah8[ m * 2 + 1 ] ) )
+        printf( "array8 diff %" PRIu64 " %" PRIu64 "\n", n, (uint64_t) m );
+    }
+  }
 #endif
   printf( "hash=%s with keylen=%u\n", name, keylen );
   printf( "timing iteration count = %" PRIu64 "\n\n", TEST_COUNT );
@@ -725,6 +772,70 @@ cmd_error:;
         cov[ h[ 15 ] % ht_size ]++;
       }
     }
+    else if ( meow_x4_arr || meow_x8_arr ) {
+      const size_t stride = ( meow_x4_arr ? 4 : 8 );
+      const void * p[ 8 ];
+      size_t       sz[ 8 ];
+      t1 = current_monotonic_time_s();
+      j = 0;
+      for ( i = 0; i < TEST_COUNT; i += stride ) {
+        uint64_t h[ 16 ];
+        h[ 0 ] = 0; h[ 1 ] = 0;
+        for ( size_t l = 0; l < stride; l++ ) {
+          p[ l ]  = kb[ j + l ].kb.u.buf;
+          sz[ l ] = kb[ j + l ].kb.keylen;
+        }
+        if ( meow_x4_arr )
+          kv_hash_meow128_4_diff_length_a( p, sz, h );
+        else
+          kv_hash_meow128_8_diff_length_a( p, sz, h );
+        j = ( j + stride ) & ( keycount - 1 );
+      }
+      t2 = current_monotonic_time_s();
+      t2 -= t1;
+
+      ::memset( cov, 0, ht_size * sizeof( cov[ 0 ] ) );
+      for ( j = 0; j < keycount; j += stride ) {
+        uint64_t h[ 16 ];
+        h[ 0 ] = 0; h[ 1 ] = 0;
+        for ( size_t l = 0; l < stride; l++ ) {
+          p[ l ]  = kb[ j + l ].kb.u.buf;
+          sz[ l ] = kb[ j + l ].kb.keylen;
+        }
+        if ( meow_x4_arr )
+          kv_hash_meow128_4_diff_length_a( p, sz, h );
+        else
+          kv_hash_meow128_8_diff_length_a( p, sz, h );
+        for ( size_t l = 0; l < stride; l++ )
+          cov[ h[ l * 2 ] % ht_size ]++;
+      }
+    }
+    else if ( meow_ar ) {
+      KeyFragment * ar[ 16 ];
+      t1 = current_monotonic_time_s();
+      j = 0;
+      for ( i = 0; i < TEST_COUNT; i += 16 ) {
+        uint64_t h[ 32 ];
+        h[ 0 ] = 0; h[ 1 ] = 0;
+        for ( size_t l = 0; l < 16; l++ )
+          ar[ l ] = &kb[ j + l ].kb;
+        KeyFragment::hash_array( ar, h, 16 );
+        j = ( j + 16 ) & ( keycount - 1 );
+      }
+      t2 = current_monotonic_time_s();
+      t2 -= t1;
+
+      ::memset( cov, 0, ht_size * sizeof( cov[ 0 ] ) );
+      for ( j = 0; j < keycount; j += 16 ) {
+        uint64_t h[ 32 ];
+        h[ 0 ] = 0; h[ 1 ] = 0;
+        for ( size_t l = 0; l < 16; l++ )
+          ar[ l ] = &kb[ j + l ].kb;
+        KeyFragment::hash_array( ar, h, 16 );
+        for ( size_t l = 0; l < 16; l++ )
+          cov[ h[ l * 2 ] % ht_size ]++;
+      }
+    }
     else {
 #endif
       t1 = current_monotonic_time_s();
@@ -0,0 +1,601 @@
+#include <stdio.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#else
+#include <raikv/win.h>
+#endif
+#include <raikv/shm_ht.h>
+#include <raikv/key_buf.h>
+#include <raikv/zipf.h>
+
+using namespace rai;
+using namespace kv;
+
+/* YCSB like mixes of read, update, insert, delete, read-modify-write over
+ * zipfian keys, N workers each attached to a ctx, as threads or processes:
+ *
+ *   kv_bench -m file:/tmp/kv.shm -c 1024 -t 8 -w a -n 10
+ *
+ * The load phase inserts the records, the run phase executes the mix, the
+ * latency of each op is sampled with rdtsc into a log histogram */
+
+enum BenchOp {
+  OP_READ   = 0,
+  OP_UPDATE = 1,
+  OP_INSERT = 2,
+  OP_DELETE = 3,
+  OP_RMW    = 4,
+  OP_COUNT  = 5
+};
+static const char *op_str[ OP_COUNT ] = {
+  "read", "update", "insert", "delete", "rmw"
+};
+
+/* log2 buckets with 16 linear sub-buckets, error < 6.25% */
+struct LatHisto {
+  static const uint32_t SUB_BITS = 4,
+                        SUB      = 1 << SUB_BITS,
+                        NBUCKET  = 61 * SUB;
+  uint64_t cnt[ NBUCKET ],
+           total,
+           max;
+
+  void zero( void ) { ::memset( this, 0, sizeof( *this ) ); }
+  static uint32_t index( uint64_t v ) {
+    if ( v < SUB )
+      return (uint32_t) v;
+    uint32_t b = 63 - (uint32_t) __builtin_clzll( v );
+    return ( b - SUB_BITS + 1 ) * SUB +
+           (uint32_t) ( ( v >> ( b - SUB_BITS ) ) & ( SUB - 1 ) );
+  }
+  static uint64_t value( uint32_t i ) {
+    if ( i < SUB )
+      return i;
+    uint32_t b = i / SUB + SUB_BITS - 1;
+    return (uint64_t) ( SUB + ( i % SUB ) ) << ( b - SUB_BITS );
+  }
+  void add( uint64_t v ) {
+    this->cnt[ index( v ) ]++;
+    this->total++;
+    if ( v > this->max )
+      this->max = v;
+  }
+  void merge( const LatHisto &h ) {
+    for ( uint32_t i = 0; i < NBUCKET; i++ )
+      this->cnt[ i ] += h.cnt[ i ];
+    this->total += h.total;
+    if ( h.max > this->max )
+      this->max = h.max;
+  }
+  /* value at percentile p, 0 -> 1 */
+  uint64_t percentile( double p ) const {
+    uint64_t target = (uint64_t) ceil( (double) this->total * p ),
+             sum    = 0;
+    if ( target == 0 )
+      return 0;
+    for ( uint32_t i = 0; i < NBUCKET; i++ ) {
+      if ( (sum += this->cnt[ i ]) >= target )
+        return value( i );
+    }
+    return this->max;
+  }
+};
+
+/* results of a worker, in shared memory when workers are processes */
+struct BenchResult {
+  LatHisto     lat[ OP_COUNT ];  /* in rdtsc ticks */
+  uint64_t     ops[ OP_COUNT ],
+               fail[ OP_COUNT ],
+               load_ops;
+  HashCounters stat;             /* ctx counters delta of the run phase */
+  double       run_secs,
+               ns_per_tick;
+  uint32_t     ctx_id;
+  bool         done;
+};
+
+struct BenchShared {
+  volatile uint64_t insert_next; /* next key inserted */
+  volatile uint32_t ready;       /* workers loaded, start run phase */
+  BenchResult       res[ 1 ];    /* one for each worker */
+};
+
+struct BenchConfig {
+  HashTab   * map;
+  BenchShared * shared;
+  uint64_t    record_count,  /* keys loaded and drawn from */
+              op_count;      /* ops for each worker, or num_secs */
+  double      num_secs;
+  uint32_t    mix[ OP_COUNT ], /* percent of each op */
+              nworkers,
+              ncpus,
+              datasize;
+  uint8_t     db_num;
+  bool        use_zipf,
+              use_latest,
+              pin_cpu;
+  void      * data;
+};
+
+struct BenchWorker {
+  BenchConfig & cfg;
+  BenchResult & res;
+  HashTab     & map;
+  WorkAlloc8k   wrk;
+  KeyBuf        kb;
+  rand::xoroshiro128plus rand;
+  uint32_t      num,
+                ctx_id,
+                dbx_id;
+
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  void operator delete( void *ptr ) { ::free( ptr ); }
+  BenchWorker( BenchConfig &c,  uint32_t n )
+    : cfg( c ), res( c.shared->res[ n ] ), map( *c.map ), num( n ),
+      ctx_id( KV_NO_CTX_ID ), dbx_id( 0 ) {
+    this->rand.init();
+  }
+  void pin( void ) noexcept;
+  bool put( uint64_t k ) noexcept;
+  bool get( uint64_t k ) noexcept;
+  bool del( uint64_t k ) noexcept;
+  void load( void ) noexcept;
+  void run( void ) noexcept;
+  void bench( void ) noexcept;
+};
+
+void
+BenchWorker::pin( void ) noexcept
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO( &set );
+  CPU_SET( this->num % this->cfg.ncpus, &set );
+  if ( ::sched_setaffinity( 0, sizeof( set ), &set ) != 0 )
+    perror( "sched_setaffinity" );
+#endif
+}
+
+bool
+BenchWorker::put( uint64_t k ) noexcept
+{
+  KeyCtx kctx( this->map, this->dbx_id, &this->kb );
+  void * p;
+  bool   b = false;
+  this->kb.set( k );
+  kctx.set_key_hash( this->kb );
+  if ( kctx.acquire( &this->wrk ) <= KEY_IS_NEW ) {
+    if ( kctx.resize( &p, this->cfg.datasize ) == KEY_OK ) {
+      ::memcpy( p, this->cfg.data, this->cfg.datasize );
+      b = true;
+    }
+    kctx.release();
+  }
+  return b;
+}
+
+bool
+BenchWorker::get( uint64_t k ) noexcept
+{
+  KeyCtx kctx( this->map, this->dbx_id, &this->kb );
+  this->kb.set( k );
+  kctx.set_key_hash( this->kb );
+  return kctx.find( &this->wrk ) == KEY_OK;
+}
+
+bool
+BenchWorker::del( uint64_t k ) noexcept
+{
+  KeyCtx kctx( this->map, this->dbx_id, &this->kb );
+  KeyStatus status;
+  bool      b = false;
+  this->kb.set( k );
+  kctx.set_key_hash( this->kb );
+  if ( (status = kctx.acquire( &this->wrk )) <= KEY_IS_NEW ) {
+    kctx.tombstone(); /* don't leave an empty key */
+    kctx.release();
+    b = ( status == KEY_OK );
+  }
+  return b;
+}
+
+/* insert the records this worker is assigned, k % nworkers == num */
+void
+BenchWorker::load( void ) noexcept
+{
+  for ( uint64_t k = this->num; k < this->cfg.record_count;
+        k += this->cfg.nworkers ) {
+    this->put( k );
+    this->res.load_ops++;
+  }
+}
+
+void
+BenchWorker::run( void ) noexcept
+{
+  ZipfianGen<99,100,rand::xoroshiro128plus>
+           zipf( this->cfg.record_count, this->rand );
+  BenchShared & sh = *this->cfg.shared;
+  uint64_t i, k, t1, t2, cnt, tsc_start, next;
+  double   start, mono;
+  uint32_t j, r, op;
+  bool     b;
+
+  start     = current_monotonic_time_s();
+  tsc_start = get_rdtsc();
+  cnt       = ( this->cfg.op_count > 0 ? this->cfg.op_count : ~(uint64_t) 0 );
+  for ( i = 0; i < cnt; i++ ) {
+    /* check time every 1024 ops */
+    if ( ( i & 1023 ) == 0 && this->cfg.num_secs > 0 &&
+         current_monotonic_time_s() - start >= this->cfg.num_secs )
+      break;
+    r = (uint32_t) ( this->rand.next() % 100 );
+    for ( op = 0, j = 0; op < OP_COUNT - 1; op++ ) {
+      if ( r < (j += this->cfg.mix[ op ]) )
+        break;
+    }
+    if ( op == OP_INSERT ) {
+      k = kv_sync_add( &sh.insert_next, (uint64_t) 1 );
+    }
+    else {
+      k = ( this->cfg.use_zipf ? zipf.next() :
+            this->rand.next() % this->cfg.record_count );
+      if ( this->cfg.use_latest ) {
+        next = kv_sync_load( &sh.insert_next );
+        k    = ( next > k ? next - 1 - k : 0 );
+      }
+    }
+    t1 = get_rdtsc();
+    switch ( op ) {
+      case OP_READ:   b = this->get( k ); break;
+      case OP_UPDATE:
+      case OP_INSERT: b = this->put( k ); break;
+      case OP_DELETE: b = this->del( k ); break;
+      default:        b = this->get( k ); b = this->put( k ) && b; break;
+    }
+    t2 = get_rdtsc();
+    this->res.lat[ op ].add( t2 - t1 );
+    this->res.ops[ op ]++;
+    if ( ! b )
+      this->res.fail[ op ]++;
+  }
+  mono = current_monotonic_time_s();
+  t2   = get_rdtsc();
+  this->res.run_secs    = mono - start;
+  this->res.ns_per_tick = ( t2 > tsc_start ?
+    ( mono - start ) * 1000000000.0 / (double) ( t2 - tsc_start ) : 1.0 );
+}
+
+void
+BenchWorker::bench( void ) noexcept
+{
+  HashDeltaCounters stats;
+  HashCounters      ops, tot;
+
+  if ( this->cfg.pin_cpu )
+    this->pin();
+  this->ctx_id = this->map.attach_ctx( ::getpid() );
+  if ( this->ctx_id == KV_NO_CTX_ID ) {
+    fprintf( stderr, "worker %u: no more ctx available\n", this->num );
+    kv_sync_add( &this->cfg.shared->ready, (uint32_t) 1 );
+    return;
+  }
+  this->dbx_id     = this->map.attach_db( this->ctx_id, this->cfg.db_num );
+  this->res.ctx_id = this->ctx_id;
+  this->load();
+  /* wait for all workers to load before running */
+  kv_sync_add( &this->cfg.shared->ready, (uint32_t) 1 );
+  while ( kv_sync_load( &this->cfg.shared->ready ) < this->cfg.nworkers )
+    kv_sync_pause();
+  stats.zero();
+  this->map.sum_ht_thr_delta( stats, ops, tot, this->ctx_id );
+  this->run();
+  this->map.sum_ht_thr_delta( stats, ops, tot, this->ctx_id );
+  this->res.stat = ops;
+  this->res.done = true;
+  this->map.detach_ctx( this->ctx_id );
+}
+
+static void *
+run_worker( void *p )
+{
+  ((BenchWorker *) p)->bench();
+  return NULL;
+}
+
+static const char *
+get_arg( int argc, char *argv[], int b, const char *f, const char *def )
+{
+  for ( int i = 1; i < argc - b; i++ )
+    if ( ::strcmp( f, argv[ i ] ) == 0 )
+      return argv[ i + b ];
+  return def; /* default value */
+}
+
+/* a, b, c, d, f are the ycsb core workloads, or r/u/i/d/m percents */
+static bool
+parse_mix( const char *w,  BenchConfig &cfg )
+{
+  uint32_t m[ OP_COUNT ] = { 0, 0, 0, 0, 0 };
+  if ( ::strlen( w ) == 1 ) {
+    switch ( w[ 0 ] ) {
+      case 'a': m[ OP_READ ] = 50; m[ OP_UPDATE ] = 50; break;
+      case 'b': m[ OP_READ ] = 95; m[ OP_UPDATE ] = 5; break;
+      case 'c': m[ OP_READ ] = 100; break;
+      case 'd': m[ OP_READ ] = 95; m[ OP_INSERT ] = 5;
+                cfg.use_latest = true; break;
+      case 'f': m[ OP_READ ] = 50; m[ OP_RMW ] = 50; break;
+      default: return false;
+    }
+  }
+  else {
+    int n = ::sscanf( w, "%u/%u/%u/%u/%u", &m[ 0 ], &m[ 1 ], &m[ 2 ],
+                      &m[ 3 ], &m[ 4 ] );
+    if ( n < 1 )
+      return false;
+  }
+  uint32_t sum = 0;
+  for ( int i = 0; i < OP_COUNT; i++ )
+    sum += ( cfg.mix[ i ] = m[ i ] );
+  return sum == 100;
+}
+
+static void
+print_results( BenchConfig &cfg,  bool quiet )
+{
+  BenchShared & sh = *cfg.shared;
+  LatHisto   *  lat = (LatHisto *) ::malloc( sizeof( LatHisto ) * OP_COUNT );
+  HashCounters  stat;
+  uint64_t      ops[ OP_COUNT ], fail[ OP_COUNT ], total = 0;
+  double        secs = 0, ns_per_tick = 0;
+  uint32_t      i, n = 0;
+  int           op;
+
+  ::memset( ops, 0, sizeof( ops ) );
+  ::memset( fail, 0, sizeof( fail ) );
+  for ( op = 0; op < OP_COUNT; op++ )
+    lat[ op ].zero();
+  for ( i = 0; i < cfg.nworkers; i++ ) {
+    BenchResult &r = sh.res[ i ];
+    if ( ! r.done )
+      continue;
+    for ( op = 0; op < OP_COUNT; op++ ) {
+      lat[ op ].merge( r.lat[ op ] );
+      ops[ op ]  += r.ops[ op ];
+      fail[ op ] += r.fail[ op ];
+      total      += r.ops[ op ];
+    }
+    stat        += r.stat;
+    secs        += r.run_secs;
+    ns_per_tick += r.ns_per_tick;
+    n++;
+  }
+  if ( n == 0 ) {
+    printf( "no results\n" );
+    return;
+  }
+  secs        /= n;
+  ns_per_tick /= n;
+  if ( ! quiet ) {
+    printf( "workers %u, records %" PRIu64 ", secs %.2f, ops %" PRIu64
+            ", ops/s %.0f\n", n, cfg.record_count, secs, total,
+            (double) total / secs );
+    printf( "%-8s%12s%10s%10s%10s%10s%12s\n", "op", "count", "fail",
+            "p50", "p99", "p999", "max(ns)" );
+    for ( op = 0; op < OP_COUNT; op++ ) {
+      if ( ops[ op ] == 0 )
+        continue;
+      LatHisto &h = lat[ op ];
+      printf( "%-8s%12" PRIu64 "%10" PRIu64 "%10.0f%10.0f%10.0f%12.0f\n",
+              op_str[ op ], ops[ op ], fail[ op ],
+              (double) h.percentile( 0.50 ) * ns_per_tick,
+              (double) h.percentile( 0.99 ) * ns_per_tick,
+              (double) h.percentile( 0.999 ) * ns_per_tick,
+              (double) h.max * ns_per_tick );
+    }
+    printf( "spins %" PRId64 ", chains %" PRId64 ", hit %" PRId64
+            ", miss %" PRId64 ", evict %" PRId64 "\n",
+            stat.spins, stat.chains, stat.hit, stat.miss, stat.htevict );
+    printf( "cuckoo acq %" PRId64 ", fet %" PRId64 ", mov %" PRId64
+            ", ret %" PRId64 ", max %" PRId64 "\n",
+            stat.cuckacq, stat.cuckfet, stat.cuckmov, stat.cuckret,
+            stat.cuckmax );
+  }
+  else {
+    /* workers ops/s [op count p50 p99 p999]... spins chains cuckmov */
+    printf( "%u %.1f", n, (double) total / secs );
+    for ( op = 0; op < OP_COUNT; op++ ) {
+      if ( ops[ op ] == 0 )
+        continue;
+      LatHisto &h = lat[ op ];
+      printf( " %s %" PRIu64 " %.0f %.0f %.0f", op_str[ op ], ops[ op ],
+              (double) h.percentile( 0.50 ) * ns_per_tick,
+              (double) h.percentile( 0.99 ) * ns_per_tick,
+              (double) h.percentile( 0.999 ) * ns_per_tick );
+    }
+    printf( " %" PRId64 " %" PRId64 " %" PRId64 "\n", stat.spins,
+            stat.chains, stat.cuckmov );
+  }
+  ::free( lat );
+}
+
+int
+main( int argc, char *argv[] )
+{
+  HashTabGeom geom;
+  HashTab   * map;
+  BenchConfig cfg;
+
+  const char * mn = get_arg( argc, argv, 1, "-m", KV_DEFAULT_SHM ),
+             * cr = get_arg( argc, argv, 1, "-c", NULL ),
+             * th = get_arg( argc, argv, 1, "-t", "1" ),
+             * wl = get_arg( argc, argv, 1, "-w", "a" ),
+             * ke = get_arg( argc, argv, 1, "-k", "zipf" ),
+             * pc = get_arg( argc, argv, 1, "-p", "50" ),
+             * oc = get_arg( argc, argv, 1, "-o", "0" ),
+             * nn = get_arg( argc, argv, 1, "-n", "5" ),
+             * db = get_arg( argc, argv, 1, "-d", "0" ),
+             * sz = get_arg( argc, argv, 1, "-z", "0" ),
+             * ez = get_arg( argc, argv, 1, "-e", "64" ),
+             * cx = get_arg( argc, argv, 1, "-x", NULL ),
+             * pr = get_arg( argc, argv, 0, "-P", NULL ),
+             * af = get_arg( argc, argv, 0, "-a", NULL ),
+             * qu = get_arg( argc, argv, 0, "-q", NULL ),
+             * he = get_arg( argc, argv, 0, "-h", 0 );
+
+  ::memset( &cfg, 0, sizeof( cfg ) );
+  if ( he != NULL || ! parse_mix( wl, cfg ) ) {
+  cmd_error:;
+    fprintf( stderr, "raikv version: %s\n", kv_stringify( KV_VER ) );
+    fprintf( stderr,
+  "%s [-m map] [-c size] [-t workers] [-w mix] [-k dist] [-p pct] "
+     "[-o ops] [-n secs] [-d db-num] [-z data-sz] [-e entry-sz] [-x depth] "
+     "[-P] [-a] [-q]\n"
+  "  -m map      = name of map file (default: " KV_DEFAULT_SHM ")\n"
+  "  -c size     = size of map file to create in MB\n"
+  "  -t workers  = num threads or processes (def: 1)\n"
+  "  -w mix      = ycsb workload a, b, c, d, f or read/upd/ins/del/rmw\n"
+  "                percents, ex: 80/10/5/5/0 (def: a)\n"
+  "  -k dist     = key distribution: zipf, uniform (def: zipf)\n"
+  "  -p pct      = records loaded, percent of hash entries (def: 50%%)\n"
+  "  -o ops      = ops for each worker (def: use secs)\n"
+  "  -n secs     = num seconds to run (def: 5)\n"
+  "  -d db-num   = database number to use (def: 0)\n"
+  "  -z data-sz  = size of data field (def: 0)\n"
+  "  -e entry-sz = hash entry size of created map, 32 or 64 (def: 64)\n"
+  "  -x depth    = cuckoo path search, 0 = random walk, N = bfs depth\n"
+  "  -P          = workers are processes, otherwise threads\n"
+  "  -a          = pin each worker to a cpu\n"
+  "  -q          = one line of results\n", argv[ 0 ] );
+    return 1;
+  }
+  cfg.datasize = (uint32_t) atoi( sz );
+  if ( cr != NULL ) {
+    uint32_t entsize = ( atoi( ez ) <= 32 ? 32 : 64 );
+    geom.map_size         = (uint64_t) ( strtod( cr, 0 ) * 1024 * 1024 );
+    geom.hash_entry_size  = entsize;
+    geom.cuckoo_buckets   = 4;
+    geom.cuckoo_arity     = 2;
+    geom.cuckoo_path_depth = ( cx != NULL ? (uint8_t) atoi( cx ) : 0 );
+    geom.ctx_count        = 0;
+    /* compact entries always put the key and value in a segment */
+    if ( cfg.datasize == 0 && ! HashEntry::is_compact( entsize ) ) {
+      geom.max_value_size   = 0; /* all ht, no value */
+      geom.hash_value_ratio = 1;
+    }
+    else {
+      geom.max_value_size   = cfg.datasize + 128;
+      geom.hash_value_ratio = (float) ( (double) entsize / /* ht / seg msg */
+                   ( entsize + ( (uint64_t) cfg.datasize | 127 ) + 65 ) );
+    }
+    map = HashTab::create_map( mn, 0, geom, 0666 );
+  }
+  else {
+    map = HashTab::attach_map( mn, 0, geom );
+  }
+  if ( map == NULL )
+    return 1;
+  if ( cx != NULL ) /* an attached map may use a different search */
+    map->hdr.cuckoo_path_depth = (uint8_t) atoi( cx );
+
+  int nthr = atoi( th );
+  if ( nthr < 1 ) nthr = 1;
+  if ( (uint32_t) nthr > map->max_ctx_count() - 1 )
+    nthr = (int) map->max_ctx_count() - 1;
+  double load_pct = strtod( pc, 0 );
+  if ( load_pct <= 0 )
+    goto cmd_error;
+
+  cfg.map          = map;
+  cfg.nworkers     = (uint32_t) nthr;
+  cfg.record_count = (uint64_t)
+    ( ( (double) map->hdr.ht_size * load_pct ) / 100.0 );
+  if ( cfg.record_count == 0 )
+    cfg.record_count = 1;
+  cfg.op_count     = strtoull( oc, NULL, 0 );
+  cfg.num_secs     = ( cfg.op_count > 0 ? 0 : strtod( nn, 0 ) );
+  cfg.db_num       = (uint8_t) atoi( db );
+  cfg.use_zipf     = ( ::strcmp( ke, "zipf" ) == 0 );
+  cfg.pin_cpu      = ( af != NULL );
+  cfg.ncpus        = (uint32_t) ::sysconf( _SC_NPROCESSORS_ONLN );
+  if ( cfg.ncpus == 0 )
+    cfg.ncpus = 1;
+  if ( cfg.datasize > 0 ) {
+    cfg.data = ::malloc( cfg.datasize );
+    for ( uint32_t i = 0; i < cfg.datasize; i++ )
+      ((uint8_t *) cfg.data)[ i ] = (uint8_t) i;
+  }
+  else {
+    static char hello[ 6 ] = "hello";
+    cfg.datasize = 6;
+    cfg.data     = (void *) hello;
+  }
+
+  /* results are shared with the forked workers */
+  size_t shsz = sizeof( BenchShared ) + sizeof( BenchResult ) * nthr;
+  void * shp  = ::mmap( NULL, shsz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+  if ( shp == MAP_FAILED ) {
+    perror( "mmap" );
+    return 1;
+  }
+  ::memset( shp, 0, shsz );
+  cfg.shared = (BenchShared *) shp;
+  cfg.shared->insert_next = cfg.record_count;
+
+  if ( qu == NULL ) {
+    printf( "%s: %s %s, %s, %u workers%s\n", argv[ 0 ], wl, ke,
+            pr != NULL ? "processes" : "threads", cfg.nworkers,
+            cfg.pin_cpu ? ", pinned" : "" );
+    printf( "mix read %u%% update %u%% insert %u%% delete %u%% rmw %u%%\n",
+            cfg.mix[ OP_READ ], cfg.mix[ OP_UPDATE ], cfg.mix[ OP_INSERT ],
+            cfg.mix[ OP_DELETE ], cfg.mix[ OP_RMW ] );
+  }
+  if ( pr != NULL ) {
+    pid_t pid[ 256 ];
+    if ( nthr > 256 )
+      nthr = cfg.nworkers = 256;
+    for ( int i = 0; i < nthr; i++ ) {
+      if ( (pid[ i ] = ::fork()) == 0 ) {
+        BenchWorker w( cfg, (uint32_t) i );
+        w.bench();
+        ::_exit( 0 );
+      }
+      if ( pid[ i ] < 0 ) {
+        perror( "fork" );
+        kv_sync_add( &cfg.shared->ready, (uint32_t) 1 ); /* don't wait */
+      }
+    }
+    for ( int i = 0; i < nthr; i++ ) {
+      int status;
+      if ( pid[ i ] > 0 )
+        ::waitpid( pid[ i ], &status, 0 );
+    }
+  }
+  else {
+    pthread_t     tid[ 256 ];
+    BenchWorker * w[ 256 ];
+    if ( nthr > 256 )
+      nthr = cfg.nworkers = 256;
+    for ( int i = 0; i < nthr; i++ ) {
+      void * p = ::aligned_malloc( sizeof( BenchWorker ) );
+      w[ i ] = new ( p ) BenchWorker( cfg, (uint32_t) i );
+      pthread_create( &tid[ i ], NULL, run_worker, w[ i ] );
+    }
+    for ( int i = 0; i < nthr; i++ )
+      pthread_join( tid[ i ], NULL );
+  }
+  print_results( cfg, qu != NULL );
+  return 0;
+}
@@ -19,7 +19,7 @@ using namespace kv;
 
 HashTabGeom geom;
 HashTab   * map;
-uint32_t    ctx_id = MAX_CTX_ID,
+uint32_t    ctx_id = KV_NO_CTX_ID,
             dbx_id = MAX_STAT_ID;
 
 static void
@@ -36,13 +36,13 @@ shm_attach( const char *mn )
 static void
 shm_close( void )
 {
-  if ( ctx_id != MAX_CTX_ID ) {
-    HashCounters & stat = map->stats[ dbx_id ];
+  if ( ctx_id != KV_NO_CTX_ID ) {
+    HashCounters & stat = map->get_stats( dbx_id );
     printf( "rd %" PRIu64 ", wr %" PRIu64 ", "
             "sp %" PRIu64 ", ch %" PRIu64 "\n",
             stat.rd, stat.wr, stat.spins, stat.chains );
     map->detach_ctx( ctx_id );
-    ctx_id = MAX_CTX_ID;
+    ctx_id = KV_NO_CTX_ID;
   }
   delete map;
 }
@@ -220,7 +220,7 @@ main( int argc, char *argv[] )
           cur = t2;
           if ( ( t2 - t1 ) >= NANOS / 2 ) {
 //            compute_key_count();
-            HashCounters & stat = map->stats[ dbx_id ];
+            HashCounters & stat = map->get_stats( dbx_id );
             printf( "%.1f msg/s %.1f bytes/s %.1f fail/s "
                 "add %" PRIu64 " drop %" PRIu64 " total %" PRIu64 "\n",
          /* "seg %" PRIu64 " immed %" PRIu64 " no_val %" PRIu64 " key_count %" PRIu64 " drops %" PRIu64 " tot %" PRIu64 "\n",*/
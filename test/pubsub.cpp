@@ -17,7 +17,7 @@ using namespace kv;
 
 HashTabGeom geom;
 HashTab   * map;
-uint32_t    ctx_id = MAX_CTX_ID,
+uint32_t    ctx_id = KV_NO_CTX_ID,
             dbx_id = MAX_STAT_ID;
 
 static void
@@ -34,13 +34,13 @@ shm_attach( const char *mn )
 static void
 shm_close( void )
 {
-  if ( ctx_id != MAX_CTX_ID ) {
-    HashCounters & stat = map->stats[ dbx_id ];
+  if ( ctx_id != KV_NO_CTX_ID ) {
+    HashCounters & stat = map->get_stats( dbx_id );
     printf( "rd %" PRIu64 ", wr %" PRIu64 ", "
             "sp %" PRIu64 ", ch %" PRIu64 "\n",
             stat.rd, stat.wr, stat.spins, stat.chains );
     map->detach_ctx( ctx_id );
-    ctx_id = MAX_CTX_ID;
+    ctx_id = KV_NO_CTX_ID;
   }
   delete map;
 }
@@ -39,14 +39,18 @@ main( int argc, char *argv[] )
   uint64_t      mbsize     = 1024 * 1024 * 1024; /* 1G */
   uint32_t      entsize    = 64,                 /* 64b */
                 valsize    = 1024 * 1024;        /* 1MB */
-  uint8_t       arity      = 2;                  /* cuckoo 2+4 */
-  uint16_t      buckets    = 4;
+  uint8_t       arity      = 2,                  /* cuckoo 2+4 */
+                depth      = KV_CUCKOO_PATH_DEPTH; /* bfs 6 */
+  uint16_t      buckets    = 4,
+                ctx_count  = 0;                  /* 0 = 128 */
 
   const char * mn = get_arg( argc, argv, 1, "-m",
                              KV_DEFAULT_SHM, KV_MAP_NAME_ENV ),
              * mb = get_arg( argc, argv, 1, "-s", "2048",  KV_MAP_SIZE_ENV ),
              * pc = get_arg( argc, argv, 1, "-k", "0.25",  KV_HT_RATIO_ENV ),
              * cu = get_arg( argc, argv, 1, "-c", "2+4",   KV_CUCKOO_ENV ),
+             * cd = get_arg( argc, argv, 1, "-d",
+                             kv_stringify( KV_CUCKOO_PATH_DEPTH ) ),
              * mo = get_arg( argc, argv, 1, "-o", "ug+rw", KV_MAP_MODE_ENV ),
              * vz = get_arg( argc, argv, 1, "-v", "2048",  KV_VALUE_SIZE_ENV ),
              * ez = get_arg( argc, argv, 1, "-e", "64",    KV_ENTRY_SIZE_ENV ),
@@ -54,6 +58,7 @@ main( int argc, char *argv[] )
              * rm = get_arg( argc, argv, 0, "-r", 0 ),
              * iv = get_arg( argc, argv, 1, "-i", "1" ),
              * ix = get_arg( argc, argv, 1, "-x", "0.1" ),
+             * tc = get_arg( argc, argv, 1, "-t", "128" ),
              * he = get_arg( argc, argv, 0, "-h", 0 );
 
   if ( he != NULL ) {
@@ -66,14 +71,17 @@ main( int argc, char *argv[] )
   "  -k ratio      = entry to value ratio (float 0 -> 1, 0.25) (" KV_HT_RATIO_ENV ")\n"
   "                 (1 = all ht, 0 = all msg -- must have some ht)\n"
   "  -c cuckoo a+b = cuckoo hash arity and buckets (2+4) (" KV_CUCKOO_ENV ")\n"
+  "  -d depth      = cuckoo bfs path moves, 0 = random walk (%u, max %u)\n"
   "  -o mode       = create map using mode (ug+rw) (" KV_MAP_MODE_ENV ")\n"
   "  -v value-sz   = max value size in KB (2048) (" KV_VALUE_SIZE_ENV ")\n"
-  "  -e entry-sz   = hash entry size (mult of 64, 64) (" KV_ENTRY_SIZE_ENV ")\n"
+  "  -e entry-sz   = hash entry size (32, mult of 64, 64) (" KV_ENTRY_SIZE_ENV ")\n"
   "  -a            = attach to map, don't create (create)\n"
   "  -r            = remove map and then exit\n"
   "  -i secs       = stats interval (1)\n"
-  "  -x secs       = check interval (0.1)\n",
-             argv[ 0 ] );
+  "  -x secs       = check interval (0.1)\n"
+  "  -t count      = number of thread contexts (128, max %u)\n",
+             argv[ 0 ], (uint32_t) KV_CUCKOO_PATH_DEPTH,
+             (uint32_t) KV_CUCKOO_PATH_MAX, (uint32_t) KV_MAX_CTX_COUNT );
     return 1;
   }
 
@@ -91,6 +99,9 @@ main( int argc, char *argv[] )
   else {
     goto cmd_error;
   }
+  if ( ! isdigit( cd[ 0 ] ) || atoi( cd ) > KV_CUCKOO_PATH_MAX )
+    goto cmd_error;
+  depth = (uint8_t) atoi( cd );
   valsize = (uint32_t) atoi( vz ) * (uint32_t) 1024;
   if ( valsize == 0 && ratio < 1.0 )
     goto cmd_error;
@@ -99,15 +110,21 @@ main( int argc, char *argv[] )
     goto cmd_error;
   stats_ival = (uint64_t) ( strtod( iv, 0 ) * NANOSF );
   check_ival = (uint64_t) ( strtod( ix, 0 ) * NANOSF );
+  if ( atoi( tc ) <= 0 || atoi( tc ) > KV_MAX_CTX_COUNT )
+    goto cmd_error;
+  ctx_count = (uint16_t) atoi( tc );
 
   if ( at == NULL && rm == NULL ) {
     int mode, x;
     geom.map_size         = mbsize;
     geom.max_value_size   = ratio < 0.999 ? valsize : 0;
-    geom.hash_entry_size  = align<uint32_t>( entsize, 64 );
+    geom.hash_entry_size  = ( entsize <= 32 ? 32 : /* compact entry */
+                              align<uint32_t>( entsize, 64 ) );
     geom.hash_value_ratio = (float) ratio;
     geom.cuckoo_buckets   = buckets;
     geom.cuckoo_arity     = arity;
+    geom.cuckoo_path_depth = depth;
+    geom.ctx_count        = ctx_count;
     mode = atoi( mo );
     if ( mode == 0 ) {
       x = mode = 0;
@@ -167,7 +167,7 @@ struct Test {
 
   void init_hash_seed( void ) {
     this->map.hdr.get_hash_seed(
-      this->map.hdr.stat_link[ this->dbx_id ].db_num, this->hs );
+      this->map.get_stat_link( this->dbx_id ).db_num, this->hs );
   }
   void sum_stats( void ) noexcept;
   void print_hdr( void ) noexcept;
@@ -316,18 +316,16 @@ Test::test_one( void ) noexcept
 void
 Test::hash_stride( KeyBufAligned *kbar,  uint32_t stride,  uint64_t *hash )
 {
-  uint32_t j;
+  KeyFragment * ar[ 8 ];
+  uint32_t j, k, n;
   /* this uses SIMD hashing, it looks like overlapping hashing and
    * prefetching is better than SIMD in this test */
-  for ( j = 0; j + 4 <= stride; j += 4 )
-    this->hs.hash( kbar[ j ], kbar[ j + 1 ], kbar[ j + 2 ], kbar[ j + 3 ],
-                   &hash[ j * 2 ] );
-  if ( j + 2 <= stride ) {
-    this->hs.hash( kbar[ j ], kbar[ j + 1 ], &hash[ j * 2 ] );
-    j += 2;
+  for ( j = 0; j < stride; j += n ) {
+    n = ( stride - j < 8 ? stride - j : 8 );
+    for ( k = 0; k < n; k++ )
+      ar[ k ] = kbar[ j + k ];
+    this->hs.hash( ar, &hash[ j * 2 ], n );
   }
-  if ( j < stride )
-    this->hs.hash( kbar[ j ], hash[ j * 2 ], hash[ j * 2 + 1 ] );
 }
 
 /* test latency of a key = integer between 0 -> total_count */
@@ -480,7 +478,7 @@ Test::run( void ) noexcept
   uint32_t mypid;
   mypid = ::getpid();
   this->ctx_id = this->map.attach_ctx( mypid );
-  if ( this->ctx_id == MAX_CTX_ID ) {
+  if ( this->ctx_id == KV_NO_CTX_ID ) {
     fprintf( stderr, "no more ctx available\n" );
     return;
   }
@@ -597,6 +595,8 @@ main( int argc, char *argv[] )
     geom.hash_entry_size  = 64;
     geom.cuckoo_buckets   = 4;
     geom.cuckoo_arity     = 2;
+    geom.cuckoo_path_depth = 0;
+    geom.ctx_count        = 0;
 
     if ( szf == 0 ) {
       geom.max_value_size   = 0; /* all ht, no value */
@@ -12,6 +12,8 @@
 #include <raikv/uint_ht.h>
 #include <raikv/radix_sort.h>
 #include <raikv/bloom.h>
+#include <raikv/route_db.h>
+#include <raikv/kv_pubsub.h>
 
 using namespace rai;
 using namespace kv;
@@ -205,6 +207,182 @@ test_filter( uint8_t width,  size_t *elem_count,  double *false_ratio,
   delete filter;
 }
 
+static uint32_t
+delta_hash( uint32_t i ) noexcept
+{
+  return kv_hash_uint( i + 1 );
+}
+
+static void
+delta_add( BloomRef &ref,  uint32_t from,  uint32_t to,
+           uint16_t prefix_len = SUB_RTE ) noexcept
+{
+  for ( uint32_t i = from; i < to; i++ )
+    ref.add_route( prefix_len, delta_hash( i ) );
+}
+
+static void
+delta_del( BloomRef &ref,  uint32_t from,  uint32_t to ) noexcept
+{
+  for ( uint32_t i = from; i < to; i++ )
+    ref.del_route( SUB_RTE, delta_hash( i ) );
+}
+
+static bool
+bloom_equal( const BloomRef &a,  const BloomRef &b ) noexcept
+{
+  return a.bits->width == b.bits->width &&
+         a.bits->count == b.bits->count &&
+         ::memcmp( a.bits->bits, b.bits->bits, a.bits->width ) == 0 &&
+         ::memcmp( a.pref_count, b.pref_count, sizeof( a.pref_count ) ) == 0;
+}
+
+/* the full bloom, as KvPubSub::send_bloom() does */
+static void
+delta_full( BloomRef &src,  BloomRef &peer ) noexcept
+{
+  BloomCodec code, code2;
+  uint32_t   pref[ MAX_RTE ];
+  void     * details, * queue;
+  size_t     details_size, queue_size;
+  src.encode( code );
+  BloomBits * bits = code2.decode( pref, MAX_RTE, details, details_size,
+                                   queue, queue_size, code.ptr, code.code_sz );
+  if ( bits != NULL )
+    peer.update_route( pref, bits, (BloomDetail *) details,
+                       (uint32_t) ( details_size / sizeof( BloomDetail ) ) );
+}
+
+/* a KV_MSG_BLOOM_DELTA from src, decoded and applied to peer, as
+ * KvPubSub::on_bloom_ref() and KvPubSubPeer::bloom_delta_msg() do */
+static bool
+delta_send( BloomRef &src,  BloomRef &peer,  uint64_t sent_seqno,
+            uint64_t &peer_seqno ) noexcept
+{
+  uint64_t   seqno = src.delta_seqno(),
+             from_seqno;
+  BloomCodec code, code2;
+  char       buf[ 64 * 1024 ];
+
+  if ( ! src.can_delta( sent_seqno ) )
+    return false;
+  src.encode_delta( sent_seqno, code );
+  KvEst e;
+  e.ref_num()
+   .bloom_seqno()
+   .data( code.code_sz * 4 );
+  if ( e.len() > sizeof( buf ) )
+    return false;
+  KvMsg &m = *(new ( buf ) KvMsg( KV_MSG_BLOOM_DELTA ) );
+  m.ref_num( src.ref_num )
+   .bloom_seqno( seqno )
+   .data( code.ptr, code.code_sz * 4 );
+
+  KvMsgIn       msg;
+  BloomDeltaOps ops;
+  uint32_t      delta_len;
+  if ( msg.decode( (const char *) m.msg(), (uint32_t) m.len() ) != KV_MSG_OK ||
+       msg.type != KV_MSG_BLOOM_DELTA ||
+       msg.get<uint32_t>( KV_FLD_REF_NUM ) != src.ref_num )
+    return false;
+  uint64_t recv_seqno = msg.get<uint64_t>( KV_FLD_BLOOM_SEQNO );
+  void   * delta = (void *) msg.get_field( KV_FLD_DATA, delta_len );
+  /* the peer rejects a delta that does not follow its seqno */
+  if ( msg.is_field_missing() || recv_seqno != seqno ||
+       ! code2.decode_ops( from_seqno, ops, delta, delta_len / 4 ) ||
+       from_seqno != peer_seqno )
+    return false;
+  peer.apply_delta( ops );
+  peer_seqno = recv_seqno;
+  return true;
+}
+
+/* route changes sent as deltas are the same as the full bloom */
+static uint32_t
+test_delta( void ) noexcept
+{
+  BloomDB  db, peer_db;
+  BloomRef src( 0x5eed, "src", db ),
+           peer( 0x5eed, "peer", peer_db );
+  uint64_t seqno, peer_seqno, old_seqno;
+  uint32_t fail = 0;
+
+  delta_add( src, 0, 100 );
+  delta_add( src, 0, 10, 3 ); /* prefix routes */
+  /* start of the log, the peer gets the full bloom */
+  peer_seqno = src.delta_seqno();
+  delta_full( src, peer );
+  if ( ! bloom_equal( src, peer ) )
+    fail++;
+
+  /* adds, dels, an add + del of the same hash and a double add */
+  delta_add( src, 100, 150 );
+  delta_del( src, 0, 20 );
+  delta_add( src, 200, 201 );
+  delta_del( src, 200, 201 );
+  delta_add( src, 300, 301 );
+  delta_add( src, 300, 301 );
+  delta_add( src, 10, 12, 3 );
+  old_seqno = peer_seqno;
+  seqno     = src.delta_seqno();
+  if ( seqno != old_seqno + 76 || src.delta->log.count != 76 ||
+       ! delta_send( src, peer, peer_seqno, peer_seqno ) ||
+       peer_seqno != seqno ||
+       ! bloom_equal( src, peer ) )
+    fail++;
+  printf( "delta %u ops, bloom equal: %s\n", (uint32_t) ( seqno - old_seqno ),
+          fail == 0 ? "ok" : "failed" );
+
+  /* all peers are at seqno, the log is trimmed, an older seqno can't
+   * be updated with a delta and gets the full bloom */
+  src.delta->trim( seqno );
+  if ( src.delta->log.count != 0 || src.can_delta( old_seqno ) ||
+       ! src.can_delta( seqno ) ||
+       delta_send( src, peer, old_seqno, old_seqno ) )
+    fail++;
+  /* the peer misses a delta, the next one is not in sequence */
+  delta_add( src, 150, 155 );
+  uint64_t sent_seqno = src.delta_seqno();
+  delta_add( src, 155, 160 );
+  delta_del( src, 20, 25 );
+  if ( delta_send( src, peer, sent_seqno, peer_seqno ) ||
+       peer_seqno != seqno )
+    fail++;
+  delta_full( src, peer );
+  peer_seqno = src.delta_seqno();
+  if ( ! bloom_equal( src, peer ) )
+    fail++;
+  printf( "delta trim and seqno gap, full bloom: %s\n",
+          fail == 0 ? "ok" : "failed" );
+
+  /* replacing the bits resets the log, the peer needs the full bloom */
+  BloomBits * b = BloomBits::resize( NULL, src.bits->seed, 52,
+                                     src.bits->SHFT1 + 1 );
+  for ( uint32_t i = 25; i < 160; i++ )
+    b->add( delta_hash( i ) );
+  b->add( delta_hash( 300 ) );
+  b->add( delta_hash( 300 ) );
+  for ( uint32_t i = 0; i < 12; i++ )
+    b->add( delta_hash( i ) );
+  old_seqno = peer_seqno;
+  src.update_route( src.pref_count, b, NULL, 0 );
+  seqno = src.delta_seqno();
+  if ( seqno <= old_seqno || src.can_delta( old_seqno ) ||
+       delta_send( src, peer, peer_seqno, peer_seqno ) )
+    fail++;
+  delta_full( src, peer );
+  peer_seqno = seqno;
+  if ( ! bloom_equal( src, peer ) )
+    fail++;
+  delta_add( src, 400, 410 );
+  if ( ! delta_send( src, peer, peer_seqno, peer_seqno ) ||
+       ! bloom_equal( src, peer ) )
+    fail++;
+  printf( "delta resize width %" PRIu64 ", full then delta: %s\n",
+          src.bits->width, fail == 0 ? "ok" : "failed" );
+  return fail;
+}
+
 int
 main( int argc,  const char *argv[] )
 {
@@ -214,6 +392,8 @@ main( int argc,  const char *argv[] )
   static char words[] = "words";
   #endif
   const char * input = ( argc > 1 ? argv[ 1 ] : words );
+  if ( test_delta() != 0 )
+    return 1;
   MapFile map( input );
   if ( ! map.open() || ! load_words( map ) )
     return 1;
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <raikv/route_bus.h>
+#include <raikv/ev_publish.h>
+#include <raikv/pattern_cvt.h>
+
+using namespace rai;
+using namespace kv;
+
+/* a subscriber or publisher without a connection */
+struct TestSock : public EvSocket {
+  uint32_t count; /* read by main after join */
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  TestSock( EvPoll &p ) : EvSocket( p, p.register_type( "test_sock" ) ),
+                          count( 0 ) {
+    this->sock_opts = OPT_NO_POLL;
+    this->PeerData::init_peer( p.get_next_id(), p.get_null_fd(), -1, NULL,
+                               "test" );
+    p.add_sock( this );
+  }
+  virtual void write( void ) noexcept {}
+  virtual void read( void ) noexcept {}
+  virtual void process( void ) noexcept {}
+  virtual void release( void ) noexcept {}
+  virtual bool on_msg( EvPublish &pub ) noexcept {
+    if ( pub.is_pub_type( PUB_TYPE_BUS ) )
+      this->count++;
+    return true;
+  }
+};
+
+static uint32_t
+publish( EvPoll &p,  TestSock &src,  const char *sub,  uint32_t cnt )
+{
+  size_t   len = ::strlen( sub );
+  uint32_t h   = kv_crc_c( sub, len, 0 );
+  for ( uint32_t i = 0; i < cnt; i++ ) {
+    EvPublish pub( sub, len, NULL, 0, &i, sizeof( i ), p.sub_route, src, h,
+                   0 );
+    p.sub_route.forward_msg( pub );
+  }
+  return cnt;
+}
+
+static const size_t NTHR = 3;
+static const char * SUB = "test.bus", * PAT = "test.>";
+
+/* each poll runs on its own thread, the thread only touches its own poll,
+ * routes of the other threads are seen through the bus peers */
+struct BusThr {
+  RouteBus * bus;
+  EvPoll     poll;
+  TestSock * sock;
+  pthread_t  tid;
+  uint32_t   thr,
+             cnt;      /* publishes from thread 0 */
+  volatile uint32_t done;
+};
+
+static BusThr           bthr[ NTHR ];
+static volatile uint32_t quit;
+
+/* count of subs and psubs of peer thread known to this thread */
+static size_t
+peer_routes( BusThr &t,  uint32_t peer )
+{
+  return t.bus->port[ t.thr ]->peer[ peer ]->sub_ref->bits->count;
+}
+
+static void
+poll_once( BusThr &t )
+{
+  t.poll.dispatch();
+  t.poll.wait( 1 );
+}
+
+static void *
+run_thr( void *arg )
+{
+  BusThr & t = *(BusThr *) arg;
+  size_t   len = ::strlen( SUB );
+  NotifySub nsub( SUB, len, kv_crc_c( SUB, len, 0 ), false, 'C', *t.sock );
+  PatternCvt cvt;
+
+  if ( t.thr == 1 ) /* sub on thread 1 */
+    t.poll.sub_route.add_sub( nsub );
+  else if ( t.thr == 2 ) { /* psub on thread 2 */
+    cvt.convert_rv( PAT, ::strlen( PAT ) );
+    uint32_t ph = kv_crc_c( PAT, cvt.prefixlen,
+                            t.poll.sub_route.prefix_seed( cvt.prefixlen ) );
+    NotifyPattern npat( cvt, PAT, ::strlen( PAT ), ph, false, 'C', *t.sock );
+    t.poll.sub_route.add_pat( npat );
+  }
+  if ( t.thr == 0 ) {
+    /* publish when both routes arrived, more than a ring, some overflow */
+    while ( ! quit && ( peer_routes( t, 1 ) == 0 ||
+                        peer_routes( t, 2 ) == 0 ) )
+      poll_once( t );
+    publish( t.poll, *t.sock, SUB, t.cnt );
+    /* publish again after the unsub arrived, only the pattern matches */
+    while ( ! quit && peer_routes( t, 1 ) != 0 )
+      poll_once( t );
+    publish( t.poll, *t.sock, SUB, 10 );
+  }
+  else if ( t.thr == 1 ) {
+    while ( ! quit && t.sock->count < t.cnt )
+      poll_once( t );
+    t.poll.sub_route.del_sub( nsub );
+  }
+  else {
+    while ( ! quit && t.sock->count < t.cnt + 10 )
+      poll_once( t );
+  }
+  /* keep draining until all are done, extra msgs are counted */
+  kv_sync_store( &t.done, (uint32_t) 1 );
+  while ( ! quit )
+    poll_once( t );
+  return NULL;
+}
+
+int
+main( void )
+{
+  RouteBus * bus  = RouteBus::create( NTHR );
+  int        fail = 0;
+  size_t     i, ndone;
+
+  for ( i = 0; i < NTHR; i++ ) {
+    BusThr & t = bthr[ i ];
+    if ( t.poll.init( 64, false ) != 0 || bus->attach( t.poll, i ) == NULL ) {
+      fprintf( stderr, "attach %u failed\n", (uint32_t) i );
+      return 1;
+    }
+    t.bus  = bus;
+    t.sock = new ( ::malloc( sizeof( TestSock ) ) ) TestSock( t.poll );
+    t.thr  = (uint32_t) i;
+    t.cnt  = RouteBusRing::RING_SIZE + 100;
+  }
+  for ( i = 0; i < NTHR; i++ )
+    pthread_create( &bthr[ i ].tid, NULL, run_thr, &bthr[ i ] );
+  /* wait for all, then a little longer for msgs that should not arrive */
+  double start = kv_current_monotonic_time_s();
+  do {
+    ::usleep( 1000 );
+    for ( ndone = 0, i = 0; i < NTHR; i++ )
+      ndone += kv_sync_load( &bthr[ i ].done );
+  } while ( ndone < NTHR && kv_current_monotonic_time_s() - start < 10.0 );
+  ::usleep( 50 * 1000 );
+  kv_sync_store( &quit, (uint32_t) 1 );
+  for ( i = 0; i < NTHR; i++ )
+    pthread_join( bthr[ i ].tid, NULL );
+
+  uint32_t cnt = bthr[ 0 ].cnt;
+  printf( "sub %u of %u, psub %u of %u, src %u, done %u of %u\n",
+          bthr[ 1 ].sock->count, cnt, bthr[ 2 ].sock->count, cnt + 10,
+          bthr[ 0 ].sock->count, (uint32_t) ndone, (uint32_t) NTHR );
+  if ( ndone != NTHR || bthr[ 1 ].sock->count != cnt ||
+       bthr[ 2 ].sock->count != cnt + 10 || bthr[ 0 ].sock->count != 0 )
+    fail++;
+
+  bus->release();
+  delete bus;
+  if ( fail == 0 )
+    printf( "success\n" );
+  else
+    printf( "failed : %d\n", fail );
+  return fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,583 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <raikv/ev_net.h>
+#include <raikv/ev_publish.h>
+#include <raikv/kv_pubsub.h>
+
+using namespace rai;
+using namespace kv;
+
+/* a subscriber connection, the msg data is written to the socket */
+struct TestConn : public EvConnection {
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  TestConn( EvPoll &p,  int fd ) : EvConnection( p, p.register_type( "tconn" ) ) {
+    this->PeerData::init_peer( p.get_next_id(), fd, -1, NULL, "tconn" );
+    p.add_sock( this );
+  }
+  virtual void process( void ) noexcept {
+    this->off = this->len;
+    this->pop( EV_PROCESS );
+  }
+  virtual void release( void ) noexcept {
+    this->EvConnection::release_buffers();
+  }
+  virtual bool on_msg( EvPublish &pub ) noexcept {
+    this->append( pub.msg, pub.msg_len );
+    this->msgs_sent++;
+    return this->idle_push_write();
+  }
+};
+
+/* a subscriber which references the msg, as KvPubSubPeer::on_msg() does */
+struct TestRefConn : public TestConn {
+  TestRefConn( EvPoll &p,  int fd ) : TestConn( p, fd ) {}
+  virtual bool on_msg( EvPublish &pub ) noexcept {
+    uint32_t ref_idx = this->poll.zero_copy_pub( pub );
+    if ( ref_idx == 0 )
+      return this->TestConn::on_msg( pub );
+    this->append_ref_iov( NULL, 0, pub.msg, pub.msg_len, ref_idx );
+    this->msgs_sent++;
+    return this->idle_push_write();
+  }
+};
+
+/* a publisher without a connection */
+struct TestSrc : public EvSocket {
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  TestSrc( EvPoll &p ) : EvSocket( p, p.register_type( "tsrc" ) ) {
+    this->sock_opts = OPT_NO_POLL;
+    this->PeerData::init_peer( p.get_next_id(), p.get_null_fd(), -1, NULL,
+                               "tsrc" );
+    p.add_sock( this );
+  }
+  virtual void write( void ) noexcept {}
+  virtual void read( void ) noexcept {}
+  virtual void process( void ) noexcept {}
+  virtual void release( void ) noexcept {}
+};
+
+static void
+subscribe( EvPoll &poll,  EvSocket &s,  const char *sub )
+{
+  size_t len = ::strlen( sub );
+  NotifySub nsub( sub, len, kv_crc_c( sub, len, 0 ), false, 'C', s );
+  poll.sub_route.add_sub( nsub );
+}
+
+static TestConn *
+make_conn( EvPoll &poll,  int *fd,  const char *sub )
+{
+  if ( ::socketpair( AF_UNIX, SOCK_STREAM, 0, fd ) != 0 )
+    return NULL;
+  ::fcntl( fd[ 0 ], F_SETFL, O_NONBLOCK );
+  ::fcntl( fd[ 1 ], F_SETFL, O_NONBLOCK );
+  TestConn * c = new ( aligned_malloc( sizeof( TestConn ) ) )
+    TestConn( poll, fd[ 0 ] );
+  subscribe( poll, *c, sub );
+  return c;
+}
+
+static void
+run( EvPoll &poll,  int cnt,  int ms )
+{
+  for ( int i = 0; i < cnt; i++ ) {
+    poll.dispatch();
+    poll.wait( ms );
+  }
+}
+
+static void
+publish( EvPoll &poll,  TestSrc &src,  const char *sub,  const void *msg,
+         size_t msg_len )
+{
+  size_t len = ::strlen( sub );
+  EvPublish pub( sub, len, NULL, 0, msg, msg_len, poll.sub_route, src,
+                 kv_crc_c( sub, len, 0 ), 0 );
+  poll.sub_route.forward_msg( pub );
+}
+
+static size_t
+drain( int fd,  char *buf,  size_t buflen )
+{
+  size_t  off = 0;
+  ssize_t n;
+  while ( off < buflen && (n = ::read( fd, &buf[ off ], buflen - off )) > 0 )
+    off += (size_t) n;
+  return off;
+}
+
+/* small writes are held and sent together when the timer expires, a hold
+ * that reaches wr_coalesce_size is sent without waiting */
+static int
+test_coalesce( void )
+{
+  static const uint32_t SMALL_CNT = 10, LARGE_CNT = 20;
+  EvPoll     poll;
+  TestSrc  * src;
+  TestConn * c;
+  int        fd[ 2 ], fail = 0, ret;
+  char       msg[ 1024 ], buf[ 64 * 1024 ];
+  size_t     n = 0;
+  uint32_t   i;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  poll.wr_coalesce_ns = 50 * 1000 * 1000; /* 50 ms */
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  if ( (c = make_conn( poll, fd, "co.x" )) == NULL )
+    return 1;
+  /* each msg is in a new dispatch, all are held */
+  for ( i = 0; i < SMALL_CNT; i++ ) {
+    ::snprintf( msg, sizeof( msg ), "msg.%04u", i );
+    publish( poll, *src, "co.x", msg, 8 );
+    ret = poll.dispatch();
+    poll.wait( 0 );
+    n += drain( fd[ 1 ], &buf[ n ], sizeof( buf ) - n );
+  }
+  /* not busy, the flush timer wakes up poll() */
+  if ( n != 0 || ( ret & EvPoll::DISPATCH_BUSY ) != 0 ||
+       poll.flush_timer.expires_ns == 0 || poll.wr_hold_cnt == 0 )
+    fail++;
+  for ( i = 0; i < 50 && n < SMALL_CNT * 8; i++ ) {
+    poll.wait( 20 );
+    poll.dispatch();
+    n += drain( fd[ 1 ], &buf[ n ], sizeof( buf ) - n );
+  }
+  if ( n != SMALL_CNT * 8 || ::memcmp( buf, "msg.0000msg.0001", 16 ) != 0 ||
+       c->send_count != 1 || poll.wr_send_cnt != 1 )
+    fail++;
+  printf( "coalesce %u msgs, %" PRIu64 " sends, %" PRIu64 " holds: %s\n",
+          SMALL_CNT, c->send_count, poll.wr_hold_cnt,
+          fail == 0 ? "ok" : "failed" );
+
+  /* a held write grows past wr_coalesce_size, it is sent on next dispatch */
+  publish( poll, *src, "co.x", msg, 8 );
+  poll.dispatch();
+  if ( ! c->in_queue( IN_FLUSH_QUEUE ) )
+    fail++;
+  ::memset( msg, 'x', sizeof( msg ) );
+  for ( i = 0; i < LARGE_CNT; i++ )
+    publish( poll, *src, "co.x", msg, sizeof( msg ) );
+  if ( c->in_queue( IN_FLUSH_QUEUE ) )
+    fail++;
+  poll.dispatch();
+  n = drain( fd[ 1 ], buf, sizeof( buf ) );
+  if ( n != 8 + LARGE_CNT * sizeof( msg ) || c->send_count != 2 )
+    fail++;
+  printf( "coalesce size %u bytes, %" PRIu64 " sends: %s\n", (uint32_t) n,
+          c->send_count, fail == 0 ? "ok" : "failed" );
+  ::close( fd[ 1 ] );
+  return fail;
+}
+
+/* the send buffers of a blocked sock are counted in send_mem, over the cap
+ * lossy msgs are dropped, reads are paused and the slow sock is closed */
+static int
+test_shed( void )
+{
+  EvPoll     poll;
+  TestSrc  * src;
+  TestConn * slow, * rd;
+  int        fd[ 2 ], rfd[ 2 ], fail = 0, i;
+  char       msg[ 1024 ], buf[ 64 * 1024 ];
+  uint64_t   sent, recv, t;
+  size_t     n;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  if ( (slow = make_conn( poll, fd, "sh.x" )) == NULL ||
+       (rd = make_conn( poll, rfd, "sh.rd" )) == NULL )
+    return 1;
+  subscribe( poll, *slow, "sh.lossy" );
+  poll.add_lossy( "sh.lossy", 8, false );
+  /* the peer doesn't read, the kernel buffer fills and the rest is queued */
+  ::memset( msg, 'x', sizeof( msg ) );
+  for ( i = 0; i < 1024; i++ ) {
+    publish( poll, *src, "sh.x", msg, sizeof( msg ) );
+    if ( i % 64 == 0 )
+      run( poll, 1, 0 );
+  }
+  run( poll, 4, 0 );
+  if ( slow->send_mem < poll.send_highwater ||
+       poll.send_mem != slow->send_mem + rd->send_mem ||
+       poll.send_mem_peak < poll.send_mem )
+    fail++;
+  printf( "send_mem %" PRIu64 " peak %" PRIu64 ": %s\n", poll.send_mem,
+          poll.send_mem_peak, fail == 0 ? "ok" : "failed" );
+
+  /* over the cap, lossy msgs to the slow sock are dropped */
+  poll.send_mem_max = poll.send_mem / 2;
+  poll.shed_policy  = SHED_DROP_LOSSY;
+  sent = slow->msgs_sent;
+  for ( i = 0; i < 100; i++ )
+    publish( poll, *src, "sh.lossy", msg, 8 );
+  if ( poll.shed_drop_cnt != 100 || slow->msgs_sent != sent )
+    fail++;
+  for ( i = 0; i < 10; i++ )
+    publish( poll, *src, "sh.x", msg, 8 );
+  if ( slow->msgs_sent != sent + 10 )
+    fail++;
+  printf( "lossy dropped %" PRIu64 ": %s\n", poll.shed_drop_cnt,
+          fail == 0 ? "ok" : "failed" );
+
+  /* over the cap, reads are limited to blocked_read_rate, writes are not */
+  poll.shed_policy       = SHED_PAUSE_READ;
+  poll.blocked_read_rate = 256 * 1024;
+  t = poll.current_mono_ns();
+  for ( i = 0; i < 100; i++ ) {
+    while ( ::write( rfd[ 1 ], msg, sizeof( msg ) ) > 0 )
+      ;
+    run( poll, 1, 1 );
+  }
+  t    = poll.current_mono_ns() - t;
+  recv = rd->bytes_recv;
+  if ( poll.shed_pause_cnt == 0 ||
+       recv > poll.blocked_read_rate * t / EvPoll::ONE_NS + 64 * 1024 )
+    fail++;
+  for ( i = 0; i < 100 && rd->pause_ns == 0; i++ ) {
+    while ( ::write( rfd[ 1 ], msg, sizeof( msg ) ) > 0 )
+      ;
+    run( poll, 1, 0 );
+  }
+  if ( rd->pause_ns == 0 )
+    fail++;
+  rd->append( "hello", 5 );
+  rd->idle_push_write();
+  run( poll, 1, 0 );
+  n = drain( rfd[ 1 ], buf, sizeof( buf ) );
+  if ( n != 5 || ::memcmp( buf, "hello", 5 ) != 0 )
+    fail++;
+  /* under the cap, paused reads resume */
+  poll.send_mem_max = 0;
+  run( poll, 4, 0 );
+  if ( poll.pause_list.count != 0 || rd->bytes_recv <= recv )
+    fail++;
+  printf( "paused %" PRIu64 ", read %" PRIu64 " bytes in %" PRIu64
+          " ms: %s\n", poll.shed_pause_cnt, recv, t / 1000000,
+          fail == 0 ? "ok" : "failed" );
+
+  /* over the cap, the sock with the most send mem is closed */
+  poll.send_mem_max = 1;
+  poll.shed_policy  = SHED_CLOSE_SLOW;
+  run( poll, 4, 0 );
+  n = drain( fd[ 1 ], buf, sizeof( buf ) );
+  while ( drain( fd[ 1 ], buf, sizeof( buf ) ) != 0 )
+    ;
+  if ( poll.shed_close_cnt != 1 || slow->sock_err != EV_ERR_SEND_MEM ||
+       ::read( fd[ 1 ], buf, 1 ) != 0 || poll.send_mem != rd->send_mem ||
+       rd->sock_err != 0 )
+    fail++;
+  printf( "closed %" PRIu64 " slow: %s\n", poll.shed_close_cnt,
+          fail == 0 ? "ok" : "failed" );
+  ::close( fd[ 1 ] );
+  ::close( rfd[ 1 ] );
+  return fail;
+}
+
+/* a write blocked sock holds the latest msg of a conflated subject, plain
+ * msgs are queued as usual, the held msgs are sent in the order they
+ * arrived when the sock is write ready */
+static int
+test_conflate( void )
+{
+  static const char expect[] = "P1;P2;P3;P4;P5;A5;B5;";
+  EvPoll     poll;
+  TestSrc  * src;
+  TestConn * c;
+  int        fd[ 2 ], fail = 0, i;
+  char       msg[ 1024 ], buf[ 64 * 1024 ], out[ 256 ];
+  size_t     n, j, outlen = 0;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  if ( (c = make_conn( poll, fd, "cf.p" )) == NULL )
+    return 1;
+  subscribe( poll, *c, "cf.a" );
+  subscribe( poll, *c, "cf.b" );
+  poll.add_conflate( "cf.a", 4, false );
+  poll.add_conflate( "cf.b", 4, false );
+  /* the peer doesn't read until the sock is write blocked */
+  ::memset( msg, 'x', sizeof( msg ) );
+  for ( i = 0; i < 4096 && ! c->test2( EV_WRITE_POLL, EV_WRITE_HI ); i++ ) {
+    publish( poll, *src, "cf.p", msg, sizeof( msg ) );
+    run( poll, 1, 0 );
+  }
+  if ( ! c->test( EV_WRITE_HI ) )
+    fail++;
+  for ( i = 1; i <= 5; i++ ) {
+    ::snprintf( msg, sizeof( msg ), "A%d;", i );
+    publish( poll, *src, "cf.a", msg, 3 );
+    ::snprintf( msg, sizeof( msg ), "B%d;", i );
+    publish( poll, *src, "cf.b", msg, 3 );
+    ::snprintf( msg, sizeof( msg ), "P%d;", i );
+    publish( poll, *src, "cf.p", msg, 3 );
+  }
+  PollStats st;
+  poll.poll_stats( st );
+  if ( c->msgs_conflated != 8 || st.conflated != 8 ||
+       ! poll.has_conflate( c->fd ) )
+    fail++;
+  /* read the backlog, the held msgs follow it */
+  for ( i = 0; i < 1000 && outlen < sizeof( expect ) - 1; i++ ) {
+    n = drain( fd[ 1 ], buf, sizeof( buf ) );
+    for ( j = 0; j < n; j++ )
+      if ( buf[ j ] != 'x' && outlen < sizeof( out ) - 1 )
+        out[ outlen++ ] = buf[ j ];
+    run( poll, 1, 1 );
+  }
+  out[ outlen ] = '\0';
+  if ( ::strcmp( out, expect ) != 0 || poll.has_conflate( c->fd ) ||
+       c->msgs_conflated != 8 )
+    fail++;
+  printf( "conflated %" PRIu64 ", recv \"%s\": %s\n", c->msgs_conflated, out,
+          fail == 0 ? "ok" : "failed" );
+  ::close( fd[ 1 ] );
+  return fail;
+}
+
+/* a msg which is not in a recv buffer is copied once to a pool buffer that
+ * the writers share, each writer derefs it after writev, it is freed after
+ * the poll ref is released */
+static int
+test_zero_copy( void )
+{
+  static const uint32_t PEERS = 3;
+  EvPoll        poll;
+  TestSrc     * src;
+  TestRefConn * c[ PEERS ];
+  int           fd[ PEERS ][ 2 ], fail = 0;
+  char          msg[ 4096 ], buf[ 8192 ];
+  uint32_t      i, zi;
+  size_t        zcnt;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  for ( i = 0; i < PEERS; i++ ) {
+    if ( ::socketpair( AF_UNIX, SOCK_STREAM, 0, fd[ i ] ) != 0 )
+      return 1;
+    ::fcntl( fd[ i ][ 1 ], F_SETFL, O_NONBLOCK );
+    c[ i ] = new ( aligned_malloc( sizeof( TestRefConn ) ) )
+      TestRefConn( poll, fd[ i ][ 0 ] );
+    subscribe( poll, *c[ i ], "zc.x" );
+  }
+  ::memset( msg, 'z', sizeof( msg ) );
+  zcnt = poll.zref.count;
+  publish( poll, *src, "zc.x", msg, sizeof( msg ) );
+  /* one copy, referenced by the poll and each writer */
+  if ( poll.zref.count != zcnt + 1 || poll.zref_pub.count != 1 )
+    return 1;
+  zi = poll.zref_pub.ptr[ 0 ];
+  ZeroRef & zr = poll.zref.ptr[ zi - 1 ];
+  if ( zr.owner != ZREF_POOL || zr.ref_count != 1 + PEERS ||
+       zr.buf_size != sizeof( msg ) || poll.zero_copy_ref_count( zi ) != PEERS )
+    fail++;
+  for ( i = 0; i < PEERS; i++ ) {
+    if ( c[ i ]->StreamBuf::ref_cnt != 1 || c[ i ]->StreamBuf::refs[ 0 ] != zi )
+      fail++;
+  }
+  /* each writer derefs after writev, the poll ref holds the buffer */
+  for ( i = 0; i < PEERS; i++ ) {
+    c[ i ]->write();
+    if ( zr.ref_count != PEERS - i || zr.buf == NULL ||
+         drain( fd[ i ][ 1 ], buf, sizeof( buf ) ) != sizeof( msg ) ||
+         ::memcmp( buf, msg, sizeof( msg ) ) != 0 )
+      fail++;
+  }
+  /* the event is done, the buffer is freed */
+  poll.zero_copy_release_pub();
+  if ( zr.ref_count != 0 || zr.buf != NULL || zr.buf_size != 0 ||
+       poll.zref_free != zi )
+    fail++;
+  printf( "zero copy %u peers, 1 copy, freed after the poll ref: %s\n",
+          PEERS, fail == 0 ? "ok" : "failed" );
+
+  /* a pub with the msg_ref of the freed buffer makes a new copy */
+  EvPublish pub( "zc.x", 4, NULL, 0, msg, sizeof( msg ), poll.sub_route,
+                 *src, kv_crc_c( "zc.x", 4, 0 ), 0 );
+  pub.msg_ref = zi;
+  if ( poll.zero_copy_pub( pub ) != zi || zr.ref_count != 2 ||
+       zr.buf == NULL || pub.msg == msg ||
+       ::memcmp( pub.msg, msg, sizeof( msg ) ) != 0 )
+    fail++;
+  poll.zero_copy_deref( zi, false );
+  poll.zero_copy_release_pub();
+  if ( zr.ref_count != 0 || zr.buf != NULL )
+    fail++;
+  printf( "zero copy stale msg_ref copied: %s\n",
+          fail == 0 ? "ok" : "failed" );
+  for ( i = 0; i < PEERS; i++ )
+    ::close( fd[ i ][ 1 ] );
+  return fail;
+}
+
+/* a kv pub sub without the ctrl file and listener, for the peers */
+static KvPubSub *
+make_kv( EvPoll &poll )
+{
+  PsCtrlFile * ctrl = (PsCtrlFile *) aligned_malloc( sizeof( PsCtrlFile ) );
+  ::memset( (void *) ctrl, 0, sizeof( PsCtrlFile ) );
+  return new ( aligned_malloc( sizeof( KvPubSub ) ) )
+    KvPubSub( poll.sub_route, *ctrl, "test_evflow", 0, "test_evflow" );
+}
+
+static KvPubSubPeer *
+make_kv_peer( EvPoll &poll,  KvPubSub &kv,  int *fd,  const char *sub )
+{
+  if ( ::socketpair( AF_UNIX, SOCK_STREAM, 0, fd ) != 0 )
+    return NULL;
+  ::fcntl( fd[ 1 ], F_SETFL, O_NONBLOCK );
+  KvPubSubPeer * peer = new ( aligned_malloc( sizeof( KvPubSubPeer ) ) )
+    KvPubSubPeer( poll, kv.peer_sock_type, kv );
+  peer->PeerData::init_peer( poll.get_next_id(), fd[ 0 ], -1, NULL, "kvpeer" );
+  poll.add_sock( peer );
+  subscribe( poll, *peer, sub );
+  return peer;
+}
+
+/* decode a KV_MSG_FWD of sub from buf, as the peer process does */
+static bool
+kv_fwd_decode( const char *buf,  size_t buflen,  const char *sub,
+               const void *data,  uint32_t data_len,  bool status,
+               size_t &msg_len )
+{
+  KvMsgIn    in;
+  uint32_t   sublen = (uint32_t) ::strlen( sub ), subject_len, len;
+  if ( in.decode( buf, (uint32_t) buflen ) != KV_MSG_OK ||
+       in.type != KV_MSG_FWD )
+    return false;
+  const char * subject = in.get_field( KV_FLD_SUBJECT, subject_len ),
+             * d       = in.get_field( KV_FLD_DATA, len );
+  msg_len = in.len;
+  return ! in.is_field_missing() && subject_len == sublen &&
+         ::memcmp( subject, sub, sublen ) == 0 && len == data_len &&
+         ::memcmp( d, data, len ) == 0 &&
+         in.is_set( KV_FLD_PUB_STATUS ) == status;
+}
+
+/* a KV_MSG_FWD with the data by reference is framed the same as a copy, with
+ * or without the pub_status field, the peer decodes each msg in sequence */
+static int
+test_kv_fwd( void )
+{
+  static const char     SUB[] = "kv.x";
+  static const uint32_t MSGS  = 3;
+  static const uint32_t size[ MSGS ] = { 2048, 5, 2048 };
+  EvPoll         poll;
+  TestSrc      * src;
+  KvPubSubPeer * peer;
+  int            fd[ 2 ], fail = 0;
+  char           msg[ 2048 ], buf[ 8192 ];
+  uint32_t       h = kv_crc_c( SUB, sizeof( SUB ) - 1, 0 ), cnt = 0;
+  size_t         n, off, len;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  if ( (peer = make_kv_peer( poll, *make_kv( poll ), fd, SUB )) == NULL )
+    return 1;
+
+  /* by reference, copied, by reference with a pub_status */
+  ::memset( msg, 'k', sizeof( msg ) );
+  publish( poll, *src, SUB, msg, sizeof( msg ) );
+  publish( poll, *src, SUB, "small", 5 );
+  EvPublish pub( SUB, sizeof( SUB ) - 1, NULL, 0, msg, sizeof( msg ),
+                 poll.sub_route, *src, h, 0 );
+  pub.pub_status = 1;
+  poll.sub_route.forward_msg( pub );
+  if ( peer->StreamBuf::ref_cnt != 2 )
+    fail++;
+  peer->write();
+  n = drain( fd[ 1 ], buf, sizeof( buf ) );
+  poll.zero_copy_release_pub();
+
+  for ( off = 0; off < n && cnt < MSGS; cnt++ ) {
+    if ( ! kv_fwd_decode( &buf[ off ], n - off, SUB,
+                          cnt == 1 ? (const void *) "small" : msg,
+                          size[ cnt ], cnt == 2, len ) ) {
+      fail++;
+      break;
+    }
+    off += len;
+  }
+  if ( cnt != MSGS || off != n )
+    fail++;
+  printf( "kv fwd %u msgs, %u bytes, 2 by reference: %s\n", cnt,
+          (uint32_t) n, fail == 0 ? "ok" : "failed" );
+  ::close( fd[ 1 ] );
+  return fail;
+}
+
+/* the pool buffer of a pub is shared by the kv peers, each sends a fwd
+ * which references it, it is freed after the writes and the poll ref */
+static int
+test_kv_pool( void )
+{
+  static const char     SUB[] = "kv.pool";
+  static const uint32_t PEERS = 3;
+  EvPoll         poll;
+  TestSrc      * src;
+  KvPubSub     * kv;
+  KvPubSubPeer * peer[ PEERS ];
+  int            fd[ PEERS ][ 2 ], fail = 0;
+  char           msg[ 4096 ], buf[ 8192 ];
+  uint32_t       i, zi;
+  size_t         n, len;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src = new ( aligned_malloc( sizeof( TestSrc ) ) ) TestSrc( poll );
+  kv  = make_kv( poll );
+  for ( i = 0; i < PEERS; i++ )
+    if ( (peer[ i ] = make_kv_peer( poll, *kv, fd[ i ], SUB )) == NULL )
+      return 1;
+  ::memset( msg, 'p', sizeof( msg ) );
+  publish( poll, *src, SUB, msg, sizeof( msg ) );
+  /* one pool copy, referenced by the poll and each peer */
+  if ( poll.zref_pub.count != 1 )
+    return 1;
+  zi = poll.zref_pub.ptr[ 0 ];
+  ZeroRef & zr = poll.zref.ptr[ zi - 1 ];
+  if ( zr.owner != ZREF_POOL || zr.ref_count != 1 + PEERS )
+    fail++;
+  for ( i = 0; i < PEERS; i++ ) {
+    if ( peer[ i ]->StreamBuf::ref_cnt != 1 ||
+         peer[ i ]->StreamBuf::refs[ 0 ] != zi )
+      fail++;
+    peer[ i ]->write();
+    n = drain( fd[ i ][ 1 ], buf, sizeof( buf ) );
+    if ( ! kv_fwd_decode( buf, n, SUB, msg, sizeof( msg ), false, len ) ||
+         len != n || zr.ref_count != PEERS - i )
+      fail++;
+  }
+  poll.zero_copy_release_pub();
+  if ( zr.ref_count != 0 || zr.buf != NULL || zr.buf_size != 0 )
+    fail++;
+  printf( "kv pool %u peers, 1 copy, fwd decoded: %s\n", PEERS,
+          fail == 0 ? "ok" : "failed" );
+  for ( i = 0; i < PEERS; i++ )
+    ::close( fd[ i ][ 1 ] );
+  return fail;
+}
+
+int
+main( void )
+{
+  int fail = 0;
+  fail += test_coalesce();
+  fail += test_shed();
+  fail += test_conflate();
+  fail += test_zero_copy();
+  fail += test_kv_fwd();
+  fail += test_kv_pool();
+  return fail == 0 ? 0 : 1;
+}
@@ -1,9 +1,17 @@
 #include <stdio.h>
 #include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 #include <raikv/shm_ht.h>
+#include <raikv/key_buf.h>
+#include <raikv/key_ctx.h>
 
 using namespace rai;
 using namespace kv;
@@ -20,11 +28,416 @@ main( void )
   geom.hash_value_ratio = 1;
   geom.cuckoo_buckets   = 0;
   geom.cuckoo_arity     = 0;
+  geom.cuckoo_path_depth = 0;
+  geom.ctx_count        = 0;
 
   if ( (map = HashTab::alloc_map( geom )) == NULL )
     return 1;
   map->hdr.ht_read_only = 1;
   fputs( print_map_geom( map, 0 ), stdout );
-  return 0;
+  delete map;
+
+  /* more than MAX_CTX_COUNT or an ext region too large for the map fails */
+  static const uint16_t bad_ctx[ 2 ] = { MAX_CTX_COUNT + 1, MAX_CTX_COUNT };
+  int fail = 0;
+  geom.map_size = 4 * 1024 * 1024;
+  for ( int k = 0; k < 2; k++ ) {
+    geom.ctx_count = bad_ctx[ k ];
+    if ( (map = HashTab::alloc_map( geom )) != NULL ) {
+      fail++;
+      delete map;
+    }
+  }
+  printf( "ctx_count %u and %u rejected: %s\n", (uint32_t) bad_ctx[ 0 ],
+          (uint32_t) bad_ctx[ 1 ], fail == 0 ? "ok" : "failed" );
+
+  /* more contexts than MAX_CTX_ID, each with a db stat */
+  static const uint32_t CTX_COUNT = 300;
+  uint32_t ctx_id[ CTX_COUNT ], dbx_id[ CTX_COUNT ], i;
+  geom.map_size         = 16 * 1024 * 1024;
+  geom.ctx_count        = 512;
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  for ( i = 0; i < CTX_COUNT; i++ ) {
+    ctx_id[ i ] = map->attach_ctx( 1000 + i );
+    dbx_id[ i ] = KV_NO_DBSTAT_ID;
+    if ( ctx_id[ i ] == KV_NO_CTX_ID ) {
+      fail++;
+      continue;
+    }
+    dbx_id[ i ] = map->attach_db( ctx_id[ i ], (uint8_t) ( i % 4 ) );
+    if ( dbx_id[ i ] == KV_NO_DBSTAT_ID || dbx_id[ i ] == MAX_STAT_ID )
+      fail++;
+  }
+  /* a key op from the last ctx updates its stats */
+  if ( fail == 0 ) {
+    KeyBuf kbuf;
+    KeyCtx kctx( *map, dbx_id[ CTX_COUNT - 1 ], &kbuf );
+    uint64_t h1 = 1, h2 = 2;
+    void   * ptr;
+    kbuf.copy( "hello", 5 );
+    kctx.set_hash( h1, h2 );
+    if ( kctx.acquire() <= KEY_IS_NEW &&
+         kctx.resize( &ptr, 8 ) == KEY_OK ) {
+      ::memcpy( ptr, "world!!!", 8 );
+      kctx.release();
+    }
+    else {
+      fail++;
+    }
+    if ( map->get_stats( dbx_id[ CTX_COUNT - 1 ] ).add != 1 )
+      fail++;
+  }
+  fputs( print_map_geom( map, ctx_id[ CTX_COUNT - 1 ] ), stdout );
+  for ( i = 0; i < CTX_COUNT; i++ )
+    map->detach_ctx( ctx_id[ i ] );
+  if ( (uint16_t) map->hdr.ctx_used != 0 )
+    fail++;
+  printf( "%u ctx of %u: %s\n", CTX_COUNT, map->max_ctx_count(),
+          fail == 0 ? "ok" : "failed" );
+  delete map;
+
+  /* compact 32 byte entries, key and value in segments */
+  geom.map_size         = 16 * 1024 * 1024;
+  geom.max_value_size   = 64 * 1024;
+  geom.hash_value_ratio = 0.25;
+  geom.ctx_count        = 0;
+  geom.hash_entry_size  = 64;
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  uint64_t ht_size64 = map->hdr.ht_size;
+  delete map;
+  geom.hash_entry_size  = 32;
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  if ( map->hdr.ht_size < ht_size64 * 2 - 2 || map->hdr.nsegs == 0 )
+    fail++;
+  {
+    static const uint32_t KEY_COUNT = 20000;
+    uint32_t    c = map->attach_ctx( 2000 ),
+                d = map->attach_db( c, 0 ),
+                ok = 0;
+    KeyBuf      kbuf;
+    KeyCtx      kctx( *map, d, &kbuf );
+    WorkAlloc8k wrk;
+    char        key[ 32 ], val[ 32 ];
+    void      * ptr;
+    uint64_t    sz;
+    size_t      klen, vlen;
+    for ( int pass = 0; pass < 4; pass++ ) {
+      for ( i = 0; i < KEY_COUNT; i++ ) {
+        klen = ::snprintf( key, sizeof( key ), "key.%u", i );
+        vlen = ::snprintf( val, sizeof( val ), "value.%u.%d", i, pass );
+        kbuf.copy( key, klen );
+        kctx.set_key_hash( kbuf );
+        wrk.reset();
+        if ( pass == 3 ) { /* drop the odd keys */
+          if ( ( i & 1 ) != 0 && kctx.acquire( &wrk ) == KEY_OK ) {
+            kctx.tombstone();
+            kctx.release();
+          }
+          continue;
+        }
+        if ( kctx.acquire( &wrk ) > KEY_IS_NEW )
+          continue;
+        /* stamps do not fit, the value grows on pass 1 */
+        if ( kctx.resize( &ptr, vlen + pass * 100 ) == KEY_OK &&
+             kctx.update_stamps( 1, 0 ) == KEY_ALLOC_FAILED ) {
+          ::memcpy( ptr, val, vlen );
+          ok++;
+        }
+        kctx.release();
+      }
+      for ( i = 0; i < KEY_COUNT; i++ ) {
+        KeyFragment * kp;
+        void        * data;
+        klen = ::snprintf( key, sizeof( key ), "key.%u", i );
+        vlen = ::snprintf( val, sizeof( val ), "value.%u.%d", i,
+                           pass < 3 ? pass : 2 );
+        kbuf.copy( key, klen );
+        kctx.set_key_hash( kbuf );
+        wrk.reset();
+        bool found = ( kctx.find( &wrk ) == KEY_OK &&
+                       kctx.get_key( kp ) == KEY_OK &&
+                       kp->keylen == klen &&
+                       ::memcmp( kp->u.buf, key, klen ) == 0 &&
+                       kctx.value( &data, sz ) == KEY_OK &&
+                       sz == vlen + ( pass < 3 ? pass : 2 ) * 100 &&
+                       ::memcmp( data, val, vlen ) == 0 );
+        if ( found != ( pass < 3 || ( i & 1 ) == 0 ) )
+          fail++;
+      }
+    }
+    if ( ok != KEY_COUNT * 3 )
+      fail++;
+    /* the same key with a different hash2 is not found */
+    kbuf.copy( "key.0", 5 );
+    kctx.set_key_hash( kbuf );
+    kctx.set_hash( kctx.key, kctx.key2 ^ 1 );
+    wrk.reset();
+    if ( kctx.find( &wrk ) == KEY_OK )
+      fail++;
+    map->detach_ctx( c );
+  }
+  printf( "compact entry %u ht_size %" PRIu64 " (64b %" PRIu64 "): %s\n",
+          map->hdr.hash_entry_size, map->hdr.ht_size, ht_size64,
+          fail == 0 ? "ok" : "failed" );
+  delete map;
+
+  /* an odd number of compact entries, the segs start after the last entry */
+  for ( geom.map_size = 16 * 1024 * 1024; ; geom.map_size += 64 ) {
+    if ( (map = HashTab::alloc_map( geom )) == NULL )
+      return 1;
+    if ( ( map->hdr.ht_size & 1 ) != 0 )
+      break;
+    delete map;
+  }
+  {
+    uint32_t    c = map->attach_ctx( 2500 ),
+                d = map->attach_db( c, 0 ),
+                ok = 0;
+    KeyBuf      kbuf;
+    KeyCtx      kctx( *map, d, &kbuf );
+    WorkAlloc8k wrk;
+    char        key[ 32 ];
+    void      * ptr;
+    size_t      klen;
+    if ( (uint8_t *) (void *) map->get_entry( map->hdr.ht_size ) >
+         (uint8_t *) map->seg_data( 0, 0 ) ||
+         map->hdr.seg[ 0 ].seg_off != map->hdr.seg_start() )
+      fail++;
+    for ( i = 0; i < 1000; i++ ) {
+      klen = ::snprintf( key, sizeof( key ), "odd.%u", i );
+      kbuf.copy( key, klen );
+      kctx.set_key_hash( kbuf );
+      wrk.reset();
+      if ( kctx.acquire( &wrk ) <= KEY_IS_NEW ) {
+        if ( kctx.resize( &ptr, klen ) == KEY_OK ) {
+          ::memcpy( ptr, key, klen );
+          ok++;
+        }
+        kctx.release();
+      }
+    }
+    if ( ok != 1000 )
+      fail++;
+    printf( "compact entry odd ht_size %" PRIu64 ": %s\n", map->hdr.ht_size,
+            fail == 0 ? "ok" : "failed" );
+    map->detach_ctx( c );
+  }
+  delete map;
+  geom.map_size         = 16 * 1024 * 1024;
+
+  /* db 1 over its quota evicts its own entries, db 2 is not touched */
+  geom.hash_entry_size  = 64;
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  {
+    static const uint32_t KEY_COUNT = 5000, MAX_ENTRIES = 1000,
+                          MAX_BYTES = 256 * 1024;
+    uint32_t    c  = map->attach_ctx( 3000 ),
+                d1 = map->attach_db( c, 1 ),
+                d2 = map->attach_db( c, 2 ),
+                found = 0;
+    KeyBuf      kbuf;
+    WorkAlloc8k wrk;
+    char        key[ 32 ], val[ 200 ];
+    void      * ptr;
+    size_t      klen;
+    ::memset( val, 'v', sizeof( val ) );
+    /* pass 1 is limited by bytes, pass 2 by entries */
+    for ( int pass = 0; pass < 3; pass++ ) {
+      KeyCtx kctx( *map, pass == 0 ? d2 : d1, &kbuf );
+      if ( pass == 1 ) {
+        map->set_db_quota( 2, 0, KEY_COUNT );
+        map->set_db_quota( 1, MAX_BYTES, MAX_ENTRIES );
+      }
+      else if ( pass == 2 )
+        map->set_db_quota( 1, 0, MAX_ENTRIES / 4 );
+      for ( i = 0; i < ( pass == 0 ? 500 : KEY_COUNT / 2 ); i++ ) {
+        klen = ::snprintf( key, sizeof( key ), "key.%u.%d", i, pass );
+        kbuf.copy( key, klen );
+        kctx.set_key_hash( kbuf );
+        wrk.reset();
+        if ( kctx.acquire( &wrk ) > KEY_IS_NEW ) {
+          fail++;
+          continue;
+        }
+        if ( kctx.resize( &ptr, sizeof( val ) ) == KEY_OK )
+          ::memcpy( ptr, val, sizeof( val ) );
+        else
+          fail++;
+        kctx.release();
+        if ( pass == 1 && ( map->db_quota( 1 ).over_entries( 0 ) ||
+                            map->db_quota( 1 ).over_bytes( 0 ) ) )
+          fail++;
+      }
+    }
+    KeyCtx kctx( *map, d2, &kbuf );
+    for ( i = 0; i < 500; i++ ) {
+      klen = ::snprintf( key, sizeof( key ), "key.%u.0", i );
+      kbuf.copy( key, klen );
+      kctx.set_key_hash( kbuf );
+      wrk.reset();
+      if ( kctx.find( &wrk ) == KEY_OK )
+        found++;
+    }
+    if ( found != 500 || map->db_quota( 2 ).entries.load() != 500 ||
+         map->db_quota( 1 ).entries.load() != MAX_ENTRIES / 4 ||
+         map->get_stats( d1 ).htevict == 0 ||
+         map->get_stats( d1 ).afail != 0 ||
+         map->get_stats( d2 ).htevict != 0 )
+      fail++;
+    printf( "db quota evict %" PRIu64 " of %u, %" PRIu64 " entries %" PRIu64
+            " bytes: %s\n", map->get_stats( d1 ).htevict, KEY_COUNT,
+            map->db_quota( 1 ).entries.load(),
+            map->db_quota( 1 ).bytes.load(), fail == 0 ? "ok" : "failed" );
+    /* a value larger than the byte quota can't be made to fit */
+    map->set_db_quota( 1, 64, 0 );
+    KeyCtx kctx1( *map, d1, &kbuf );
+    kbuf.copy( "key.big", 7 );
+    kctx1.set_key_hash( kbuf );
+    wrk.reset();
+    if ( kctx1.acquire( &wrk ) > KEY_IS_NEW )
+      fail++;
+    else {
+      if ( kctx1.resize( &ptr, sizeof( val ) ) != KEY_ALLOC_FAILED ||
+           map->get_stats( d1 ).afail == 0 )
+        fail++;
+      kctx1.release();
+    }
+    printf( "db quota %" PRIu64 " bytes, alloc failed: %s\n",
+            map->db_quota( 1 ).bytes.load(), fail == 0 ? "ok" : "failed" );
+    map->detach_ctx( c );
+  }
+  delete map;
+
+  /* a pinned reader keeps the value it found while it is replaced */
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  {
+    uint32_t    c = map->attach_ctx( 4000 ),
+                d = map->attach_db( c, 0 ),
+                same = 0;
+    KeyBuf      kbuf, rbuf;
+    KeyCtx      kctx( *map, d, &kbuf ),
+                rctx( *map, d, &rbuf );
+    WorkAlloc8k wrk, rwrk;
+    GCStats     pinned, freed;
+    char        key[ 32 ], val[ 500 ];
+    void      * ptr, * data = NULL;
+    uint64_t    sz = 0;
+    size_t      klen;
+    uint16_t    s;
+    pinned.zero();
+    freed.zero();
+    for ( int pass = 0; pass < 10; pass++ ) {
+      ::memset( val, 'a' + pass, sizeof( val ) );
+      for ( i = 0; i < 1000; i++ ) {
+        klen = ::snprintf( key, sizeof( key ), "key.%u", i );
+        kbuf.copy( key, klen );
+        kctx.set_key_hash( kbuf );
+        wrk.reset();
+        if ( kctx.acquire( &wrk ) <= KEY_IS_NEW &&
+             kctx.resize( &ptr, sizeof( val ) ) == KEY_OK )
+          ::memcpy( ptr, val, sizeof( val ) );
+        else
+          fail++;
+        kctx.release();
+      }
+      if ( pass == 0 ) {
+        rbuf.copy( "key.0", 5 );
+        rctx.set_key_hash( rbuf );
+        rctx.pin_read();
+        rctx.set( KEYCTX_NO_COPY_ON_READ );
+        if ( rctx.find( &rwrk ) != KEY_OK ||
+             rctx.value( &data, sz ) != KEY_OK || sz != sizeof( val ) )
+          fail++;
+      }
+    }
+    for ( i = 0; data != NULL && i < sz; i++ )
+      if ( ((char *) data)[ i ] == 'a' )
+        same++;
+    for ( s = 0; s < map->hdr.nsegs; s++ )
+      map->gc_segment( d, s, pinned );
+    rctx.unpin_read();
+    for ( s = 0; s < map->hdr.nsegs; s++ )
+      map->gc_segment( d, s, freed );
+    /* the pin is dropped, gc moves values again */
+    if ( same != sz || pinned.pinned == 0 || pinned.moved != 0 ||
+         freed.zombie == 0 || freed.pinned != 0 ||
+         map->hdr.pin_ctx_count != 0 )
+      fail++;
+    printf( "pinned read %u of %" PRIu64 " bytes, pinned %u, freed %u: %s\n",
+            same, sz, pinned.pinned, freed.zombie, fail == 0 ? "ok" : "failed" );
+    map->detach_ctx( c );
+  }
+  delete map;
+  geom.max_value_size   = 0;
+  geom.hash_value_ratio = 1;
+
+#if ! defined( _MSC_VER ) && ! defined( __MINGW32__ )
+  /* a child process dies holding a lock, recover_dead_ctx() releases it */
+  static const char MAP_NAME[] = "file:/tmp/test_min.shm";
+  geom.ctx_count = 0;
+  if ( (map = HashTab::create_map( MAP_NAME, 0, geom, 0600 )) == NULL )
+    return 1;
+  pid_t child = ::fork();
+  if ( child == 0 ) {
+    uint32_t c = map->attach_ctx( ::getpid() ),
+             d = map->attach_db( c, 0 );
+    KeyBuf kbuf;
+    KeyCtx kctx( *map, d, &kbuf );
+    kbuf.copy( "dead", 4 );
+    kctx.set_hash( 3, 4 );
+    kctx.acquire();
+    ::_exit( 0 ); /* without release */
+  }
+  ::waitpid( child, NULL, 0 );
+  uint32_t c = map->attach_ctx( ::getpid() ),
+           d = map->attach_db( c, 0 ),
+           n;
+  {
+    KeyBuf kbuf;
+    KeyCtx kctx( *map, d, &kbuf );
+    kbuf.copy( "dead", 4 );
+    kctx.set_hash( 3, 4 );
+    if ( kctx.try_acquire() != KEY_BUSY )
+      fail++;
+    n = map->recover_dead_ctx();
+    if ( n != 1 || map->hdr.recover.lock_recov != 1 ||
+         map->hdr.recover.ctx_detach != 1 )
+      fail++;
+    if ( kctx.try_acquire() > KEY_IS_NEW )
+      fail++;
+    else
+      kctx.release();
+  }
+  printf( "recovered %u dead ctx: %s\n", n, fail == 0 ? "ok" : "failed" );
+  /* a child dies without locks, it is detached, the live ctx is not */
+  child = ::fork();
+  if ( child == 0 ) {
+    map->attach_ctx( ::getpid() );
+    ::_exit( 0 ); /* without detach */
+  }
+  ::waitpid( child, NULL, 0 );
+  {
+    uint32_t used = map->hdr.ctx_used,
+             m    = map->recover_dead_ctx(),
+             k    = map->recover_dead_ctx(); /* already detached */
+    bool     ok   = ( m == 1 && k == 0 && map->hdr.recover.lock_recov == 1 &&
+                      map->hdr.recover.ctx_detach == 2 &&
+                      map->hdr.ctx_used == used - 1 &&
+                      map->get_ctx( c ).ctx_id == c );
+    printf( "recovered %u dead ctx without locks: %s\n", m,
+            ok ? "ok" : "failed" );
+    if ( ! ok )
+      fail++;
+  }
+  map->detach_ctx( c );
+  delete map;
+  HashTab::remove_map( MAP_NAME, 0 );
+#endif
+  return fail == 0 ? 0 : 1;
 }
 
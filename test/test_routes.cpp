@@ -4,7 +4,10 @@
 #include <stdint.h>
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <unistd.h>
 #include <raikv/route_db.h>
+#include <raikv/ev_net.h>
+#include <raikv/ev_publish.h>
 #include <raikv/util.h>
 #include <raikv/bit_set.h>
 
@@ -75,6 +78,9 @@ void print_routedb( RouteDB &rte )
   printf( "zht %" PRIu64 "/%" PRIu64 "\n", rte.zip.zht->elem_count, rte.zip.zht->tab_size() );
   printf( "cache_elems %" PRIu64 " cache_free %" PRIu64 "\n", rte.cache.end, rte.cache.free );
   printf( "entry_count %u cache_count %" PRIu64 "\n", rte.entry_count, rte.cache.count );
+  printf( "cache_hit %" PRIu64 " cache_miss %" PRIu64 " cache_inval %" PRIu64 " cache_evict %" PRIu64 "\n",
+          rte.cache.hit_cnt, rte.cache.miss_cnt, rte.cache.inval_cnt,
+          rte.cache.evict_cnt );
 }
 
 int
@@ -383,6 +389,280 @@ TestDB::remove_random( size_t count ) noexcept
   }
 }
 
+struct ShiftRemap : public RouteRemap {
+  virtual uint32_t remap( uint32_t r ) noexcept {
+    return ( r == 0 ) ? (uint32_t) -1 : r + 100; /* drop 0, shift others */
+  }
+};
+
+void
+snap_test( size_t cnt,  const char *path ) noexcept
+{
+  BloomDB db, db2;
+  TestDB test( db );
+  RouteDB rte( db2 );
+  uint32_t i, j, fail = 0;
+  test.generate_routes( cnt );
+  test.add_routes();
+  BloomRef * ref = test.rte.create_bloom_ref(
+    NULL, BloomBits::resize( NULL, 0, 20 ), "snap", db );
+  for ( i = 0; i < TestDB::SUB; i++ )
+    ref->add( hash_int( i + 1 ) );
+  if ( ! test.rte.save_snap( path ) || ! rte.attach_snap( path ) ) {
+    printf( "snap %s failed\n", path );
+    return;
+  }
+  ShiftRemap map;
+  uint32_t upd = rte.remap_snap( map );
+  for ( i = 0; i < TestDB::SUB; i++ ) {
+    RouteLookup look( NULL, 0, hash_int( i + 1 ), 0 );
+    uint32_t k = 0, r;
+    rte.get_sub_route( look );
+    if ( test.rdb[ i ].first( r ) ) {
+      do {
+        if ( r == 0 )
+          continue;
+        for ( j = 0; j < look.rcount; j++ )
+          if ( look.routes[ j ] == r + 100 )
+            break;
+        if ( j == look.rcount )
+          fail++;
+        k++;
+      } while ( test.rdb[ i ].next( r ) );
+    }
+    if ( k != look.rcount )
+      fail++;
+    look.deref( rte );
+  }
+  if ( ref->ref_num >= db2.count || db2[ ref->ref_num ] == NULL ||
+       db2[ ref->ref_num ]->bits->count != ref->bits->count )
+    fail++;
+  printf( "snap %s: entry_count %u/%u, remapped %u, %s\n", path,
+          rte.entry_count, test.rte.entry_count, upd,
+          fail == 0 ? "ok" : "failed" );
+}
+
+/* a queue member, counts the msgs selected, load is set by the test */
+struct QueueMember : public EvConnection {
+  uint64_t msg_cnt;
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  QueueMember( EvPoll &p ) : EvConnection( p, p.register_type( "qmember" ) ),
+                             msg_cnt( 0 ) {
+    this->sock_opts = OPT_NO_POLL;
+    this->PeerData::init_peer( p.get_next_id(), ::dup( p.get_null_fd() ), -1,
+                               NULL, "qmember" );
+    p.add_sock( this );
+  }
+  virtual void process( void ) noexcept {}
+  virtual void release( void ) noexcept {
+    this->EvConnection::release_buffers();
+  }
+  virtual bool on_msg( EvPublish & ) noexcept {
+    this->msg_cnt++;
+    return true;
+  }
+};
+
+struct QueueSrc : public EvSocket {
+  void * operator new( size_t, void *ptr ) { return ptr; }
+  QueueSrc( EvPoll &p ) : EvSocket( p, p.register_type( "qsrc" ) ) {
+    this->sock_opts = OPT_NO_POLL;
+    this->PeerData::init_peer( p.get_next_id(), p.get_null_fd(), -1, NULL,
+                               "qsrc" );
+    p.add_sock( this );
+  }
+  virtual void write( void ) noexcept {}
+  virtual void read( void ) noexcept {}
+  virtual void process( void ) noexcept {}
+  virtual void release( void ) noexcept {}
+};
+
+static const uint32_t QMEMBERS = 4, QMSGS = 1000;
+static const char QSUB[] = "q.test", QNAME[] = "qgrp";
+
+static void
+queue_publish( EvPoll &poll,  QueueSrc &src,  QueueMember **m,
+               uint64_t *cnt ) noexcept
+{
+  uint32_t h = kv_crc_c( QSUB, sizeof( QSUB ) - 1, 0 ), i;
+  for ( i = 0; i <= QMEMBERS; i++ ) /* m[ QMEMBERS ] is not in the queue */
+    m[ i ]->msg_cnt = 0;
+  for ( i = 0; i < QMSGS; i++ ) {
+    EvPublish pub( QSUB, sizeof( QSUB ) - 1, NULL, 0, "x", 1, poll.sub_route,
+                   src, h, 0 );
+    poll.sub_route.forward_msg( pub );
+  }
+  for ( i = 0; i < QMEMBERS; i++ )
+    cnt[ i ] = m[ i ]->msg_cnt;
+}
+
+/* members with different loads: m[0] and m[3] idle, m[1] has pending send
+ * bytes, m[2] is back pressured, check each policy selects by load */
+static uint32_t
+queue_test( void ) noexcept
+{
+  EvPoll        poll;
+  QueueSrc    * src;
+  QueueMember * m[ QMEMBERS + 1 ], * plain;
+  uint64_t      cnt[ QMEMBERS ];
+  uint32_t      i, h, qh, fail = 0;
+
+  if ( poll.init( 64, false ) != 0 )
+    return 1;
+  src   = new ( aligned_malloc( sizeof( QueueSrc ) ) ) QueueSrc( poll );
+  h     = kv_crc_c( QSUB, sizeof( QSUB ) - 1, 0 );
+  qh    = kv_crc_c( QNAME, sizeof( QNAME ) - 1, 0 );
+  for ( i = 0; i < QMEMBERS; i++ ) {
+    m[ i ] = new ( aligned_malloc( sizeof( QueueMember ) ) )
+      QueueMember( poll );
+    NotifyQueue nsub( QSUB, sizeof( QSUB ) - 1, NULL, 0, h, false, 'C',
+                      *m[ i ], QNAME, sizeof( QNAME ) - 1, qh );
+    poll.sub_route.add_sub_queue( nsub );
+  }
+  /* a plain sub on the same subject, it gets every msg */
+  plain = new ( aligned_malloc( sizeof( QueueMember ) ) ) QueueMember( poll );
+  m[ QMEMBERS ] = plain;
+  NotifySub psub( QSUB, sizeof( QSUB ) - 1, h, false, 'C', *plain );
+  poll.sub_route.add_sub( psub );
+
+  char junk[ 1000 ];
+  ::memset( junk, 'x', sizeof( junk ) );
+  m[ 1 ]->append( junk, sizeof( junk ) );
+  m[ 2 ]->push( EV_WRITE_HI );
+
+  QueueName qn( QNAME, sizeof( QNAME ) - 1, qh );
+  QueueDB & q = poll.sub_route.get_queue_db( qn );
+  /* group 0 is the sub_route, queue groups start at 1 in the cache key */
+  if ( q.route_group->group_num != 1 )
+    fail++;
+
+  /* round robin, each member is selected equally, load is not used */
+  q.select = QUEUE_ROUND_ROBIN;
+  queue_publish( poll, *src, m, cnt );
+  for ( i = 0; i < QMEMBERS; i++ )
+    if ( cnt[ i ] != QMSGS / QMEMBERS )
+      fail++;
+  if ( q.stats.select_cnt != QMSGS || q.stats.bp_cnt != QMSGS / QMEMBERS ||
+       q.stats.pending_sum != QMSGS / QMEMBERS * sizeof( junk ) ||
+       plain->msg_cnt != QMSGS )
+    fail++;
+  printf( "queue round robin %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+          ": %s\n", cnt[ 0 ], cnt[ 1 ], cnt[ 2 ], cnt[ 3 ],
+          fail == 0 ? "ok" : "failed" );
+
+  /* least load, only the idle members are selected, they share the msgs */
+  ::memset( &q.stats, 0, sizeof( q.stats ) );
+  q.select = QUEUE_LEAST_LOAD;
+  queue_publish( poll, *src, m, cnt );
+  if ( cnt[ 1 ] != 0 || cnt[ 2 ] != 0 || cnt[ 0 ] != QMSGS / 2 ||
+       cnt[ 3 ] != QMSGS / 2 )
+    fail++;
+  if ( q.stats.select_cnt != QMSGS || q.stats.bp_cnt != 0 ||
+       q.stats.pending_sum != 0 || plain->msg_cnt != QMSGS )
+    fail++;
+  printf( "queue least load %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+          ": %s\n", cnt[ 0 ], cnt[ 1 ], cnt[ 2 ], cnt[ 3 ],
+          fail == 0 ? "ok" : "failed" );
+
+  /* two choice, the back pressured member always loses, the pending member
+   * is selected only when paired with it */
+  ::memset( &q.stats, 0, sizeof( q.stats ) );
+  q.select = QUEUE_TWO_CHOICE;
+  queue_publish( poll, *src, m, cnt );
+  if ( cnt[ 2 ] != 0 || cnt[ 1 ] == 0 || cnt[ 1 ] >= cnt[ 0 ] ||
+       cnt[ 1 ] >= cnt[ 3 ] || cnt[ 0 ] + cnt[ 1 ] + cnt[ 3 ] != QMSGS )
+    fail++;
+  if ( q.stats.select_cnt != QMSGS || q.stats.bp_cnt != 0 ||
+       q.stats.pending_sum != cnt[ 1 ] * sizeof( junk ) )
+    fail++;
+  printf( "queue two choice %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+          ": %s\n", cnt[ 0 ], cnt[ 1 ], cnt[ 2 ], cnt[ 3 ],
+          fail == 0 ? "ok" : "failed" );
+
+  /* weighted 3:0:1:1, a zero weight is not selected */
+  ::memset( &q.stats, 0, sizeof( q.stats ) );
+  q.select = QUEUE_WEIGHTED;
+  q.set_weight( m[ 0 ]->fd, 3 );
+  q.set_weight( m[ 1 ]->fd, 0 );
+  if ( q.get_weight( m[ 0 ]->fd ) != 3 || q.get_weight( m[ 1 ]->fd ) != 0 ||
+       q.get_weight( m[ 2 ]->fd ) != 1 )
+    fail++;
+  queue_publish( poll, *src, m, cnt );
+  if ( cnt[ 0 ] != QMSGS * 3 / 5 || cnt[ 1 ] != 0 || cnt[ 2 ] != QMSGS / 5 ||
+       cnt[ 3 ] != QMSGS / 5 )
+    fail++;
+  if ( q.stats.select_cnt != QMSGS || q.stats.bp_cnt != QMSGS / 5 )
+    fail++;
+  printf( "queue weighted %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+          ": %s\n", cnt[ 0 ], cnt[ 1 ], cnt[ 2 ], cnt[ 3 ],
+          fail == 0 ? "ok" : "failed" );
+
+  /* a closed fd loses its weight, the next sock with the fd is 1 */
+  uint32_t fd = (uint32_t) m[ 1 ]->fd;
+  poll.remove_sock( m[ 1 ] );
+  if ( q.get_weight( fd ) != 1 || q.get_weight( m[ 0 ]->fd ) != 3 )
+    fail++;
+  printf( "queue weight removed on close: %s\n", fail == 0 ? "ok" : "failed" );
+  return fail;
+}
+
+/* more subjects than RouteCache::MAX_CACHE with adds and dels interleaved
+ * with lookups, the cache is evicted and invalidated and routes stay correct */
+static uint32_t
+cache_test( void ) noexcept
+{
+  static const uint32_t N   = RouteCache::MAX_CACHE + RouteCache::MAX_CACHE / 4,
+                        HOT = 64;
+  BloomDB   db;
+  RouteDB   rte( db );
+  uint8_t * cnt = (uint8_t *) ::calloc( N, sizeof( cnt[ 0 ] ) );
+  uint32_t  i, j, k, fail = 0;
+  rand::xoroshiro128plus r;
+  r.static_init();
+
+  for ( i = 0; i < N * 3; i++ ) {
+    if ( i < N ) {              /* fill, one route each */
+      k = i;
+      rte.add_sub_route( hash_int( k ), 1 );
+      cnt[ k ] = 1;
+    }
+    else {                      /* churn, the hot set is looked up below */
+      uint64_t val = r.next();
+      k = (uint32_t) ( val % N );
+      if ( ( val >> 32 ) % 2 == 0 ) {
+        if ( cnt[ k ] < 8 ) {
+          cnt[ k ]++;
+          rte.add_sub_route( hash_int( k ), cnt[ k ] );
+        }
+      }
+      else if ( cnt[ k ] > 0 ) {
+        rte.del_sub_route( hash_int( k ), cnt[ k ] );
+        cnt[ k ]--;
+      }
+    }
+    for ( j = 0; j < 2; j++ ) {
+      uint32_t x = ( j == 0 ? k : k % HOT );
+      RouteLookup look( NULL, 0, hash_int( x ), 0 );
+      rte.get_sub_route( look );
+      if ( look.rcount != cnt[ x ] )
+        fail++;
+      for ( uint32_t y = 0; y < look.rcount; y++ )
+        if ( look.routes[ y ] != y + 1 )
+          fail++;
+      look.deref( rte );
+    }
+  }
+  if ( rte.cache.hit_cnt == 0 || rte.cache.evict_cnt == 0 ||
+       rte.cache.count > RouteCache::MAX_CACHE )
+    fail++;
+  printf( "cache churn %u subs, hit %" PRIu64 " miss %" PRIu64
+          " inval %" PRIu64 " evict %" PRIu64 ": %s\n", N,
+          rte.cache.hit_cnt, rte.cache.miss_cnt, rte.cache.inval_cnt,
+          rte.cache.evict_cnt, fail == 0 ? "ok" : "failed" );
+  ::free( cnt );
+  return fail;
+}
+
 int
 main( int argc, char *argv[] )
 {
@@ -400,9 +680,15 @@ main( int argc, char *argv[] )
   size_t cnt = 8000;
   if ( argc > 1 && atoi( argv[ 1 ] ) > 0 )
     cnt = atoi( argv[ 1 ] );
+  if ( argc > 2 ) {
+    snap_test( cnt, argv[ 2 ] );
+    return 0;
+  }
   test.generate_routes( cnt );
   test.add_bloom_routes();
   test.verify_routes();
+  if ( queue_test() != 0 || cache_test() != 0 )
+    return 1;
   /*while ( test.sub_count > 1000 )
     test.remove_random( 1000 );
   test.verify_routes();*/
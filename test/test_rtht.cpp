@@ -92,6 +92,83 @@ struct SubTab : public RouteVec<RouteSub> {
   }
 };
 
+/* market data like subjects, which share a few long prefixes */
+static size_t
+make_subject( char *buf,  size_t i )
+{
+  static const char * pre[] = { "MD.EQUITY.NYSE.", "MD.EQUITY.NASDAQ.",
+                                "MD.EQUITY.LSE.", "MD.FX.SPOT.",
+                                "MD.FUTURES.CME." };
+  size_t len = ::strlen( pre[ i % 5 ] );
+  ::memcpy( buf, pre[ i % 5 ], len );
+  for ( i /= 5; ; i /= 26 ) {
+    buf[ len++ ] = (char) ( 'A' + i % 26 );
+    if ( i < 26 )
+      break;
+  }
+  return len;
+}
+
+/* insert, find and remove n subjects, print memory per subject */
+static bool
+mem_bench( size_t n,  bool prefix_z )
+{
+  RouteVec<RouteSub> vec;
+  char     buf[ 64 ], val[ 64 ];
+  size_t   i, len, sum = 0, cnt = 0;
+  uint64_t t, t2;
+  bool     ok = true;
+
+  if ( prefix_z )
+    vec.set_prefix_compress();
+  t = current_monotonic_time_ns();
+  for ( i = 0; i < n; i++ ) {
+    len  = make_subject( buf, i );
+    sum += len;
+    if ( vec.upsert( hash_f( buf, len ), buf, len ) == NULL )
+      ok = false;
+  }
+  t2 = current_monotonic_time_ns();
+  printf( "%s: %" PRIu64 " subjects, avg len %.1f, vec_count %u, "
+          "%.1f bytes per subject, insert %.1fns per\n",
+          prefix_z ? "prefix" : "plain", vec.pop_count(),
+          (double) sum / (double) n, vec.vec_size,
+          (double) vec.mem_size() / (double) n,
+          (double) ( t2 - t ) / (double) n );
+  t = current_monotonic_time_ns();
+  for ( i = 0; i < n; i++ ) {
+    RouteLoc loc;
+    len = make_subject( buf, i );
+    RouteSub * sub = vec.find( hash_f( buf, len ), buf, len, loc );
+    if ( sub != NULL && vec.value_len( loc, sub ) == len &&
+         vec.get_value( loc, sub, val ) == len &&
+         ::memcmp( buf, val, len ) == 0 )
+      cnt++;
+  }
+  t2 = current_monotonic_time_ns();
+  printf( "%s: find %" PRIu64 " of %" PRIu64 ", %.1fns per\n",
+          prefix_z ? "prefix" : "plain", cnt, n,
+          (double) ( t2 - t ) / (double) n );
+  if ( cnt != n )
+    ok = false;
+  for ( i = 0; i < n; i += 2 ) {
+    len = make_subject( buf, i );
+    if ( ! vec.remove( hash_f( buf, len ), buf, len ) )
+      ok = false;
+  }
+  for ( i = 0; i < n; i++ ) {
+    len = make_subject( buf, i );
+    if ( ( vec.find( hash_f( buf, len ), buf, len ) != NULL ) != ( i % 2 == 1 ) )
+      ok = false;
+  }
+  if ( vec.pop_count() != n / 2 )
+    ok = false;
+  printf( "%s: remove half, pop %" PRIu64 ", vec_count %u, %s\n",
+          prefix_z ? "prefix" : "plain", vec.pop_count(), vec.vec_size,
+          ok ? "ok" : "failed" );
+  return ok;
+}
+
 static const char * 
 get_arg( int argc, char *argv[], int b, const char *f, const char *def )
 {   
@@ -116,9 +193,19 @@ main( int argc, char *argv[] )
   const char * input = get_arg( argc, argv, 1, "-i", words ),
              * load  = get_arg( argc, argv, 1, "-l", NULL ),
              * save  = get_arg( argc, argv, 0, "-x", NULL ),
-             * fail  = get_arg( argc, argv, 0, "-f", NULL );
+             * fail  = get_arg( argc, argv, 0, "-f", NULL ),
+             * prez  = get_arg( argc, argv, 0, "-z", NULL ),
+             * bench = get_arg( argc, argv, 1, "-m", NULL );
   MapFile      map( input );
 
+  if ( bench != NULL ) {
+    size_t n = (size_t) atol( bench );
+    bool ok = mem_bench( n, false ) & mem_bench( n, true );
+    return ok ? 0 : 1;
+  }
+  if ( prez != NULL )
+    vec.set_prefix_compress();
+
   if ( load != NULL ) {
     if ( ! vec.load( load ) ) {
       fprintf( stderr, "load %s failed\n", load );
@@ -231,7 +318,7 @@ main( int argc, char *argv[] )
       RouteSub *d = vec.find_by_hash( h, loc );
       sum = 0;
       while ( d != NULL ) {
-        sum += d->len;
+        sum += vec.value_len( loc, d );
         d = vec.find_next_by_hash( h, loc );
       }
       if ( sum != isum ) {
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#ifndef _MSC_VER
+#include <unistd.h>
+#else
+#include <raikv/win.h>
+#endif
+#include <raikv/topic_log.h>
+#include <raikv/msg_cursor.h>
+
+using namespace rai;
+using namespace kv;
+
+static const char   SUB[]    = "test.topic";
+static const size_t SUB_LEN  = sizeof( SUB ) - 1;
+
+/* read everything from seqno, check msgs are in sequence */
+static uint64_t
+catch_up( TopicLog &log,  uint64_t &seqno,  int &fail )
+{
+  void     * msg[ 64 ];
+  msg_size_t msg_sz[ 64 ];
+  uint64_t   cnt, total = 0;
+  for (;;) {
+    cnt = 64;
+    if ( log.read( SUB, SUB_LEN, seqno, msg, msg_sz, cnt ) != KEY_OK )
+      break;
+    for ( uint64_t i = 0; i < cnt; i++ ) {
+      uint64_t n;
+      ::memcpy( &n, msg[ i ], sizeof( n ) );
+      if ( msg_sz[ i ] != sizeof( n ) || n != seqno + i ) {
+        printf( "seqno %" PRIu64 " has %" PRIu64 "\n", seqno + i, n );
+        fail++;
+      }
+    }
+    seqno += cnt;
+    total += cnt;
+  }
+  return total;
+}
+
+int
+main( int argc, char *argv[] )
+{
+  HashTabGeom geom;
+  HashTab   * map;
+  uint64_t    count = 10000, seqno, first, last, n, i, rd;
+  uint32_t    ctx_id, dbx_id;
+  int         fail = 0;
+
+  if ( argc > 1 && atoi( argv[ 1 ] ) > 0 )
+    count = atoi( argv[ 1 ] );
+  geom.map_size         = 64 * 1024 * 1024;
+  geom.max_value_size   = 1024 * 1024;
+  geom.hash_entry_size  = 64;
+  geom.hash_value_ratio = 0.5;
+  geom.cuckoo_buckets   = 0;
+  geom.cuckoo_arity     = 0;
+  geom.cuckoo_path_depth = 0;
+  geom.ctx_count        = 0;
+  if ( (map = HashTab::alloc_map( geom )) == NULL )
+    return 1;
+  ctx_id = map->attach_ctx( ::getpid() );
+  dbx_id = map->attach_db( ctx_id, 0 );
+
+  TopicLog pub( *map, dbx_id ),
+           sub( *map, dbx_id );
+  /* publish and catch up from the start */
+  for ( i = 0; i < count; i++ ) {
+    n = i;
+    if ( pub.publish( SUB, SUB_LEN, &n, sizeof( n ), seqno ) != KEY_OK ||
+         seqno != i ) {
+      printf( "publish %" PRIu64 " failed\n", i );
+      fail++;
+      break;
+    }
+  }
+  seqno = 0;
+  rd = catch_up( sub, seqno, fail );
+  printf( "published %" PRIu64 ", read %" PRIu64 ", next %" PRIu64 "\n",
+          count, rd, seqno );
+  if ( rd != count )
+    fail++;
+
+  /* trim half, reader starting at 0 skips to the first available */
+  pub.trim( SUB, SUB_LEN, count / 2 );
+  if ( sub.bounds( SUB, SUB_LEN, first, last ) != KEY_OK )
+    fail++;
+  seqno = 0;
+  rd = catch_up( sub, seqno, fail );
+  printf( "trimmed %" PRIu64 ", bounds %" PRIu64 " -> %" PRIu64
+          ", read %" PRIu64 "\n", count / 2, first, last, rd );
+  if ( last + 1 != count || first > count / 2 || rd != last + 1 - first )
+    fail++;
+
+  /* limited size, old msgs are dropped while publishing */
+  TopicLog lim( *map, dbx_id, 64 * 1024 );
+  for ( i = count; i < count * 4; i++ ) {
+    n = i;
+    if ( lim.publish( SUB, SUB_LEN, &n, sizeof( n ), seqno ) != KEY_OK ||
+         seqno != i ) {
+      printf( "publish %" PRIu64 " failed\n", i );
+      fail++;
+      break;
+    }
+  }
+  sub.bounds( SUB, SUB_LEN, first, last );
+  seqno = first;
+  rd = catch_up( sub, seqno, fail );
+  printf( "max_size %" PRIu64 ", bounds %" PRIu64 " -> %" PRIu64
+          ", read %" PRIu64 "\n", lim.max_size, first, last, rd );
+  /* the oldest chain is dropped, at least 2 * max_size of msgs remain */
+  if ( last + 1 != count * 4 || rd != last + 1 - first || first <= count ||
+       rd < 2 * lim.max_size / 16 )
+    fail++;
+  /* other append_vector() callers don't reuse the trimmed chains, the list
+   * is full when the head is */
+  lim.set_subject( SUB, SUB_LEN );
+  lim.wrk.reset();
+  i = 0;
+  n = last + 1;
+  if ( lim.kctx.acquire( &lim.wrk ) == KEY_OK ) {
+    if ( lim.kctx.append_msg( &n, sizeof( n ) ) == KEY_OK &&
+         lim.kctx.msg_chain_size > 2 ) {
+      ValueGeom mchain; /* trim chain 2 like TopicLog */
+      lim.kctx.msg->get_next( 2, mchain, lim.kctx.seg_align_shift );
+      lim.kctx.trim_msg( ( ( mchain.serial - lim.kctx.key ) &
+                           ValueCtr::SERIAL_MASK ) + 1 );
+      for ( i = 0; i < count * 4; i++ ) {
+        n = i;
+        if ( lim.kctx.append_msg( &n, sizeof( n ), lim.max_size ) != KEY_OK )
+          break;
+      }
+    }
+    lim.kctx.release();
+  }
+  printf( "append max_size %" PRIu64 ", full after %" PRIu64 ": %s\n",
+          lim.max_size, i,
+          i > 0 && i <= lim.max_size / 16 ? "ok" : "failed" );
+  if ( i == 0 || i > lim.max_size / 16 )
+    fail++;
+
+  /* cursor reads interleaved with publish, mostly from the cached geom */
+  static const char CUR_SUB[] = "test.cursor";
+  MsgCursor cur( *map, dbx_id );
+  cur.set_key( CUR_SUB, sizeof( CUR_SUB ) - 1, true );
+  cur.seek( 0 );
+  rd = 0;
+  for ( i = 0; i < count; i++ ) {
+    void     * msg[ 8 ];
+    msg_size_t msg_sz[ 8 ];
+    uint64_t   cnt = 8;
+    n = i;
+    pub.publish( CUR_SUB, sizeof( CUR_SUB ) - 1, &n, sizeof( n ), seqno );
+    if ( ( i % 3 ) != 0 )
+      continue;
+    while ( cur.read( first, msg, msg_sz, cnt ) == KEY_OK && cnt > 0 ) {
+      for ( uint64_t j = 0; j < cnt; j++ ) {
+        ::memcpy( &n, msg[ j ], sizeof( n ) );
+        if ( n != first + j || n != rd ) {
+          printf( "cursor seqno %" PRIu64 " has %" PRIu64 "\n", first + j, n );
+          fail++;
+        }
+        rd++;
+      }
+      cnt = 8;
+    }
+  }
+  printf( "cursor read %" PRIu64 ", hit %" PRIu64 ", miss %" PRIu64 "\n",
+          rd, cur.cache_hit, cur.cache_miss );
+  if ( rd != ( ( count - 1 ) / 3 ) * 3 + 1 || cur.cache_hit == 0 )
+    fail++;
+  /* keylen is used as is, the null is part of the key */
+  MsgCursor raw( *map, dbx_id );
+  raw.set_key( CUR_SUB, sizeof( CUR_SUB ) );
+  raw.seek( count - 1 );
+  {
+    void     * msg[ 1 ];
+    msg_size_t msg_sz[ 1 ];
+    uint64_t   cnt = 1;
+    n = 0;
+    if ( raw.read( first, msg, msg_sz, cnt ) == KEY_OK && cnt == 1 )
+      ::memcpy( &n, msg[ 0 ], sizeof( n ) );
+    printf( "raw key read %" PRIu64 ": %s\n", n,
+            n == count - 1 ? "ok" : "failed" );
+    if ( n != count - 1 )
+      fail++;
+  }
+
+  map->detach_ctx( ctx_id );
+  printf( "%s\n", fail == 0 ? "ok" : "failed" );
+  return fail == 0 ? 0 : 1;
+}
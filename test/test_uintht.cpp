@@ -11,11 +11,12 @@
 using namespace rai;
 using namespace kv;
 
-template <class Int, class Value, size_t iters>
+template <class Int, class Value, size_t iters, class Probe = LinearProbe>
 void
 do_test( const char *kind )
 {
-  IntHashTabT<Int,Value> *ht = IntHashTabT<Int,Value>::resize( NULL );
+  typedef IntHashTabT<Int,Value,Probe> HT;
+  HT     * ht = HT::resize( NULL );
   size_t   pos, i;
   Value    v;
   uint64_t t, ins_time, find_time, even_time, odd_time;
@@ -23,7 +24,7 @@ do_test( const char *kind )
   t = kv_current_monotonic_time_ns();
   for ( i = 0; i < iters; i++ ) {
     ht->upsert( Int( kv_hash_uint( (uint32_t) i ) ), Value( i ) );
-    IntHashTabT<Int,Value>::check_resize( ht );
+    HT::check_resize( ht );
   }
   ins_time = kv_current_monotonic_time_ns() - t;
 
@@ -45,7 +46,7 @@ do_test( const char *kind )
     }
     else {
       ht->remove( pos );
-      IntHashTabT<Int,Value>::check_resize( ht );
+      HT::check_resize( ht );
     }
   }
   even_time = kv_current_monotonic_time_ns() - t;
@@ -57,7 +58,7 @@ do_test( const char *kind )
     }
     else {
       ht->remove( pos );
-      IntHashTabT<Int,Value>::check_resize( ht );
+      HT::check_resize( ht );
     }
   }
   odd_time = kv_current_monotonic_time_ns() - t;
@@ -72,11 +73,11 @@ do_test( const char *kind )
   delete ht;
 }
 
-template <class Int, class Value, size_t iters>
+template <class Int, class Value, size_t iters, class Probe = LinearProbe>
 void
 do_test2( const char *kind )
 {
-  IntHashTabX<Int,Value> ht;
+  IntHashTabX<Int,Value,Probe> ht;
   size_t   pos, i;
   Value    v;
   uint64_t t, ins_time, find_time, even_time, odd_time;
@@ -129,18 +130,19 @@ do_test2( const char *kind )
            (double) odd_time / (double) iters / 2 );
 }
 
-template <class Int, size_t iters>
+template <class Int, size_t iters, class Probe = LinearProbe>
 void
 do_test3( const char *kind )
 {
-  IntHashTabU<Int> *ht = IntHashTabU<Int>::resize( NULL );
+  typedef IntHashTabU<Int,Probe> HT;
+  HT     * ht = HT::resize( NULL );
   size_t   pos, i;
   uint64_t t, ins_time, find_time, even_time, odd_time;
 
   t = kv_current_monotonic_time_ns();
   for ( i = 0; i < iters; i++ ) {
     ht->upsert( Int( kv_hash_uint( (uint32_t) i ) ) );
-    IntHashTabU<Int>::check_resize( ht );
+    HT::check_resize( ht );
   }
   ins_time = kv_current_monotonic_time_ns() - t;
 
@@ -159,7 +161,7 @@ do_test3( const char *kind )
     }
     else {
       ht->remove( pos );
-      IntHashTabU<Int>::check_resize( ht );
+      HT::check_resize( ht );
     }
   }
   even_time = kv_current_monotonic_time_ns() - t;
@@ -171,7 +173,7 @@ do_test3( const char *kind )
     }
     else {
       ht->remove( pos );
-      IntHashTabU<Int>::check_resize( ht );
+      HT::check_resize( ht );
     }
   }
   odd_time = kv_current_monotonic_time_ns() - t;
@@ -186,6 +188,75 @@ do_test3( const char *kind )
   delete ht;
 }
 
+/* random hash values, crc of a counter fills a table too evenly */
+static inline uint32_t
+mix_hash( size_t i )
+{
+  uint32_t h = (uint32_t) i * 0x9e3779b1U;
+  h ^= h >> 16; h *= 0x85ebca6bU; h ^= h >> 13;
+  return h;
+}
+/* fill a fixed size table to load %, measure probe lengths and lookup time */
+template <class Probe>
+void
+do_load( const char *kind,  uint32_t load )
+{
+  typedef IntHashTabT<uint32_t,uint32_t,Probe> HT;
+  static const size_t TAB_SIZE = 64 * 1024,
+                      LOOKUPS  = 4 * 1024 * 1024;
+  const size_t cnt = TAB_SIZE * load / 100;
+  HT     * ht = new ( ::malloc( HT::alloc_size( TAB_SIZE ) ) ) HT( TAB_SIZE );
+  size_t   pos, i, j, dist, hit_sum = 0, hit_max = 0, miss_sum = 0;
+  uint32_t v, h;
+  uint64_t t, hit_time, miss_time, sum = 0;
+
+  for ( i = 0; i < cnt; i++ ) {
+    h = mix_hash( i );
+    ht->find( h, pos );
+    ht->set( h, pos, (uint32_t) i );
+  }
+  for ( i = 0; i < cnt; i++ ) {
+    h = mix_hash( i );
+    if ( ! ht->find( h, pos ) )
+      fprintf( stderr, "not found %" PRIu64 "\n", (uint64_t) i );
+    dist = ( ( pos - ( h & ht->tab_mask ) ) & ht->tab_mask ) + 1;
+    hit_sum += dist;
+    if ( dist > hit_max )
+      hit_max = dist;
+  }
+  for ( i = 0; i < cnt; i++ ) {
+    h = mix_hash( i + cnt );
+    if ( ht->find( h, pos ) )
+      fprintf( stderr, "found %" PRIu64 "\n", (uint64_t) i );
+    /* miss probes stop at pos, the empty or displaced slot */
+    miss_sum += ( ( pos - ( h & ht->tab_mask ) ) & ht->tab_mask ) + 1;
+  }
+  t = kv_current_monotonic_time_ns();
+  for ( i = 0, j = 0; i < LOOKUPS; i++ ) {
+    if ( ht->find( mix_hash( j ), pos, v ) )
+      sum += v;
+    if ( ++j == cnt )
+      j = 0;
+  }
+  hit_time = kv_current_monotonic_time_ns() - t;
+  t = kv_current_monotonic_time_ns();
+  for ( i = 0, j = cnt; i < LOOKUPS; i++ ) {
+    if ( ht->find( mix_hash( j ), pos, v ) )
+      sum += v;
+    if ( ++j == cnt * 2 )
+      j = cnt;
+  }
+  miss_time = kv_current_monotonic_time_ns() - t;
+
+  printf( "%s load %u%% probe hit avg %.2f max %" PRIu64 ", miss avg %.2f, "
+          "ns per hit %.2f, miss %.2f (%" PRIu64 ")\n", kind, load,
+          (double) hit_sum / (double) cnt, (uint64_t) hit_max,
+          (double) miss_sum / (double) cnt,
+          (double) hit_time / (double) LOOKUPS,
+          (double) miss_time / (double) LOOKUPS, sum % 10 );
+  delete ht;
+}
+
 struct Hash {
   uint32_t hash[ 4 ];
   Hash() {}
@@ -233,6 +304,21 @@ main( void )
     do_test3<uint32_t, 50000>( t1 );
     do_test3<uint64_t, 50000>( t2 );
     do_test3<Hash, 50000>( t3 );
+
+    printf( "\nrobin hood\n" );
+    do_test<uint32_t, uint32_t, 50000, RobinHoodProbe>( t1 );
+    do_test<uint64_t, uint64_t, 50000, RobinHoodProbe>( t2 );
+    do_test<Hash, uint32_t, 50000, RobinHoodProbe>( t3 );
+    do_test2<uint32_t, uint32_t, 50000, RobinHoodProbe>( t1 );
+    do_test2<Hash, uint32_t, 50000, RobinHoodProbe>( t3 );
+    do_test3<uint32_t, 50000, RobinHoodProbe>( t1 );
+    do_test3<Hash, 50000, RobinHoodProbe>( t3 );
+  }
+
+  printf( "\nload\n" );
+  for ( uint32_t load = 50; load <= 90; load += 10 ) {
+    do_load<LinearProbe>( "linear", load );
+    do_load<RobinHoodProbe>( "robin ", load );
   }
 
   return 0;
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdlib.h>
+#include <raikv/util.h>
+#include <raikv/wild_match.h>
+
+using namespace rai;
+using namespace kv;
+
+/* the same patterns and results as test_wild, which uses pcre */
+static int
+do_match( PatternFmt fmt,  const char **pat,  size_t pc,
+          const char **match,  size_t mc,  const int *mat )
+{
+  int fail = 0;
+  for ( size_t i = 0; i < pc; i++ ) {
+    for ( size_t j = 0; j < mc; j++ ) {
+      bool b = WildMatch::match( fmt, pat[ i ], ::strlen( pat[ i ] ),
+                                 match[ j ], ::strlen( match[ j ] ) );
+      if ( ( b ? 1 : -1 ) != mat[ i * mc + j ] ) {
+        printf( "%s == %s failed\n", pat[ i ], match[ j ] );
+        fail++;
+      }
+    }
+  }
+  return fail;
+}
+
+/* compare the trie with matching each pattern */
+static int
+do_trie( PatternFmt fmt,  const char **pat,  size_t pc,
+         const char **match,  size_t mc )
+{
+  WildTrie     t;
+  WildMatchIds ids;
+  int          fail = 0;
+  size_t       i, j, k;
+
+  for ( i = 0; i < pc; i++ )
+    t.add( pat[ i ], ::strlen( pat[ i ] ), fmt, (uint32_t) i );
+  for ( int pass = 0; pass < 2; pass++ ) {
+    for ( j = 0; j < mc; j++ ) {
+      ids.count = 0;
+      t.match( match[ j ], ::strlen( match[ j ] ), ids );
+      for ( i = 0; i < pc; i++ ) {
+        bool b = ( pass == 0 || ( i % 2 ) == 1 ) &&
+                 WildMatch::match( fmt, pat[ i ], ::strlen( pat[ i ] ),
+                                   match[ j ], ::strlen( match[ j ] ) );
+        size_t n = 0;
+        for ( k = 0; k < ids.count; k++ )
+          if ( ids.ptr[ k ] == i )
+            n++;
+        if ( n != ( b ? 1 : 0 ) ) {
+          printf( "trie %s == %s failed (%" PRIu64 ")\n", pat[ i ], match[ j ],
+                  (uint64_t) n );
+          fail++;
+        }
+      }
+    }
+    /* remove the even, match again */
+    for ( i = 0; pass == 0 && i < pc; i += 2 )
+      if ( ! t.remove( pat[ i ], ::strlen( pat[ i ] ), fmt, (uint32_t) i ) )
+        fail++;
+  }
+  for ( i = 1; i < pc; i += 2 )
+    if ( ! t.remove( pat[ i ], ::strlen( pat[ i ] ), fmt, (uint32_t) i ) )
+      fail++;
+  if ( t.pattern_count != 0 || t.node.ptr[ 0 ]->ref != 0 )
+    fail++;
+  return fail;
+}
+
+int
+main( int argc, char *argv[] )
+{
+  const char *pat[] = {
+    "h?ll*",
+    "h*llo",
+    "h[ae]llo",
+    "h[^e]llo",
+    "h[a-b]llo",
+    "hello*"
+  };
+  const char *match[] = {
+    "hello",
+    "hallo",
+    "hxllo",
+    "hllo",
+    "heeeello",
+    "hbllo",
+    "ehello",
+    "helloworld"
+  };
+  int mat[] = {
+                  /* "hello", "hallo", "hxllo", "hllo", "heeeello", "hbllo", "ehello", "helloworld" */
+  /* "h?ll*"     */        1,       1,       1,     -1,         -1,       1,       -1,           1,
+  /* "h*llo"     */        1,       1,       1,      1,          1,       1,       -1,          -1,
+  /* "h[ae]llo"  */        1,       1,      -1,     -1,         -1,      -1,       -1,          -1,
+  /* "h[^e]llo"  */       -1,       1,       1,     -1,         -1,       1,       -1,          -1,
+  /* "h[a-b]llo" */       -1,       1,      -1,     -1,         -1,       1,       -1,          -1,
+  /* "hello*"    */        1,      -1,      -1,     -1,         -1,      -1,       -1,           1,
+  };
+
+  const char *patrv[] = {
+    "hello.*",
+    "hello.>",
+    "hello.*.>(0,4)",
+    "*.again",
+    "hello.*.again",
+    "hello.*.*(1,4)"
+  };
+  const char *matchrv[] = {
+    "hello.world",
+    "hallo",
+    "hello.world.again",
+    "testing.again",
+    "he.world"
+  };
+  int matrv[] = {
+                      /* "hello.world", "hallo", "hello.world.again", "testing.again", "he.world" */
+  /* "hello.*"       */              1,      -1,                  -1,              -1,         -1,
+  /* "hello.>"       */              1,      -1,                   1,              -1,         -1,
+  /* "hello.*.>"     */             -1,      -1,                   1,              -1,         -1,
+  /* "*.again"       */             -1,      -1,                  -1,               1,         -1,
+  /* "hello.*.again" */             -1,      -1,                   1,              -1,         -1,
+  /* "hello.*.*      */             -1,      -1,                   1,              -1,         -1,
+  };
+  /* segment edge cases for the trie */
+  const char *patseg[] = {
+    ">", "*", "a.>", "a.*", "a.*.>", "a*", "a.b*", "*.b", "a.>.c", "a.",
+    "a..b", "*.*", "a.b", "a.b.c", "a.*.c", ".>", "a.b>", "x*.b", "a.>(1,2)"
+  };
+  const char *matchseg[] = {
+    "", "a", "a.", "a.b", "a.b.c", "a..b", ".b", "ab", "ab.b", "a.bc",
+    "a.b.c.d", "x.b", "xy.b", "a.x.c", "b", "a.b.", "."
+  };
+  const char *patglob[] = {
+    "*", "a.*", "a*", "a.b", "a.?", "a.[bc]", "a.\\*", "*.b", "a.b.*",
+    "a.b*", "[ab].b", "a.b(0,2)"
+  };
+  const char *matchglob[] = {
+    "", "a", "a.", "a.b", "a.c", "a.*", "a.bc", "b.b", "a.b.c", "ab", "x.b"
+  };
+  const size_t pc   = sizeof( pat ) / sizeof( pat[ 0 ] ),
+               mc   = sizeof( match ) / sizeof( match[ 0 ] ),
+               prvc = sizeof( patrv ) / sizeof( patrv[ 0 ] ),
+               mrvc = sizeof( matchrv ) / sizeof( matchrv[ 0 ] ),
+               psc  = sizeof( patseg ) / sizeof( patseg[ 0 ] ),
+               msc  = sizeof( matchseg ) / sizeof( matchseg[ 0 ] ),
+               pgc  = sizeof( patglob ) / sizeof( patglob[ 0 ] ),
+               mgc  = sizeof( matchglob ) / sizeof( matchglob[ 0 ] );
+  int fail = 0;
+
+  fail += do_match( GLOB_PATTERN_FMT, pat, pc, match, mc, mat );
+  fail += do_match( RV_PATTERN_FMT, patrv, prvc, matchrv, mrvc, matrv );
+  fail += do_trie( GLOB_PATTERN_FMT, pat, pc, match, mc );
+  fail += do_trie( RV_PATTERN_FMT, patrv, prvc, matchrv, mrvc );
+  fail += do_trie( RV_PATTERN_FMT, patseg, psc, matchseg, msc );
+  fail += do_trie( GLOB_PATTERN_FMT, patglob, pgc, matchglob, mgc );
+
+  /* many patterns, one match walks the trie */
+  size_t count = 50000;
+  if ( argc > 1 && atoi( argv[ 1 ] ) > 0 )
+    count = atoi( argv[ 1 ] );
+  WildTrie     t;
+  WildMatchIds ids;
+  char         buf[ 64 ];
+  size_t       i, n = 0;
+  for ( i = 0; i < count; i++ ) {
+    size_t len = ::snprintf( buf, sizeof( buf ), "quote.%" PRIu64 ".*",
+                             (uint64_t) i );
+    t.add( buf, len, RV_PATTERN_FMT, (uint32_t) i );
+  }
+  t.add( "quote.>", 7, RV_PATTERN_FMT, (uint32_t) count );
+  uint64_t t1 = kv_get_rdtsc();
+  for ( i = 0; i < count; i++ ) {
+    size_t len = ::snprintf( buf, sizeof( buf ), "quote.%" PRIu64 ".NYSE",
+                             (uint64_t) i );
+    ids.count = 0;
+    if ( t.match( buf, len, ids ) == 2 && ids.ptr[ 1 ] == i )
+      n++;
+  }
+  uint64_t t2 = kv_get_rdtsc();
+  printf( "%" PRIu64 " patterns, %" PRIu64 " matched, avg %" PRIu64
+          " cycles\n", (uint64_t) count, (uint64_t) n,
+          ( t2 - t1 ) / ( count > 0 ? count : 1 ) );
+  if ( n != count )
+    fail++;
+
+  if ( fail == 0 )
+    printf( "success\n" );
+  else
+    printf( "failed : %d\n", fail );
+  return fail == 0 ? 0 : 1;
+}